@@ -0,0 +1,164 @@
+/**
+ * Decoder for compressed reading blocks (application/octet-stream)
+ * Mirrors firmware/esp32_boiler_controller/src/reading_codec.cpp; the bit
+ * stream layout is described in include/reading_codec.h.
+ */
+
+const RCODEC_VERSION = 1;
+const RCODEC_HEADER_SIZE = 3;
+
+// SD_REC_* flags of sd_log_record_t
+const REC_BLOWDOWN = 0x01;
+const REC_PUMP1 = 0x02;
+const REC_PUMP2 = 0x04;
+const REC_PUMP3 = 0x08;
+const REC_FW_PUMP = 0x10;
+const REC_COND_VALID = 0x20;
+const REC_TEMP_VALID = 0x40;
+
+class BitReader {
+  constructor(buf, offset) {
+    this.buf = buf;
+    this.pos = offset * 8;
+    this.len = buf.length * 8;
+  }
+
+  get(bits) {
+    let v = 0;
+    for (let i = 0; i < bits; i++) {
+      if (this.pos >= this.len) throw new Error('block truncated');
+      v = (v * 2) + ((this.buf[this.pos >> 3] >> (7 - (this.pos & 7))) & 1);
+      this.pos++;
+    }
+    return v;                       // Unsigned, up to 32 bits
+  }
+
+  getVar() {
+    if (this.get(1) === 0) return 0;
+    let v = 0;
+    for (let shift = 0; shift < 32; shift += 4) {
+      v += this.get(4) * 2 ** shift;
+      if (this.get(1) === 0) break;
+    }
+    return v >>> 0;
+  }
+
+  getDelta() {
+    const v = this.getVar();
+    return (v >>> 1) ^ -(v & 1);    // Zigzag back to signed
+  }
+}
+
+const f32 = new DataView(new ArrayBuffer(4));
+const floatOf = (bits) => { f32.setUint32(0, bits >>> 0); return f32.getFloat32(0); };
+const int16 = (v) => (v << 16) >> 16;
+
+/**
+ * Decode one block into sd_log_record_t fields
+ * @returns {object[]} records
+ */
+function decodeRecords(buf) {
+  if (buf.length < RCODEC_HEADER_SIZE || buf[0] !== RCODEC_VERSION) {
+    throw new Error('not a reading block (version ' + RCODEC_VERSION + ' expected)');
+  }
+  const count = buf[1] | (buf[2] << 8);
+  const r = new BitReader(buf, RCODEC_HEADER_SIZE);
+  const records = [];
+  let p = {
+    timestamp: 0, conductivity_bits: 0, temperature_d: 0, flow_cgpm: 0, valve_dmA: 0,
+    measurement_age_ms: 0, water_meter1: 0, water_meter2: 0,
+    fw_pump_cycle_count: 0, fw_pump_on_time_sec: 0,
+    flags: 0, safe_mode: 0, devices_operational: 0, devices_faulted: 0,
+    active_alarms: 0, devices_faulted_mask: 0,
+  };
+  let prevDelta = 0;
+  let xorLeading = 0;
+  let xorLength = 0;
+
+  for (let i = 0; i < count; i++) {
+    const c = { ...p };
+
+    if (i === 0) {
+      c.timestamp = r.get(32);
+      prevDelta = 0;
+      c.conductivity_bits = r.get(32);
+    } else {
+      let dod;
+      if (r.get(1) === 0) dod = 0;
+      else if (r.get(1) === 0) dod = r.get(7) - 63;
+      else if (r.get(1) === 0) dod = r.get(9) - 255;
+      else if (r.get(1) === 0) dod = r.get(12) - 2047;
+      else dod = r.get(32) | 0;
+      prevDelta = (prevDelta + dod) | 0;
+      c.timestamp = (p.timestamp + prevDelta) >>> 0;
+
+      if (r.get(1) === 1) {
+        if (r.get(1) === 1) {
+          xorLeading = r.get(5);
+          xorLength = r.get(5) + 1;
+        }
+        if (xorLength === 0 || xorLeading + xorLength > 32) throw new Error('block corrupt');
+        const x = r.get(xorLength) * 2 ** (32 - xorLeading - xorLength);
+        c.conductivity_bits = (p.conductivity_bits ^ x) >>> 0;
+      }
+    }
+
+    c.temperature_d = int16(p.temperature_d + r.getDelta());
+    c.flow_cgpm = (p.flow_cgpm + r.getDelta()) & 0xFFFF;
+    c.valve_dmA = int16(p.valve_dmA + r.getDelta());
+    c.measurement_age_ms = (p.measurement_age_ms + r.getDelta()) >>> 0;
+    c.water_meter1 = (p.water_meter1 + r.getDelta()) >>> 0;
+    c.water_meter2 = (p.water_meter2 + r.getDelta()) >>> 0;
+    c.fw_pump_cycle_count = (p.fw_pump_cycle_count + r.getDelta()) >>> 0;
+    c.fw_pump_on_time_sec = (p.fw_pump_on_time_sec + r.getDelta()) >>> 0;
+
+    if (r.get(1) === 1) {
+      if (r.get(1)) c.flags = r.get(8);
+      if (r.get(1)) c.safe_mode = r.get(8);
+      if (r.get(1)) c.devices_operational = r.get(8);
+      if (r.get(1)) c.devices_faulted = r.get(8);
+      if (r.get(1)) c.active_alarms = r.get(16);
+      if (r.get(1)) c.devices_faulted_mask = r.get(16);
+    }
+
+    records.push(c);
+    p = c;
+  }
+  return records;
+}
+
+/**
+ * Decode one block into readings with the fields of the JSON upload
+ * (values at the SD log resolution, as sdlog_unpack gives them)
+ */
+function decodeReadings(buf) {
+  return decodeRecords(buf).map((c) => {
+    const conductivity = floatOf(c.conductivity_bits);
+    return {
+      timestamp: c.timestamp,
+      conductivity: Number.isFinite(conductivity) ? conductivity : null,
+      temperature: c.temperature_d / 10,
+      water_meter1: c.water_meter1,
+      water_meter2: c.water_meter2,
+      flow_rate: c.flow_cgpm / 100,
+      blowdown_active: (c.flags & REC_BLOWDOWN) !== 0,
+      valve_position_mA: c.valve_dmA / 10,
+      pump1_active: (c.flags & REC_PUMP1) !== 0,
+      pump2_active: (c.flags & REC_PUMP2) !== 0,
+      pump3_active: (c.flags & REC_PUMP3) !== 0,
+      feedwater_pump_on: (c.flags & REC_FW_PUMP) !== 0,
+      fw_pump_cycle_count: c.fw_pump_cycle_count,
+      fw_pump_on_time_sec: c.fw_pump_on_time_sec,
+      active_alarms: c.active_alarms,
+      safe_mode: c.safe_mode,
+      cond_sensor_valid: (c.flags & REC_COND_VALID) !== 0,
+      temp_sensor_valid: (c.flags & REC_TEMP_VALID) !== 0,
+      devices_operational: c.devices_operational,
+      devices_faulted: c.devices_faulted,
+      devices_faulted_mask: c.devices_faulted_mask,
+      measurement_age_ms: c.measurement_age_ms,
+    };
+  });
+}
+
+module.exports = { decodeRecords, decodeReadings };
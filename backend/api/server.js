@@ -10,6 +10,7 @@ const cors = require('cors');
 const helmet = require('helmet');
 const morgan = require('morgan');
 const mqtt = require('mqtt');
+const { decodeReadings } = require('./reading_codec');
 
 const app = express();
 const PORT = process.env.PORT || 3000;
@@ -97,14 +98,9 @@ app.post('/api/readings', authenticateApiKey, async (req, res) => {
 });
 
 // Batch insert readings (for offline buffer flush)
-app.post('/api/readings/batch', authenticateApiKey, async (req, res) => {
+async function insertReadings(readings) {
   const client = await pool.connect();
   try {
-    const { readings } = req.body;
-    if (!Array.isArray(readings)) {
-      return res.status(400).json({ error: 'readings must be an array' });
-    }
-
     await client.query('BEGIN');
 
     for (const r of readings) {
@@ -121,16 +117,48 @@ app.post('/api/readings/batch', authenticateApiKey, async (req, res) => {
     }
 
     await client.query('COMMIT');
-    res.status(201).json({ success: true, count: readings.length });
   } catch (err) {
     await client.query('ROLLBACK');
-    console.error('Error batch inserting readings:', err);
-    res.status(500).json({ error: err.message });
+    throw err;
   } finally {
     client.release();
   }
+}
+
+app.post('/api/readings/batch', authenticateApiKey, async (req, res) => {
+  try {
+    const { readings } = req.body;
+    if (!Array.isArray(readings)) {
+      return res.status(400).json({ error: 'readings must be an array' });
+    }
+
+    await insertReadings(readings);
+    res.status(201).json({ success: true, count: readings.length });
+  } catch (err) {
+    console.error('Error batch inserting readings:', err);
+    res.status(500).json({ error: err.message });
+  }
 });
 
+// Batch of readings as one compressed block (tsdb_encoding = packed), see reading_codec.js
+app.post('/api/readings/packed', authenticateApiKey,
+  express.raw({ type: 'application/octet-stream', limit: '100kb' }), async (req, res) => {
+    let readings;
+    try {
+      readings = decodeReadings(req.body);
+    } catch (err) {
+      return res.status(400).json({ error: err.message });
+    }
+
+    try {
+      await insertReadings(readings);
+      res.status(201).json({ success: true, count: readings.length });
+    } catch (err) {
+      console.error('Error inserting packed readings:', err);
+      res.status(500).json({ error: err.message });
+    }
+  });
+
 // Get latest reading
 app.get('/api/readings/latest', async (req, res) => {
   try {
@@ -412,6 +440,38 @@ function metricValue(metrics, id, defaultVal = null) {
   return m != null && typeof m.value === 'number' ? m.value : defaultVal;
 }
 
+// Devices resend unconfirmed messages after a reconnect (at-least-once), with
+// the same {boot_id, sequence}: remember the last MQTT_DEDUP_WINDOW per boot
+// and drop repeats. Telemetry spooled on the SD card keeps the numbering of
+// the boot that spooled it, so after a reset a device sends messages of
+// earlier boots too: the last MQTT_DEDUP_BOOTS boots are kept per device.
+const MQTT_DEDUP_WINDOW = 1024;
+const MQTT_DEDUP_BOOTS = 4;
+const mqttSeen = new Map();         // device_id -> Map(boot_id -> { seen: Set, order: [] })
+
+function isDuplicate(deviceId, doc) {
+  if (typeof doc.sequence !== 'number' || doc.boot_id == null) return false;
+  let boots = mqttSeen.get(deviceId);
+  if (!boots) {
+    boots = new Map();
+    mqttSeen.set(deviceId, boots);
+  }
+  let boot = boots.get(doc.boot_id);
+  if (!boot) {
+    boot = { seen: new Set(), order: [] };
+    boots.set(doc.boot_id, boot);
+    if (boots.size > MQTT_DEDUP_BOOTS) boots.delete(boots.keys().next().value);
+  }
+  if (boot.seen.has(doc.sequence)) return true;
+  boot.seen.add(doc.sequence);
+  boot.order.push(doc.sequence);
+  if (boot.order.length > MQTT_DEDUP_WINDOW) boot.seen.delete(boot.order.shift());
+  return false;
+}
+
+// Topics carrying numbered telemetry (events are published on `state`)
+const MQTT_DEDUP_TOPICS = new Set(['metrics', 'alarm', 'state']);
+
 function startMqttGateway() {
   if (!MQTT_ENABLED) return;
   const client = mqtt.connect(MQTT_URL, { reconnectPeriod: 10000 });
@@ -419,7 +479,8 @@ function startMqttGateway() {
     client.subscribe('device/+/metrics', { qos: 0 });
     client.subscribe('device/+/alarm', { qos: 0 });
     client.subscribe('device/+/health', { qos: 0 });
-    console.log('MQTT gateway connected, subscribed to device/+/metrics, alarm, health');
+    client.subscribe('device/+/state', { qos: 0 });
+    console.log('MQTT gateway connected, subscribed to device/+/metrics, alarm, health, state');
   });
   client.on('error', (err) => console.error('MQTT error:', err));
 
@@ -434,6 +495,7 @@ function startMqttGateway() {
       return;
     }
     const suffix = topic.split('/').pop();
+    if (MQTT_DEDUP_TOPICS.has(suffix) && isDuplicate(deviceId, doc)) return;
     try {
       if (suffix === 'metrics') {
         const time = doc.timestamp ? new Date(doc.timestamp * 1000) : new Date();
@@ -481,6 +543,13 @@ function startMqttGateway() {
             [time, deviceId, 0, doc.event_type || 'event']
           );
         }
+      } else if (suffix === 'state') {
+        const time = doc.timestamp ? new Date(doc.timestamp * 1000) : new Date();
+        await pool.query(
+          `INSERT INTO pump_events (time, device_id, pump_id, event_type)
+           VALUES ($1, $2, $3, $4)`,
+          [time, deviceId, 0, doc.event_type || 'event']
+        );
       } else if (suffix === 'health') {
         if (payload.toString() === 'offline') return; // LWT, no insert
         const time = doc.timestamp ? new Date(doc.timestamp * 1000) : new Date();
@@ -131,10 +131,11 @@ public:
      * @param water_contacts Number of water meter contacts since last check
      * @param water_volume Volume from paddlewheel since last check
      * @param fuzzy_rate Fuzzy logic output rate (0-100%)
+     * @param mpc_rate Planned rate for Mode M (ml/min)
      */
     void processFeedMode(bool blowdown_active, uint32_t blowdown_time_ms,
                         uint32_t water_contacts, float water_volume,
-                        float fuzzy_rate = 0.0f);
+                        float fuzzy_rate = 0.0f, float mpc_rate = 0.0f);
 
     /**
      * @brief Process scheduled feed
@@ -237,6 +238,8 @@ private:
     uint32_t _mode_b_accumulated_blowdown;
     bool _mode_a_was_blowing;
     uint32_t _mode_c_cycle_start;
+    float _mode_m_pending_ml;
+    uint32_t _mode_m_last_ms;
 
     // Internal methods
     void enableDriver(bool enable);
@@ -247,6 +250,8 @@ private:
     void processModeD(uint32_t water_contacts);
     void processModeE(float water_volume);
     void processModeF(float water_volume, float fuzzy_rate);
+    void processModeM(float rate_ml_min);
+    void resetModeM();
     void checkTimeout();
     void updateStats();
 };
@@ -282,10 +287,12 @@ public:
     /**
      * @brief Process feed modes for all pumps
      * @param fuzzy_rates Array of fuzzy outputs [0]=H2SO3/acid, [1]=NaOH/caustic, [2]=Amine/sulfite
+     * @param mpc_rates Mode M planned rates (ml/min), same order
      */
     void processFeedModes(bool blowdown_active, uint32_t blowdown_time_ms,
                          uint32_t water_contacts, float water_volume,
-                         float fuzzy_rates[PUMP_COUNT] = nullptr);
+                         float fuzzy_rates[PUMP_COUNT] = nullptr,
+                         float mpc_rates[PUMP_COUNT] = nullptr);
 
     /**
      * @brief Enable/disable all pumps
@@ -61,6 +61,11 @@
 #define TSDB_HTTP_PORT          3000    // API server port (not PostgreSQL)
 #define TSDB_LOG_INTERVAL_MS    10000   // 10 seconds default
 #define TSDB_API_KEY_MAX_LEN    64      // API authentication key length
+#define TSDB_URL_MAX_LEN        (TSDB_HOST_MAX_LEN + 40)
+#define TSDB_BATCH_READINGS     16      // Readings per /api/readings/batch POST (default)
+#define TSDB_BATCH_MAX          32      // Upper limit for tsdb_batch_size
+#define TSDB_BATCH_BYTES        8192    // Batch body limit (default and maximum)
+#define TSDB_BATCH_BYTES_MIN    1024
 
 // MQTT / Sparkplug telemetry (Modern IoT Stack)
 #define MQTT_HOST_MAX_LEN       64
@@ -100,7 +105,8 @@ typedef enum {
     FEED_MODE_D_WATER_CONTACT = 4,      // Triggered by water meter contacts
     FEED_MODE_E_PADDLEWHEEL = 5,        // Triggered by paddlewheel volume
     FEED_MODE_S_SCHEDULED = 6,          // Time-of-day scheduled feed
-    FEED_MODE_F_FUZZY = 7               // Fuzzy logic controlled (proportional to makeup water)
+    FEED_MODE_F_FUZZY = 7,              // Fuzzy logic controlled (proportional to makeup water)
+    FEED_MODE_M_MPC = 8                 // Model predictive (planned rate, see mpc_dosing.h)
 } feed_mode_t;
 
 // Feed Timing Limits
@@ -377,7 +383,7 @@ typedef struct {
     // Control behavior
     bool aggressive_mode;           // Faster response, narrower deadbands
     uint8_t inference_method;       // 0=Mamdani, 1=Sugeno
-    uint8_t defuzz_method;          // 0=Centroid, 1=Bisector, 2=MOM
+    uint8_t defuzz_method;          // 0=Centroid, 1=Bisector, 2=MOM, 3=SOM, 4=LOM
 
     // Manual test input validity timeout (minutes, 0=never expire)
     uint16_t manual_input_timeout;
@@ -445,10 +451,31 @@ typedef struct {
     uint16_t enabled_devices;       // Bitmask: bit N = device N enabled
     uint16_t _hw_reserved;          // Alignment padding / future use
 
+    // SD card logging
+    uint8_t sd_log_format;          // SD_LOG_FORMAT_CSV / SD_LOG_FORMAT_BINARY
+
+    // HTTP batch upload (0 = default; older configs migrate with 0)
+    uint8_t tsdb_batch_size;        // Readings per batch, 1..TSDB_BATCH_MAX
+    uint16_t tsdb_batch_bytes;      // JSON body limit, TSDB_BATCH_BYTES_MIN..TSDB_BATCH_BYTES
+    uint8_t tsdb_encoding;          // TSDB_ENCODING_JSON / TSDB_ENCODING_PACKED
+
+    // Fuzzy control surface (0 = on with the defaults; older configs migrate with 0)
+    uint8_t fuzzy_surface_off;      // 1 = evaluate exactly every cycle
+    uint8_t fuzzy_surface_nodes;    // Node budget per axis, 2..FUZZY_SURFACE_MAX_NODES (0 = default)
+    float fuzzy_surface_max_err;    // Error bound, % output (0 = FUZZY_SURFACE_DEFAULT_MAX_ERR)
+
 } system_config_t;
 
 #define CONFIG_MAGIC                0x43543630  // "CT60" in hex
-#define CONFIG_VERSION              1
+#define CONFIG_VERSION              2       // 2: fields appended after _hw_reserved (config_migrate.h)
+
+// SD log file format (older configs migrate with 0 = CSV)
+#define SD_LOG_FORMAT_CSV           0       // /logs/YYYY-MM-DD.csv
+#define SD_LOG_FORMAT_BINARY        1       // /logs/YYYY-MM-DD.bin + .idx (sd_log_record.h)
+
+// HTTP batch body (older configs migrate with 0 = JSON)
+#define TSDB_ENCODING_JSON          0       // {"readings":[...]} to /api/readings/batch
+#define TSDB_ENCODING_PACKED        1       // Compressed block to /api/readings/packed (reading_codec.h)
 
 // ============================================================================
 // SYSTEM STATE STRUCTURE (Runtime State)
@@ -549,6 +576,8 @@ typedef struct {
 #define NVS_KEY_LAST_CAL_DATE       "last_cal"
 #define NVS_KEY_FW_PUMP_CYCLES      "fw_cycles"   // Feedwater pump activation count
 #define NVS_KEY_FW_PUMP_ONTIME      "fw_ontime"   // Feedwater pump cumulative on-time (sec)
+#define NVS_KEY_FUZZY_RULES         "fz_rules"    // Uploaded fuzzy rule base (binary, fuzzy_rb_encode)
+#define NVS_KEY_SPOOL_CURSOR        "spool_rd"    // Telemetry spool replay cursor (record number)
 
 // ============================================================================
 // FREERTOS TASK CONFIGURATION
@@ -559,12 +588,16 @@ typedef struct {
 #define TASK_PRIORITY_MEASUREMENT   3
 #define TASK_PRIORITY_DISPLAY       2
 #define TASK_PRIORITY_LOGGING       1   // Lowest priority
+#define TASK_PRIORITY_SD_WRITER     1   // Drains the SD log queue (sd_logger.h)
+#define TASK_PRIORITY_NETWORK       1   // HTTP/MQTT uploads (net_outbox.h)
 
 #define TASK_STACK_SAFETY           2048
 #define TASK_STACK_CONTROL          4096
 #define TASK_STACK_MEASUREMENT      6144
 #define TASK_STACK_DISPLAY          4096
 #define TASK_STACK_LOGGING          8192
+#define TASK_STACK_SD_WRITER        4096
+#define TASK_STACK_NETWORK          8192
 
 #define TASK_PERIOD_SAFETY_MS       100     // 10 Hz
 #define TASK_PERIOD_CONTROL_MS      100     // 10 Hz
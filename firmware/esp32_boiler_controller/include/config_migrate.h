@@ -0,0 +1,30 @@
+/**
+ * @file config_migrate.h
+ * @brief Bring a system_config_t stored by older firmware up to the current layout
+ *
+ * New fields are only ever appended to system_config_t, so an older NVS blob is a
+ * prefix of the current struct. The bytes past the stored size are zeroed (0 is the
+ * default of every appended field); fields that need a non-zero default get it only
+ * when the stored blob predates them, so settings the blob does hold are kept.
+ */
+
+#ifndef CONFIG_MIGRATE_H
+#define CONFIG_MIGRATE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Defaults for the MQTT/telemetry fields (broker unset, HTTP upload)
+ */
+void config_apply_mqtt_defaults(system_config_t* cfg);
+
+/**
+ * @brief Migrate a config whose first stored_size bytes were read from NVS
+ * @param cfg Config holding the stored prefix (the rest is overwritten)
+ * @param stored_size Size of the stored blob, < sizeof(system_config_t)
+ * @return true if the blob predates the MQTT fields and their defaults were applied
+ */
+bool config_migrate(system_config_t* cfg, size_t stored_size);
+
+#endif // CONFIG_MIGRATE_H
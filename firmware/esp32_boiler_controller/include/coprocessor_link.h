@@ -1,9 +1,15 @@
 /**
  * @file coprocessor_link.h
- * @brief Main ESP32 side: RS-485 link to panel coprocessor (ESP32 DevKit at boiler)
+ * @brief Main ESP32 side: RS-485 link to panel coprocessors (ESP32 DevKit at boiler)
  *
  * Sends commands (blowdown open/close, solenoid, etc.), receives telemetry,
  * ACK/NAK, events, and errors. DE/RE for half-duplex; turn-around delay after TX.
+ *
+ * Multi-drop: main is bus master. poll() runs a scheduler over the registered
+ * nodes — each node has a poll interval and priority; among nodes that are due
+ * the highest (priority + lateness) wins, ties go round-robin, so a busy
+ * high-priority panel cannot starve the others. Panels answer POLL with
+ * TELEMETRY, which lands in a per-node cache.
  */
 
 #ifndef COPROCESSOR_LINK_H
@@ -13,6 +19,7 @@
 #include <freertos/semphr.h>
 #include "config.h"
 #include "coprocessor_protocol.h"
+#include "cp_clock_sync.h"
 
 // Defaults
 #define CP_LINK_TELEMETRY_TIMEOUT_MS   5000   // No telemetry for this long → comms lost
@@ -20,12 +27,24 @@
 #define CP_LINK_CMD_RETRIES            3
 #define CP_LINK_TURNAROUND_MS          2      // 1–2 character times at 115200
 #define CP_LINK_BAUD_DEFAULT          115200
+#define CP_LINK_DRIFT_BOUND_MS         50     // Resend TIME_SYNC when panel drift exceeds this
+#define CP_LINK_TIME_SYNC_MIN_GAP_MS   60000  // Never resync more often than this
+#define CP_LINK_UNIX_TIME_VALID        1600000000UL  // Wall clock considered set (NTP) above this
+
+// Bus master scheduler
+#define CP_LINK_MAX_NODES              16
+#define CP_LINK_POLL_INTERVAL_MS       200    // Default per-node telemetry period (5 Hz)
+#define CP_LINK_POLL_REPLY_TIMEOUT_MS  20     // POLL → TELEMETRY slot (~3 ms frame at 115200)
+#define CP_LINK_MAX_POLLS_PER_CALL     4      // Bounds time spent in poll() per control tick
+#define CP_LINK_PRIORITY_WEIGHT_MS     100    // One priority level outranks this much lateness
+#define CP_LINK_LOST_POLL_INTERVAL_MS  1000   // Back-off for nodes in comms lost
 
 // ============================================================================
 // LAST TELEMETRY (mirrors panel telemetry for main control loop)
 // ============================================================================
 
 typedef struct {
+    uint8_t addr;               // Node address this snapshot came from
     float conductivity_uS_cm;
     float temperature_c;
     uint8_t blowdown_state;
@@ -38,10 +57,25 @@ typedef struct {
     bool comms_lost;           // Panel reports loss of main heartbeat
     uint16_t sequence;
     uint32_t timestamp_ms;
+    uint32_t sample_local_ms;   // timestamp_ms mapped onto main millis() (clock model)
     bool valid;                 // At least one telemetry received
     uint32_t last_received_ms;  // millis() when last telemetry arrived
 } cp_link_telemetry_t;
 
+// ============================================================================
+// PER-NODE POLL STATISTICS
+// ============================================================================
+
+typedef struct {
+    uint8_t addr;
+    uint8_t priority;
+    uint16_t poll_interval_ms;
+    uint32_t polls_sent;
+    uint32_t polls_missed;      // POLL with no TELEMETRY inside the reply slot
+    uint32_t last_period_ms;    // Measured time between the last two replies
+    bool comms_lost;
+} cp_link_node_stats_t;
+
 // ============================================================================
 // COMMAND RESULT (after sendCommand)
 // ============================================================================
@@ -68,57 +102,97 @@ public:
     CoprocessorLink(HardwareSerial& serial, int8_t de_re_pin);
 
     /**
-     * @brief Initialize serial and DE/RE pin
+     * @brief Initialize serial and DE/RE pin.
+     * Registers CP_ADDR_DEFAULT if no node was added beforehand.
      * @param baud Baud rate (default CP_LINK_BAUD_DEFAULT)
      * @return true on success
      */
     bool begin(uint32_t baud = CP_LINK_BAUD_DEFAULT);
 
     /**
-     * @brief Call from main loop or a task: receive bytes, parse frames, update last telemetry.
+     * @brief Register a panel node on the bus (before or after begin()).
+     * The first node added is the primary node used by the single-panel API.
+     * @param addr Node address (CP_ADDR_MIN..CP_ADDR_MAX)
+     * @param poll_interval_ms Target telemetry period for this node
+     * @param priority Higher values are polled first when several nodes are due
+     * @return false if the table is full, addr is invalid or already registered
+     */
+    bool addNode(uint8_t addr, uint16_t poll_interval_ms = CP_LINK_POLL_INTERVAL_MS, uint8_t priority = 0);
+
+    /**
+     * @brief Change poll rate / priority of a registered node
+     * @return false if addr is not registered
+     */
+    bool setNodeSchedule(uint8_t addr, uint16_t poll_interval_ms, uint8_t priority);
+
+    /**
+     * @brief Number of registered nodes
+     */
+    uint8_t getNodeCount() const;
+
+    /**
+     * @brief Call from main loop or a task: receive bytes, poll due nodes, update telemetry caches.
      * Thread-safe: use from one task only or with mutex (internal mutex protects RX/telemetry).
      */
     void poll();
 
     /**
-     * @brief Get last received telemetry (valid only if .valid is true).
+     * @brief Get last received telemetry of the primary node (valid only if .valid is true).
      * Thread-safe: returns a snapshot copy.
      */
     const cp_link_telemetry_t& getLastTelemetry() const;
 
     /**
-     * @brief True if no telemetry received within CP_LINK_TELEMETRY_TIMEOUT_MS
+     * @brief Copy the cached telemetry of one node
+     * @return false if addr is not registered
+     */
+    bool getNodeTelemetry(uint8_t addr, cp_link_telemetry_t* out) const;
+
+    /**
+     * @brief Copy poll statistics of one node
+     * @return false if addr is not registered
+     */
+    bool getNodeStats(uint8_t addr, cp_link_node_stats_t* out) const;
+
+    /**
+     * @brief True if the primary node sent no telemetry within CP_LINK_TELEMETRY_TIMEOUT_MS
      */
     bool isCommsLost() const;
 
     /**
-     * @brief millis() when comms were first considered lost (0 if not lost)
+     * @brief Per-node variant of isCommsLost() (unregistered → true)
+     */
+    bool isNodeCommsLost(uint8_t addr) const;
+
+    /**
+     * @brief millis() when comms to the primary node were first considered lost (0 if not lost)
      */
     uint32_t getCommsLostSinceMs() const;
 
     /**
      * @brief Send blowdown open command; blocks until ACK/NAK or timeout
+     * @param addr Target node (default: single-panel address)
      * @return CP_CMD_RESULT_ACK, NAK, TIMEOUT, or LINK_DOWN
      */
-    cp_cmd_result_t sendBlowdownOpen();
+    cp_cmd_result_t sendBlowdownOpen(uint8_t addr = CP_ADDR_DEFAULT);
 
     /**
      * @brief Send blowdown close command
      */
-    cp_cmd_result_t sendBlowdownClose();
+    cp_cmd_result_t sendBlowdownClose(uint8_t addr = CP_ADDR_DEFAULT);
 
     /**
      * @brief Send solenoid on/off
      */
-    cp_cmd_result_t sendSolenoid(bool on);
+    cp_cmd_result_t sendSolenoid(bool on, uint8_t addr = CP_ADDR_DEFAULT);
 
     /**
      * @brief Send sample request (optional)
      */
-    cp_cmd_result_t sendSampleRequest();
+    cp_cmd_result_t sendSampleRequest(uint8_t addr = CP_ADDR_DEFAULT);
 
     /**
-     * @brief Send time sync (Unix time)
+     * @brief Broadcast time sync (Unix time) to all panels
      */
     void sendTimeSync(uint32_t unix_sec, uint32_t subsec_ms = 0);
 
@@ -132,28 +206,59 @@ public:
      */
     uint8_t getLastNakResult() const;
 
+    /**
+     * @brief Map a panel timestamp_ms onto main board millis() using that node's clock model
+     */
+    uint32_t panelToLocalMs(uint32_t panel_ms, uint8_t addr = CP_ADDR_DEFAULT) const;
+
+    /**
+     * @brief Estimated panel clock skew (ppm) and accumulated drift since last TIME_SYNC (ms)
+     */
+    float getClockSkewPpm(uint8_t addr = CP_ADDR_DEFAULT) const;
+    float getClockDriftMs(uint8_t addr = CP_ADDR_DEFAULT) const;
+
 private:
+    typedef struct {
+        uint8_t addr;
+        uint8_t priority;
+        uint16_t poll_interval_ms;
+        uint32_t next_due_ms;
+        cp_link_telemetry_t telemetry;
+        CpClockEstimator clock;         // Panel timestamp → main millis() model
+        bool comms_lost;
+        uint32_t comms_lost_since_ms;
+        uint32_t polls_sent;
+        uint32_t polls_missed;
+        uint32_t last_period_ms;
+    } node_t;
+
     HardwareSerial& _serial;
     int8_t _de_re_pin;
     uint32_t _baud;
-    cp_link_telemetry_t _telemetry;
+    node_t _nodes[CP_LINK_MAX_NODES];
+    uint8_t _node_count;
+    uint8_t _rr_index;              // Last node polled (round-robin token)
     mutable cp_link_telemetry_t _telemetry_copy;  // Snapshot for getLastTelemetry()
-    bool _comms_lost;
-    uint32_t _comms_lost_since_ms;
     uint16_t _cmd_sequence;
     cp_cmd_result_t _last_cmd_result;
     uint8_t _last_nak_result;
 
+    uint32_t _last_time_sync_ms;    // millis() of last TIME_SYNC sent (0 = never)
+
     uint8_t _rx_buf[CP_MAX_FRAME];
     size_t _rx_len;
 
-    SemaphoreHandle_t _mutex;  // Protects _rx_buf, _rx_len, _telemetry, _comms_lost, _last_*
+    SemaphoreHandle_t _mutex;  // Protects _rx_buf, _rx_len, _nodes, _last_*
 
     void _setDeRe(bool drive);
-    void _sendFrame(uint8_t type, const uint8_t* payload, uint8_t plen);
-    cp_cmd_result_t _sendCommandAndWaitAck(uint8_t type, const uint8_t* payload, uint8_t plen);
+    void _sendFrame(uint8_t addr, uint8_t type, const uint8_t* payload, uint8_t plen);
+    cp_cmd_result_t _sendCommandAndWaitAck(uint8_t addr, uint8_t type, const uint8_t* payload, uint8_t plen);
     void _processFrame(const uint8_t* frame, size_t len);
     bool _readFrame(uint8_t* out_frame, size_t* out_len, uint32_t timeout_ms);
+    int _findNode(uint8_t addr) const;
+    int _pickNextNode(uint32_t now) const;
+    void _pollNode(int idx);
+    bool _timeSyncDue() const;
 };
 
 #endif // COPROCESSOR_LINK_H
@@ -6,7 +6,11 @@
  * Used by both main (control box) and panel (boiler panel) firmware.
  *
  * Physical: half-duplex RS-485; UART 115200–921600 8N1; DE/RE per node.
- * Frame: SYNC(2) TYPE(1) LEN(1) PAYLOAD(LEN) CRC16(2). LEN excludes header and CRC.
+ * Frame: SYNC(2) ADDR(1) TYPE(1) LEN(1) PAYLOAD(LEN) CRC16(2). LEN excludes header and CRC.
+ *
+ * Multi-drop: main is the only bus master. ADDR is the panel node address —
+ * destination on Main -> Panel frames, source on Panel -> Main frames.
+ * Panels transmit only in reply to a frame addressed to them (POLL or command).
  */
 
 #ifndef COPROCESSOR_PROTOCOL_H
@@ -23,17 +27,32 @@
 
 #define CP_SYNC_0                0xAA
 #define CP_SYNC_1                0x55
-#define CP_HEADER_SIZE           4   // sync0, sync1, type, len
+#define CP_HEADER_SIZE           5   // sync0, sync1, addr, type, len
 #define CP_CRC_SIZE              2
 #define CP_MAX_PAYLOAD           64
 #define CP_MAX_FRAME             (CP_HEADER_SIZE + CP_MAX_PAYLOAD + CP_CRC_SIZE)
 
+// Header byte offsets
+#define CP_HDR_ADDR              2
+#define CP_HDR_TYPE              3
+#define CP_HDR_LEN               4
+
+// ============================================================================
+// NODE ADDRESSES
+// ============================================================================
+
+#define CP_ADDR_DEFAULT          0x01  // Single-panel installs
+#define CP_ADDR_MIN              0x01
+#define CP_ADDR_MAX              0x1F  // 31 panels per RS-485 segment (unit-load limited)
+#define CP_ADDR_BROADCAST        0xFF  // Main -> all panels, never answered (TIME_SYNC)
+
 // ============================================================================
 // MESSAGE TYPES
 // ============================================================================
 
 typedef enum {
-    CP_TYPE_TELEMETRY = 0x01,    // Panel -> Main: sensor + actuator state
+    CP_TYPE_TELEMETRY = 0x01,    // Panel -> Main: sensor + actuator state (reply to POLL)
+    CP_TYPE_POLL      = 0x02,    // Main -> Panel: request telemetry (no payload)
     CP_TYPE_CMD_MASK  = 0x10,    // Commands from Main -> Panel
     CP_TYPE_CMD_BLOWDOWN_OPEN  = 0x11,
     CP_TYPE_CMD_BLOWDOWN_CLOSE = 0x12,
@@ -48,7 +67,7 @@ typedef enum {
 } cp_msg_type_t;
 
 // ============================================================================
-// TELEMETRY PAYLOAD (Panel -> Main, 2–10 Hz)
+// TELEMETRY PAYLOAD (Panel -> Main, per poll, 2–10 Hz)
 // ============================================================================
 
 typedef struct __attribute__((packed)) {
@@ -151,6 +170,12 @@ typedef struct __attribute__((packed)) {
  */
 uint16_t cp_crc16(const uint8_t* data, size_t length);
 
+/**
+ * Build a complete frame (header, payload, CRC) into out_frame (>= CP_MAX_FRAME bytes).
+ * @return Frame length, or 0 if plen > CP_MAX_PAYLOAD
+ */
+size_t cp_frame_build(uint8_t* out_frame, uint8_t addr, uint8_t type, const uint8_t* payload, uint8_t plen);
+
 /**
  * Check frame: sync, type, len <= CP_MAX_PAYLOAD, CRC.
  * frame_len = CP_HEADER_SIZE + payload_len + CP_CRC_SIZE.
@@ -165,17 +190,24 @@ static inline const uint8_t* cp_frame_payload(const uint8_t* frame) {
 }
 
 /**
- * Get payload length from frame (byte at index 3).
+ * Get payload length from frame (byte at CP_HDR_LEN).
  */
 static inline uint8_t cp_frame_payload_len(const uint8_t* frame) {
-    return frame[3];
+    return frame[CP_HDR_LEN];
 }
 
 /**
- * Get message type from frame (byte at index 2).
+ * Get message type from frame (byte at CP_HDR_TYPE).
  */
 static inline uint8_t cp_frame_type(const uint8_t* frame) {
-    return frame[2];
+    return frame[CP_HDR_TYPE];
+}
+
+/**
+ * Get node address from frame (byte at CP_HDR_ADDR).
+ */
+static inline uint8_t cp_frame_addr(const uint8_t* frame) {
+    return frame[CP_HDR_ADDR];
 }
 
 #endif // COPROCESSOR_PROTOCOL_H
@@ -0,0 +1,116 @@
+/**
+ * @file cp_clock_sync.h
+ * @brief Panel clock offset/skew estimation from coprocessor telemetry timestamps
+ *
+ * Each telemetry frame carries the panel's millis() (timestamp_ms). The main
+ * board pairs it with its own millis() at arrival and fits
+ *   local_ms ≈ offset + skew * panel_ms
+ * Arrival time only ever adds latency (UART buffering, 100 ms control-task
+ * poll), so pairs are min-filtered per bucket (the least-delayed pair of each
+ * CP_CLOCK_BUCKET_MS survives) before a least-squares slope over a bounded
+ * window of buckets; offset is the lower envelope (minimum residual).
+ *
+ * The fitted model maps every panel sample onto the main board timeline, and
+ * reports accumulated drift since the last TIME_SYNC so the link only
+ * resynchronizes when the bound is exceeded.
+ */
+
+#ifndef CP_CLOCK_SYNC_H
+#define CP_CLOCK_SYNC_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#define CP_CLOCK_WINDOW            32      // Min-filtered pairs kept for the fit
+#define CP_CLOCK_BUCKET_MS         5000    // One pair per bucket → ~160 s window
+#define CP_CLOCK_MIN_SAMPLES       6       // Pairs required before the model is trusted
+#define CP_CLOCK_MIN_SPAN_MS       20000   // Below this panel span skew is fixed at 1.0
+#define CP_CLOCK_MAX_SKEW_PPM      2000    // Reject fits beyond ±0.2 % (crystal is ~±50 ppm)
+#define CP_CLOCK_RESET_JUMP_MS     1000    // Residual beyond this → panel reboot / clock step
+
+typedef struct {
+    uint32_t panel_ms;   // Panel millis() from telemetry
+    uint32_t local_ms;   // Main millis() at arrival
+} cp_clock_pair_t;
+
+class CpClockEstimator {
+public:
+    CpClockEstimator();
+
+    /**
+     * @brief Drop all pairs and the sync reference (e.g. after comms loss)
+     */
+    void reset();
+
+    /**
+     * @brief Add one (panel, arrival) pair and refit the model
+     * @param panel_ms Panel timestamp from telemetry
+     * @param local_ms Main board millis() when the frame was parsed
+     * @return false if the pair looked like a panel restart and the window was reset
+     */
+    bool addSample(uint32_t panel_ms, uint32_t local_ms);
+
+    /**
+     * @brief True once CP_CLOCK_MIN_SAMPLES buckets have been fitted
+     */
+    bool isValid() const { return _count >= CP_CLOCK_MIN_SAMPLES; }
+
+    /**
+     * @brief Map a panel timestamp to main board millis()
+     * Before the model is valid this uses the last pair with unit skew.
+     */
+    uint32_t toLocal(uint32_t panel_ms) const;
+
+    /**
+     * @brief Estimated skew in ppm (panel clock fast → positive)
+     */
+    float getSkewPpm() const;
+
+    /**
+     * @brief Offset local - panel (ms) at the most recent pair
+     */
+    int32_t getOffsetMs() const;
+
+    /**
+     * @brief Record that TIME_SYNC was sent; drift accumulates from here
+     * @param local_ms Main board millis() when TIME_SYNC went out
+     */
+    void markSynced(uint32_t local_ms);
+
+    /**
+     * @brief True if TIME_SYNC has been recorded since the last reset
+     */
+    bool isSynced() const { return _synced; }
+
+    /**
+     * @brief Accumulated panel drift (ms) since the last TIME_SYNC
+     * |(skew - 1) * panel time elapsed since sync|; 0 when not synced or not valid.
+     */
+    float getDriftMs() const;
+
+    uint8_t getSampleCount() const { return _count; }
+
+private:
+    cp_clock_pair_t _pairs[CP_CLOCK_WINDOW];
+    uint8_t _head;
+    uint8_t _count;
+
+    cp_clock_pair_t _cand;          // Least-delayed pair of the open bucket
+    bool _cand_valid;
+    uint32_t _bucket_start_ms;      // local_ms when the open bucket started
+    uint32_t _last_panel_ms;        // Newest panel timestamp seen (reboot detection)
+
+    // Model relative to the newest pair: local = _ref_local + _offset + _skew * (panel - _ref_panel)
+    uint32_t _ref_panel;
+    uint32_t _ref_local;
+    float _skew;
+    float _offset;
+
+    bool _synced;
+    uint32_t _sync_panel_ms;
+
+    void _fit();
+    float _residual(const cp_clock_pair_t& p, float skew) const;
+};
+
+#endif // CP_CLOCK_SYNC_H
@@ -7,7 +7,14 @@
  * - HTTP POST to TimescaleDB REST endpoint
  * - Event logging
  * - Alarm history
- * - Buffered uploads for network resilience
+ * - Buffered uploads for network resilience (SD telemetry spool when a card
+ *   is fitted, RAM buffer otherwise), sent as batches to /api/readings/batch
+ *   (or as compressed blocks to /api/readings/packed, tsdb_encoding) over one
+ *   keep-alive connection
+ *
+ * logReading/logEvent/logAlarm only queue the record (net_outbox.h); all HTTP
+ * traffic happens in deliver(), update() and sendSpooled(), called from the
+ * network task.
  */
 
 #ifndef DATA_LOGGER_H
@@ -18,6 +25,10 @@
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include "config.h"
+#include "sensor_reading.h"
+#include "spool_record.h"
+#include "net_outbox.h"
+#include "packed_reading.h"
 
 // ============================================================================
 // LOG ENTRY TYPES
@@ -30,37 +41,6 @@ typedef enum {
     LOG_TYPE_CONFIG         // Configuration changes
 } log_type_t;
 
-// ============================================================================
-// SENSOR READING STRUCTURE
-// ============================================================================
-
-typedef struct {
-    uint32_t timestamp;             // Unix timestamp
-    float conductivity;             // uS/cm
-    float temperature;              // Celsius
-    uint32_t water_meter1;          // Total gallons
-    uint32_t water_meter2;          // Total gallons
-    float flow_rate;                // GPM
-    bool blowdown_active;
-    float valve_position_mA;        // 4-20mA feedback (4=closed, 20=open)
-    bool pump1_active;
-    bool pump2_active;
-    bool pump3_active;
-    bool feedwater_pump_on;
-    uint32_t fw_pump_cycle_count;       // Cumulative feedwater pump cycles
-    uint32_t fw_pump_on_time_sec;       // Cumulative feedwater pump on-time (sec)
-    uint16_t active_alarms;
-
-    // Health & diagnostics (added for DeviceManager/SensorHealth integration)
-    uint8_t safe_mode;              // 0=NONE, 1=SENSOR_FAIL, 2=STALE_DATA, etc.
-    bool cond_sensor_valid;         // Conductivity reading is trustworthy
-    bool temp_sensor_valid;         // Temperature reading is trustworthy
-    uint8_t devices_operational;    // Count of operational devices
-    uint8_t devices_faulted;        // Count of faulted devices
-    uint16_t devices_faulted_mask;  // Bitmask of faulted device IDs
-    uint32_t measurement_age_ms;    // Age of last measurement cycle (ms)
-} sensor_reading_t;
-
 // ============================================================================
 // EVENT STRUCTURE
 // ============================================================================
@@ -122,13 +102,13 @@ public:
     void update();
 
     /**
-     * @brief Log sensor readings
+     * @brief Log sensor readings (queued for the network task)
      * @param reading Sensor reading structure
      */
     void logReading(sensor_reading_t* reading);
 
     /**
-     * @brief Log event
+     * @brief Log event (queued for the network task)
      * @param event_type Event type string
      * @param description Event description
      * @param value Optional numeric value
@@ -136,7 +116,7 @@ public:
     void logEvent(const char* event_type, const char* description, int32_t value = 0);
 
     /**
-     * @brief Log alarm
+     * @brief Log alarm (queued for the network task)
      * @param alarm_code Alarm code
      * @param alarm_name Alarm name
      * @param active True if alarm became active
@@ -145,6 +125,20 @@ public:
     void logAlarm(uint16_t alarm_code, const char* alarm_name,
                   bool active, float trigger_value);
 
+    /**
+     * @brief Send a queued record, or keep it for later (network task)
+     */
+    void deliver(const net_msg_t* msg);
+
+    /**
+     * @brief Upload records replayed from the SD telemetry spool
+     *
+     * Runs of readings are sent as batches; events and alarms one by one.
+     * @return Records delivered or rejected by the server (not retried),
+     *         from the start of recs; the rest are to be sent again
+     */
+    uint32_t sendSpooled(const spool_record_t* recs, uint32_t count);
+
     /**
      * @brief Force upload of buffered data
      * @return Number of records uploaded
@@ -227,25 +221,45 @@ private:
     uint32_t _log_interval;
     int _last_http_status;
 
-    // Circular buffer for readings (store when offline)
-    static const int BUFFER_SIZE = 100;
-    sensor_reading_t _reading_buffer[BUFFER_SIZE];
-    int _buffer_head;
-    int _buffer_tail;
-    int _buffer_count;
+    // Readings kept while offline without an SD card (24 bytes each)
+    PackedReadingRing _ring;
 
-    // HTTP client
+    // HTTP client (keep-alive) and URLs built once per server
     HTTPClient _http;
+    char _url_host[TSDB_HOST_MAX_LEN];
+    uint16_t _url_port;
+    char _url_reading[TSDB_URL_MAX_LEN];
+    char _url_batch[TSDB_URL_MAX_LEN];
+    char _url_packed[TSDB_URL_MAX_LEN];
+    char _url_event[TSDB_URL_MAX_LEN];
+    char _url_alarm[TSDB_URL_MAX_LEN];
+
+    // Retry backoff after a failed POST (NET_RETRY_MIN_MS..NET_RETRY_MAX_MS)
+    uint32_t _retry_at;
+    uint32_t _retry_backoff;
+
+    // Batch upload: readings to send and the JSON or compressed body
+    sensor_reading_t _batch_readings[TSDB_BATCH_MAX];
+    char _batch_buf[TSDB_BATCH_BYTES];
 
     // Internal methods
+    bool prepareURLs();
+    bool post(const char* url, const char* body, size_t len,
+              const char* content_type = "application/json");
+    bool backingOff();
     bool uploadReading(sensor_reading_t* reading);
+    int uploadBatch(int count);
+    int uploadPackedBatch(int count);
     bool uploadEvent(event_log_t* event);
     bool uploadAlarm(alarm_log_t* alarm);
+    int batchSize();
+    size_t batchBytes();
+    bool spoolEnabled();
     void bufferReading(sensor_reading_t* reading);
-    bool uploadBuffered();
-    String buildReadingJSON(sensor_reading_t* reading);
-    String buildEventJSON(event_log_t* event);
-    String buildAlarmJSON(alarm_log_t* alarm);
+    int uploadBuffered();
+    void buildReadingJSON(const sensor_reading_t* reading, JsonDocument& doc);
+    void buildEventJSON(const event_log_t* event, JsonDocument& doc);
+    void buildAlarmJSON(const alarm_log_t* alarm, JsonDocument& doc);
     void handleWiFiEvents();
 };
 
@@ -0,0 +1,148 @@
+/**
+ * @file fuzzy_fixed.h
+ * @brief Fixed-point (Q15/Q16.16) variant of the Mamdani fuzzy controller
+ *
+ * Runs the same inference as FuzzyController (MIN/MAX, rule weights, sampled
+ * centroid over FUZZY_RESOLUTION points) with integer arithmetic only, so it
+ * gives bit-identical results on the ESP32 main MCU and the FPU-less ESP32-C3
+ * panel:
+ *   - Crisp inputs, MF breakpoints and outputs are Q16.16 (engineering units * 65536)
+ *   - Membership degrees, rule weights and firing strengths are Q15 (1.0 = 32768)
+ *   - Gaussian and sigmoid MFs use 257-entry exp / logistic tables with linear
+ *     interpolation (error < 0.05 % of full scale)
+ *   - Output sets are pre-sampled into Q15 tables; the centroid is an integer
+ *     moment sum with one 64-bit division per output
+ *
+ * Tables are compiled once from a float FuzzyController (load(), the only place
+ * float is used) and can be copied as a blob (getTables()/loadTables()), e.g.
+ * compiled on the main board or a PC and shipped to the panel.
+ * Sugeno inference and the non-centroid defuzzification methods are float-only.
+ */
+
+#ifndef FUZZY_FIXED_H
+#define FUZZY_FIXED_H
+
+#include <Arduino.h>
+#include "fuzzy_logic.h"
+
+#define FUZZY_Q15_ONE           32768           // Membership 1.0
+#define FUZZY_Q16_ONE           65536L          // Crisp 1.0
+#define FUZZY_Q15_MIN_FIRING    33              // 0.001 in Q15, same cut as the float engine
+#define FUZZY_Q_LUT_SIZE        257             // exp(-u) / logistic(z) at u, z = k/16, k = 0..256
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Membership function, Q16.16 parameters
+ * Triangular/trapezoidal: breakpoints. Gaussian: center, sigma.
+ * Sigmoid: center, slope (per unit, Q16.16). Singleton: value.
+ */
+typedef struct {
+    uint8_t type;                       // mf_type_t
+    int32_t params[4];
+} fuzzy_fixed_mf_t;
+
+typedef struct {
+    int32_t min_value;                  // Q16.16
+    int32_t max_value;
+    uint8_t num_sets;
+    fuzzy_fixed_mf_t sets[FUZZY_MAX_SETS];
+} fuzzy_fixed_var_t;
+
+typedef struct {
+    uint8_t antecedent[FUZZY_MAX_INPUTS];
+    uint8_t consequent[FUZZY_MAX_OUTPUTS];
+    uint16_t weight;                    // Q15
+    bool enabled;
+} fuzzy_fixed_rule_t;
+
+/**
+ * @brief Compiled controller (plain data, safe to memcpy / send / store)
+ */
+typedef struct {
+    fuzzy_fixed_var_t inputs[FUZZY_MAX_INPUTS];
+    fuzzy_fixed_var_t outputs[FUZZY_MAX_OUTPUTS];
+    fuzzy_fixed_rule_t rules[FUZZY_MAX_RULES];
+    uint8_t num_rules;
+    uint16_t out_mf[FUZZY_MAX_OUTPUTS][FUZZY_MAX_SETS][FUZZY_RESOLUTION];  // Output sets sampled, Q15
+} fuzzy_fixed_tables_t;
+
+/**
+ * @brief Inputs in Q16.16 (indexed by fuzzy_input_t)
+ * An input whose valid bit is clear reads as set 2 ("Normal"), like an unknown manual value.
+ */
+typedef struct {
+    int32_t value[FUZZY_MAX_INPUTS];
+    uint8_t valid_mask;                 // Bit i = input i known
+} fuzzy_inputs_q_t;
+
+typedef struct {
+    int32_t rate[FUZZY_MAX_OUTPUTS];    // Q16.16, indexed by fuzzy_output_t
+    uint16_t max_firing_strength;       // Q15
+    uint8_t active_rules;
+    uint8_t dominant_rule;
+} fuzzy_result_q_t;
+
+/**
+ * @brief float → Q16.16, rounded and saturated
+ */
+int32_t fuzzy_to_q16(float v);
+
+inline float fuzzy_q16_to_float(int32_t q) { return (float)q / (float)FUZZY_Q16_ONE; }
+
+// ============================================================================
+// FIXED-POINT FUZZY CONTROLLER
+// ============================================================================
+
+class FuzzyFixed {
+public:
+    FuzzyFixed();
+
+    /**
+     * @brief Compile variables and rules of a float controller into Q15/Q16 tables
+     * Call again after the float controller's config or rules change.
+     * @return false if the controller has no rules
+     */
+    bool load(const FuzzyController& src);
+
+    /**
+     * @brief Use tables compiled elsewhere (e.g. received from the main board)
+     */
+    bool loadTables(const fuzzy_fixed_tables_t& tables);
+
+    const fuzzy_fixed_tables_t& getTables() const { return _t; }
+    bool isLoaded() const { return _loaded; }
+
+    /**
+     * @brief Integer-only inference (no float, no state; identical on every target)
+     */
+    fuzzy_result_q_t evaluate(const fuzzy_inputs_q_t& inputs) const;
+
+    /**
+     * @brief Membership of one input set (Q15)
+     */
+    uint16_t getMembership(uint8_t var_idx, uint8_t set_idx, int32_t value_q16) const;
+
+    /**
+     * @brief Build Q16 inputs the way FuzzyController::evaluate() reads them:
+     * manual values for TDS/alkalinity/sulfite/pH, temperature and trend from inputs
+     */
+    static void inputsFromController(const FuzzyController& src, const fuzzy_inputs_t& inputs,
+                                     fuzzy_inputs_q_t* out);
+
+    /**
+     * @brief Convert a fixed-point result to the float result struct
+     */
+    static fuzzy_result_t toFloat(const fuzzy_result_q_t& r);
+
+private:
+    fuzzy_fixed_tables_t _t;
+    bool _loaded;
+
+    static uint16_t evaluateMF(const fuzzy_fixed_mf_t& mf, int32_t x);
+    void sampleOutputSets();
+};
+
+#endif // FUZZY_FIXED_H
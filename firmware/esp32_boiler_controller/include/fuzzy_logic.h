@@ -27,6 +27,8 @@
 #define FUZZY_LOGIC_H
 
 #include <Arduino.h>
+#include <atomic>
+#include "config.h"             // fuzzy_config_t (system_config_t.fuzzy)
 
 // ============================================================================
 // CONFIGURATION
@@ -37,6 +39,44 @@
 #define FUZZY_MAX_OUTPUTS       4       // Maximum output variables
 #define FUZZY_MAX_SETS          7       // Max membership functions per variable
 #define FUZZY_RESOLUTION        101     // Defuzzification resolution (0-100)
+#define FUZZY_ANALYTIC_MAX_BREAKS 128   // Breakpoints for closed-form centroid (vertices + crossings)
+#define FUZZY_RULE_WORDS        ((FUZZY_MAX_RULES + 31) / 32)  // 32-bit words per rule bitset
+#define FUZZY_SUGENO_PARAMS     (FUZZY_MAX_INPUTS + 1)  // c0 + one coefficient per normalized input
+#define FUZZY_SETPOINT_INPUTS   4       // TDS, alkalinity, sulfite, pH: sets follow the setpoints (RAM)
+
+// Precomputed control surface over (temperature, trend) for the current manual inputs
+#define FUZZY_SURFACE_MAX_NODES     24      // Max grid nodes per axis (heap use ~N*N*26 bytes)
+#define FUZZY_SURFACE_DEFAULT_NODES 24      // Default node budget per axis
+#define FUZZY_SURFACE_DEFAULT_MAX_ERR 1.0f  // Accept surface if cell-center error <= this (% output)
+
+// Incremental evaluation: an input is re-fuzzified only if it moved more than this
+// fraction of its range since it was last fuzzified (setCacheEpsilon overrides per input)
+#define FUZZY_CACHE_EPS_FRACTION    0.0001f
+
+// Binary rule base (see fuzzy_rb_encode): 6-byte header + 6 bytes per rule
+// (+ Sugeno consequents in version 2)
+#define FUZZY_RB_MAGIC0             'F'
+#define FUZZY_RB_MAGIC1             'R'
+#define FUZZY_RB_VERSION            1       // Rules only (Sugeno: output set centroids)
+#define FUZZY_RB_VERSION_SUGENO     2       // Rules + Sugeno consequents
+#define FUZZY_RB_HEADER_SIZE        6
+#define FUZZY_RB_RECORD_SIZE        6
+#define FUZZY_RB_SUGENO_SCALE       100     // Consequent parameter units per 1.0 (int16, ±327.67)
+#define FUZZY_RB_MAX_SIZE           (FUZZY_RB_HEADER_SIZE + FUZZY_MAX_RULES * FUZZY_RB_RECORD_SIZE + 1 + \
+                                     FUZZY_MAX_RULES * FUZZY_MAX_OUTPUTS * FUZZY_SUGENO_PARAMS * 2)
+#define FUZZY_RB_DONT_CARE          0x0F    // Nibble value for DONT_CARE
+#define FUZZY_RB_WEIGHT_ONE         200     // Weight byte for 1.0 (steps of 0.005)
+
+// Inference trace ring (see FuzzyController::enableTrace)
+#define FUZZY_TRACE_TOP_K           4       // Strongest rules kept per record
+#define FUZZY_TRACE_DEFAULT_DEPTH   128     // Records (56 bytes each, heap, plus one spare slot)
+#define FUZZY_TRACE_MAX_DEPTH       1024
+#define FUZZY_TRACE_DEFAULT_SAMPLE  10      // Record every 10th evaluation (1 s at the 100 ms control loop)
+#define FUZZY_TRACE_FLAG_SURFACE    0x01    // Answered from the control surface (top rule = dominant node rule)
+#define FUZZY_TRACE_FLAG_SUGENO     0x02
+
+// Batch evaluation (see FuzzyController::evaluateBatch)
+#define FUZZY_BATCH_BLOCK           16      // Points per block (heap scratch ~6 KB per call)
 
 // ============================================================================
 // LINGUISTIC VARIABLE INDICES
@@ -78,6 +118,62 @@ typedef enum {
     MF_SINGLETON                // Single point: value
 } mf_type_t;
 
+// ============================================================================
+// CENTROID IMPLEMENTATION
+// ============================================================================
+
+typedef enum {
+    FUZZY_CENTROID_SAMPLED = 0,     // Discrete sum over FUZZY_RESOLUTION points
+    FUZZY_CENTROID_ANALYTIC         // Exact area/moment of clipped triangles/trapezoids
+} fuzzy_centroid_impl_t;
+
+// ============================================================================
+// INFERENCE METHOD (fuzzy_config_t.inference_method)
+// ============================================================================
+
+typedef enum {
+    FUZZY_INFERENCE_MAMDANI = 0,    // Clip/MAX aggregation + centroid
+    FUZZY_INFERENCE_SUGENO          // Weighted average of constant/linear rule consequents
+} fuzzy_inference_t;
+
+// ============================================================================
+// DEFUZZIFICATION METHOD (fuzzy_config_t.defuzz_method)
+// ============================================================================
+
+typedef enum {
+    FUZZY_DEFUZZ_CENTROID = 0,      // Center of gravity
+    FUZZY_DEFUZZ_BISECTOR,          // Splits the area in half
+    FUZZY_DEFUZZ_MOM,               // Mean of maximum
+    FUZZY_DEFUZZ_SOM,               // Smallest of maximum
+    FUZZY_DEFUZZ_LOM,               // Largest of maximum
+    FUZZY_DEFUZZ_COUNT
+} fuzzy_defuzz_t;
+
+/**
+ * @brief All defuzzified values of one aggregated output (see fuzzy_defuzz_all)
+ */
+typedef struct {
+    float value[FUZZY_DEFUZZ_COUNT];    // Indexed by fuzzy_defuzz_t
+} fuzzy_defuzz_all_t;
+
+// ============================================================================
+// BINARY RULE BASE STATUS
+// ============================================================================
+
+typedef enum {
+    FUZZY_RB_OK = 0,
+    FUZZY_RB_ERR_LENGTH,            // Shorter than the header or not header + count * record
+    FUZZY_RB_ERR_MAGIC,
+    FUZZY_RB_ERR_VERSION,
+    FUZZY_RB_ERR_COUNT,             // 0 rules or more than FUZZY_MAX_RULES
+    FUZZY_RB_ERR_CRC,
+    FUZZY_RB_ERR_TERM,              // Term nibble >= FUZZY_MAX_SETS (other than don't care)
+    FUZZY_RB_ERR_WEIGHT,            // Weight byte > FUZZY_RB_WEIGHT_ONE
+    FUZZY_RB_ERR_NO_CONSEQUENT,     // Rule with every consequent don't care
+    FUZZY_RB_ERR_SUGENO,            // Sugeno section: parameter count other than 1 or FUZZY_SUGENO_PARAMS
+    FUZZY_RB_ERR_BUSY               // Another upload is being staged, or the spare bank is still being read
+} fuzzy_rb_status_t;
+
 // ============================================================================
 // LINGUISTIC TERM NAMES
 // ============================================================================
@@ -129,6 +225,12 @@ typedef struct {
     bool enabled;
 } fuzzy_rule_t;
 
+// Sugeno consequents per rule and output: c0, then one coefficient per normalized input.
+// Held as in the binary rule base, int16 in units of 1 / FUZZY_RB_SUGENO_SCALE (3.5 KB
+// per table rather than 7 KB of float; each rule bank has one)
+typedef int16_t fuzzy_sugeno_table_t[FUZZY_MAX_RULES][FUZZY_MAX_OUTPUTS][FUZZY_SUGENO_PARAMS];
+#define FUZZY_SUGENO_LSB            (1.0f / FUZZY_RB_SUGENO_SCALE)
+
 /**
  * @brief Fuzzy inference result
  */
@@ -162,34 +264,64 @@ typedef struct {
 } fuzzy_inputs_t;
 
 /**
- * @brief Fuzzy controller configuration (stored in NVS)
+ * @brief Control surface status (see FuzzyController::enableSurface)
+ */
+typedef struct {
+    bool enabled;
+    bool valid;                 // Last build is current and within the error bound (lookup in use)
+    uint8_t temp_nodes;
+    uint8_t trend_nodes;
+    float max_error;            // Worst |surface - exact| at cell centers, % output
+    float error_bound;
+    uint32_t build_us;          // Duration of the last rebuild
+    uint32_t builds;
+    bool pending;               // Manual inputs, config or rules changed since the last build
+} fuzzy_surface_status_t;
+
+/**
+ * @brief Incremental evaluation counters (see FuzzyController::setCacheEnabled)
  */
 typedef struct {
-    // Setpoints for "MEDIUM" membership function centers
-    float cond_setpoint;        // Target conductivity µS/cm
-    float alk_setpoint;         // Target alkalinity ppm
-    float sulfite_setpoint;     // Target sulfite ppm
-    float ph_setpoint;          // Target pH
-
-    // Deadbands (no action within this range around setpoint)
-    float cond_deadband;        // ±µS/cm
-    float alk_deadband;         // ±ppm
-    float sulfite_deadband;     // ±ppm
-    float ph_deadband;          // ±pH units
-
-    // Output scaling
-    float blowdown_max;         // Max blowdown duration per cycle (sec)
-    float caustic_max_ml_min;   // Max NaOH rate ml/min
-    float sulfite_max_ml_min;   // Max sulfite rate ml/min
-    float acid_max_ml_min;      // Max acid rate ml/min
-
-    // Control behavior
-    bool aggressive_mode;       // Faster response, higher overshoot risk
-    bool manual_override;       // Disable fuzzy, use manual rates
-    uint8_t inference_method;   // 0=Mamdani, 1=Sugeno
-    uint8_t defuzz_method;      // 0=Centroid, 1=Bisector, 2=MOM, 3=SOM, 4=LOM
-
-} fuzzy_config_t;
+    uint32_t evaluations;       // Exact evaluations (surface lookups not counted)
+    uint32_t full_passes;       // Evaluations after an invalidation (config/rules/method change)
+    uint32_t input_hits;        // Inputs whose cached membership was reused
+    uint32_t input_misses;      // Inputs re-fuzzified
+    uint32_t rule_hits;         // Rule firing strengths reused
+    uint32_t rule_misses;       // Rule firing strengths recomputed
+    uint32_t output_hits;       // Outputs whose crisp value was reused (clip levels unchanged)
+    uint32_t output_misses;     // Outputs defuzzified
+} fuzzy_cache_stats_t;
+
+/**
+ * @brief One traced evaluation (see FuzzyController::readTrace)
+ */
+typedef struct {
+    uint32_t seq;                               // 1-based evaluation record number
+    uint32_t t_ms;                              // millis() at evaluation
+    float input[FUZZY_MAX_INPUTS];              // Crisp inputs as used (indexed by fuzzy_input_t)
+    uint16_t output[FUZZY_MAX_OUTPUTS];         // Rates in 0.01 % (indexed by fuzzy_output_t)
+    uint8_t valid_mask;                         // Bit i = input i known
+    uint8_t active_rules;
+    uint8_t flags;                              // FUZZY_TRACE_FLAG_*, defuzz method in bits 4-7
+    uint8_t num_top;                            // Entries used in top_rule/top_strength
+    uint8_t top_rule[FUZZY_TRACE_TOP_K];        // Strongest firing rules, strongest first
+    uint16_t top_strength[FUZZY_TRACE_TOP_K];   // Firing strength after weight, 65535 = 1.0
+} fuzzy_trace_rec_t;
+
+/**
+ * @brief Structure-of-arrays batch for FuzzyController::evaluateBatch
+ * Point k reads input[i][k] and writes output[o][k]. Result arrays left nullptr are not filled.
+ */
+typedef struct {
+    const float* input[FUZZY_MAX_INPUTS];   // Indexed by fuzzy_input_t, nullptr = fixed (see evaluateBatch)
+    const uint8_t* valid_mask;              // Per point, bit i = input i known; nullptr = all known
+    float* output[FUZZY_MAX_OUTPUTS];       // Indexed by fuzzy_output_t (skipping one skips its defuzzification)
+    float* max_firing;
+    uint8_t* active_rules;                  // 0 = no rule fired (rule gap)
+    uint8_t* dominant_rule;
+    uint8_t* covered_mask;                  // Bit o = a fired rule has a consequent for output o
+    size_t count;
+} fuzzy_batch_t;
 
 // ============================================================================
 // FUZZY LOGIC CONTROLLER CLASS
@@ -201,7 +333,8 @@ public:
 
     /**
      * @brief Initialize fuzzy controller with default rules
-     * @param config Pointer to configuration structure
+     * @param config Fuzzy settings, normally &system_config_t.fuzzy; read in place, so
+     *        edits need notifyConfigChanged() (methods) or updateConfig() (setpoints)
      * @return true if successful
      */
     bool begin(fuzzy_config_t* config);
@@ -213,12 +346,41 @@ public:
      */
     fuzzy_result_t evaluate(const fuzzy_inputs_t& inputs);
 
+    /**
+     * @brief Evaluate many operating points (offline tuning, what-if sweeps)
+     *
+     * Same inference as the exact path of evaluate() with the current config, rules and
+     * methods. Points go through in blocks of FUZZY_BATCH_BLOCK: fuzzification, rule
+     * firing and aggregation are branch-free loops across the block (vectorized by the
+     * host compiler), defuzzification is per point. Never uses the surface or the cache
+     * and writes no controller state, so the live loop is unaffected and another task
+     * may run it beside evaluate(). The whole call reads one rule bank (rules and Sugeno
+     * consequents); a swap meanwhile takes effect from the next call.
+     * A nullptr input column holds the value set with setManualInput() (with its validity)
+     * for TDS..pH, and 0 for temperature and trend.
+     * @return Points evaluated (0 without a config or if the scratch block could not be allocated)
+     */
+    size_t evaluateBatch(const fuzzy_batch_t& batch);
+
+    /**
+     * @brief Array-of-structs form of evaluateBatch()
+     * Unlike evaluate(), every input comes from the struct: conductivity as TDS (always
+     * known), alkalinity, sulfite and pH with their valid flags.
+     */
+    size_t evaluateBatch(const fuzzy_inputs_t* inputs, fuzzy_result_t* results, size_t count);
+
     /**
      * @brief Update configuration and rebuild membership functions
      * @param config New configuration
      */
     void updateConfig(fuzzy_config_t* config);
 
+    /**
+     * @brief Call after editing fields of the active config in place (e.g. inference or
+     * defuzzification method from the web UI); drops results cached from the old values
+     */
+    void notifyConfigChanged() { invalidateDerived(); }
+
     /**
      * @brief Get membership degree for input in specific set
      * @param var_idx Variable index (fuzzy_input_t)
@@ -238,18 +400,23 @@ public:
 
     /**
      * @brief Add or modify a rule
+     *
+     * Staged like loadRuleBase(): the change is made on a copy of the live rule base (or on
+     * the rule base already staged) and goes live at the next evaluate(), so tasks reading
+     * the live bank never see it half edited. Safe from any one task at a time.
      * @param rule_idx Rule index (0 to FUZZY_MAX_RULES-1)
      * @param rule Rule definition
-     * @return true if successful
+     * @return false if the index is out of range or staging is busy (see loadRuleBase)
      */
     bool setRule(uint8_t rule_idx, const fuzzy_rule_t& rule);
 
     /**
-     * @brief Enable/disable a rule
+     * @brief Enable/disable a rule (staged like setRule)
      * @param rule_idx Rule index
      * @param enabled Enable state
+     * @return false if the index is out of range or staging is busy
      */
-    void enableRule(uint8_t rule_idx, bool enabled);
+    bool enableRule(uint8_t rule_idx, bool enabled);
 
     /**
      * @brief Get number of active rules
@@ -258,9 +425,52 @@ public:
 
     /**
      * @brief Reset to default rule base
+     * Edits the live rule base: for begin() and the task that runs evaluate() while no
+     * other task reads rules. Other tasks use stageDefaultRules().
      */
     void loadDefaultRules();
 
+    /**
+     * @brief Validate a binary rule base and stage it for the next evaluate()
+     *
+     * Rules are double-buffered: the blob is decoded and indexed into the inactive
+     * bank, and evaluate() switches banks before it reads any rule, so an evaluation
+     * always sees either the old or the new rule base in full. Safe to call from
+     * another task (e.g. the web server) while the control task evaluates. A second
+     * upload before the swap replaces the staged one. The staged bank gets its own
+     * Sugeno consequents: those in the blob (version 2), otherwise the new rules'
+     * output set centroids.
+     * FUZZY_RB_ERR_BUSY: another upload is being staged, or the bank to fill was retired
+     * by the last swap and another task (exportRuleBase, evaluateBatch) is still reading it.
+     * @param data Blob in the fuzzy_rb_encode() format
+     * @param len Blob length in bytes
+     * @return FUZZY_RB_OK, a validation error (nothing staged) or FUZZY_RB_ERR_BUSY
+     */
+    fuzzy_rb_status_t loadRuleBase(const uint8_t* data, size_t len);
+
+    /**
+     * @brief Stage the default rule base the same way (safe from another task)
+     * @return false when busy (see loadRuleBase)
+     */
+    bool stageDefaultRules();
+
+    /**
+     * @brief Encode the live rule base and its Sugeno consequents (fuzzy_rb_encode
+     * format, version 2); safe from another task
+     * @return Bytes written, 0 if cap is too small
+     */
+    size_t exportRuleBase(uint8_t* out, size_t cap) const;
+
+    /**
+     * @brief True while a staged rule base waits for the next evaluate()
+     */
+    bool hasPendingRuleBase() const { return _rb_stage.load() == RB_STAGE_READY; }
+
+    /**
+     * @brief Number of staged rule bases that went live
+     */
+    uint32_t getRuleBaseSwaps() const { return _rb_swaps; }
+
     /**
      * @brief Print debug info to Serial
      */
@@ -274,16 +484,203 @@ public:
      */
     void setManualInput(fuzzy_input_t param, float value, bool valid = true);
 
+    /**
+     * @brief Select centroid implementation
+     * Analytic integrates the clipped piecewise-linear output sets exactly and falls back
+     * to sampling for outputs that use Gaussian/sigmoid/singleton sets.
+     * @param impl FUZZY_CENTROID_SAMPLED or FUZZY_CENTROID_ANALYTIC
+     */
+    void setCentroidImpl(fuzzy_centroid_impl_t impl) { _centroid_impl = impl; invalidateDerived(); }
+    fuzzy_centroid_impl_t getCentroidImpl() const { return _centroid_impl; }
+
+    /**
+     * @brief Use the (input, term) → rules index to skip rules with an inactive antecedent
+     * Disabling it walks every enabled rule (reference path for tests/benchmarks).
+     */
+    void setRuleIndexEnabled(bool enabled) { _rule_index_enabled = enabled; _cache_valid = false; }
+
+    /**
+     * @brief Rules whose firing strength was computed in the last evaluate()
+     * (with the cache enabled, only candidates that reference a changed input)
+     */
+    uint8_t getLastCandidateRules() const { return _last_candidates; }
+
+    /**
+     * @brief Answer evaluate() from a precomputed surface over (temperature, trend)
+     *
+     * With config, rules and manual inputs fixed the controller is a pure function of
+     * temperature and trend. updateSurface() builds the surface off the control path;
+     * evaluate() takes a finished one over between evaluations and uses it only while none
+     * of those inputs changed since it was built. Until then evaluate() stays exact.
+     * Lookups are bilinear. Grid nodes start at the MF breakpoints; the cell with the worst
+     * center error is then split (along the axis whose edge error is larger) until every
+     * center is within max_error or the node budget is spent. If the bound is not met the
+     * surface is not used. In surface mode, membership degrees (printDebugInfo) reflect the
+     * last exact evaluation. Safe to call from another task.
+     * @param nodes_per_axis Node budget per axis (2..FUZZY_SURFACE_MAX_NODES)
+     * @param max_error Error bound in output percent
+     */
+    void enableSurface(uint8_t nodes_per_axis = FUZZY_SURFACE_DEFAULT_NODES,
+                       float max_error = FUZZY_SURFACE_DEFAULT_MAX_ERR);
+
+    /**
+     * @brief Stop using the surface; evaluate() frees the grid (safe from another task)
+     */
+    void disableSurface();
+
+    /**
+     * @brief Rebuild the surface if it is enabled and out of date (call from a background task)
+     *
+     * Runs the batch engine over one rule bank, so it never touches evaluate()'s state and
+     * can run beside it. The new grid (heap, ~15 KB) is handed to evaluate() atomically; a
+     * change during the build leaves it out of date, and the next call builds again.
+     * @return true if a surface was built (within the bound or not)
+     */
+    bool updateSurface();
+
+    /**
+     * @brief Surface state, node counts, achieved error and build time
+     */
+    fuzzy_surface_status_t getSurfaceStatus() const;
+
+    /**
+     * @brief Set the Sugeno consequent of one rule for one output
+     *
+     * z = c0 + sum(coeffs[i] * u[i]), u[i] = input i normalized to 0..1 over its range
+     * (unknown manual inputs use the "Normal" set peak). Used when
+     * fuzzy_config_t.inference_method == FUZZY_INFERENCE_SUGENO; the output is
+     * sum(w_r * z_r) / sum(w_r) over rules whose Mamdani consequent for that output is set.
+     * @param rule_idx Rule index
+     * @param output_idx Output index (fuzzy_output_t)
+     * @param c0 Constant term (output units, 0-100%)
+     * Values are kept to FUZZY_SUGENO_LSB (0.01), saturating at ±327.67.
+     * @param coeffs FUZZY_MAX_INPUTS coefficients, or nullptr for zero-order
+     * @return false if an index is out of range
+     */
+    bool setSugenoConsequent(uint8_t rule_idx, uint8_t output_idx, float c0, const float* coeffs = nullptr);
+
+    /**
+     * @brief Read back a Sugeno consequent (FUZZY_SUGENO_PARAMS values: c0, coeffs...)
+     */
+    bool getSugenoConsequent(uint8_t rule_idx, uint8_t output_idx, float* params) const;
+
+    /**
+     * @brief Zero-order Sugeno constants from the Mamdani consequents (output set centroids)
+     * Called by loadDefaultRules(); setRule() does the same for the rule it replaces.
+     * Like setSugenoConsequent(), edits the live bank: call from the evaluate task.
+     */
+    void resetSugenoConsequents();
+
+    /**
+     * @brief Firing strength (after weight) of every rule in the last exact evaluation
+     * @param strengths Array of FUZZY_MAX_RULES (0 for rules that did not fire)
+     * @param inputs_norm Optional FUZZY_MAX_INPUTS normalized inputs used by the Sugeno consequents
+     * @return Number of rules in the live rule base
+     */
+    uint8_t getLastRuleStrengths(float* strengths, float* inputs_norm = nullptr) const;
+
+    /**
+     * @brief Reuse membership vectors, rule firing strengths and crisp outputs between evaluations
+     *
+     * Each input keeps the value it was last fuzzified at; it is re-fuzzified only when it
+     * moves by more than its epsilon (or its validity changes). Only rules that reference a
+     * re-fuzzified input are recomputed, and only outputs whose clip levels changed are
+     * defuzzified again. updateConfig(), notifyConfigChanged(), rule changes, Sugeno
+     * consequent changes and method switches invalidate everything. Enabled by default.
+     */
+    void setCacheEnabled(bool enabled) { _cache_enabled = enabled; _cache_valid = false; }
+    bool isCacheEnabled() const { return _cache_enabled; }
+
+    /**
+     * @brief Re-fuzzify threshold of one input, in input units (0 = any change)
+     * Default: FUZZY_CACHE_EPS_FRACTION of the input range (set by begin()).
+     */
+    void setCacheEpsilon(uint8_t var_idx, float epsilon);
+
+    fuzzy_cache_stats_t getCacheStats() const { return _cache_stats; }
+    void resetCacheStats() { memset(&_cache_stats, 0, sizeof(_cache_stats)); }
+
+    /**
+     * @brief Record sampled evaluations in a ring: crisp inputs, outputs and the
+     * FUZZY_TRACE_TOP_K strongest rules with their firing strengths
+     *
+     * Non-sampled evaluations cost one counter increment; a sampled one scans the
+     * fired-rule bitset once (no allocation, no Serial). Allocate before the control
+     * task starts evaluating; enableTrace()/disableTrace() are not safe against a
+     * concurrent evaluate(). setTraceSampling() and readTrace() are.
+     * @param depth Ring size in records (capped at FUZZY_TRACE_MAX_DEPTH)
+     * @param sample_every Record every Nth evaluate() (0 = paused)
+     * @return false if the ring could not be allocated
+     */
+    bool enableTrace(uint16_t depth = FUZZY_TRACE_DEFAULT_DEPTH,
+                     uint16_t sample_every = FUZZY_TRACE_DEFAULT_SAMPLE);
+    void disableTrace();
+    void setTraceSampling(uint16_t sample_every) { _trace_sample = sample_every; }
+    uint16_t getTraceSampling() const { return _trace_sample; }
+    uint16_t getTraceDepth() const { return _trace ? _trace_depth : 0; }
+
+    /**
+     * @brief Sequence number of the newest record (0 = none yet)
+     */
+    uint32_t getTraceHead() const { return _trace_head.load(); }
+
+    /**
+     * @brief Copy records newer than after_seq, oldest first (safe from another task)
+     *
+     * Records overwritten by the control task during the copy are dropped, so the
+     * result is always a run of consecutive, intact records. Poll with the last
+     * seq received to stream the ring; a gap in seq means records were lost.
+     * @return Number of records copied
+     */
+    size_t readTrace(fuzzy_trace_rec_t* out, size_t max_records, uint32_t after_seq = 0) const;
+
+    /**
+     * @brief Read-only access to variable and rule definitions (e.g. to compile FuzzyFixed tables)
+     * Indices are not range-checked.
+     */
+    const linguistic_var_t& getInputVar(uint8_t var_idx) const { return *_inputs[var_idx]; }
+    const linguistic_var_t& getOutputVar(uint8_t var_idx) const { return _outputs[var_idx]; }
+    const fuzzy_rule_t& getRule(uint8_t rule_idx) const { return live()->rules[rule_idx]; }
+    uint8_t getRuleCount() const { return live()->num_rules; }
+
+    /**
+     * @brief Last manual value set with setManualInput()
+     * @return false if param is out of range
+     */
+    bool getManualInput(fuzzy_input_t param, float* value, bool* valid) const;
+
 private:
     fuzzy_config_t* _config;
 
-    // Linguistic variables
-    linguistic_var_t _inputs[FUZZY_MAX_INPUTS];
-    linguistic_var_t _outputs[FUZZY_MAX_OUTPUTS];
-
-    // Rule base
-    fuzzy_rule_t _rules[FUZZY_MAX_RULES];
-    uint8_t _num_rules;
+    // Linguistic variables. Output variables and the temperature/trend inputs point into
+    // constexpr tables in flash; only the setpoint-dependent inputs are held in RAM.
+    linguistic_var_t _setpoint_vars[FUZZY_SETPOINT_INPUTS];
+    const linguistic_var_t* _inputs[FUZZY_MAX_INPUTS];
+    const linguistic_var_t* _outputs;
+
+    // Rule base with its index (bit r = rule r). At most two adjacent terms per input
+    // have non-zero membership, so the candidates are
+    // enabled & AND_i (dont_care[i] | OR_{active t} by_term[i][t]).
+    typedef struct {
+        fuzzy_rule_t rules[FUZZY_MAX_RULES];
+        uint8_t num_rules;
+        uint32_t by_term[FUZZY_MAX_INPUTS][FUZZY_MAX_SETS][FUZZY_RULE_WORDS];
+        uint32_t dont_care[FUZZY_MAX_INPUTS][FUZZY_RULE_WORDS];
+        uint32_t enabled[FUZZY_RULE_WORDS];
+        uint32_t uses_input[FUZZY_MAX_INPUTS][FUZZY_RULE_WORDS];  // Rules with a real term on input i
+        fuzzy_sugeno_table_t sugeno;    // Swapped with the rules
+    } rule_bank_t;
+
+    // Double buffer: evaluate() reads *_rb; loadRuleBase() fills the other bank.
+    // _rb_stage hands the inactive bank between the writer and evaluate(). Other tasks
+    // that read the live bank (export, batch) count themselves in _rb_readers, so a bank
+    // retired by a swap is not restaged while one of them is still reading it.
+    enum { RB_STAGE_FREE = 0, RB_STAGE_WRITING, RB_STAGE_READY, RB_STAGE_SWAPPING };
+    rule_bank_t _banks[2];
+    std::atomic<rule_bank_t*> _rb;
+    mutable std::atomic<uint8_t> _rb_readers[2];
+    std::atomic<uint8_t> _rb_stage;
+    uint32_t _rb_swaps;
 
     // Current fuzzified inputs
     float _input_membership[FUZZY_MAX_INPUTS][FUZZY_MAX_SETS];
@@ -292,14 +689,131 @@ private:
     float _manual_values[FUZZY_MAX_INPUTS];
     bool _manual_valid[FUZZY_MAX_INPUTS];
 
+    fuzzy_centroid_impl_t _centroid_impl;
+
+    bool _rule_index_enabled;
+    uint8_t _last_candidates;
+
+    // Last exact evaluation (fitting/diagnostics)
+    float _rule_strength[FUZZY_MAX_RULES];
+    float _input_norm[FUZZY_MAX_INPUTS];
+
+    // Incremental evaluation cache (_rule_strength holds the cached firing strengths)
+    bool _cache_enabled;
+    bool _cache_valid;                                  // False → next evaluation is a full pass
+    float _cache_value[FUZZY_MAX_INPUTS];               // Value each input was last fuzzified at
+    bool _cache_input_valid[FUZZY_MAX_INPUTS];
+    float _cache_eps[FUZZY_MAX_INPUTS];
+    uint32_t _rule_fired[FUZZY_RULE_WORDS];             // Rules with non-zero cached strength
+    float _cache_clip[FUZZY_MAX_OUTPUTS][FUZZY_MAX_SETS];
+    float _cache_crisp[FUZZY_MAX_OUTPUTS];
+    uint8_t _cache_mode;                                // Inference/defuzz/centroid impl of the cached outputs
+    fuzzy_cache_stats_t _cache_stats;
+
+    // Control surface (heap, allocated by updateSurface)
+    typedef struct {
+        uint32_t derived_gen, surface_gen;                      // What it was built from
+        bool valid;                                             // Within the error bound
+        uint8_t nt, nr;                                         // Nodes: temperature, trend
+        float t[FUZZY_SURFACE_MAX_NODES];
+        float r[FUZZY_SURFACE_MAX_NODES];
+        float out[FUZZY_SURFACE_MAX_NODES][FUZZY_SURFACE_MAX_NODES][FUZZY_MAX_OUTPUTS + 1];  // +max firing
+        uint8_t active[FUZZY_SURFACE_MAX_NODES][FUZZY_SURFACE_MAX_NODES];
+        uint8_t dominant[FUZZY_SURFACE_MAX_NODES][FUZZY_SURFACE_MAX_NODES];
+        float cell_err[FUZZY_SURFACE_MAX_NODES][FUZZY_SURFACE_MAX_NODES];  // |lookup - exact| at centers
+    } surface_t;
+
+    // Exact result at one (temperature, trend) point during a surface build
+    typedef struct {
+        float out[FUZZY_MAX_OUTPUTS + 1];                       // +max firing
+        uint8_t active;
+        uint8_t dominant;
+    } surface_point_t;
+
+    // Scratch for one evaluateBatch() block (heap, allocated per call)
+    typedef struct {
+        float x[FUZZY_MAX_INPUTS][FUZZY_BATCH_BLOCK];
+        uint8_t valid[FUZZY_MAX_INPUTS][FUZZY_BATCH_BLOCK];
+        float mu[FUZZY_MAX_INPUTS][FUZZY_MAX_SETS][FUZZY_BATCH_BLOCK];
+        float norm[FUZZY_MAX_INPUTS][FUZZY_BATCH_BLOCK];
+        float strength[FUZZY_BATCH_BLOCK];
+        float clip[FUZZY_MAX_OUTPUTS][FUZZY_MAX_SETS][FUZZY_BATCH_BLOCK];
+        float num[FUZZY_MAX_OUTPUTS][FUZZY_BATCH_BLOCK];    // Sugeno weighted sums
+        float den[FUZZY_MAX_OUTPUTS][FUZZY_BATCH_BLOCK];
+        float max_firing[FUZZY_BATCH_BLOCK];
+        uint8_t active[FUZZY_BATCH_BLOCK];
+        uint8_t dominant[FUZZY_BATCH_BLOCK];
+        uint8_t covered[FUZZY_BATCH_BLOCK];
+    } batch_block_t;
+
+    // Inference trace ring (heap, allocated by enableTrace)
+    fuzzy_trace_rec_t* _trace;
+    uint16_t _trace_depth;
+    volatile uint16_t _trace_sample;
+    uint16_t _trace_skip;                               // Evaluations since the last record
+    std::atomic<uint32_t> _trace_head;                  // seq of the newest complete record
+
+    // Control surface: updateSurface() publishes a build in _surface_next, evaluate() takes
+    // it over as _surface (control task only). Both stamp what they depend on with the
+    // generation counters, which other tasks bump, so nothing stale is ever looked up.
+    surface_t* _surface;
+    std::atomic<surface_t*> _surface_next;
+    std::atomic<bool> _surface_enabled;
+    std::atomic<uint8_t> _surface_nodes;
+    std::atomic<float> _surface_max_err;
+    std::atomic<uint32_t> _derived_gen;                 // Config, rules, consequents (invalidateDerived)
+    std::atomic<uint32_t> _surface_gen;                 // Manual inputs and surface settings
+    uint32_t _cache_gen;                                // _derived_gen the cache was filled under
+
+    // Last build (updateSurface side)
+    uint32_t _surface_built_derived;
+    uint32_t _surface_built_gen;
+    bool _surface_built;
+    bool _surface_ok;
+    uint8_t _surface_nt, _surface_nr;
+    float _surface_err;
+    uint32_t _surface_build_us;
+    uint32_t _surface_builds;
+
     // Internal methods
-    void initInputVariables();
-    void initOutputVariables();
+    void invalidateDerived() { _derived_gen.fetch_add(1); }
     void updateMembershipFunctions();
+    void rebuildRuleIndex();
+    void indexRuleBank(rule_bank_t* b);
+    static void fillDefaultRules(rule_bank_t* b);
+    rule_bank_t* live() const { return _rb.load(std::memory_order_relaxed); }  // Control task only swaps it
+    rule_bank_t* acquireStagingBank(bool* was_staged = nullptr);
+    rule_bank_t* acquireEditBank();
+    const rule_bank_t* acquireReadBank() const;
+    void releaseReadBank(const rule_bank_t* b) const;
+    void applyStagedRuleBase();
+    void recordTrace(const fuzzy_inputs_t& inputs, const fuzzy_result_t& result, bool from_surface);
+    void selectCandidateRules(uint32_t* candidates);
+
+    fuzzy_result_t evaluateExact(const fuzzy_inputs_t& inputs);
+    void evaluateBlock(const rule_bank_t* rb, const fuzzy_batch_t& batch, size_t base, uint8_t n,
+                       batch_block_t* s);
+    void fuzzifyBlock(const membership_func_t& mf, const float* x, uint8_t n, float* mu,
+                      float min_val, float max_val);
+    float normalizeInput(uint8_t var_idx, float value, bool valid);
+    void resetSugenoRule(rule_bank_t* b, uint8_t rule_idx);
+    void resetSugenoBank(rule_bank_t* b);
+    void buildSurface(surface_t& sf, const rule_bank_t* rb, batch_block_t* s);
+    uint8_t buildSurfaceAxis(uint8_t var_idx, float* nodes, uint8_t max_nodes);
+    fuzzy_result_t lookupSurface(const surface_t& sf, float temperature, float trend) const;
+    void surfaceExact(const rule_bank_t* rb, batch_block_t* s, const float* t, const float* r, uint8_t n,
+                      surface_point_t* out);
+    void surfaceEvalNodes(surface_t& sf, const rule_bank_t* rb, batch_block_t* s, bool temp_axis, uint8_t k);
+    void surfaceCellErrors(surface_t& sf, const rule_bank_t* rb, batch_block_t* s,
+                           uint8_t i0, uint8_t i1, uint8_t j0, uint8_t j1);
+    bool surfaceSplitTemp(const surface_t& sf, const rule_bank_t* rb, batch_block_t* s, uint8_t wi, uint8_t wj);
+    void surfaceSplit(surface_t& sf, const rule_bank_t* rb, batch_block_t* s, bool temp_axis, uint8_t k);
 
     float evaluateMF(const membership_func_t& mf, float value, float min_val, float max_val);
     float applyRule(const fuzzy_rule_t& rule);
-    float defuzzify(uint8_t output_idx, float* aggregated);
+    float defuzzify(uint8_t output_idx, float* aggregated, uint8_t method = FUZZY_DEFUZZ_CENTROID);
+    float defuzzifyAnalytic(uint8_t output_idx, const float* clip);
+    void sampleAggregation(uint8_t output_idx, const float* clip, float* aggregated);
 
     // T-norm and S-norm operations
     float tNormMin(float a, float b) { return min(a, b); }
@@ -307,6 +821,68 @@ private:
     float sNormMax(float a, float b) { return max(a, b); }
 };
 
+// ============================================================================
+// DEFUZZIFICATION HELPER
+// ============================================================================
+
+/**
+ * @brief Centroid, bisector, MOM, SOM and LOM of a sampled output in one pass
+ *
+ * One scan builds the prefix sum of membership (area), the first moment and the
+ * plateau of the maximum; bisector is then a binary search on the prefix sums.
+ * O(n) time, no allocation. Sample k sits at min_v + (max_v - min_v) * k / (n - 1).
+ * All values are 0 when the total membership is below 0.001 (no rule fired).
+ * @param aggregated n membership samples
+ * @param prefix Scratch array of n floats (cumulative membership)
+ * @param n Number of samples (>= 2)
+ * @param min_v Crisp value of the first sample
+ * @param max_v Crisp value of the last sample
+ * @param out Results indexed by fuzzy_defuzz_t
+ */
+void fuzzy_defuzz_all(const float* aggregated, float* prefix, uint16_t n,
+                      float min_v, float max_v, fuzzy_defuzz_all_t* out);
+
+// ============================================================================
+// BINARY RULE BASE
+// ============================================================================
+
+/**
+ * @brief Encode rules in the compact binary format
+ *
+ * Header: 'F' 'R', version, rule count, CRC-16/CCITT (init 0xFFFF, little-endian)
+ * over the records. Record per rule, 6 bytes:
+ *   bytes 0-2  antecedent terms, one nibble each, input 0 in the low nibble of byte 0
+ *   bytes 3-4  consequent terms, output 0 in the low nibble of byte 3
+ *   byte  5    weight * FUZZY_RB_WEIGHT_ONE, 0 = rule disabled
+ * Nibble FUZZY_RB_DONT_CARE = don't care. Terms >= FUZZY_MAX_SETS are stored as don't care.
+ *
+ * With Sugeno consequents the version is FUZZY_RB_VERSION_SUGENO and the records are
+ * followed by one byte P (1 = zero-order, FUZZY_SUGENO_PARAMS = first-order), then for
+ * each rule and each output it names (in rule, then output order) P int16 values,
+ * little-endian, in units of 1 / FUZZY_RB_SUGENO_SCALE: c0, then the input coefficients
+ * (the units of fuzzy_sugeno_table_t, stored as they are). P is 1 when every coefficient
+ * is 0.
+ * @param sugeno Consequents to store, or nullptr for a rules-only (version 1) blob
+ * @return Bytes written, 0 if cap is too small
+ */
+size_t fuzzy_rb_encode(const fuzzy_rule_t* rules, uint8_t count, uint8_t* out, size_t cap,
+                       const fuzzy_sugeno_table_t* sugeno = nullptr);
+
+/**
+ * @brief Validate and decode a binary rule base
+ * @param rules Output array of FUZZY_MAX_RULES (untouched unless FUZZY_RB_OK)
+ * @param count Number of rules decoded
+ * @param sugeno Version 2: every (rule, output) of the decoded rules is written (0 where
+ *        the consequent is don't care). Version 1: untouched. May be nullptr.
+ */
+fuzzy_rb_status_t fuzzy_rb_decode(const uint8_t* data, size_t len, fuzzy_rule_t* rules, uint8_t* count,
+                                  fuzzy_sugeno_table_t* sugeno = nullptr);
+
+/**
+ * @brief Short name of a status code (for logs and the web API)
+ */
+const char* fuzzy_rb_status_name(fuzzy_rb_status_t status);
+
 // ============================================================================
 // GLOBAL INSTANCE
 // ============================================================================
@@ -0,0 +1,141 @@
+/**
+ * @file historian.h
+ * @brief In-RAM multi-resolution trend history (constant memory)
+ *
+ * Three tiers per channel, each a ring of fixed slots allocated once at boot:
+ *
+ *   raw      1 s averages     last HIST_RAW_SLOTS s   (10 min)
+ *   minute   min / avg / max  last HIST_MINUTE_SLOTS  (1 day)
+ *   hour     min / avg / max  last HIST_HOUR_SLOTS    (30 days)
+ *
+ * record() adds a sample to the open 1 s bucket. When a bucket closes it is
+ * written to its slot and its sum/count/min/max are carried into the open
+ * bucket of the next tier (cascading rollup), so every insert is O(1) and the
+ * averages of coarse tiers are exact, not averages of averages. Values are
+ * stored as int16 at the channel's resolution.
+ *
+ * Time is the caller's monotonic second counter (uptime); a gap leaves empty
+ * slots, a sample older than the open bucket is ignored. Readers in other
+ * tasks (web server) copy slots under a sequence counter and retry if
+ * record() ran meanwhile; the recording task is never blocked.
+ */
+
+#ifndef HISTORIAN_H
+#define HISTORIAN_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#define HIST_RAW_SLOTS          600         // 10 min of 1 s averages
+#define HIST_MINUTE_SLOTS       1440        // 1 day of 1 min aggregates
+#define HIST_HOUR_SLOTS         720         // 30 days of 1 h aggregates
+#define HIST_TIERS              3
+#define HIST_EMPTY              INT16_MIN   // Slot without samples
+
+typedef enum {
+    HIST_CH_CONDUCTIVITY = 0,   // µS/cm, 1 µS/cm resolution
+    HIST_CH_TEMPERATURE,        // °C, 0.1
+    HIST_CH_FLOW,               // gpm, 0.01
+    HIST_CH_VALVE_MA,           // Blowdown valve feedback mA, 0.01
+    HIST_CHANNELS
+} hist_channel_t;
+
+typedef struct {
+    uint32_t t;                 // Start of the point's interval (historian seconds)
+    float min;
+    float avg;
+    float max;
+} hist_point_t;
+
+// ============================================================================
+// HISTORIAN CLASS
+// ============================================================================
+
+class Historian {
+public:
+    Historian();
+
+    /**
+     * @brief Allocate the tiers (once; fixed size afterwards)
+     * @return false if the allocation failed (record/query then do nothing)
+     */
+    bool begin();
+
+    /**
+     * @brief Add one sample per channel (NAN = no sample for that channel)
+     * @param t_sec Monotonic seconds; several samples in one second are averaged
+     * @return false if t_sec is older than the open bucket
+     */
+    bool record(uint32_t t_sec, const float values[HIST_CHANNELS]);
+
+    /**
+     * @brief Points of one channel over [from, to]
+     *
+     * Uses the finest tier that still holds `from`; points are step_s apart
+     * (rounded up to a multiple of that tier's resolution) and cover min/avg/max
+     * of their interval. Intervals without data are skipped.
+     *
+     * @param resume Set to where a follow-up call continues when max_points was reached
+     *               (to + 1 when the range is complete)
+     * @return Number of points written to out (0 also if the tiers changed under
+     *         the reader three times in a row)
+     */
+    size_t query(uint8_t channel, uint32_t from, uint32_t to, uint32_t step_s,
+                 hist_point_t* out, size_t max_points, uint32_t* resume) const;
+
+    /**
+     * @brief Resolution query() will use for a range starting at `from`
+     */
+    uint32_t resolutionFor(uint32_t from) const;
+
+    /**
+     * @brief Oldest second still held by any tier (0 before the first sample)
+     */
+    uint32_t getOldest() const;
+
+    bool isReady() const { return _mem != nullptr; }
+    size_t getMemoryBytes() const { return _mem_bytes; }
+    static const char* channelName(uint8_t channel);
+    static const char* channelUnit(uint8_t channel);
+    static int channelIndex(const char* name);      // -1 if unknown
+
+private:
+    typedef struct {
+        float sum;
+        float min;
+        float max;
+        uint32_t n;
+    } acc_t;
+
+    typedef struct {
+        uint32_t period;            // Seconds per slot
+        uint16_t slots;
+        bool started;
+        uint32_t open;              // Period number of the bucket being accumulated
+        int16_t* avg;               // [slots][HIST_CHANNELS]
+        int16_t* min;               // nullptr on the raw tier (min = max = avg)
+        int16_t* max;
+        acc_t acc[HIST_CHANNELS];
+    } tier_t;
+
+    tier_t _tier[HIST_TIERS];
+    void* _mem;
+    size_t _mem_bytes;
+    std::atomic<uint32_t> _seq;     // Odd while record() modifies the tiers
+
+    void advance(uint8_t level, uint32_t t_sec);
+    void feed(uint8_t level, uint32_t t_sec, const acc_t* carry);
+    void clearSlot(tier_t& tr, uint32_t period_no);
+    bool readSlot(const tier_t& tr, uint32_t period_no, uint8_t ch, float* mn, float* av, float* mx) const;
+    uint8_t tierFor(uint32_t from) const;
+    size_t queryOnce(uint8_t channel, uint32_t from, uint32_t to, uint32_t step_s,
+                     hist_point_t* out, size_t max_points, uint32_t* resume) const;
+};
+
+// ============================================================================
+// GLOBAL INSTANCE
+// ============================================================================
+
+extern Historian historian;
+
+#endif // HISTORIAN_H
@@ -0,0 +1,193 @@
+/**
+ * @file mpc_dosing.h
+ * @brief Model predictive dosing (feed mode M), an alternative to fuzzy Mode F
+ *
+ * Mode F doses from the current fuzzy inputs only; between lab tests it keeps
+ * acting on the last (aging) manual values. Mode M keeps a model of each
+ * residual and plans the pump rate over a short horizon:
+ *
+ *   c[k+1] = a*c[k] + b*u[k] + d
+ *   a = 1 - dt*(Qbd/V + kd)       blowdown removes residual, chemical decays
+ *   b = dt*gain/V                 u = pump rate, ml/min
+ *   d = dt*Qm*load/V + bias       makeup brings residual in (load < 0: demand)
+ *
+ * V is the boiler volume, Qm the makeup flow (water meters), Qbd the mean
+ * blowdown flow (valve duty from BlowdownController x valve flow). Every
+ * MPC_STEP_SEC the planner minimises
+ *
+ *   sum ((c[k] - setpoint) / deadband)^2 + move_weight * sum (u[k] / u_max)^2
+ *
+ * subject to 0 <= u[k] <= u_max (the fuzzy *_max_ml_min limits) with an
+ * accelerated projected gradient (gradient by one forward/backward pass, so
+ * O(horizon) per iteration, no matrices), warm-started from the previous
+ * plan. Only the first move is applied.
+ *
+ * Lab tests (manual inputs) reset the residual estimate; the prediction error
+ * since the previous test feeds a per-step bias so model errors do not leave
+ * a steady offset. A channel has no plan (rate 0) until its first test.
+ * pH is a log quantity: the acid channel models hydroxide instead
+ * (OH- mmol/L = 10^(pH - 11), which concentrates and is neutralised
+ * linearly) and converts tests, setpoint and deadband on the way in.
+ *
+ * Channels are indexed like pump_id_t (0 = H2SO3/acid, 1 = NaOH/caustic,
+ * 2 = amine/sulfite), matching the fuzzy rate mapping in the control task.
+ */
+
+#ifndef MPC_DOSING_H
+#define MPC_DOSING_H
+
+#include <Arduino.h>
+
+// Forward declaration only: the controller is used by mpc_dosing.cpp
+class FuzzyController;
+
+#define MPC_CHANNELS                3       // Indexed like pump_id_t
+#define MPC_HORIZON                 24      // Prediction steps
+#define MPC_STEP_SEC                300     // 5 min per step, 2 h horizon
+#define MPC_MAX_ITER                80      // Solver iterations per channel and step
+#define MPC_TOL                     1e-4f   // Stop when no move changes by more than this * u_max
+#define MPC_FLOW_SMOOTHING          0.3f    // EMA weight of the last step's flows in the forecast
+#define MPC_BIAS_GAIN               0.5f    // Share of the per-step prediction error taken into the bias
+#define MPC_MIN_DOSE_ML             0.5f    // Pump dispenses once this much has accumulated
+
+// Plant defaults (16 gal boiler, conductivity blowdown valve)
+#define MPC_DEFAULT_BOILER_GAL      16.0f
+#define MPC_DEFAULT_BLOWDOWN_GPM    2.0f    // Flow with the blowdown valve open
+#define MPC_DEFAULT_MOVE_WEIGHT     0.05f
+#define MPC_DEFAULT_MAX_ML_MIN      5.0f    // Used when the fuzzy limit is 0 (unlimited)
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Linear model of one residual
+ */
+typedef struct {
+    uint8_t input;              // fuzzy_input_t measured by lab test
+    bool hydroxide;             // Input is pH; model OH- in mmol/L
+    float gain;                 // Residual change x boiler gal per ml of product (< 0 lowers)
+    float makeup_load;          // Residual per gallon of makeup (concentrates with cycles; < 0 = demand)
+    float decay_per_hr;         // First-order consumption in the boiler
+    float move_weight;          // Chemical cost relative to tracking error
+} mpc_channel_model_t;
+
+typedef struct {
+    float boiler_volume_gal;
+    float blowdown_gpm;
+    mpc_channel_model_t ch[MPC_CHANNELS];
+} mpc_model_t;
+
+typedef struct {
+    bool enabled;               // Pump is in feed mode M
+    bool has_estimate;          // At least one lab test seen
+    float setpoint;
+    float deadband;
+    float max_ml_min;
+    float residual;             // Estimate at the start of the current step (test units)
+    float bias;                 // Unmodelled change per step (model units)
+    float rate_ml_min;          // First planned move (applied this step)
+    float predicted_end;        // Residual at the end of the horizon (test units)
+    float cost;
+    uint8_t iterations;
+} mpc_channel_status_t;
+
+typedef struct {
+    float makeup_gpm;           // Smoothed flows used for the forecast
+    float blowdown_gpm;
+    uint32_t solve_us;          // Last planning pass, all channels
+    uint32_t max_solve_us;
+    uint32_t plans;
+} mpc_status_t;
+
+// ============================================================================
+// MPC DOSING CONTROLLER
+// ============================================================================
+
+class MpcDosing {
+public:
+    MpcDosing();
+
+    /**
+     * @brief Reset estimates and use the default model
+     */
+    void begin();
+
+    void setModel(const mpc_model_t& model) { _model = model; }
+    const mpc_model_t& getModel() const { return _model; }
+
+    /**
+     * @brief Setpoint, deadband (error scale) and rate limit of one channel
+     * @param max_ml_min 0 selects MPC_DEFAULT_MAX_ML_MIN
+     */
+    void setTarget(uint8_t ch, float setpoint, float deadband, float max_ml_min);
+
+    /**
+     * @brief Plan only for pumps in feed mode M (a disabled channel doses 0)
+     */
+    void setEnabled(uint8_t ch, bool enabled);
+
+    /**
+     * @brief Lab test result for a channel's residual; used at the next update()
+     */
+    void measure(uint8_t ch, float value);
+
+    /**
+     * @brief Feed the latest manual values; a changed valid value counts as a new test
+     */
+    void pollManualInputs(const FuzzyController& fc);
+
+    /**
+     * @brief Call every control cycle
+     * @param now_ms Current time (millis())
+     * @param makeup_gal Makeup volume since the previous call
+     * @param blowdown_active Blowdown valve open
+     * @return true when a new plan was computed (step boundary or new lab test)
+     */
+    bool update(uint32_t now_ms, float makeup_gal, bool blowdown_active);
+
+    /**
+     * @brief Planned rate for the current step, ml/min (0 when disabled or untested)
+     */
+    float getRate(uint8_t ch) const;
+
+    const mpc_channel_status_t& getChannelStatus(uint8_t ch) const { return _ch[ch]; }
+    const mpc_status_t& getStatus() const { return _status; }
+
+    /**
+     * @brief Plan one channel over the horizon (no state; used by update() and the host bench)
+     * @param plan In: warm start, out: MPC_HORIZON moves in 0..u_max
+     * @return Cost of the returned plan
+     */
+    static float solve(float c0, float a, float b, float d, float setpoint, float deadband,
+                       float u_max, float move_weight, float* plan, uint8_t* iterations);
+
+private:
+    mpc_model_t _model;
+    mpc_channel_status_t _ch[MPC_CHANNELS];
+    mpc_status_t _status;
+    float _x[MPC_CHANNELS];             // Residual estimate in model units
+    float _plan[MPC_CHANNELS][MPC_HORIZON];
+    float _pending[MPC_CHANNELS];
+    bool _pending_valid[MPC_CHANNELS];
+    float _since_test_min[MPC_CHANNELS];
+    float _last_manual[MPC_CHANNELS];
+    bool _last_manual_valid[MPC_CHANNELS];
+    bool _started;
+    uint32_t _last_ms;
+    uint32_t _step_start_ms;
+    float _step_makeup_gal;
+    uint32_t _step_blowdown_ms;
+
+    void closeStep(uint32_t elapsed_ms);
+    float toModel(uint8_t ch, float value) const;
+    float toTest(uint8_t ch, float x) const;
+};
+
+// ============================================================================
+// GLOBAL INSTANCE
+// ============================================================================
+
+extern MpcDosing mpcDosing;
+
+#endif // MPC_DOSING_H
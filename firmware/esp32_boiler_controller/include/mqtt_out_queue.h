@@ -0,0 +1,127 @@
+/**
+ * @file mqtt_out_queue.h
+ * @brief Bounded MQTT outbound queue with in-flight window and drain rate limit
+ *
+ * MqttTelemetry puts readings, alarms and events here instead of publishing
+ * them straight away, so nothing is lost while the broker is unreachable:
+ *
+ *   - each message comes with its {boot_id, sequence} and keeps them, so a
+ *     message published twice (resent after a reconnect, or replayed from the
+ *     SD spool after a reset) carries the same pair and the backend drops the
+ *     copy. Replays from an earlier boot have that boot's numbers, so the
+ *     queue orders messages by a separate `order`, one per push
+ *   - PubSubClient publishes QoS 0 only (no PUBACK), so a published message
+ *     stays in the queue "in flight" until confirmed: MqttTelemetry echoes the
+ *     last order through the broker on its own ack topic (the broker keeps
+ *     a connection's messages in order, so the echo confirms everything before
+ *     it), or, with a broker that does not echo, once the connection has stayed
+ *     up MQTT_CONFIRM_MS after the publish. If the connection drops or the echo
+ *     is overdue, resend() puts the in-flight messages back in line
+ *     (at-least-once delivery)
+ *   - at most MQTT_INFLIGHT_MAX messages are unconfirmed, and publishing is
+ *     paced by a token bucket (MQTT_DRAIN_PER_SEC, bursts of MQTT_DRAIN_BURST)
+ *     so a reconnect does not flood the broker or starve the network task
+ *   - when full, the oldest queued reading makes room (alarms and events are
+ *     kept); with an SD card, MqttTelemetry spools the overflow instead
+ *   - a message replayed from the spool carries the spool cursor past its
+ *     record; confirming it returns that cursor, so the spool only moves on
+ *     (and saves its position) once the record is delivered
+ *
+ * Used by the network task only; no locking.
+ */
+
+#ifndef MQTT_OUT_QUEUE_H
+#define MQTT_OUT_QUEUE_H
+
+#include <Arduino.h>
+#include "net_outbox.h"
+
+#define MQTT_QUEUE_SLOTS        32      // 6.1 KB
+#define MQTT_INFLIGHT_MAX       16      // Published, not yet confirmed
+#define MQTT_CONFIRM_MS         1500    // Without ack echo: connection up this long = delivered
+#define MQTT_ACK_TIMEOUT_MS     5000    // Ack echo overdue: resend
+#define MQTT_DRAIN_PER_SEC      10
+#define MQTT_DRAIN_BURST        10
+
+typedef struct {
+    net_msg_t msg;
+    uint32_t order;                     // One more than the previous push (wraps); echoed as the ack
+    uint32_t boot_id;                   // Payload numbering, kept on every publish
+    uint32_t sequence;
+    uint32_t spool_next;                // Spool cursor once delivered; 0 = not from the spool
+    uint32_t sent_at;                   // millis() of the last publish
+} mqtt_queued_t;
+
+// ============================================================================
+// QUEUE CLASS
+// ============================================================================
+
+class MqttOutQueue {
+public:
+    MqttOutQueue();
+
+    /**
+     * @brief Queue a message with its order and numbering (sent_at is ignored)
+     * @param drop_reading When full, drop the oldest waiting reading to make room
+     * @return false when full and nothing was dropped
+     */
+    bool push(const mqtt_queued_t* item, bool drop_reading);
+
+    /**
+     * @brief Next message to publish, if the window and the rate allow one
+     * @return nullptr when nothing may be published now
+     */
+    const mqtt_queued_t* next(uint32_t now);
+
+    /**
+     * @brief The message from next() was published
+     */
+    void markSent(uint32_t now);
+
+    /**
+     * @brief Ack echo received: messages up to this order are delivered
+     * @return spool_next of the last spooled message delivered, 0 if none
+     */
+    uint32_t confirm(uint32_t order);
+
+    /**
+     * @brief Connection is up: messages published MQTT_CONFIRM_MS ago are delivered
+     * @return As confirm()
+     */
+    uint32_t confirmBefore(uint32_t now);
+
+    /**
+     * @brief The oldest in-flight message has waited MQTT_ACK_TIMEOUT_MS
+     */
+    bool ackOverdue(uint32_t now);
+
+    /**
+     * @brief Connection lost: publish the in-flight messages again
+     */
+    void resend();
+
+    void clear();
+
+    int count() const { return _count; }
+    int inFlight() const { return _sent; }
+    uint32_t lastSentOrder();
+    bool isFull() const { return _count >= MQTT_QUEUE_SLOTS; }
+    uint32_t getDropped() const { return _dropped; }
+    uint32_t getResent() const { return _resent; }
+
+private:
+    mqtt_queued_t _slots[MQTT_QUEUE_SLOTS];
+    uint8_t _head;                      // Oldest
+    uint8_t _count;
+    uint8_t _sent;                      // Oldest _sent messages are in flight
+    uint32_t _dropped;
+    uint32_t _resent;
+    uint32_t _tokens_milli;             // Token bucket, 1000 per publish
+    uint32_t _refill_at;
+
+    mqtt_queued_t* at(int i) { return &_slots[(_head + i) % MQTT_QUEUE_SLOTS]; }
+    bool dropOldestReading();
+    uint32_t release();
+};
+
+#endif // MQTT_OUT_QUEUE_H
@@ -3,8 +3,16 @@
  * @brief MQTT + Sparkplug-compatible telemetry (Modern IoT Stack)
  *
  * Publishes to device/{id}/state, metrics, alarm, health.
- * Payload: timestamp, device_id, sequence_number, metrics (id, value, unit, quality).
- * Offline buffering; non-blocking.
+ * Payload: timestamp, device_id, boot_id, sequence, metrics (id, value, unit, quality).
+ * Non-blocking. The publishX calls only queue the message (net_outbox.h); the
+ * network task hands it to deliver(), which puts readings, alarms and events
+ * in the outbound queue (mqtt_out_queue.h) with their sequence number. The
+ * queue is published after connect at a limited rate, in-flight messages are
+ * confirmed by an ack echoed through the broker (device/{id}/ack) and resent
+ * with the same {boot_id, sequence} after a drop, so the backend can discard
+ * copies. What does not fit in the queue is spooled on the SD card
+ * (telemetry_spool.h) with the numbering it was given, and replayed through
+ * the queue via sendSpooled(); the ack echo confirms it to the spool.
  */
 
 #ifndef MQTT_TELEMETRY_H
@@ -12,6 +20,9 @@
 
 #include "config.h"
 #include "data_logger.h"
+#include "spool_record.h"
+#include "net_outbox.h"
+#include "mqtt_out_queue.h"
 
 class MqttTelemetry {
 public:
@@ -26,11 +37,23 @@ public:
     void publishHealth(uint32_t uptime_sec, int free_heap, bool wifi_ok, uint16_t active_alarms);
     void publishCommandResult(const char* request_id, const char* result, const char* message);
     void publishEvent(const char* event_type, const char* description, int32_t value, uint32_t timestamp);
+    void deliver(const net_msg_t* msg);
+    uint32_t sendSpooled(const spool_record_t* recs, const uint32_t* next, uint32_t count);
+    void onAck(const char* payload, unsigned int len);
+
+    int getQueued() const { return _queue.count(); }
+    uint32_t getQueueRoom() const { return MQTT_QUEUE_SLOTS - _queue.count(); }
+    uint32_t getQueueDropped() const { return _queue.getDropped(); }
 
 private:
     system_config_t* _config;
     bool _connected;
     uint32_t _sequence;
+    uint32_t _boot_id;              // Random per boot; with _sequence the backend's dedup key
+    uint32_t _order;                // Next queue order (the ack echo)
+    MqttOutQueue _queue;
+    bool _ack_seen;                 // Broker echoed an ack on this connection
+    bool _ack_timed;                // No echo: confirm in-flight messages by time
     uint32_t _last_reconnect;
     uint32_t _backoff_ms;
     char _device_id[DEVICE_ID_MAX_LEN];
@@ -39,7 +62,21 @@ private:
     bool connect();
     void disconnect();
     bool publish(const char* topic_suffix, const char* payload);
-    void buildMetricsPayload(const sensor_reading_t* reading, char* buf, size_t buf_len);
+    bool spoolEnabled() const;
+    void drainQueue();
+    bool enqueue(const net_msg_t* msg, uint32_t boot_id, uint32_t sequence, uint32_t spool_next,
+                 bool drop_reading);
+    void confirmed(uint32_t spool_next);
+    bool sendQueued(const mqtt_queued_t* q);
+    bool sendReading(const sensor_reading_t* reading, uint32_t boot_id, uint32_t sequence);
+    bool sendAlarm(uint16_t alarm_code, const char* alarm_name, bool active, float trigger_value,
+                   uint32_t timestamp, uint32_t boot_id, uint32_t sequence);
+    bool sendEvent(const char* event_type, const char* description, int32_t value,
+                   uint32_t timestamp, uint32_t boot_id, uint32_t sequence);
+    bool sendHealth(const net_msg_t* msg);
+    bool sendCommandResult(const net_msg_t* msg);
+    void buildMetricsPayload(const sensor_reading_t* reading, uint32_t boot_id, uint32_t sequence,
+                             char* buf, size_t buf_len);
 };
 
 extern MqttTelemetry mqttTelemetry;
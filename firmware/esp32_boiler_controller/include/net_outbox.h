@@ -0,0 +1,118 @@
+/**
+ * @file net_outbox.h
+ * @brief Outbound telemetry queue serviced by the network task
+ *
+ * DataLogger (HTTP) and MqttTelemetry calls made from the control, logging
+ * and measurement tasks only copy a fixed-size net_msg_t into this queue;
+ * the network task (main.cpp taskNetworkLoop) is the only task that touches
+ * HTTPClient or the MQTT client. A slow or unreachable server therefore
+ * delays telemetry, never the 10 Hz control loop. push() never blocks: when
+ * the queue is full the message is dropped and counted (readings are still on
+ * the SD log).
+ */
+
+#ifndef NET_OUTBOX_H
+#define NET_OUTBOX_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "sensor_reading.h"
+
+#define NET_OUTBOX_SLOTS        16
+#define NET_TASK_PERIOD_MS      1000    // WiFi/MQTT upkeep, buffer and spool replay
+#define NET_HTTP_TIMEOUT_MS     4000    // Response timeout per POST
+#define NET_HTTP_CONNECT_MS     2000    // TCP connect timeout
+#define NET_RETRY_MIN_MS        2000    // Backoff after a failed POST, doubling
+#define NET_RETRY_MAX_MS        60000
+
+typedef enum {
+    NET_MSG_READING = 1,
+    NET_MSG_EVENT,
+    NET_MSG_ALARM,
+    NET_MSG_HEALTH,
+    NET_MSG_COMMAND_RESULT
+} net_msg_kind_t;
+
+typedef enum {
+    NET_SINK_HTTP = 0,                  // DataLogger
+    NET_SINK_MQTT                       // MqttTelemetry
+} net_sink_t;
+
+typedef struct {
+    uint8_t kind;                       // net_msg_kind_t
+    uint8_t sink;                       // net_sink_t
+    uint32_t timestamp;                 // When queued (Unix time, or uptime s without NTP)
+    union {
+        sensor_reading_t reading;
+        struct {
+            int32_t value;
+            char type[32];
+            char description[128];
+        } event;
+        struct {
+            uint16_t code;
+            bool active;
+            float trigger_value;
+            char name[32];
+        } alarm;
+        struct {
+            uint32_t uptime_sec;
+            int32_t free_heap;
+            bool wifi_ok;
+            uint16_t active_alarms;
+        } health;
+        struct {
+            char request_id[48];
+            char result[16];
+            char message[64];
+        } command;
+    };
+} net_msg_t;
+
+typedef struct {
+    uint32_t queued;
+    uint32_t dropped;                   // Queue full
+    uint32_t high_water;
+} net_outbox_stats_t;
+
+// ============================================================================
+// OUTBOX CLASS
+// ============================================================================
+
+class NetOutbox {
+public:
+    NetOutbox();
+
+    /**
+     * @brief Create the queue (setup, before the tasks start)
+     */
+    bool begin();
+
+    /**
+     * @brief Queue a message (any task, never blocks)
+     * @return false when the queue is full (message dropped)
+     */
+    bool push(const net_msg_t* msg);
+
+    /**
+     * @brief Take the oldest message (network task only)
+     * @param wait_ms Sleep up to this long for one to arrive
+     */
+    bool pop(net_msg_t* out, uint32_t wait_ms);
+
+    net_outbox_stats_t getStats() const;
+
+private:
+    QueueHandle_t _queue;
+    std::atomic<uint32_t> _queued;
+    std::atomic<uint32_t> _dropped;
+    std::atomic<uint32_t> _high_water;
+};
+
+// ============================================================================
+// GLOBAL INSTANCE
+// ============================================================================
+
+extern NetOutbox netOutbox;
+
+#endif // NET_OUTBOX_H
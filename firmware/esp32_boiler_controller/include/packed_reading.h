@@ -0,0 +1,116 @@
+/**
+ * @file packed_reading.h
+ * @brief 24-byte delta-packed reading and the RAM ring that holds them
+ *
+ * sensor_reading_t takes 60 bytes (padded bools, 32-bit counters). Readings
+ * waiting in RAM for upload are kept as packed_reading_t instead:
+ *
+ *   - values quantized as in the SD log record (sdlog_pack: 0.1 °C, 0.01 gpm,
+ *     0.1 mA, SD_REC_* flags), conductivity at 1 µS/cm as in the historian
+ *   - timestamp, water meter totals and feedwater pump counters stored as
+ *     16-bit deltas from the previous reading in the ring
+ *   - safe mode, device counts and the pump cycle delta in bitfields
+ *
+ * A delta that does not fit (NTP setting the clock, a counter reset, a long
+ * gap) is preceded by a keyframe slot holding the absolute values, so nothing
+ * is clamped. The ring keeps the absolute values of the reading before its
+ * oldest slot, so the oldest reading can be decoded and dropped in O(1).
+ * Conversion back to sensor_reading_t happens only when a reading leaves the
+ * ring. The SD log and the telemetry spool keep sd_log_record_t: their
+ * records must each decode on their own (random access, torn writes).
+ */
+
+#ifndef PACKED_READING_H
+#define PACKED_READING_H
+
+#include <Arduino.h>
+#include "sd_log_record.h"
+
+#define PACKED_READING_SIZE     24
+#define PACKED_RING_SLOTS       250         // 6000 bytes, as 100 sensor_reading_t
+#define PACKED_KEYFRAME         0x80        // flags: slot holds absolute values
+#define PACKED_FW_CYCLES_MAX    31          // 5-bit pump cycle delta
+
+typedef struct __attribute__((packed)) {
+    uint8_t flags;                  // SD_REC_* or PACKED_KEYFRAME
+    uint8_t status;                 // Safe mode (bits 0-2), pump cycles since previous (3-7)
+    uint8_t devices;                // Operational (high nibble), faulted (low nibble)
+    uint8_t valve_dmA;              // 0.1 mA
+    union {
+        struct __attribute__((packed)) {
+            uint16_t dt_s;                  // Seconds since the previous reading
+            uint16_t conductivity;          // 1 µS/cm
+            int16_t temperature_d;          // 0.1 °C
+            uint16_t flow_cgpm;             // 0.01 gpm
+            uint16_t d_water_meter1;        // Gallons since the previous reading
+            uint16_t d_water_meter2;
+            uint16_t d_fw_on_time_sec;
+            uint16_t active_alarms;
+            uint16_t devices_faulted_mask;
+            uint16_t measurement_age_ms;    // Saturates at 65535
+        } d;
+        struct __attribute__((packed)) {
+            uint32_t timestamp;
+            uint32_t water_meter1;
+            uint32_t water_meter2;
+            uint32_t fw_pump_cycle_count;
+            uint32_t fw_pump_on_time_sec;
+        } key;
+    };
+} packed_reading_t;
+
+static_assert(sizeof(packed_reading_t) == PACKED_READING_SIZE, "Packed reading size");
+
+// Absolute values the deltas apply to
+typedef struct {
+    uint32_t timestamp;
+    uint32_t water_meter1;
+    uint32_t water_meter2;
+    uint32_t fw_pump_cycle_count;
+    uint32_t fw_pump_on_time_sec;
+} packed_base_t;
+
+// ============================================================================
+// RING CLASS
+// ============================================================================
+
+class PackedReadingRing {
+public:
+    PackedReadingRing();
+
+    /**
+     * @brief Add a reading; when full the oldest readings are dropped
+     */
+    void push(const sensor_reading_t* reading);
+
+    /**
+     * @brief Decode up to max of the oldest readings without removing them
+     * @return Readings written to out
+     */
+    int peek(sensor_reading_t* out, int max) const;
+
+    /**
+     * @brief Remove the n oldest readings
+     */
+    void drop(int n);
+
+    void clear();
+
+    int count() const { return _count; }
+    int slotsUsed() const { return _used; }
+    uint32_t getDropped() const { return _dropped; }
+
+private:
+    packed_reading_t _slots[PACKED_RING_SLOTS];
+    uint16_t _tail;                 // Oldest slot
+    uint16_t _used;                 // Slots in use (readings + keyframes)
+    uint16_t _count;                // Readings
+    uint32_t _dropped;              // Overwritten before upload
+    packed_base_t _base;            // Reading before the oldest slot
+    packed_base_t _last;            // Newest reading
+
+    void put(const packed_reading_t* slot);
+    void decode(uint16_t* pos, packed_base_t* base, sensor_reading_t* out) const;
+};
+
+#endif // PACKED_READING_H
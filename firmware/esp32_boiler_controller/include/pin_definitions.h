@@ -254,6 +254,12 @@
 #define CP_LINK_UART_NUM        2             // Serial2
 #define CP_LINK_DE_RE_PIN      (-1)           // GPIO for DE/RE (set per board; -1 = not used)
 #define CP_LINK_BAUD            115200
+// Multi-drop: panels at addresses 1..CP_LINK_PANEL_COUNT on the same pair. Address 1 is the
+// boiler this controller doses (polled fastest, highest priority); the rest are monitor-only.
+#ifndef CP_LINK_PANEL_COUNT
+#define CP_LINK_PANEL_COUNT     1
+#endif
+#define CP_LINK_SECONDARY_POLL_MS  1000       // Telemetry period for panels other than address 1
 
 // ============================================================================
 // PIN VALIDATION
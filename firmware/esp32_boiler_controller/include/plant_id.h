@@ -0,0 +1,135 @@
+/**
+ * @file plant_id.h
+ * @brief Online identification of the boiler concentration dynamics (recursive least squares)
+ *
+ * Fits, every PLANT_ID_SAMPLE_SEC, the conductivity balance
+ *
+ *   C[k+1] - C[k] = Km * makeup_gal[k-d] - Kb * open_sec[k-d] * C[k] + drift
+ *
+ *   Km   µS/cm rise per gallon of makeup (feedwater conductivity / boiler volume)
+ *   Kb   fraction of conductivity removed per second of open blowdown valve
+ *        (valve flow / boiler volume); 1/Kb is the blowdown time constant
+ *   d    dead time (valve travel, mixing, sensor location) in samples
+ *
+ * One exponentially weighted RLS per dead-time candidate 0..PLANT_ID_MAX_DELAY-1
+ * runs in parallel; the candidate with the smallest a-priori error is published.
+ * Memory and CPU are fixed: a 3x3 covariance per candidate and a short ring of
+ * past regressors, one small update per candidate every 10 s. Forgetting is
+ * suspended while the covariance is large (no blowdown for a long time), so the
+ * estimate does not wind up between blowdowns.
+ *
+ * The fitted parameters feed auto-tuning: the MPC dosing model's blowdown flow,
+ * and suggested blowdown deadband and Mode P proportional band (reported only;
+ * the operator applies them).
+ */
+
+#ifndef PLANT_ID_H
+#define PLANT_ID_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define PLANT_ID_SAMPLE_SEC     10
+#define PLANT_ID_MAX_DELAY      12          // Dead-time candidates 0..110 s
+#define PLANT_ID_PARAMS         3           // Km, Kb (x1000), drift
+#define PLANT_ID_FORGETTING     0.9995f     // ~2000 samples ≈ 5.5 h memory
+#define PLANT_ID_P0             1000.0f     // Initial covariance (diagonal)
+#define PLANT_ID_TRACE_MAX      1.0e4f      // No forgetting above this covariance trace
+#define PLANT_ID_MIN_SAMPLES    360         // 1 h before the estimate is published
+#define PLANT_ID_MIN_BLOWDOWNS  30          // Samples with the valve open (excitation)
+#define PLANT_ID_PROP_MARGIN    1.5f        // Proportional band = deadbeat band x margin
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+typedef struct {
+    bool valid;                     // Enough data and excitation, physically sensible signs
+    uint32_t samples;
+    uint32_t blowdown_samples;      // Samples with the valve open
+    float makeup_gain;              // Km, µS/cm per gallon of makeup
+    float blowdown_rate;            // Kb, 1/s of open valve
+    float tau_blowdown_sec;         // 1 / Kb
+    float dead_time_sec;
+    float drift_per_min;            // Unmodelled change, µS/cm per minute
+    float rms_error;                // A-priori error of the selected model, µS/cm per sample
+
+    // Auto-tuning suggestions for the current setpoint (0 until valid)
+    float suggested_deadband;       // µS/cm: fall during valve close + dead time
+    float suggested_prop_band;      // µS/cm (Mode P): deadbeat band x PLANT_ID_PROP_MARGIN
+} plant_id_params_t;
+
+// ============================================================================
+// PLANT IDENTIFIER
+// ============================================================================
+
+class PlantIdentifier {
+public:
+    PlantIdentifier();
+
+    /**
+     * @brief Reset all estimates
+     * @param bd_config Blowdown setpoint and valve travel time for the suggestions (may be nullptr)
+     * @param cond_config Mode P max proportional time (may be nullptr)
+     */
+    void begin(const blowdown_config_t* bd_config = nullptr,
+               const conductivity_config_t* cond_config = nullptr);
+
+    /**
+     * @brief Call every control cycle
+     * @param now_ms Current time (millis())
+     * @param conductivity Calibrated conductivity (µS/cm)
+     * @param blowdown_open Blowdown valve open
+     * @param makeup_gal Makeup volume since the previous call
+     * @return true when a sample was processed (every PLANT_ID_SAMPLE_SEC)
+     */
+    bool update(uint32_t now_ms, float conductivity, bool blowdown_open, float makeup_gal);
+
+    const plant_id_params_t& getParams() const { return _params; }
+
+    /**
+     * @brief Parameters of one dead-time candidate (for diagnostics and tests)
+     */
+    void getCandidate(uint8_t delay, float theta[PLANT_ID_PARAMS], float* error) const;
+
+private:
+    typedef struct {
+        float theta[PLANT_ID_PARAMS];
+        float P[PLANT_ID_PARAMS][PLANT_ID_PARAMS];
+        float err;                  // EWMA of the squared a-priori error
+    } rls_t;
+
+    rls_t _rls[PLANT_ID_MAX_DELAY];
+    float _hist_gal[PLANT_ID_MAX_DELAY];    // Ring of past samples, newest at _head
+    float _hist_open[PLANT_ID_MAX_DELAY];
+    uint8_t _head;
+    uint8_t _filled;
+
+    const blowdown_config_t* _bd_config;
+    const conductivity_config_t* _cond_config;
+    plant_id_params_t _params;
+
+    bool _started;
+    uint32_t _last_ms;
+    uint32_t _sample_start_ms;
+    float _sample_cond;             // Conductivity at the start of the sample
+    float _sample_gal;
+    uint32_t _sample_open_ms;
+    uint32_t _pulse_ms;             // Last makeup meter pulse (0 = none yet)
+    float _pulse_gal;
+    float _flow_gal_ms;             // Makeup flow between the last two pulses
+
+    void integrateMakeup(uint32_t now_ms, uint32_t dt_ms, float makeup_gal);
+
+    void processSample(float cond_now);
+    static void rlsUpdate(rls_t& r, const float phi[PLANT_ID_PARAMS], float y);
+    void publish(float cond_now);
+};
+
+// ============================================================================
+// GLOBAL INSTANCE
+// ============================================================================
+
+extern PlantIdentifier plantId;
+
+#endif // PLANT_ID_H
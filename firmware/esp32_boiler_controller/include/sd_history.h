@@ -0,0 +1,131 @@
+/**
+ * @file sd_history.h
+ * @brief Time-range reader over the SD reading logs (GET /api/history)
+ *
+ * SDHistoryReader walks the daily reading logs for [from, to] and produces CSV
+ * text (a header of the selected columns, then one row per reading) in pieces
+ * of whatever size the caller asks for, so an HTTP chunked response can be fed
+ * straight from it. Memory is the reader object (~1 KB), whatever the range:
+ *
+ *   - Days are visited from the local date of `from` to that of `to`; each
+ *     day's /logs/DATE.csv and /logs/DATE.bin are read if present (a day on
+ *     which the log format was switched has both; CSV rows come first).
+ *   - .bin: the .idx is binary-searched entry by entry on the card, then
+ *     records are read from the indexed one; records failing their CRC are
+ *     skipped.
+ *   - .csv: the file is bisected by offset (read a block, skip to the next
+ *     line, compare its timestamp) before reading forward.
+ *   - A file is left as soon as a timestamp passes `to`.
+ *   - step > 1 keeps the first reading in each step-second interval.
+ *
+ * All card access goes through SDHistorySource, one read of at most
+ * SD_HIST_BLOCK bytes per call; the SD implementation (sd_logger.h) holds the
+ * SPI mutex for exactly one such read.
+ */
+
+#ifndef SD_HISTORY_H
+#define SD_HISTORY_H
+
+#include <Arduino.h>
+#include "sd_log_record.h"
+
+#define SD_HIST_BLOCK           512         // Bytes per card read (one SPI mutex hold)
+#define SD_HIST_MAX_DAYS        400         // Longest range accepted
+
+// ============================================================================
+// FILE ACCESS
+// ============================================================================
+
+class SDHistorySource {
+public:
+    virtual ~SDHistorySource() {}
+    virtual bool open(const char* path) = 0;                    // Closes the previous file
+    virtual int32_t read(uint32_t offset, uint8_t* buf, size_t len) = 0;   // < 0 on error
+    virtual uint32_t size() = 0;
+    virtual void close() = 0;
+};
+
+/**
+ * @brief Local date of t as used in log file names ("YYYY-MM-DD")
+ */
+void sdhist_date(uint32_t t, char* buf, size_t len);
+
+// ============================================================================
+// READER
+// ============================================================================
+
+class SDHistoryReader {
+public:
+    /**
+     * @param dir Directory of the daily logs (SD_LOG_DIR)
+     */
+    SDHistoryReader(SDHistorySource* src, const char* dir);
+
+    /**
+     * @brief Start a query
+     * @param fields Bit i selects column i of SD_CSV_HEADER (0 = all); timestamp is always included
+     * @param step_s Keep one reading per step_s seconds (0 or 1 = all)
+     * @return false for an empty or too long range
+     */
+    bool begin(uint32_t from, uint32_t to, uint32_t fields, uint32_t step_s);
+
+    /**
+     * @brief Next piece of CSV output (whole rows split only at the buffer end)
+     * @return Bytes written; 0 when the range is complete or the card failed
+     */
+    size_t read(char* out, size_t max_len);
+
+    uint32_t getRows() const { return _rows; }
+    uint32_t getBlockReads() const { return _reads; }
+    bool hadError() const { return _error; }
+
+    /**
+     * @brief Parse "timestamp,conductivity,..." into a column mask
+     * @return false if a name is not in SD_CSV_HEADER
+     */
+    static bool parseFields(const char* list, uint32_t* fields);
+
+private:
+    typedef enum { FILE_NONE = 0, FILE_CSV, FILE_BIN } file_kind_t;
+
+    SDHistorySource* _src;
+    const char* _dir;
+    uint32_t _from;
+    uint32_t _to;
+    uint32_t _fields;
+    uint32_t _step;
+    uint32_t _next_emit;
+    uint32_t _day;              // Noon of the day being read (local time)
+    char _last_date[12];        // Date of `to`
+    uint8_t _next_kind;         // Next file of the day to try (file_kind_t)
+    uint8_t _open_kind;         // File being read (FILE_NONE = none)
+    bool _done;
+    bool _error;
+    uint32_t _pos;              // Next offset to read
+    uint32_t _size;
+    uint8_t _rec_size;          // .bin record size from its header
+    uint32_t _rows;
+    uint32_t _reads;
+
+    uint8_t _block[SD_HIST_BLOCK];
+    size_t _block_len;
+    size_t _block_pos;
+    char _line[SD_CSV_MAX_LINE];    // CSV row carried across blocks
+    size_t _line_len;
+    char _out[sizeof(SD_CSV_HEADER) + 1];   // Header or row not yet handed out (header is longest)
+    size_t _out_len;
+    size_t _out_pos;
+
+    bool nextRow(sd_log_record_t* rec);
+    bool openNextFile();
+    void closeFile();
+    bool openBin(const char* date);
+    bool openCsv(const char* date);
+    int32_t readAt(uint32_t offset, uint8_t* buf, size_t len);
+    bool csvTimestampAfter(uint32_t offset, uint32_t* ts, uint32_t* line_start);
+    bool fillBlock();
+    void formatRow(const sd_log_record_t* rec);
+    void formatHeader();
+};
+
+#endif // SD_HISTORY_H
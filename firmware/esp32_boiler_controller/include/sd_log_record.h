@@ -0,0 +1,162 @@
+/**
+ * @file sd_log_record.h
+ * @brief Fixed-size binary SD log record, sparse time index and CSV formatting
+ *
+ * Binary log mode (sd_log_format = SD_LOG_FORMAT_BINARY) writes one packed
+ * 44-byte record per reading instead of a ~110-byte CSV line:
+ *
+ *   /logs/YYYY-MM-DD.bin   16-byte file header, then records back to back
+ *   /logs/YYYY-MM-DD.idx   {timestamp, record number} of every
+ *                          SD_BIN_INDEX_INTERVAL-th record
+ *
+ * Each record carries a CRC-16/CCITT over its other bytes, so a torn write
+ * (power loss) costs one record, not the rest of the file: on reopen a
+ * partial record is padded to the record boundary and fails its CRC.
+ * Record n is at SD_BIN_HEADER_SIZE + n * SD_BIN_RECORD_SIZE; a time-range
+ * lookup binary-searches the small index, then scans at most one interval.
+ * Timestamps are assumed non-decreasing within a file (daily file per NTP date).
+ *
+ * Values keep the resolution the CSV prints (0.1 °C, 0.01 gpm, 0.1 mA);
+ * the CSV log is produced from the same record, so a converted binary log is
+ * identical to the CSV the logger would have written. Little-endian, as on
+ * the ESP32 and the host tools.
+ */
+
+#ifndef SD_LOG_RECORD_H
+#define SD_LOG_RECORD_H
+
+#include <Arduino.h>
+#include "sensor_reading.h"
+
+#define SD_CSV_HEADER           "timestamp,conductivity,temperature,wm1_gal,wm2_gal," \
+                                "flow_gpm,blowdown,valve_mA,pump1,pump2,pump3," \
+                                "fw_pump,fw_cycles,fw_ontime_s,alarms," \
+                                "safe_mode,cond_valid,temp_valid," \
+                                "dev_operational,dev_faulted,dev_faulted_mask,meas_age_ms"
+#define SD_CSV_MAX_LINE         192
+#define SD_CSV_FIELDS           22          // Columns of SD_CSV_HEADER
+
+#define SD_BIN_MAGIC            0x474C4243  // "CBLG" little-endian
+#define SD_BIN_VERSION          1
+#define SD_BIN_HEADER_SIZE      16
+#define SD_BIN_RECORD_SIZE      44
+#define SD_BIN_INDEX_INTERVAL   64          // Records per index entry (~11 min at 10 s)
+
+// Record flags
+#define SD_REC_BLOWDOWN         0x01
+#define SD_REC_PUMP1            0x02
+#define SD_REC_PUMP2            0x04
+#define SD_REC_PUMP3            0x08
+#define SD_REC_FW_PUMP          0x10
+#define SD_REC_COND_VALID       0x20
+#define SD_REC_TEMP_VALID       0x40
+
+// ============================================================================
+// ON-CARD STRUCTURES
+// ============================================================================
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;                 // SD_BIN_MAGIC
+    uint8_t version;                // SD_BIN_VERSION (later versions only append to records)
+    uint8_t record_size;            // SD_BIN_RECORD_SIZE; readers step by this
+    uint16_t index_interval;        // SD_BIN_INDEX_INTERVAL when written
+    uint32_t reserved[2];
+} sd_log_file_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp;
+    float conductivity;             // µS/cm
+    uint32_t water_meter1;          // Total gallons
+    uint32_t water_meter2;
+    uint32_t fw_pump_cycle_count;
+    uint32_t fw_pump_on_time_sec;
+    uint32_t measurement_age_ms;
+    int16_t temperature_d;          // 0.1 °C
+    uint16_t flow_cgpm;             // 0.01 gpm
+    int16_t valve_dmA;              // 0.1 mA
+    uint16_t active_alarms;
+    uint16_t devices_faulted_mask;
+    uint8_t flags;                  // SD_REC_*
+    uint8_t safe_mode;
+    uint8_t devices_operational;
+    uint8_t devices_faulted;
+    uint16_t crc;                   // CRC-16/CCITT of the bytes above
+} sd_log_record_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp;             // Of the indexed record
+    uint32_t record;                // Record number in the .bin file
+} sd_log_index_entry_t;
+
+static_assert(sizeof(sd_log_file_header_t) == SD_BIN_HEADER_SIZE, "SD log header size");
+static_assert(sizeof(sd_log_record_t) == SD_BIN_RECORD_SIZE, "SD log record size");
+
+// ============================================================================
+// FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Quantize a reading into a record and set its CRC
+ */
+void sdlog_pack(const sensor_reading_t* reading, sd_log_record_t* rec);
+
+/**
+ * @brief Reading back from a record (values at the record's resolution)
+ */
+void sdlog_unpack(const sd_log_record_t* rec, sensor_reading_t* reading);
+
+/**
+ * @brief Check a record's CRC
+ */
+bool sdlog_record_valid(const sd_log_record_t* rec);
+
+/**
+ * @brief One CSV row (SD_CSV_HEADER columns, no line ending)
+ * @return Characters written (as snprintf)
+ */
+int sdlog_format_csv(const sd_log_record_t* rec, char* buf, size_t len);
+
+/**
+ * @brief Name of column `field` of SD_CSV_HEADER ("" if out of range)
+ */
+const char* sdlog_field_name(uint8_t field);
+
+/**
+ * @brief Column number of a SD_CSV_HEADER name (len characters), -1 if unknown
+ */
+int sdlog_field_index(const char* name, size_t len);
+
+/**
+ * @brief One column of the CSV row, formatted exactly as sdlog_format_csv does
+ * @return Characters written (as snprintf)
+ */
+int sdlog_format_field(const sd_log_record_t* rec, uint8_t field, char* buf, size_t len);
+
+/**
+ * @brief Parse a CSV log row back into a record (CRC set)
+ * @return false for the header or a malformed/truncated row
+ */
+bool sdlog_parse_csv(const char* line, sd_log_record_t* rec);
+
+/**
+ * @brief Fill a file header for a new .bin file
+ */
+void sdlog_init_header(sd_log_file_header_t* hdr);
+
+/**
+ * @brief Check a file header; returns the record size to use (0 = not a log)
+ *
+ * Version SD_BIN_VERSION or later with records of at least SD_BIN_RECORD_SIZE:
+ * step by the returned size and read the first SD_BIN_RECORD_SIZE bytes.
+ */
+uint8_t sdlog_check_header(const sd_log_file_header_t* hdr);
+
+/**
+ * @brief Record number to start scanning from for the first record at or after t
+ *
+ * Binary search of the index for the last entry with timestamp < t; the first
+ * match is at or after the returned record and before the next indexed one.
+ */
+uint32_t sdlog_index_start(const sd_log_index_entry_t* index, size_t count, uint32_t t);
+
+#endif // SD_LOG_RECORD_H
@@ -6,11 +6,20 @@
  * to the ESP32 VSPI bus (shared with MAX31865 PT1000 RTD).
  *
  * Features:
- * - Always-on local CSV logging (audit trail independent of WiFi)
- * - Daily log files: /logs/YYYY-MM-DD.csv
+ * - Always-on local logging (audit trail independent of WiFi)
+ * - Daily log files: /logs/YYYY-MM-DD.csv, or in binary mode fixed-size
+ *   records /logs/YYYY-MM-DD.bin with a sparse time index .idx (sd_log_record.h)
  * - Falls back to sequential filenames when NTP time is unavailable
  * - Event and alarm logging in separate files
  * - SPI bus mutex for safe sharing with MAX31865
+ * - Callers only queue: a dedicated writer task (runWriter) formats into
+ *   double-buffered RAM blocks sized to the FAT cluster (capped at
+ *   SD_BLOCK_MAX) and writes whole, file-aligned blocks, taking the SPI
+ *   mutex once per block instead of once per line. A partial block is
+ *   written once its oldest data has waited SD_HOLD_MS, or on flush().
+ * - Telemetry backlog (spool_record.h): records that could not be sent are
+ *   appended through the same queue to /spool segment files; the writer
+ *   publishes how many are on the card for TelemetrySpool to replay
  *
  * Hardware:
  * - Standard micro-SD card module (SPI interface)
@@ -25,9 +34,11 @@
 #include <SPI.h>
 #include <SD.h>
 #include "config.h"
-
-// Forward declaration
-struct sensor_reading_t;
+#include "sd_log_record.h"
+#include "sd_write_buffer.h"
+#include "sd_history.h"
+#include "spool_record.h"
+#include <atomic>
 
 // ============================================================================
 // SD CARD STATUS
@@ -46,13 +57,44 @@ typedef enum {
 
 #define SD_LOG_DIR              "/logs"
 #define SD_EVENT_DIR            "/events"
+#define SD_SPOOL_DIR            "/spool"
 #define SD_MAX_FILENAME_LEN     32
-#define SD_FLUSH_INTERVAL_MS    30000   // Flush file every 30 seconds
-#define SD_CSV_HEADER           "timestamp,conductivity,temperature,wm1_gal,wm2_gal," \
-                                "flow_gpm,blowdown,valve_mA,pump1,pump2,pump3," \
-                                "fw_pump,fw_cycles,fw_ontime_s,alarms," \
-                                "safe_mode,cond_valid,temp_valid," \
-                                "dev_operational,dev_faulted,dev_faulted_mask,meas_age_ms"
+#define SD_BLOCK_MAX            4096    // Reading log staging block: FAT cluster, capped (x2 in RAM)
+#define SD_EVENT_BLOCK          512     // Event log staging block: one sector (x2 in RAM)
+#define SD_DEFAULT_CLUSTER      4096    // Divides the cluster of any default-formatted FAT32 card
+#define SD_HOLD_MS              120000  // Write a partial block once data has been staged this long
+#define SD_WRITER_WAIT_MS       1000    // Writer wakes at least this often (hold timer)
+// Index entries staged ahead of their records: two blocks of records, plus one
+#define SD_INDEX_PENDING        ((2 * SD_BLOCK_MAX / SD_BIN_RECORD_SIZE) / SD_BIN_INDEX_INTERVAL + 2)
+
+// ============================================================================
+// WRITER STATISTICS
+// ============================================================================
+
+typedef struct {
+    uint32_t messages;              // Taken from the queue
+    uint32_t dropped;               // Queue full (caller did not block)
+    uint32_t queue_high_water;
+    uint32_t blocks;                // Full block writes
+    uint32_t partial_writes;        // Hold-time / flush writes of a partial block
+    uint32_t bytes;
+    uint32_t write_errors;
+    uint32_t cluster_size;          // Detected FAT cluster (bytes)
+    uint32_t block_size;            // Reading log block actually used
+    // SD latency: one write with the SPI mutex held (µs)
+    uint32_t write_us_last;
+    uint32_t write_us_max;
+    uint32_t write_us_avg;          // EWMA 1/8
+    uint32_t writer_wait_us_max;    // Writer waiting for the SPI mutex
+    // MAX31865 contention: measurement task waiting for the SPI mutex (µs)
+    uint32_t sensor_wait_us_last;
+    uint32_t sensor_wait_us_max;
+    uint32_t sensor_waits;
+    uint32_t sensor_waits_blocked;  // Waits over 1 ms (the bus was busy)
+    uint32_t sensor_timeouts;       // Mutex not obtained; reading skipped
+    // Telemetry spool
+    uint32_t spool_segments_dropped;    // Oldest segment deleted at SPOOL_MAX_SEGMENTS
+} sd_writer_stats_t;
 
 // ============================================================================
 // SD LOGGER CLASS
@@ -78,18 +120,25 @@ public:
     bool isAvailable();
 
     /**
-     * @brief Log a sensor reading as CSV row
+     * @brief Queue a sensor reading (CSV row or binary record, see setFormat)
      * @param reading Pointer to sensor reading structure
-     * @return true if written successfully
+     * @return true if queued (written later by the writer task)
      */
     bool logReading(const sensor_reading_t* reading);
 
     /**
-     * @brief Log a system event
-     * @param event_type Event type string (e.g., "FW_PUMP_ON")
-     * @param description Human-readable description
+     * @brief Select the reading log format; a change starts a new file at the next reading
+     * @param format SD_LOG_FORMAT_CSV or SD_LOG_FORMAT_BINARY
+     */
+    void setFormat(uint8_t format);
+    uint8_t getFormat() const { return _format; }
+
+    /**
+     * @brief Queue a system event
+     * @param event_type Event type string (e.g., "FW_PUMP_ON"), up to 31 characters
+     * @param description Human-readable description, up to 96 characters
      * @param value Optional numeric value
-     * @return true if written successfully
+     * @return true if queued
      */
     bool logEvent(const char* event_type, const char* description, int32_t value = 0);
 
@@ -99,20 +148,53 @@ public:
      * @param alarm_name Human-readable alarm name
      * @param active true if alarm became active, false if cleared
      * @param trigger_value Sensor value that triggered the alarm
-     * @return true if written successfully
+     * @return true if queued
      */
     bool logAlarm(uint16_t alarm_code, const char* alarm_name,
                   bool active, float trigger_value);
 
     /**
-     * @brief Flush buffered writes to SD card
+     * @brief Queue a record for the telemetry spool (TelemetrySpool)
+     * @return true if queued
+     */
+    bool logSpool(const spool_record_t* rec);
+
+    /**
+     * @brief Queue deletion of spool segments wholly before `record` (replayed)
+     */
+    void trimSpool(uint32_t record);
+
+    /**
+     * @brief Spool extent on the card: oldest record kept, one past the newest
+     *        written, and records queued or staged but not yet written
+     */
+    uint32_t getSpoolFirst() const { return _spoolFirst.load(); }
+    uint32_t getSpoolHead() const { return _spoolHead.load(); }
+    uint32_t getSpoolInFlight() const { return _spoolQueued.load() - _spoolDone.load(); }
+
+    /**
+     * @brief Ask the writer task to write staged data now, partial blocks included
      */
     void flush();
 
     /**
-     * @brief Call periodically to handle file rotation and flushing
+     * @brief Body of the SD writer task: waits for queued messages (or the
+     *        hold timer), stages them and writes full blocks
+     * @param wait_ms Longest wait for new messages
      */
-    void update();
+    void runWriter(uint32_t wait_ms = SD_WRITER_WAIT_MS);
+
+    /**
+     * @brief Record how long the measurement task waited for the shared SPI bus
+     * @param wait_us Time spent in xSemaphoreTake
+     * @param acquired false when the take timed out
+     */
+    void noteSensorBusWait(uint32_t wait_us, bool acquired);
+
+    /**
+     * @brief Writer, latency and bus contention statistics
+     */
+    sd_writer_stats_t getWriterStats();
 
     /**
      * @brief Get total records written today
@@ -156,6 +238,8 @@ public:
     bool formatCard();
 
 private:
+    friend class SDCardHistorySource;
+
     // Hardware
     uint8_t _csPin;
     SPIClass* _spi;
@@ -163,25 +247,92 @@ private:
 
     // State
     bool _available;
-    bool _headerWritten;
+    uint8_t _format;                    // SD_LOG_FORMAT_* requested
+    uint8_t _fileFormat;                // Format of the open reading log
     sd_card_status_t _card_status;
-    File _dataFile;
     char _currentFilename[SD_MAX_FILENAME_LEN];
+    char _indexFilename[SD_MAX_FILENAME_LEN];   // Binary mode: time index next to the .bin
     char _currentDate[12];              // "YYYY-MM-DD"
+    char _eventFilename[SD_MAX_FILENAME_LEN];
+    char _eventDate[12];
     uint32_t _recordsToday;
-    uint32_t _lastFlushTime;
     uint32_t _bootSequence;             // Fallback sequence number when no NTP
 
+    // Writer task (files and staging are touched only from there)
+    SDWriteQueue _queue;
+    TaskHandle_t _writerTask;
+    volatile bool _flushRequested;
+    volatile bool _dropStaged;          // Card was formatted: staged data has no file
+    File _dataFile;
+    File _indexFile;
+    File _eventFile;
+    SDBlockStager _dataStage;
+    SDBlockStager _eventStage;
+    uint32_t _dataStagedSince;          // millis() of the oldest unwritten data (0 = none)
+    uint32_t _eventStagedSince;
+    uint32_t _dataStagedEnd;            // File offset after the last staged byte
+    uint32_t _dataWritten;              // File offset after the last written byte
+    File _spoolFile;
+    SDBlockStager _spoolStage;
+    uint32_t _spoolStagedSince;
+    uint32_t _spoolSegment;             // Open segment (UINT32_MAX = none)
+    uint32_t _spoolNext;                // Number of the next record staged
+    uint32_t _spoolWritten;             // Bytes of the open segment on the card
+    std::atomic<uint32_t> _spoolFirst;
+    std::atomic<uint32_t> _spoolHead;
+    std::atomic<uint32_t> _spoolQueued; // Producers: records queued
+    std::atomic<uint32_t> _spoolDone;   // Writer: records written or lost
+    struct {
+        sd_log_index_entry_t entry;
+        uint32_t end;                   // Written once the record up to here is on the card
+    } _pendingIndex[SD_INDEX_PENDING];
+    uint8_t _pendingIndexCount;
+    sd_writer_stats_t _stats;
+
     // Internal methods
     bool ensureDailyFile();
+    bool ensureEventFile();
     bool ensureDirectory(const char* dir);
     void getDateString(char* buf, size_t len);
     bool takeSPI(uint32_t timeout_ms = 1000);
     void giveSPI();
-    bool writeCSVRow(const char* line);
-    bool writeEventLine(const char* filename, const char* line);
+    bool openBinaryFile();
+    void closeFiles();
+    uint32_t detectClusterSize();
+    bool queue(uint8_t kind, const void* payload, size_t len);
+    void stageReading(const sd_log_record_t* rec);
+    void stageEvent(const char* line, size_t len);
+    void stageSpool(const spool_record_t* rec);
+    bool openSpoolSegment(uint32_t segment);
+    void removeSpoolSegments(uint32_t before_segment);
+    void scanSpool();
+    void stage(SDBlockStager& st, File& f, uint32_t& since, const uint8_t* data, size_t len);
+    void writeStaged(SDBlockStager& st, File& f, uint32_t& since, bool tail);
+    void writePendingIndex();
 };
 
 extern SDLogger sdLogger;
 
+// ============================================================================
+// HISTORY READS
+// ============================================================================
+
+/**
+ * @brief SDHistorySource on the card: every open, read and close takes the
+ *        SPI mutex for just that call, so the writer task and the MAX31865
+ *        interleave with a long history download
+ */
+class SDCardHistorySource : public SDHistorySource {
+public:
+    ~SDCardHistorySource() override { close(); }
+    bool open(const char* path) override;
+    int32_t read(uint32_t offset, uint8_t* buf, size_t len) override;
+    uint32_t size() override { return _size; }
+    void close() override;
+
+private:
+    File _file;
+    uint32_t _size = 0;
+};
+
 #endif // SD_LOGGER_H
@@ -0,0 +1,131 @@
+/**
+ * @file sd_write_buffer.h
+ * @brief Lock-free message queue and double-buffered block staging for the SD writer task
+ *
+ * SDWriteQueue: bounded multi-producer queue of log messages (packed readings,
+ * event lines). Producers in any task claim a slot with one compare-and-swap
+ * and publish it with a per-slot sequence number; no mutex, no blocking, and
+ * a full queue drops the message (counted) instead of stalling the caller.
+ * The SD writer task is the only consumer.
+ *
+ * SDBlockStager: two RAM buffers of one block each. Bytes are appended to the
+ * active buffer; when it is full it is handed over for writing and appending
+ * continues in the other one. The first block after reset() is shortened so
+ * it ends on a block boundary of the file, so every full block lands
+ * block-aligned in the file (and, with block = FAT cluster or a divisor of
+ * it, in one cluster).
+ */
+
+#ifndef SD_WRITE_BUFFER_H
+#define SD_WRITE_BUFFER_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#define SD_QUEUE_SLOTS          16          // Power of two
+#define SD_MSG_PAYLOAD          160         // Packed record or one event line
+
+typedef enum {
+    SD_MSG_READING = 0,                     // payload = sd_log_record_t
+    SD_MSG_EVENT,                           // payload = event CSV line (no line ending)
+    SD_MSG_SPOOL,                           // payload = spool_record_t (telemetry backlog)
+    SD_MSG_SPOOL_TRIM                       // payload = uint32_t record: delete segments before it
+} sd_msg_kind_t;
+
+typedef struct {
+    uint8_t kind;                           // sd_msg_kind_t
+    uint8_t len;
+    uint8_t payload[SD_MSG_PAYLOAD];
+} sd_msg_t;
+
+// ============================================================================
+// LOCK-FREE MESSAGE QUEUE
+// ============================================================================
+
+class SDWriteQueue {
+public:
+    SDWriteQueue();
+
+    /**
+     * @brief Queue a message (any task, never blocks)
+     * @return false when the queue is full (message dropped)
+     */
+    bool push(uint8_t kind, const void* payload, size_t len);
+
+    /**
+     * @brief Take the oldest message (single consumer only)
+     * @return false when empty
+     */
+    bool pop(sd_msg_t* out);
+
+    uint32_t getDropped() const { return _dropped.load(std::memory_order_relaxed); }
+    uint32_t getHighWater() const { return _high_water.load(std::memory_order_relaxed); }
+
+private:
+    typedef struct {
+        std::atomic<uint32_t> seq;          // == pos: free for producer pos; == pos+1: holds message pos
+        sd_msg_t msg;
+    } cell_t;
+
+    cell_t _cells[SD_QUEUE_SLOTS];
+    std::atomic<uint32_t> _enqueue;
+    std::atomic<uint32_t> _dequeue;         // Written by the consumer only
+    std::atomic<uint32_t> _dropped;
+    std::atomic<uint32_t> _high_water;
+};
+
+// ============================================================================
+// DOUBLE-BUFFERED BLOCK STAGING
+// ============================================================================
+
+class SDBlockStager {
+public:
+    SDBlockStager();
+
+    /**
+     * @brief Attach the two buffers (each block_size bytes)
+     */
+    void begin(uint8_t* buf0, uint8_t* buf1, size_t block_size);
+
+    /**
+     * @brief Drop staged data and align the first block to the end of a file of this size
+     */
+    void reset(uint32_t file_size);
+
+    /**
+     * @brief Stage bytes
+     * @return Bytes accepted; short when both buffers are full (write one, then retry)
+     */
+    size_t append(const uint8_t* data, size_t len);
+
+    /**
+     * @brief Oldest region to write: a full block, or with tail=true also the
+     *        unwritten part of the active (partial) buffer
+     * @return false when there is nothing to write
+     */
+    bool peek(const uint8_t** data, size_t* len, bool tail) const;
+
+    /**
+     * @brief Mark the region returned by peek() as written
+     * @return true when it completed a block (false: partial tail)
+     */
+    bool consume(size_t len);
+
+    bool hasFullBlock() const { return _full[0] || _full[1]; }
+    size_t getStaged() const;               // Bytes not yet written
+    size_t getBlockSize() const { return _block; }
+
+private:
+    uint8_t* _buf[2];
+    size_t _block;
+    size_t _cap[2];                         // Block size, or less for the first (alignment) block
+    size_t _fill[2];
+    size_t _done[2];                        // Bytes of this buffer already written (partial flush)
+    bool _full[2];
+    uint8_t _active;
+
+    int8_t oldest(bool tail) const;
+    void release(uint8_t b);
+};
+
+#endif // SD_WRITE_BUFFER_H
@@ -0,0 +1,45 @@
+/**
+ * @file sensor_reading.h
+ * @brief One logged sample of the controller state
+ *
+ * Shared by the HTTP/MQTT uploaders and the SD logger; kept free of network
+ * headers so the SD record format and its host tools can use it.
+ */
+
+#ifndef SENSOR_READING_H
+#define SENSOR_READING_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// SENSOR READING STRUCTURE
+// ============================================================================
+
+typedef struct {
+    uint32_t timestamp;             // Unix timestamp
+    float conductivity;             // uS/cm
+    float temperature;              // Celsius
+    uint32_t water_meter1;          // Total gallons
+    uint32_t water_meter2;          // Total gallons
+    float flow_rate;                // GPM
+    bool blowdown_active;
+    float valve_position_mA;        // 4-20mA feedback (4=closed, 20=open)
+    bool pump1_active;
+    bool pump2_active;
+    bool pump3_active;
+    bool feedwater_pump_on;
+    uint32_t fw_pump_cycle_count;       // Cumulative feedwater pump cycles
+    uint32_t fw_pump_on_time_sec;       // Cumulative feedwater pump on-time (sec)
+    uint16_t active_alarms;
+
+    // Health & diagnostics (added for DeviceManager/SensorHealth integration)
+    uint8_t safe_mode;              // 0=NONE, 1=SENSOR_FAIL, 2=STALE_DATA, etc.
+    bool cond_sensor_valid;         // Conductivity reading is trustworthy
+    bool temp_sensor_valid;         // Temperature reading is trustworthy
+    uint8_t devices_operational;    // Count of operational devices
+    uint8_t devices_faulted;        // Count of faulted devices
+    uint16_t devices_faulted_mask;  // Bitmask of faulted device IDs
+    uint32_t measurement_age_ms;    // Age of last measurement cycle (ms)
+} sensor_reading_t;
+
+#endif // SENSOR_READING_H
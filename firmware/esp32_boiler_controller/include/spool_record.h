@@ -0,0 +1,144 @@
+/**
+ * @file spool_record.h
+ * @brief Outbound telemetry spool on the SD card: record format and reader
+ *
+ * Telemetry that could not be sent (no WiFi, MQTT down, server error) is
+ * appended to a durable queue on the card and replayed after reconnect:
+ *
+ *   /spool/NNNNNNNN.q   segment files of SPOOL_SEGMENT_RECORDS fixed-size
+ *                       128-byte records (four per sector)
+ *
+ * Records are numbered from the first ever spooled; record n is in segment
+ * n / SPOOL_SEGMENT_RECORDS at offset (n % SPOOL_SEGMENT_RECORDS) * 128, so
+ * a read cursor is one number (kept in NVS by TelemetrySpool). A record
+ * carries a CRC-16/CCITT; torn or damaged records are skipped on replay.
+ * Readings reuse the SD log record (sd_log_record.h), so a replayed reading
+ * has the resolution of the SD log.
+ *
+ * A record spooled by MQTT carries the {boot_id, sequence} it was given when
+ * spooled, so a replay sent again after a reset is a copy the backend drops.
+ * Records spooled by the HTTP path have boot_id 0 and are numbered on replay.
+ */
+
+#ifndef SPOOL_RECORD_H
+#define SPOOL_RECORD_H
+
+#include <Arduino.h>
+#include "sd_log_record.h"
+#include "sd_history.h"             // SDHistorySource
+
+#define SPOOL_RECORD_SIZE       128
+#define SPOOL_SEGMENT_RECORDS   8192        // 1 MB per segment file (~1 day at 10 s)
+#define SPOOL_MAX_SEGMENTS      64          // Oldest segment dropped beyond this (64 MB)
+#define SPOOL_BLOCK_RECORDS     4           // Records per card read (one sector)
+
+typedef enum {
+    SPOOL_READING = 1,
+    SPOOL_EVENT,
+    SPOOL_ALARM
+} spool_kind_t;
+
+// ============================================================================
+// ON-CARD RECORD
+// ============================================================================
+
+typedef struct __attribute__((packed)) {
+    uint8_t kind;                   // spool_kind_t
+    uint8_t reserved;
+    uint16_t crc;                   // CRC-16/CCITT of the record (this field zero)
+    uint32_t timestamp;
+    union {
+        sd_log_record_t reading;
+        struct __attribute__((packed)) {
+            int32_t value;
+            char type[32];
+            char description[76];
+        } event;
+        struct __attribute__((packed)) {
+            uint16_t code;
+            uint8_t active;
+            uint8_t reserved;
+            float trigger_value;
+            char name[32];
+        } alarm;
+        uint8_t raw[112];
+    };
+    uint32_t boot_id;               // MQTT numbering (spool_stamp); 0 = none
+    uint32_t sequence;
+} spool_record_t;
+
+static_assert(sizeof(spool_record_t) == SPOOL_RECORD_SIZE, "Spool record size");
+
+// ============================================================================
+// FUNCTIONS
+// ============================================================================
+
+void spool_pack_reading(const sensor_reading_t* reading, spool_record_t* rec);
+void spool_pack_event(uint32_t timestamp, const char* event_type, const char* description,
+                      int32_t value, spool_record_t* rec);
+void spool_pack_alarm(uint32_t timestamp, uint16_t alarm_code, const char* alarm_name,
+                      bool active, float trigger_value, spool_record_t* rec);
+
+/**
+ * @brief Give a packed record its MQTT {boot_id, sequence} (reseals it)
+ */
+void spool_stamp(spool_record_t* rec, uint32_t boot_id, uint32_t sequence);
+
+/**
+ * @brief Check kind and CRC
+ */
+bool spool_record_valid(const spool_record_t* rec);
+
+/**
+ * @brief Path of segment `segment` ("/spool/00000012.q")
+ */
+void spool_segment_path(const char* dir, uint32_t segment, char* buf, size_t len);
+
+// ============================================================================
+// READER
+// ============================================================================
+
+/**
+ * @brief Reads the spool in record order for replay
+ *
+ * peek() returns the record at the cursor without consuming it; advance()
+ * consumes it once it has been sent. Records before `first` (dropped for
+ * space), invalid records and segments missing from the card are skipped and
+ * counted. The segment is re-opened when a read comes up short, since the
+ * writer task keeps appending to it.
+ */
+class SpoolReader {
+public:
+    SpoolReader(SDHistorySource* src, const char* dir);
+
+    void seek(uint32_t record);
+    uint32_t tell() const { return _cursor; }
+
+    /**
+     * @param first Oldest record still on the card
+     * @param head  Records on the card (one past the newest)
+     * @return false when the cursor reached head or the card could not be read
+     */
+    bool peek(uint32_t first, uint32_t head, spool_record_t* rec);
+    void advance();
+    void close();
+
+    uint32_t getSkipped() const { return _skipped; }
+    uint32_t getBlockReads() const { return _reads; }
+
+private:
+    SDHistorySource* _src;
+    const char* _dir;
+    uint32_t _cursor;
+    uint32_t _openSegment;          // UINT32_MAX = none
+    bool _fresh;                    // Opened since the last short read
+    spool_record_t _block[SPOOL_BLOCK_RECORDS];
+    uint32_t _blockFirst;           // Record number of _block[0]
+    uint32_t _blockCount;
+    uint32_t _skipped;
+    uint32_t _reads;
+
+    void skipTo(uint32_t record);
+};
+
+#endif // SPOOL_RECORD_H
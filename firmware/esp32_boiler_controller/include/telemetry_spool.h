@@ -0,0 +1,123 @@
+/**
+ * @file telemetry_spool.h
+ * @brief Store-and-forward telemetry backlog on the SD card
+ *
+ * Readings, events and alarms that cannot be sent (WiFi or MQTT down, HTTP
+ * error) are appended to the SD spool (spool_record.h) instead of being
+ * dropped; while a backlog exists new telemetry is appended behind it, so the
+ * server receives everything in order. drain() replays the backlog through
+ * the sink (MQTT or HTTP, chosen in main) at a bounded rate: up to
+ * SPOOL_DRAIN_BATCH records per sink call (HTTP sends them as one batch), at
+ * most SPOOL_DRAIN_MAX_RECORDS and SPOOL_DRAIN_BUDGET_MS of sending per
+ * drain(), so a reconnect after a long outage does not monopolise the
+ * network task.
+ *
+ * The sink takes records and confirms them with confirm() once they are
+ * delivered: HTTP when the server replies, MQTT when the ack echo comes back
+ * (mqtt_out_queue.h). Only the confirmed cursor counts: it is kept in NVS
+ * every SPOOL_CURSOR_SAVE_RECORDS records and when the backlog empties, and a
+ * reset replays from the last saved one. MQTT records keep the {boot_id,
+ * sequence} they were spooled with (spool_stamp), so what is sent twice is
+ * dropped by the backend. Replayed segments are deleted by the SD writer
+ * task. Without a card the spool is unavailable and callers keep their old
+ * behaviour.
+ */
+
+#ifndef TELEMETRY_SPOOL_H
+#define TELEMETRY_SPOOL_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+#include "sd_logger.h"
+
+#define SPOOL_DRAIN_BATCH           16      // Records per sink call
+#define SPOOL_DRAIN_MAX_RECORDS     64      // Per drain() call (network task: 1 Hz)
+#define SPOOL_DRAIN_BUDGET_MS       250     // Sending time per drain() call
+#define SPOOL_RETRY_MS              5000    // Pause after the sink refused a record
+#define SPOOL_CURSOR_SAVE_RECORDS   256     // NVS write interval (records replayed)
+
+typedef struct {
+    uint32_t appended;
+    uint32_t append_failures;       // SD queue full or no card
+    uint32_t replayed;
+    uint32_t skipped;               // Damaged records, segments dropped or lost
+    uint32_t sink_failures;
+    uint32_t backlog;               // Records on the card not yet replayed
+} spool_stats_t;
+
+// ============================================================================
+// TELEMETRY SPOOL CLASS
+// ============================================================================
+
+class TelemetrySpool {
+public:
+    // Send spooled records in order; returns how many were taken from the
+    // start (the rest are retried later). next[i] is the cursor past recs[i],
+    // for confirm() once that record is delivered
+    typedef uint32_t (*SinkFn)(const spool_record_t* recs, const uint32_t* next, uint32_t count);
+
+    TelemetrySpool();
+
+    /**
+     * @brief Load the cursor from NVS (after sdLogger.begin)
+     * @return false without an SD card
+     */
+    bool begin(SinkFn sink);
+
+    bool isAvailable() const { return _ready; }
+
+    /**
+     * @brief Records not yet replayed, on the card or on their way to it
+     */
+    bool hasBacklog() const;
+
+    // boot_id / sequence: MQTT numbering (0 = none, HTTP)
+    bool appendReading(const sensor_reading_t* reading, uint32_t boot_id = 0, uint32_t sequence = 0);
+    bool appendEvent(uint32_t timestamp, const char* event_type, const char* description, int32_t value,
+                     uint32_t boot_id = 0, uint32_t sequence = 0);
+    bool appendAlarm(uint32_t timestamp, uint16_t alarm_code, const char* alarm_name,
+                     bool active, float trigger_value, uint32_t boot_id = 0, uint32_t sequence = 0);
+
+    /**
+     * @brief Replay part of the backlog (network task)
+     * @param online The sink's link is up (MQTT connected / WiFi for HTTP)
+     * @param room Records the sink can take now (MQTT: free queue slots)
+     * @return Records taken by the sink
+     */
+    uint32_t drain(bool online, uint32_t room = SPOOL_DRAIN_MAX_RECORDS);
+
+    /**
+     * @brief Records before `next` (a SinkFn next[] value) were delivered (network task)
+     */
+    void confirm(uint32_t next);
+
+    spool_stats_t getStats() const;
+
+private:
+    SDCardHistorySource _src;
+    SpoolReader _reader;
+    SinkFn _sink;
+    bool _ready;
+    std::atomic<uint32_t> _cursor;  // First record not confirmed (read by producers)
+    uint32_t _taken;                // Cursor past the last record the sink took
+    uint32_t _savedCursor;
+    uint32_t _trimmedSegment;
+    uint32_t _retryAt;
+    uint32_t _lastFlush;
+    spool_stats_t _stats;           // Network task counters (drain)
+    std::atomic<uint32_t> _appended;        // Producers (any task)
+    std::atomic<uint32_t> _append_failures;
+    spool_record_t _batch[SPOOL_DRAIN_BATCH];
+
+    bool append(spool_record_t* rec, uint32_t boot_id, uint32_t sequence);
+    void saveCursor();
+};
+
+// ============================================================================
+// GLOBAL INSTANCE
+// ============================================================================
+
+extern TelemetrySpool telemetrySpool;
+
+#endif // TELEMETRY_SPOOL_H
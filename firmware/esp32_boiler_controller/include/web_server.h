@@ -4,6 +4,9 @@
  *
  * Provides:
  * - REST: /api/state, /api/health, /api/command/{name}, /api/config, plus legacy routes
+ * - /api/fuzzy/rules: download/upload/reset the binary fuzzy rule base (hot swap, no reboot)
+ * - /api/fuzzy/trace: recent traced fuzzy evaluations as JSON, trace sampling control
+ * - /api/fuzzy/sweep: fuzzy outputs over a 1-D/2-D grid around the setpoints (rule gap check)
  * - WebSocket /ws for live updates (no polling)
  * - Mobile-friendly web UI for manual tests, status, fuzzy logic
  */
@@ -31,6 +34,14 @@
 #define WEB_API_PREFIX          "/api"
 #define WEB_MAX_JSON_SIZE       2048
 #define WEB_WS_PATH             "/ws"
+#define WEB_TRACE_DEFAULT_LIMIT 64          // Records per GET /api/fuzzy/trace (~200 bytes JSON each)
+#define WEB_TRACE_MAX_LIMIT     256
+#define WEB_SWEEP_DEFAULT_POINTS 21         // Grid points per axis for GET /api/fuzzy/sweep
+#define WEB_SWEEP_MAX_POINTS    41          // 41 x 41 = 1681 points (~60 KB JSON, streamed a row at a time)
+#define WEB_TREND_DEFAULT_POINTS 240        // Points per GET /api/trend (~40 bytes JSON each)
+#define WEB_TREND_MAX_POINTS    720
+#define WEB_HISTORY_DEFAULT_SPAN 86400      // GET /api/history without from: last day
+#define WEB_CHUNK_TEXT_SIZE     1600        // Largest JSON piece of a chunked response (a 41-point sweep row)
 
 // Command handler: return true if command accepted (202), false to reject (400).
 // request_id is provided so the handler can queue the command and later broadcast result via broadcastCommandResult(request_id, "completed"|"failed", message).
@@ -100,6 +111,11 @@ private:
     void (*_test_input_callback)(fuzzy_input_t, float, bool);
     WebServerCommandHandlerFn _command_handler;
 
+    // Binary rule base upload (body arrives in chunks before the request handler runs)
+    uint8_t _rb_upload[FUZZY_RB_MAX_SIZE];
+    size_t _rb_upload_len;
+    bool _rb_upload_overflow;
+
     void setupRoutes();
     void onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
 
@@ -119,6 +135,16 @@ private:
     void handleClearTests(AsyncWebServerRequest* request);
     void handlePostCommand(AsyncWebServerRequest* request);
     void handlePostConfig(AsyncWebServerRequest* request);
+    void handleGetFuzzyRules(AsyncWebServerRequest* request);
+    void handleFuzzyRulesBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+    void handlePostFuzzyRules(AsyncWebServerRequest* request);
+    void handleDeleteFuzzyRules(AsyncWebServerRequest* request);
+    void handleGetFuzzyTrace(AsyncWebServerRequest* request);
+    void handlePostFuzzyTrace(AsyncWebServerRequest* request);
+    void handleGetFuzzySweep(AsyncWebServerRequest* request);
+    void handleGetPlant(AsyncWebServerRequest* request);
+    void handleGetTrend(AsyncWebServerRequest* request);
+    void handleGetHistory(AsyncWebServerRequest* request);
     void handleNotFound(AsyncWebServerRequest* request);
 
     String generateIndexHTML();
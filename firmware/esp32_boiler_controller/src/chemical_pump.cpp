@@ -7,6 +7,7 @@
 
 #include "chemical_pump.h"
 #include "pin_definitions.h"
+#include "mpc_dosing.h"
 
 // Global pump manager instance
 PumpManager pumpManager;
@@ -29,6 +30,8 @@ ChemicalPump::ChemicalPump(pump_id_t id, uint8_t step_pin, uint8_t dir_pin, uint
     , _mode_b_accumulated_blowdown(0)
     , _mode_a_was_blowing(false)
     , _mode_c_cycle_start(0)
+    , _mode_m_pending_ml(0)
+    , _mode_m_last_ms(0)
 {
     // Set pump name based on ID
     switch (_id) {
@@ -176,6 +179,7 @@ void ChemicalPump::setEnabled(bool enable) {
     if (!enable && _status.running) {
         stop();
     }
+    if (!enable) resetModeM();
 }
 
 void ChemicalPump::setHOA(hoa_mode_t mode) {
@@ -183,6 +187,7 @@ void ChemicalPump::setHOA(hoa_mode_t mode) {
     if (_config) {
         _config->hoa_mode = mode;
     }
+    if (mode != HOA_AUTO) resetModeM();
 }
 
 hoa_mode_t ChemicalPump::getHOA() {
@@ -191,9 +196,10 @@ hoa_mode_t ChemicalPump::getHOA() {
 
 void ChemicalPump::processFeedMode(bool blowdown_active, uint32_t blowdown_time_ms,
                                    uint32_t water_contacts, float water_volume,
-                                   float fuzzy_rate) {
+                                   float fuzzy_rate, float mpc_rate) {
     if (!_status.enabled || !_config) return;
     if (_status.hoa_mode != HOA_AUTO) return;
+    if (_config->feed_mode != FEED_MODE_M_MPC) resetModeM();
 
     switch (_config->feed_mode) {
         case FEED_MODE_A_BLOWDOWN_FEED:
@@ -214,6 +220,9 @@ void ChemicalPump::processFeedMode(bool blowdown_active, uint32_t blowdown_time_
         case FEED_MODE_F_FUZZY:
             processModeF(water_volume, fuzzy_rate);
             break;
+        case FEED_MODE_M_MPC:
+            processModeM(mpc_rate);
+            break;
         case FEED_MODE_DISABLED:
         default:
             break;
@@ -500,6 +509,40 @@ void ChemicalPump::processModeF(float water_volume, float fuzzy_rate) {
     }
 }
 
+void ChemicalPump::processModeM(float rate_ml_min) {
+    // Mode M: model predictive dosing at the rate planned by MpcDosing (ml/min,
+    // constant over one MPC step). Volume accrues every cycle and is dispensed in
+    // MPC_MIN_DOSE_ML lots so the stepper is not restarted each 100 ms.
+
+    uint32_t now = millis();
+    uint32_t dt_ms = now - _mode_m_last_ms;
+    bool continuous = (_mode_m_last_ms != 0) && dt_ms <= 1000;  // Not after a gap (HOA, disable)
+    _mode_m_last_ms = now;
+
+    // Volume accrued before a gap or a zero-rate plan belongs to a plan no longer running
+    if (!continuous || rate_ml_min <= 0) {
+        _mode_m_pending_ml = 0;
+        return;
+    }
+
+    _mode_m_pending_ml += rate_ml_min * dt_ms / 60000.0f;
+    if (_mode_m_pending_ml < MPC_MIN_DOSE_ML || _status.running) {
+        return;
+    }
+
+    float ml_to_dose = _mode_m_pending_ml;
+    _mode_m_pending_ml = 0;
+    start(0, ml_to_dose);
+    Serial.printf("Pump %s: Mode M dosing %.2f ml (planned %.2f ml/min)\n",
+                  _name, ml_to_dose, rate_ml_min);
+}
+
+void ChemicalPump::resetModeM() {
+    // Left Mode M: the next processModeM() starts a fresh accrual
+    _mode_m_pending_ml = 0;
+    _mode_m_last_ms = 0;
+}
+
 void ChemicalPump::checkTimeout() {
     if (!_config || !_status.running) return;
 
@@ -578,13 +621,15 @@ void PumpManager::update() {
 
 void PumpManager::processFeedModes(bool blowdown_active, uint32_t blowdown_time_ms,
                                    uint32_t water_contacts, float water_volume,
-                                   float fuzzy_rates[PUMP_COUNT]) {
+                                   float fuzzy_rates[PUMP_COUNT],
+                                   float mpc_rates[PUMP_COUNT]) {
     if (_emergency_stop) return;
 
     for (int i = 0; i < PUMP_COUNT; i++) {
         float rate = (fuzzy_rates != nullptr) ? fuzzy_rates[i] : 0.0f;
+        float mpc_rate = (mpc_rates != nullptr) ? mpc_rates[i] : 0.0f;
         _pumps[i]->processFeedMode(blowdown_active, blowdown_time_ms,
-                                   water_contacts, water_volume, rate);
+                                   water_contacts, water_volume, rate, mpc_rate);
     }
 }
 
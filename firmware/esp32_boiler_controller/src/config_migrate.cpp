@@ -0,0 +1,28 @@
+/**
+ * @file config_migrate.cpp
+ * @brief Migration of older stored configurations (see config_migrate.h)
+ */
+
+#include "config_migrate.h"
+#include <stddef.h>
+
+void config_apply_mqtt_defaults(system_config_t* cfg) {
+    memset(cfg->mqtt_host, 0, sizeof(cfg->mqtt_host));
+    cfg->mqtt_port = MQTT_PORT_DEFAULT;
+    memset(cfg->mqtt_user, 0, sizeof(cfg->mqtt_user));
+    memset(cfg->mqtt_pass, 0, sizeof(cfg->mqtt_pass));
+    cfg->use_mqtt_telemetry = false;
+}
+
+bool config_migrate(system_config_t* cfg, size_t stored_size) {
+    if (stored_size >= sizeof(system_config_t)) return false;
+    memset((uint8_t*)cfg + stored_size, 0, sizeof(system_config_t) - stored_size);
+    cfg->version = CONFIG_VERSION;
+
+    // Only a blob that ends before the MQTT block lacks it; later appends keep it
+    if (stored_size <= offsetof(system_config_t, mqtt_host)) {
+        config_apply_mqtt_defaults(cfg);
+        return true;
+    }
+    return false;
+}
@@ -1,23 +1,24 @@
 /**
  * @file coprocessor_link.cpp
- * @brief Main ESP32 RS-485 link to panel coprocessor
+ * @brief Main ESP32 RS-485 link to panel coprocessors (bus master, polled multi-drop)
  */
 
 #include "coprocessor_link.h"
 #include <string.h>
+#include <sys/time.h>
 
 CoprocessorLink::CoprocessorLink(HardwareSerial& serial, int8_t de_re_pin)
     : _serial(serial),
       _de_re_pin(de_re_pin),
       _baud(CP_LINK_BAUD_DEFAULT),
-      _comms_lost(true),
-      _comms_lost_since_ms(0),
+      _node_count(0),
+      _rr_index(0),
       _cmd_sequence(0),
       _last_cmd_result(CP_CMD_RESULT_NONE),
       _last_nak_result(0),
+      _last_time_sync_ms(0),
       _rx_len(0),
       _mutex(NULL) {
-    memset(&_telemetry, 0, sizeof(_telemetry));
     memset(&_telemetry_copy, 0, sizeof(_telemetry_copy));
 }
 
@@ -27,56 +28,114 @@ bool CoprocessorLink::begin(uint32_t baud) {
         _mutex = xSemaphoreCreateMutex();
         if (_mutex == NULL) return false;
     }
+    if (_node_count == 0) addNode(CP_ADDR_DEFAULT);
     if (_de_re_pin >= 0) {
         pinMode((pin_size_t)_de_re_pin, OUTPUT);
         digitalWrite((pin_size_t)_de_re_pin, LOW);
     }
     _serial.begin(baud);
     _rx_len = 0;
-    _comms_lost = true;
-    _comms_lost_since_ms = 0;
-    _telemetry.valid = false;
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < _node_count; i++) {
+        _nodes[i].comms_lost = true;
+        _nodes[i].comms_lost_since_ms = 0;
+        _nodes[i].telemetry.valid = false;
+        _nodes[i].next_due_ms = now;
+    }
     return true;
 }
 
+// ============================================================================
+// NODE TABLE
+// ============================================================================
+
+bool CoprocessorLink::addNode(uint8_t addr, uint16_t poll_interval_ms, uint8_t priority) {
+    if (addr < CP_ADDR_MIN || addr > CP_ADDR_MAX) return false;
+    if (poll_interval_ms == 0) poll_interval_ms = CP_LINK_POLL_INTERVAL_MS;
+    bool locked = (_mutex != NULL && xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) == pdTRUE);
+    if (_mutex != NULL && !locked) return false;
+
+    bool ok = false;
+    if (_node_count < CP_LINK_MAX_NODES && _findNode(addr) < 0) {
+        node_t& n = _nodes[_node_count];
+        n.addr = addr;
+        n.priority = priority;
+        n.poll_interval_ms = poll_interval_ms;
+        n.next_due_ms = millis();
+        memset(&n.telemetry, 0, sizeof(n.telemetry));
+        n.telemetry.addr = addr;
+        n.clock.reset();
+        n.comms_lost = true;
+        n.comms_lost_since_ms = 0;
+        n.polls_sent = 0;
+        n.polls_missed = 0;
+        n.last_period_ms = 0;
+        _node_count++;
+        ok = true;
+    }
+    if (locked) xSemaphoreGive(_mutex);
+    return ok;
+}
+
+bool CoprocessorLink::setNodeSchedule(uint8_t addr, uint16_t poll_interval_ms, uint8_t priority) {
+    if (_mutex == NULL) return false;
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return false;
+    int idx = _findNode(addr);
+    if (idx >= 0) {
+        _nodes[idx].poll_interval_ms = poll_interval_ms ? poll_interval_ms : CP_LINK_POLL_INTERVAL_MS;
+        _nodes[idx].priority = priority;
+    }
+    xSemaphoreGive(_mutex);
+    return idx >= 0;
+}
+
+uint8_t CoprocessorLink::getNodeCount() const {
+    return _node_count;
+}
+
+int CoprocessorLink::_findNode(uint8_t addr) const {
+    for (uint8_t i = 0; i < _node_count; i++) {
+        if (_nodes[i].addr == addr) return i;
+    }
+    return -1;
+}
+
+// ============================================================================
+// FRAMING
+// ============================================================================
+
 void CoprocessorLink::_setDeRe(bool drive) {
     if (_de_re_pin >= 0) {
         digitalWrite((pin_size_t)_de_re_pin, drive ? HIGH : LOW);
     }
 }
 
-void CoprocessorLink::_sendFrame(uint8_t type, const uint8_t* payload, uint8_t plen) {
-    if (plen > CP_MAX_PAYLOAD) return;
+void CoprocessorLink::_sendFrame(uint8_t addr, uint8_t type, const uint8_t* payload, uint8_t plen) {
     uint8_t frame[CP_MAX_FRAME];
-    frame[0] = CP_SYNC_0;
-    frame[1] = CP_SYNC_1;
-    frame[2] = type;
-    frame[3] = plen;
-    if (plen && payload) memcpy(frame + CP_HEADER_SIZE, payload, plen);
-    uint16_t crc = cp_crc16(frame, CP_HEADER_SIZE + plen);
-    frame[CP_HEADER_SIZE + plen]     = (uint8_t)(crc & 0xFF);
-    frame[CP_HEADER_SIZE + plen + 1] = (uint8_t)(crc >> 8);
+    size_t flen = cp_frame_build(frame, addr, type, payload, plen);
+    if (flen == 0) return;
 
     _setDeRe(true);
     delay(1);
-    _serial.write(frame, CP_HEADER_SIZE + plen + CP_CRC_SIZE);
+    _serial.write(frame, flen);
     _serial.flush();
     delay(CP_LINK_TURNAROUND_MS);
     _setDeRe(false);
 }
 
-cp_cmd_result_t CoprocessorLink::_sendCommandAndWaitAck(uint8_t type, const uint8_t* payload, uint8_t plen) {
+cp_cmd_result_t CoprocessorLink::_sendCommandAndWaitAck(uint8_t addr, uint8_t type, const uint8_t* payload, uint8_t plen) {
     _last_cmd_result = CP_CMD_RESULT_NONE;
     _last_nak_result = 0;
-    if (_comms_lost) return CP_CMD_RESULT_LINK_DOWN;
+    int idx = _findNode(addr);
+    if (idx < 0 || _nodes[idx].comms_lost) return CP_CMD_RESULT_LINK_DOWN;
 
     uint16_t seq = (plen >= 2) ? (uint16_t)payload[0] | ((uint16_t)payload[1] << 8) : 0;
 
     for (int retry = 0; retry < CP_LINK_CMD_RETRIES; retry++) {
-        _sendFrame(type, payload, plen);
+        _sendFrame(addr, type, payload, plen);
         uint8_t rx[CP_MAX_FRAME];
         size_t rx_len = 0;
-        if (_readFrame(rx, &rx_len, CP_LINK_CMD_REPLY_TIMEOUT_MS)) {
+        if (_readFrame(rx, &rx_len, CP_LINK_CMD_REPLY_TIMEOUT_MS) && cp_frame_addr(rx) == addr) {
             uint8_t rtype = cp_frame_type(rx);
             if (rtype == CP_TYPE_ACK) {
                 cp_ack_nak_payload_t* a = (cp_ack_nak_payload_t*)cp_frame_payload(rx);
@@ -109,7 +168,7 @@ bool CoprocessorLink::_readFrame(uint8_t* out_frame, size_t* out_len, uint32_t t
             if (_rx_len == 1 && b != CP_SYNC_1) { _rx_len = 0; continue; }
             _rx_buf[_rx_len++] = b;
             if (_rx_len >= CP_HEADER_SIZE) {
-                uint8_t plen = _rx_buf[3];
+                uint8_t plen = _rx_buf[CP_HDR_LEN];
                 if (plen > CP_MAX_PAYLOAD) { _rx_len = 0; continue; }
                 size_t need = CP_HEADER_SIZE + plen + CP_CRC_SIZE;
                 if (_rx_len >= need) {
@@ -134,6 +193,9 @@ bool CoprocessorLink::_readFrame(uint8_t* out_frame, size_t* out_len, uint32_t t
 
 void CoprocessorLink::_processFrame(const uint8_t* frame, size_t len) {
     if (!cp_frame_valid(frame, len)) return;
+    int idx = _findNode(cp_frame_addr(frame));
+    if (idx < 0) return;  // Unregistered node (or our own broadcast echo)
+    node_t& n = _nodes[idx];
     uint8_t type = cp_frame_type(frame);
     uint8_t plen = cp_frame_payload_len(frame);
     const uint8_t* pl = cp_frame_payload(frame);
@@ -142,22 +204,28 @@ void CoprocessorLink::_processFrame(const uint8_t* frame, size_t len) {
     case CP_TYPE_TELEMETRY:
         if (plen >= sizeof(cp_telemetry_payload_t)) {
             const cp_telemetry_payload_t* t = (const cp_telemetry_payload_t*)pl;
-            _telemetry.conductivity_uS_cm = t->conductivity_uS_cm;
-            _telemetry.temperature_c = t->temperature_c;
-            _telemetry.blowdown_state = t->blowdown_state;
-            _telemetry.valve_open = t->valve_open ? true : false;
-            _telemetry.valve_feedback_mA = t->valve_feedback_mA;
-            _telemetry.solenoid_on = t->solenoid_on ? true : false;
-            _telemetry.sensor_ok = t->sensor_ok ? true : false;
-            _telemetry.temp_ok = t->temp_ok ? true : false;
-            _telemetry.valve_fault = t->valve_fault ? true : false;
-            _telemetry.comms_lost = t->comms_lost ? true : false;
-            _telemetry.sequence = t->sequence;
-            _telemetry.timestamp_ms = t->timestamp_ms;
-            _telemetry.valid = true;
-            _telemetry.last_received_ms = millis();
-            _comms_lost = false;
-            _comms_lost_since_ms = 0;
+            uint32_t now = millis();
+            if (n.telemetry.valid) n.last_period_ms = now - n.telemetry.last_received_ms;
+            n.telemetry.conductivity_uS_cm = t->conductivity_uS_cm;
+            n.telemetry.temperature_c = t->temperature_c;
+            n.telemetry.blowdown_state = t->blowdown_state;
+            n.telemetry.valve_open = t->valve_open ? true : false;
+            n.telemetry.valve_feedback_mA = t->valve_feedback_mA;
+            n.telemetry.solenoid_on = t->solenoid_on ? true : false;
+            n.telemetry.sensor_ok = t->sensor_ok ? true : false;
+            n.telemetry.temp_ok = t->temp_ok ? true : false;
+            n.telemetry.valve_fault = t->valve_fault ? true : false;
+            n.telemetry.comms_lost = t->comms_lost ? true : false;
+            n.telemetry.sequence = t->sequence;
+            n.telemetry.timestamp_ms = t->timestamp_ms;
+            n.telemetry.valid = true;
+            n.telemetry.last_received_ms = now;
+            if (!n.clock.addSample(t->timestamp_ms, now)) {
+                Serial.printf("[CP] Node %u clock discontinuity; clock model reset\n", n.addr);
+            }
+            n.telemetry.sample_local_ms = n.clock.toLocal(t->timestamp_ms);
+            n.comms_lost = false;
+            n.comms_lost_since_ms = 0;
         }
         break;
     case CP_TYPE_ACK:
@@ -173,18 +241,111 @@ void CoprocessorLink::_processFrame(const uint8_t* frame, size_t len) {
     }
 }
 
+// ============================================================================
+// SCHEDULER
+// ============================================================================
+
+// Caller holds _mutex. Among due nodes pick the highest priority, with lateness as aging so
+// low-priority nodes are never starved; scanning from the node after the last one polled makes
+// equal scores round-robin.
+int CoprocessorLink::_pickNextNode(uint32_t now) const {
+    int best = -1;
+    int32_t best_score = 0;
+    for (uint8_t k = 0; k < _node_count; k++) {
+        uint8_t i = (uint8_t)((_rr_index + 1 + k) % _node_count);
+        int32_t late = (int32_t)(now - _nodes[i].next_due_ms);
+        if (late < 0) continue;
+        int32_t score = (int32_t)_nodes[i].priority * CP_LINK_PRIORITY_WEIGHT_MS + late;
+        if (best < 0 || score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+// Caller holds _mutex. One POLL → TELEMETRY exchange; the reply slot is bounded so a dead
+// node costs at most CP_LINK_POLL_REPLY_TIMEOUT_MS.
+void CoprocessorLink::_pollNode(int idx) {
+    node_t& n = _nodes[idx];
+    uint32_t now = millis();
+    uint16_t interval = n.comms_lost ? CP_LINK_LOST_POLL_INTERVAL_MS : n.poll_interval_ms;
+    n.next_due_ms += interval;
+    if ((int32_t)(now - n.next_due_ms) >= 0) n.next_due_ms = now + interval;  // No catch-up bursts
+    _rr_index = (uint8_t)idx;
+
+    _sendFrame(n.addr, CP_TYPE_POLL, NULL, 0);
+    n.polls_sent++;
+
+    uint8_t rx[CP_MAX_FRAME];
+    size_t rx_len = 0;
+    uint32_t start = millis();
+    bool answered = false;
+    while (!answered) {
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= CP_LINK_POLL_REPLY_TIMEOUT_MS) break;
+        if (!_readFrame(rx, &rx_len, CP_LINK_POLL_REPLY_TIMEOUT_MS - elapsed)) break;
+        _processFrame(rx, rx_len);
+        if (cp_frame_addr(rx) == n.addr && cp_frame_type(rx) == CP_TYPE_TELEMETRY) answered = true;
+    }
+    if (!answered) n.polls_missed++;
+}
+
+// ============================================================================
+// ACCESSORS
+// ============================================================================
+
 const cp_link_telemetry_t& CoprocessorLink::getLastTelemetry() const {
     if (_mutex != NULL && xSemaphoreTake(_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-        memcpy((void*)&_telemetry_copy, &_telemetry, sizeof(_telemetry));
+        if (_node_count > 0) {
+            memcpy((void*)&_telemetry_copy, &_nodes[0].telemetry, sizeof(_telemetry_copy));
+        }
         xSemaphoreGive(_mutex);
     }
     return _telemetry_copy;
 }
 
+bool CoprocessorLink::getNodeTelemetry(uint8_t addr, cp_link_telemetry_t* out) const {
+    if (out == NULL || _mutex == NULL) return false;
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(50)) != pdTRUE) return false;
+    int idx = _findNode(addr);
+    if (idx >= 0) memcpy(out, &_nodes[idx].telemetry, sizeof(*out));
+    xSemaphoreGive(_mutex);
+    return idx >= 0;
+}
+
+bool CoprocessorLink::getNodeStats(uint8_t addr, cp_link_node_stats_t* out) const {
+    if (out == NULL || _mutex == NULL) return false;
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(50)) != pdTRUE) return false;
+    int idx = _findNode(addr);
+    if (idx >= 0) {
+        const node_t& n = _nodes[idx];
+        out->addr = n.addr;
+        out->priority = n.priority;
+        out->poll_interval_ms = n.poll_interval_ms;
+        out->polls_sent = n.polls_sent;
+        out->polls_missed = n.polls_missed;
+        out->last_period_ms = n.last_period_ms;
+        out->comms_lost = n.comms_lost;
+    }
+    xSemaphoreGive(_mutex);
+    return idx >= 0;
+}
+
 bool CoprocessorLink::isCommsLost() const {
     bool lost = true;
     if (_mutex != NULL && xSemaphoreTake(_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-        lost = _comms_lost;
+        if (_node_count > 0) lost = _nodes[0].comms_lost;
+        xSemaphoreGive(_mutex);
+    }
+    return lost;
+}
+
+bool CoprocessorLink::isNodeCommsLost(uint8_t addr) const {
+    bool lost = true;
+    if (_mutex != NULL && xSemaphoreTake(_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+        int idx = _findNode(addr);
+        if (idx >= 0) lost = _nodes[idx].comms_lost;
         xSemaphoreGive(_mutex);
     }
     return lost;
@@ -193,7 +354,7 @@ bool CoprocessorLink::isCommsLost() const {
 uint32_t CoprocessorLink::getCommsLostSinceMs() const {
     uint32_t ms = 0;
     if (_mutex != NULL && xSemaphoreTake(_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-        ms = _comms_lost_since_ms;
+        if (_node_count > 0) ms = _nodes[0].comms_lost_since_ms;
         xSemaphoreGive(_mutex);
     }
     return ms;
@@ -217,59 +378,129 @@ uint8_t CoprocessorLink::getLastNakResult() const {
     return r;
 }
 
+uint32_t CoprocessorLink::panelToLocalMs(uint32_t panel_ms, uint8_t addr) const {
+    uint32_t ms = panel_ms;
+    if (_mutex != NULL && xSemaphoreTake(_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+        int idx = _findNode(addr);
+        if (idx >= 0) ms = _nodes[idx].clock.toLocal(panel_ms);
+        xSemaphoreGive(_mutex);
+    }
+    return ms;
+}
+
+float CoprocessorLink::getClockSkewPpm(uint8_t addr) const {
+    float ppm = 0.0f;
+    if (_mutex != NULL && xSemaphoreTake(_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+        int idx = _findNode(addr);
+        if (idx >= 0) ppm = _nodes[idx].clock.getSkewPpm();
+        xSemaphoreGive(_mutex);
+    }
+    return ppm;
+}
+
+float CoprocessorLink::getClockDriftMs(uint8_t addr) const {
+    float ms = 0.0f;
+    if (_mutex != NULL && xSemaphoreTake(_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+        int idx = _findNode(addr);
+        if (idx >= 0) ms = _nodes[idx].clock.getDriftMs();
+        xSemaphoreGive(_mutex);
+    }
+    return ms;
+}
+
+// Caller holds _mutex. Sync once any node's model is valid, then only when a node's drift
+// exceeds the bound. TIME_SYNC is broadcast, so one frame resynchronizes every panel.
+bool CoprocessorLink::_timeSyncDue() const {
+    if (_last_time_sync_ms != 0 && (millis() - _last_time_sync_ms) < CP_LINK_TIME_SYNC_MIN_GAP_MS) return false;
+    for (uint8_t i = 0; i < _node_count; i++) {
+        const node_t& n = _nodes[i];
+        if (n.comms_lost || !n.clock.isValid()) continue;
+        if (!n.clock.isSynced() || n.clock.getDriftMs() > CP_LINK_DRIFT_BOUND_MS) return true;
+    }
+    return false;
+}
+
+// ============================================================================
+// POLL (bus master)
+// ============================================================================
+
 void CoprocessorLink::poll() {
     if (_mutex == NULL) return;
     if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
     uint8_t frame[CP_MAX_FRAME];
     size_t len = 0;
+    // Stray / late replies first
     while (_readFrame(frame, &len, 0)) {
         _processFrame(frame, len);
     }
-    // Comms lost if no telemetry for timeout
-    if (_telemetry.valid && (millis() - _telemetry.last_received_ms >= CP_LINK_TELEMETRY_TIMEOUT_MS)) {
-        if (!_comms_lost) _comms_lost_since_ms = millis();
-        _comms_lost = true;
+    for (int polls = 0; polls < CP_LINK_MAX_POLLS_PER_CALL; polls++) {
+        int idx = _pickNextNode(millis());
+        if (idx < 0) break;
+        _pollNode(idx);
     }
+    // Comms lost per node if no telemetry for timeout
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < _node_count; i++) {
+        node_t& n = _nodes[i];
+        if (n.telemetry.valid && (now - n.telemetry.last_received_ms >= CP_LINK_TELEMETRY_TIMEOUT_MS)) {
+            if (!n.comms_lost) n.comms_lost_since_ms = now;
+            n.comms_lost = true;
+        }
+    }
+    bool sync_due = _timeSyncDue();
     xSemaphoreGive(_mutex);
+
+    // TIME_SYNC carries wall-clock time; skip until NTP has set it
+    if (sync_due) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        if ((uint32_t)tv.tv_sec >= CP_LINK_UNIX_TIME_VALID) {
+            sendTimeSync((uint32_t)tv.tv_sec, (uint32_t)(tv.tv_usec / 1000));
+        }
+    }
 }
 
-cp_cmd_result_t CoprocessorLink::sendBlowdownOpen() {
+// ============================================================================
+// COMMANDS
+// ============================================================================
+
+cp_cmd_result_t CoprocessorLink::sendBlowdownOpen(uint8_t addr) {
     if (_mutex == NULL) return CP_CMD_RESULT_LINK_DOWN;
     if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return CP_CMD_RESULT_TIMEOUT;
     cp_cmd_blowdown_open_t cmd;
     cmd.sequence = ++_cmd_sequence;
-    cp_cmd_result_t r = _sendCommandAndWaitAck(CP_TYPE_CMD_BLOWDOWN_OPEN, (const uint8_t*)&cmd, sizeof(cmd));
+    cp_cmd_result_t r = _sendCommandAndWaitAck(addr, CP_TYPE_CMD_BLOWDOWN_OPEN, (const uint8_t*)&cmd, sizeof(cmd));
     xSemaphoreGive(_mutex);
     return r;
 }
 
-cp_cmd_result_t CoprocessorLink::sendBlowdownClose() {
+cp_cmd_result_t CoprocessorLink::sendBlowdownClose(uint8_t addr) {
     if (_mutex == NULL) return CP_CMD_RESULT_LINK_DOWN;
     if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return CP_CMD_RESULT_TIMEOUT;
     cp_cmd_blowdown_close_t cmd;
     cmd.sequence = ++_cmd_sequence;
-    cp_cmd_result_t r = _sendCommandAndWaitAck(CP_TYPE_CMD_BLOWDOWN_CLOSE, (const uint8_t*)&cmd, sizeof(cmd));
+    cp_cmd_result_t r = _sendCommandAndWaitAck(addr, CP_TYPE_CMD_BLOWDOWN_CLOSE, (const uint8_t*)&cmd, sizeof(cmd));
     xSemaphoreGive(_mutex);
     return r;
 }
 
-cp_cmd_result_t CoprocessorLink::sendSolenoid(bool on) {
+cp_cmd_result_t CoprocessorLink::sendSolenoid(bool on, uint8_t addr) {
     if (_mutex == NULL) return CP_CMD_RESULT_LINK_DOWN;
     if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return CP_CMD_RESULT_TIMEOUT;
     cp_cmd_solenoid_t cmd;
     cmd.sequence = ++_cmd_sequence;
     cmd.on = on ? 1 : 0;
-    cp_cmd_result_t r = _sendCommandAndWaitAck(CP_TYPE_CMD_SOLENOID, (const uint8_t*)&cmd, sizeof(cmd));
+    cp_cmd_result_t r = _sendCommandAndWaitAck(addr, CP_TYPE_CMD_SOLENOID, (const uint8_t*)&cmd, sizeof(cmd));
     xSemaphoreGive(_mutex);
     return r;
 }
 
-cp_cmd_result_t CoprocessorLink::sendSampleRequest() {
+cp_cmd_result_t CoprocessorLink::sendSampleRequest(uint8_t addr) {
     if (_mutex == NULL) return CP_CMD_RESULT_LINK_DOWN;
     if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return CP_CMD_RESULT_TIMEOUT;
     cp_cmd_sample_request_t cmd;
     cmd.sequence = ++_cmd_sequence;
-    cp_cmd_result_t r = _sendCommandAndWaitAck(CP_TYPE_CMD_SAMPLE_REQUEST, (const uint8_t*)&cmd, sizeof(cmd));
+    cp_cmd_result_t r = _sendCommandAndWaitAck(addr, CP_TYPE_CMD_SAMPLE_REQUEST, (const uint8_t*)&cmd, sizeof(cmd));
     xSemaphoreGive(_mutex);
     return r;
 }
@@ -280,9 +511,12 @@ void CoprocessorLink::sendTimeSync(uint32_t unix_sec, uint32_t subsec_ms) {
     cp_time_sync_payload_t pl;
     pl.unix_time_sec = unix_sec;
     pl.unix_time_subsec_ms = subsec_ms;
-    _setDeRe(true);
-    delay(1);
-    _sendFrame(CP_TYPE_TIME_SYNC, (const uint8_t*)&pl, sizeof(pl));
-    _setDeRe(false);
+    _sendFrame(CP_ADDR_BROADCAST, CP_TYPE_TIME_SYNC, (const uint8_t*)&pl, sizeof(pl));
+    _last_time_sync_ms = millis();
+    if (_last_time_sync_ms == 0) _last_time_sync_ms = 1;
+    for (uint8_t i = 0; i < _node_count; i++) {
+        _nodes[i].clock.markSynced(_last_time_sync_ms);
+    }
+    Serial.printf("[CP] TIME_SYNC broadcast to %u node(s)\n", _node_count);
     xSemaphoreGive(_mutex);
 }
@@ -4,6 +4,7 @@
  */
 
 #include "coprocessor_protocol.h"
+#include <string.h>
 
 // CRC-16-CCITT: poly 0x1021, init 0xFFFF (used in Modbus, etc.)
 static const uint16_t crc16_table[256] = {
@@ -50,10 +51,24 @@ uint16_t cp_crc16(const uint8_t* data, size_t length) {
     return crc;
 }
 
+size_t cp_frame_build(uint8_t* out_frame, uint8_t addr, uint8_t type, const uint8_t* payload, uint8_t plen) {
+    if (out_frame == NULL || plen > CP_MAX_PAYLOAD) return 0;
+    out_frame[0] = CP_SYNC_0;
+    out_frame[1] = CP_SYNC_1;
+    out_frame[CP_HDR_ADDR] = addr;
+    out_frame[CP_HDR_TYPE] = type;
+    out_frame[CP_HDR_LEN] = plen;
+    if (plen && payload) memcpy(out_frame + CP_HEADER_SIZE, payload, plen);
+    uint16_t crc = cp_crc16(out_frame, CP_HEADER_SIZE + plen);
+    out_frame[CP_HEADER_SIZE + plen]     = (uint8_t)(crc & 0xFF);
+    out_frame[CP_HEADER_SIZE + plen + 1] = (uint8_t)(crc >> 8);
+    return CP_HEADER_SIZE + plen + CP_CRC_SIZE;
+}
+
 bool cp_frame_valid(const uint8_t* frame, size_t frame_len) {
     if (frame == NULL || frame_len < CP_HEADER_SIZE + CP_CRC_SIZE) return false;
     if (frame[0] != CP_SYNC_0 || frame[1] != CP_SYNC_1) return false;
-    uint8_t plen = frame[3];
+    uint8_t plen = frame[CP_HDR_LEN];
     if (plen > CP_MAX_PAYLOAD) return false;
     size_t expected = CP_HEADER_SIZE + plen + CP_CRC_SIZE;
     if (frame_len != expected) return false;
@@ -0,0 +1,148 @@
+/**
+ * @file cp_clock_sync.cpp
+ * @brief Panel clock offset/skew estimation (min-filtered buckets, regression, lower envelope)
+ */
+
+#include "cp_clock_sync.h"
+#include <math.h>
+#include <string.h>
+
+CpClockEstimator::CpClockEstimator() {
+    reset();
+}
+
+void CpClockEstimator::reset() {
+    memset(_pairs, 0, sizeof(_pairs));
+    _head = 0;
+    _count = 0;
+    memset(&_cand, 0, sizeof(_cand));
+    _cand_valid = false;
+    _bucket_start_ms = 0;
+    _last_panel_ms = 0;
+    _ref_panel = 0;
+    _ref_local = 0;
+    _skew = 1.0f;
+    _offset = 0.0f;
+    _synced = false;
+    _sync_panel_ms = 0;
+}
+
+bool CpClockEstimator::addSample(uint32_t panel_ms, uint32_t local_ms) {
+    bool continuous = true;
+    if (_cand_valid) {
+        int32_t dp = (int32_t)(panel_ms - _last_panel_ms);
+        if (dp == 0) return true;  // Same sample re-read; nothing new
+        if (dp < 0) {
+            continuous = false;    // Panel millis() went backwards: reboot
+        } else if (isValid()) {
+            int32_t residual = (int32_t)(local_ms - toLocal(panel_ms));
+            if (residual > CP_CLOCK_RESET_JUMP_MS || residual < -CP_CLOCK_RESET_JUMP_MS) {
+                continuous = false;
+            }
+        }
+        if (!continuous) reset();
+    }
+    _last_panel_ms = panel_ms;
+
+    if (!_cand_valid) {
+        _cand.panel_ms = panel_ms;
+        _cand.local_ms = local_ms;
+        _cand_valid = true;
+        _bucket_start_ms = local_ms;
+    } else {
+        // Close the bucket: its least-delayed pair joins the regression window
+        if ((uint32_t)(local_ms - _bucket_start_ms) >= CP_CLOCK_BUCKET_MS) {
+            _pairs[_head] = _cand;
+            _head = (uint8_t)((_head + 1) % CP_CLOCK_WINDOW);
+            if (_count < CP_CLOCK_WINDOW) _count++;
+            _cand.panel_ms = panel_ms;
+            _cand.local_ms = local_ms;
+            _bucket_start_ms = local_ms;
+        } else if ((int32_t)((local_ms - panel_ms) - (_cand.local_ms - _cand.panel_ms)) < 0) {
+            _cand.panel_ms = panel_ms;
+            _cand.local_ms = local_ms;
+        }
+    }
+
+    _ref_panel = _cand.panel_ms;
+    _ref_local = _cand.local_ms;
+    _fit();
+    return continuous;
+}
+
+// Residual of a pair against a unit-origin model with the given skew (coordinates relative to ref)
+float CpClockEstimator::_residual(const cp_clock_pair_t& p, float skew) const {
+    int32_t x = (int32_t)(p.panel_ms - _ref_panel);
+    int32_t y = (int32_t)(p.local_ms - _ref_local);
+    return (float)y - skew * (float)x;
+}
+
+void CpClockEstimator::_fit() {
+    // Coordinates relative to the newest pair keep values small for float math
+    double sx = 0, sy = 0;
+    int32_t x_min = 0;
+    uint8_t n = _count;
+    for (uint8_t i = 0; i < n; i++) {
+        int32_t x = (int32_t)(_pairs[i].panel_ms - _ref_panel);
+        int32_t y = (int32_t)(_pairs[i].local_ms - _ref_local);
+        sx += x;
+        sy += y;
+        if (x < x_min) x_min = x;
+    }
+
+    float skew = 1.0f;
+    if (n >= 2 && -x_min >= CP_CLOCK_MIN_SPAN_MS) {
+        double mx = sx / n, my = sy / n;
+        double sxx = 0, sxy = 0;
+        for (uint8_t i = 0; i < n; i++) {
+            double dx = (int32_t)(_pairs[i].panel_ms - _ref_panel) - mx;
+            double dy = (int32_t)(_pairs[i].local_ms - _ref_local) - my;
+            sxx += dx * dx;
+            sxy += dx * dy;
+        }
+        if (sxx > 0) {
+            double b = sxy / sxx;
+            double limit = CP_CLOCK_MAX_SKEW_PPM * 1e-6;
+            if (b > 1.0 + limit) b = 1.0 + limit;
+            if (b < 1.0 - limit) b = 1.0 - limit;
+            skew = (float)b;
+        }
+    }
+
+    // Lower envelope over the window and the open bucket: arrival latency is never negative
+    float offset = _cand_valid ? _residual(_cand, skew) : 0.0f;
+    for (uint8_t i = 0; i < n; i++) {
+        float r = _residual(_pairs[i], skew);
+        if (r < offset) offset = r;
+    }
+
+    _skew = skew;
+    _offset = offset;
+}
+
+uint32_t CpClockEstimator::toLocal(uint32_t panel_ms) const {
+    if (!_cand_valid) return panel_ms;
+    int32_t dx = (int32_t)(panel_ms - _ref_panel);
+    return _ref_local + (uint32_t)(int32_t)lroundf(_offset + _skew * (float)dx);
+}
+
+float CpClockEstimator::getSkewPpm() const {
+    return (1.0f / _skew - 1.0f) * 1e6f;  // Panel ticks per local tick, minus one
+}
+
+int32_t CpClockEstimator::getOffsetMs() const {
+    return (int32_t)(_ref_local - _ref_panel) + (int32_t)lroundf(_offset);
+}
+
+void CpClockEstimator::markSynced(uint32_t local_ms) {
+    if (!_cand_valid) return;
+    int32_t dy = (int32_t)(local_ms - _ref_local);
+    _sync_panel_ms = _ref_panel + (uint32_t)(int32_t)lroundf(((float)dy - _offset) / _skew);
+    _synced = true;
+}
+
+float CpClockEstimator::getDriftMs() const {
+    if (!_synced || !isValid()) return 0.0f;
+    int32_t elapsed = (int32_t)(_last_panel_ms - _sync_panel_ms);
+    return fabsf((_skew - 1.0f) * (float)elapsed);
+}
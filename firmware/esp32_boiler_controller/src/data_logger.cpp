@@ -4,6 +4,8 @@
  */
 
 #include "data_logger.h"
+#include "telemetry_spool.h"
+#include "reading_codec.h"
 #include <WiFi.h>
 #include <HTTPClient.h>
 #include <NTPClient.h>
@@ -12,6 +14,9 @@
 // Global instance
 DataLogger dataLogger;
 
+// Kept across requests so uploads reuse one TCP connection
+static WiFiClient s_httpClient;
+
 // NTP client for time sync
 static WiFiUDP ntpUDP;
 static NTPClient timeClient(ntpUDP, "pool.ntp.org", 0, 60000);
@@ -30,10 +35,11 @@ DataLogger::DataLogger()
     , _last_upload_time(0)
     , _log_interval(TSDB_LOG_INTERVAL_MS)
     , _last_http_status(0)
-    , _buffer_head(0)
-    , _buffer_tail(0)
-    , _buffer_count(0)
+    , _url_port(0)
+    , _retry_at(0)
+    , _retry_backoff(0)
 {
+    memset(_url_host, 0, sizeof(_url_host));
 }
 
 bool DataLogger::begin(system_config_t* config) {
@@ -46,6 +52,9 @@ bool DataLogger::begin(system_config_t* config) {
 
     _log_interval = _config->log_interval_ms;
     _enabled = true;
+    _http.setReuse(true);
+    _http.setConnectTimeout(NET_HTTP_CONNECT_MS);
+    _http.setTimeout(NET_HTTP_TIMEOUT_MS);
 
     Serial.println("DataLogger initialized");
     return true;
@@ -115,7 +124,7 @@ void DataLogger::update() {
     }
 
     // Try to upload buffered data
-    if (_wifi_connected && _buffer_count > 0) {
+    if (_wifi_connected && _ring.count() > 0 && !backingOff()) {
         uploadBuffered();
     }
 
@@ -141,80 +150,176 @@ void DataLogger::logReading(sensor_reading_t* reading) {
         return;
     }
 
-    // Try to upload immediately if connected
-    if (_wifi_connected) {
-        if (uploadReading(reading)) {
-            _server_connected = true;
-            return;
-        } else {
-            _server_connected = false;
-        }
-    }
-
-    // Buffer for later upload
-    bufferReading(reading);
+    // Sent by the network task (deliver)
+    net_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.kind = NET_MSG_READING;
+    msg.sink = NET_SINK_HTTP;
+    msg.timestamp = reading->timestamp;
+    msg.reading = *reading;
+    netOutbox.push(&msg);
 }
 
 void DataLogger::logEvent(const char* event_type, const char* description, int32_t value) {
     if (!_enabled) return;
 
+    Serial.printf("Event: %s - %s (%d)\n", event_type, description, value);
+
     // Phase D: When MQTT telemetry is enabled, skip HTTP upload (events sent via MQTT from main)
     if (_config && _config->use_mqtt_telemetry) {
-        Serial.printf("Event: %s - %s (%d)\n", event_type, description, value);
         return;
     }
 
-    event_log_t event;
-    event.timestamp = getTimestamp();
-    strncpy(event.event_type, event_type, sizeof(event.event_type) - 1);
-    strncpy(event.description, description, sizeof(event.description) - 1);
-    event.value = value;
-
-    if (_wifi_connected) {
-        uploadEvent(&event);
-    }
-
-    Serial.printf("Event: %s - %s (%d)\n", event_type, description, value);
+    net_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.kind = NET_MSG_EVENT;
+    msg.sink = NET_SINK_HTTP;
+    msg.timestamp = getTimestamp();
+    strncpy(msg.event.type, event_type, sizeof(msg.event.type) - 1);
+    strncpy(msg.event.description, description, sizeof(msg.event.description) - 1);
+    msg.event.value = value;
+    netOutbox.push(&msg);
 }
 
 void DataLogger::logAlarm(uint16_t alarm_code, const char* alarm_name,
                           bool active, float trigger_value) {
     if (!_enabled) return;
 
+    Serial.printf("Alarm: %s - %s (%.2f)\n", alarm_name,
+                  active ? "ACTIVE" : "CLEARED", trigger_value);
+
     // Phase D: When MQTT telemetry is enabled, skip HTTP upload (alarms sent via MQTT from main)
     if (_config && _config->use_mqtt_telemetry) {
-        Serial.printf("Alarm: %s - %s (%.2f)\n", alarm_name,
-                      active ? "ACTIVE" : "CLEARED", trigger_value);
         return;
     }
 
-    alarm_log_t alarm;
-    alarm.timestamp = getTimestamp();
-    alarm.alarm_code = alarm_code;
-    strncpy(alarm.alarm_name, alarm_name, sizeof(alarm.alarm_name) - 1);
-    alarm.active = active;
-    alarm.trigger_value = trigger_value;
+    net_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.kind = NET_MSG_ALARM;
+    msg.sink = NET_SINK_HTTP;
+    msg.timestamp = getTimestamp();
+    msg.alarm.code = alarm_code;
+    strncpy(msg.alarm.name, alarm_name, sizeof(msg.alarm.name) - 1);
+    msg.alarm.active = active;
+    msg.alarm.trigger_value = trigger_value;
+    netOutbox.push(&msg);
+}
 
-    if (_wifi_connected) {
-        uploadAlarm(&alarm);
+void DataLogger::deliver(const net_msg_t* msg) {
+    if (!_enabled || !msg) return;
+    if (_config && _config->use_mqtt_telemetry) return;   // Switched over while queued
+
+    // Send now if the server is reachable; behind a spool backlog the record
+    // queues up so the server receives everything in order
+    bool spool = spoolEnabled();
+    bool direct = _wifi_connected && !backingOff() && !(spool && telemetrySpool.hasBacklog());
+
+    switch (msg->kind) {
+        case NET_MSG_READING: {
+            sensor_reading_t reading = msg->reading;
+            if (direct) {
+                _server_connected = uploadReading(&reading);
+                if (_server_connected) return;
+            }
+            // Keep for later upload: SD spool, or the RAM buffer without a card
+            if (spool && telemetrySpool.appendReading(&reading)) return;
+            bufferReading(&reading);
+            break;
+        }
+
+        case NET_MSG_EVENT: {
+            event_log_t event;
+            memset(&event, 0, sizeof(event));
+            event.timestamp = msg->timestamp;
+            strncpy(event.event_type, msg->event.type, sizeof(event.event_type) - 1);
+            strncpy(event.description, msg->event.description, sizeof(event.description) - 1);
+            event.value = msg->event.value;
+            if (direct && uploadEvent(&event)) return;
+            if (spool) {
+                telemetrySpool.appendEvent(event.timestamp, event.event_type, event.description, event.value);
+            }
+            break;
+        }
+
+        case NET_MSG_ALARM: {
+            alarm_log_t alarm;
+            memset(&alarm, 0, sizeof(alarm));
+            alarm.timestamp = msg->timestamp;
+            alarm.alarm_code = msg->alarm.code;
+            strncpy(alarm.alarm_name, msg->alarm.name, sizeof(alarm.alarm_name) - 1);
+            alarm.active = msg->alarm.active;
+            alarm.trigger_value = msg->alarm.trigger_value;
+            if (direct && uploadAlarm(&alarm)) return;
+            if (spool) {
+                telemetrySpool.appendAlarm(alarm.timestamp, alarm.alarm_code, alarm.alarm_name,
+                                           alarm.active, alarm.trigger_value);
+            }
+            break;
+        }
+
+        default:
+            break;
     }
+}
 
-    Serial.printf("Alarm: %s - %s (%.2f)\n", alarm_name,
-                  active ? "ACTIVE" : "CLEARED", trigger_value);
+uint32_t DataLogger::sendSpooled(const spool_record_t* recs, uint32_t count) {
+    uint32_t done = 0;
+    while (done < count && _wifi_connected && !backingOff()) {
+        const spool_record_t* rec = &recs[done];
+        uint32_t n = 1;
+        bool ok = false;
+        if (rec->kind == SPOOL_READING) {
+            // A run of readings goes as one batch
+            n = 0;
+            while (done + n < count && (int)n < batchSize() && recs[done + n].kind == SPOOL_READING) {
+                sdlog_unpack(&recs[done + n].reading, &_batch_readings[n]);
+                n++;
+            }
+            int sent = uploadBatch(n);
+            if (sent > 0) n = sent;             // Fewer when the byte limit was reached
+            ok = sent > 0;
+        } else if (rec->kind == SPOOL_EVENT) {
+            event_log_t event;
+            memset(&event, 0, sizeof(event));
+            event.timestamp = rec->timestamp;
+            strncpy(event.event_type, rec->event.type, sizeof(event.event_type) - 1);
+            strncpy(event.description, rec->event.description, sizeof(event.description) - 1);
+            event.value = rec->event.value;
+            ok = uploadEvent(&event);
+        } else if (rec->kind == SPOOL_ALARM) {
+            alarm_log_t alarm;
+            memset(&alarm, 0, sizeof(alarm));
+            alarm.timestamp = rec->timestamp;
+            alarm.alarm_code = rec->alarm.code;
+            strncpy(alarm.alarm_name, rec->alarm.name, sizeof(alarm.alarm_name) - 1);
+            alarm.active = rec->alarm.active != 0;
+            alarm.trigger_value = rec->alarm.trigger_value;
+            ok = uploadAlarm(&alarm);
+        }
+        _server_connected = ok;
+
+        // Records the server rejects (4xx) will never be accepted: drop them
+        // rather than stall the backlog behind them
+        if (!ok && !(_last_http_status >= 400 && _last_http_status < 500)) break;
+        if (!ok) Serial.printf("Spooled records rejected: HTTP %d (%lu)\n", _last_http_status, (unsigned long)n);
+        done += n;
+    }
+    return done;
 }
 
 int DataLogger::forceUpload() {
-    if (!_wifi_connected) return 0;
+    if (!_wifi_connected || backingOff()) return 0;
 
     int uploaded = 0;
-    while (_buffer_count > 0 && uploadBuffered()) {
-        uploaded++;
+    int sent;
+    while (_ring.count() > 0 && (sent = uploadBuffered()) > 0) {
+        uploaded += sent;
     }
     return uploaded;
 }
 
 int DataLogger::getPendingCount() {
-    return _buffer_count;
+    return _ring.count();
 }
 
 int DataLogger::getLastUploadStatus() {
@@ -299,26 +404,66 @@ uint32_t DataLogger::getTimestamp() {
 // PRIVATE METHODS
 // ============================================================================
 
-bool DataLogger::uploadReading(sensor_reading_t* reading) {
+bool DataLogger::prepareURLs() {
     if (!_config || strlen(_config->tsdb_host) == 0) return false;
     if (_config->use_mqtt_telemetry) return false;  // Phase D: telemetry via MQTT only
 
-    String url = "http://" + String(_config->tsdb_host) + ":" +
-                 String(_config->tsdb_port) + "/api/readings";
-
-    String json = buildReadingJSON(reading);
+    // Built when the server changes, not per POST
+    if (_url_port == _config->tsdb_port && strcmp(_url_host, _config->tsdb_host) == 0) return true;
+    strncpy(_url_host, _config->tsdb_host, sizeof(_url_host) - 1);
+    _url_port = _config->tsdb_port;
+    snprintf(_url_reading, sizeof(_url_reading), "http://%s:%u/api/readings", _url_host, _url_port);
+    snprintf(_url_batch, sizeof(_url_batch), "http://%s:%u/api/readings/batch", _url_host, _url_port);
+    snprintf(_url_packed, sizeof(_url_packed), "http://%s:%u/api/readings/packed", _url_host, _url_port);
+    snprintf(_url_event, sizeof(_url_event), "http://%s:%u/api/events/pump", _url_host, _url_port);
+    snprintf(_url_alarm, sizeof(_url_alarm), "http://%s:%u/api/alarms", _url_host, _url_port);
+    return true;
+}
 
-    _http.begin(url);
-    _http.addHeader("Content-Type", "application/json");
+bool DataLogger::post(const char* url, const char* body, size_t len, const char* content_type) {
+    // s_httpClient outlives the request, so with reuse on the TCP connection
+    // stays open from one POST to the next (HTTP/1.1 keep-alive)
+    _http.begin(s_httpClient, url);
+    _http.addHeader("Content-Type", content_type);
     if (strlen(_config->api_key) > 0) {
         _http.addHeader("X-API-Key", _config->api_key);
     }
 
-    _last_http_status = _http.POST(json);
+    _last_http_status = _http.POST((uint8_t*)body, len);
 
     _http.end();
 
-    if (_last_http_status == 200 || _last_http_status == 201) {
+    // No connection, timeout or server error: hold off further POSTs
+    // (records go to the spool / RAM buffer meanwhile), doubling the pause
+    if (_last_http_status <= 0 || _last_http_status >= 500) {
+        _retry_backoff = _retry_backoff ? _retry_backoff * 2 : NET_RETRY_MIN_MS;
+        if (_retry_backoff > NET_RETRY_MAX_MS) _retry_backoff = NET_RETRY_MAX_MS;
+        _retry_at = (millis() + _retry_backoff) | 1;
+        return false;
+    }
+    _retry_backoff = 0;
+    _retry_at = 0;
+
+    return (_last_http_status == 200 || _last_http_status == 201);
+}
+
+bool DataLogger::backingOff() {
+    if (!_retry_at) return false;
+    if ((int32_t)(millis() - _retry_at) >= 0) {
+        _retry_at = 0;                      // Next POST is the retry
+        return false;
+    }
+    return true;
+}
+
+bool DataLogger::uploadReading(sensor_reading_t* reading) {
+    if (!prepareURLs()) return false;
+
+    JsonDocument doc;
+    buildReadingJSON(reading, doc);
+    size_t len = serializeJson(doc, _batch_buf, sizeof(_batch_buf));
+
+    if (post(_url_reading, _batch_buf, len)) {
         return true;
     }
 
@@ -326,81 +471,110 @@ bool DataLogger::uploadReading(sensor_reading_t* reading) {
     return false;
 }
 
-bool DataLogger::uploadEvent(event_log_t* event) {
-    if (!_config || strlen(_config->tsdb_host) == 0) return false;
-    if (_config->use_mqtt_telemetry) return false;  // Phase D: telemetry via MQTT only
+int DataLogger::uploadBatch(int count) {
+    if (!prepareURLs() || count <= 0) return 0;
+    if (_config->tsdb_encoding == TSDB_ENCODING_PACKED) return uploadPackedBatch(count);
 
-    String url = "http://" + String(_config->tsdb_host) + ":" +
-                 String(_config->tsdb_port) + "/api/events/pump";
+    // {"readings":[{...},{...}]} built in place, up to the byte limit
+    size_t limit = batchBytes();
+    size_t pos = strlen(strcpy(_batch_buf, "{\"readings\":["));
+    int n = 0;
+    JsonDocument doc;
+    for (; n < count; n++) {
+        doc.clear();
+        buildReadingJSON(&_batch_readings[n], doc);
+        size_t len = measureJson(doc);
+        if (pos + len + 3 > limit) break;           // ',' + object + "]}"
+        if (n > 0) _batch_buf[pos++] = ',';
+        pos += serializeJson(doc, _batch_buf + pos, limit - pos);
+    }
+    if (n == 0) return 0;
+    _batch_buf[pos++] = ']';
+    _batch_buf[pos++] = '}';
 
-    String json = buildEventJSON(event);
+    if (!post(_url_batch, _batch_buf, pos)) {
+        Serial.printf("Batch upload failed: HTTP %d\n", _last_http_status);
+        return 0;
+    }
+    return n;
+}
 
-    _http.begin(url);
-    _http.addHeader("Content-Type", "application/json");
-    if (strlen(_config->api_key) > 0) {
-        _http.addHeader("X-API-Key", _config->api_key);
+int DataLogger::uploadPackedBatch(int count) {
+    // One compressed block in the same buffer, a few bytes per reading
+    // instead of ~500 as JSON; what does not fit goes in the next batch
+    ReadingEncoder enc;
+    enc.begin((uint8_t*)_batch_buf, batchBytes());
+    sd_log_record_t rec;
+    int n = 0;
+    for (; n < count; n++) {
+        sdlog_pack(&_batch_readings[n], &rec);
+        if (!enc.append(&rec)) break;
     }
+    if (n == 0) return 0;
+    size_t len = enc.finish();
 
-    _last_http_status = _http.POST(json);
+    if (!post(_url_packed, _batch_buf, len, "application/octet-stream")) {
+        Serial.printf("Packed batch upload failed: HTTP %d\n", _last_http_status);
+        return 0;
+    }
+    return n;
+}
 
-    _http.end();
+bool DataLogger::uploadEvent(event_log_t* event) {
+    if (!prepareURLs()) return false;
 
-    return (_last_http_status == 200 || _last_http_status == 201);
+    JsonDocument doc;
+    buildEventJSON(event, doc);
+    char body[384];
+    size_t len = serializeJson(doc, body, sizeof(body));
+
+    return post(_url_event, body, len);
 }
 
 bool DataLogger::uploadAlarm(alarm_log_t* alarm) {
-    if (!_config || strlen(_config->tsdb_host) == 0) return false;
-    if (_config->use_mqtt_telemetry) return false;  // Phase D: telemetry via MQTT only
-
-    String url = "http://" + String(_config->tsdb_host) + ":" +
-                 String(_config->tsdb_port) + "/api/alarms";
+    if (!prepareURLs()) return false;
 
-    String json = buildAlarmJSON(alarm);
+    JsonDocument doc;
+    buildAlarmJSON(alarm, doc);
+    char body[192];
+    size_t len = serializeJson(doc, body, sizeof(body));
 
-    _http.begin(url);
-    _http.addHeader("Content-Type", "application/json");
-    if (strlen(_config->api_key) > 0) {
-        _http.addHeader("X-API-Key", _config->api_key);
-    }
+    return post(_url_alarm, body, len);
+}
 
-    _last_http_status = _http.POST(json);
+int DataLogger::batchSize() {
+    uint8_t n = _config ? _config->tsdb_batch_size : 0;
+    if (n == 0) return TSDB_BATCH_READINGS;
+    return n < TSDB_BATCH_MAX ? n : TSDB_BATCH_MAX;
+}
 
-    _http.end();
+size_t DataLogger::batchBytes() {
+    uint16_t n = _config ? _config->tsdb_batch_bytes : 0;
+    if (n == 0) return TSDB_BATCH_BYTES;
+    if (n < TSDB_BATCH_BYTES_MIN) return TSDB_BATCH_BYTES_MIN;
+    return n < TSDB_BATCH_BYTES ? n : TSDB_BATCH_BYTES;
+}
 
-    return (_last_http_status == 200 || _last_http_status == 201);
+bool DataLogger::spoolEnabled() {
+    return _config && strlen(_config->tsdb_host) > 0 && telemetrySpool.isAvailable();
 }
 
 void DataLogger::bufferReading(sensor_reading_t* reading) {
-    // Add to circular buffer
-    _reading_buffer[_buffer_head] = *reading;
-    _buffer_head = (_buffer_head + 1) % BUFFER_SIZE;
-
-    if (_buffer_count < BUFFER_SIZE) {
-        _buffer_count++;
-    } else {
-        // Buffer full - overwrite oldest
-        _buffer_tail = (_buffer_tail + 1) % BUFFER_SIZE;
-    }
+    // Packed into the ring; when full the oldest reading is overwritten
+    _ring.push(reading);
 }
 
-bool DataLogger::uploadBuffered() {
-    if (_buffer_count == 0) return false;
+int DataLogger::uploadBuffered() {
+    // Oldest readings first, as one batch
+    int count = _ring.peek(_batch_readings, batchSize());
+    if (count == 0) return 0;
 
-    // Get oldest entry
-    sensor_reading_t* reading = &_reading_buffer[_buffer_tail];
-
-    if (uploadReading(reading)) {
-        _buffer_tail = (_buffer_tail + 1) % BUFFER_SIZE;
-        _buffer_count--;
-        return true;
-    }
-
-    return false;
+    int sent = uploadBatch(count);
+    _ring.drop(sent);
+    return sent;
 }
 
-String DataLogger::buildReadingJSON(sensor_reading_t* reading) {
-    JsonDocument doc;
-
+void DataLogger::buildReadingJSON(const sensor_reading_t* reading, JsonDocument& doc) {
     doc["timestamp"] = reading->timestamp;
     doc["conductivity"] = reading->conductivity;
     doc["temperature"] = reading->temperature;
@@ -425,37 +599,21 @@ String DataLogger::buildReadingJSON(sensor_reading_t* reading) {
     doc["devices_faulted"] = reading->devices_faulted;
     doc["devices_faulted_mask"] = reading->devices_faulted_mask;
     doc["measurement_age_ms"] = reading->measurement_age_ms;
-
-    String output;
-    serializeJson(doc, output);
-    return output;
 }
 
-String DataLogger::buildEventJSON(event_log_t* event) {
-    JsonDocument doc;
-
+void DataLogger::buildEventJSON(const event_log_t* event, JsonDocument& doc) {
     doc["timestamp"] = event->timestamp;
     doc["event_type"] = event->event_type;
     doc["description"] = event->description;
     doc["value"] = event->value;
-
-    String output;
-    serializeJson(doc, output);
-    return output;
 }
 
-String DataLogger::buildAlarmJSON(alarm_log_t* alarm) {
-    JsonDocument doc;
-
+void DataLogger::buildAlarmJSON(const alarm_log_t* alarm, JsonDocument& doc) {
     doc["timestamp"] = alarm->timestamp;
     doc["alarm_code"] = alarm->alarm_code;
     doc["alarm_name"] = alarm->alarm_name;
     doc["active"] = alarm->active;
     doc["trigger_value"] = alarm->trigger_value;
-
-    String output;
-    serializeJson(doc, output);
-    return output;
 }
 
 void DataLogger::handleWiFiEvents() {
@@ -228,6 +228,7 @@ bool DeviceManager::checkPumpModeDependency(uint8_t pump_id, uint8_t feed_mode,
             break;
 
         case 7: // FEED_MODE_F_FUZZY
+        case 8: // FEED_MODE_M_MPC
             // Needs conductivity probe + at least one water meter
             if (!isOperational(DEV_CONDUCTIVITY_PROBE)) {
                 *dep_name = _devices[DEV_CONDUCTIVITY_PROBE].name;
@@ -0,0 +1,307 @@
+/**
+ * @file fuzzy_fixed.cpp
+ * @brief Fixed-point Mamdani inference (Q15 membership, Q16.16 crisp values)
+ */
+
+#include "fuzzy_fixed.h"
+#include <math.h>
+
+// ============================================================================
+// LOOKUP TABLES
+// ============================================================================
+
+// exp(-k/16), k = 0..256, Q15 (Gaussian MF)
+static const uint16_t s_exp_neg_q15[FUZZY_Q_LUT_SIZE] = {
+    32768, 30783, 28918, 27166, 25520, 23974, 22521, 21157, 19875, 18671, 17539, 16477,
+    15479, 14541, 13660, 12832, 12055, 11324, 10638,  9994,  9388,  8819,  8285,  7783,
+     7312,  6869,  6452,  6061,  5694,  5349,  5025,  4721,  4435,  4166,  3914,  3676,
+     3454,  3244,  3048,  2863,  2690,  2527,  2374,  2230,  2095,  1968,  1849,  1737,
+     1631,  1533,  1440,  1352,  1271,  1194,  1121,  1053,   990,   930,   873,   820,
+      771,   724,   680,   639,   600,   564,   530,   498,   467,   439,   412,   387,
+      364,   342,   321,   302,   283,   266,   250,   235,   221,   207,   195,   183,
+      172,   162,   152,   143,   134,   126,   118,   111,   104,    98,    92,    86,
+       81,    76,    72,    67,    63,    59,    56,    52,    49,    46,    43,    41,
+       38,    36,    34,    32,    30,    28,    26,    25,    23,    22,    21,    19,
+       18,    17,    16,    15,    14,    13,    12,    12,    11,    10,    10,     9,
+        9,     8,     8,     7,     7,     6,     6,     6,     5,     5,     5,     4,
+        4,     4,     4,     3,     3,     3,     3,     3,     2,     2,     2,     2,
+        2,     2,     2,     2,     1,     1,     1,     1,     1,     1,     1,     1,
+        1,     1,     1,     1,     1,     1,     1,     1,     1,     1,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,
+};
+
+// 1 / (1 + exp(-k/16)), k = 0..256, Q15 (sigmoid MFs; negative side by symmetry)
+static const uint16_t s_logistic_q15[FUZZY_Q_LUT_SIZE] = {
+    16384, 16896, 17407, 17916, 18421, 18923, 19420, 19912, 20397, 20874, 21344, 21804,
+    22255, 22696, 23127, 23547, 23955, 24352, 24737, 25110, 25471, 25819, 26155, 26479,
+    26790, 27090, 27377, 27653, 27917, 28169, 28411, 28642, 28862, 29072, 29272, 29462,
+    29644, 29816, 29979, 30135, 30282, 30422, 30555, 30680, 30799, 30912, 31018, 31119,
+    31214, 31304, 31389, 31469, 31545, 31616, 31684, 31747, 31807, 31864, 31917, 31968,
+    32015, 32060, 32102, 32141, 32179, 32214, 32247, 32278, 32307, 32335, 32361, 32385,
+    32408, 32430, 32450, 32469, 32487, 32504, 32520, 32535, 32549, 32562, 32574, 32586,
+    32597, 32607, 32617, 32626, 32635, 32643, 32650, 32657, 32664, 32670, 32676, 32682,
+    32687, 32692, 32696, 32701, 32705, 32709, 32712, 32716, 32719, 32722, 32725, 32727,
+    32730, 32732, 32734, 32736, 32738, 32740, 32742, 32743, 32745, 32746, 32747, 32749,
+    32750, 32751, 32752, 32753, 32754, 32755, 32756, 32756, 32757, 32758, 32758, 32759,
+    32759, 32760, 32760, 32761, 32761, 32762, 32762, 32762, 32763, 32763, 32763, 32764,
+    32764, 32764, 32764, 32765, 32765, 32765, 32765, 32765, 32766, 32766, 32766, 32766,
+    32766, 32766, 32766, 32766, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+    32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767, 32768, 32768,
+    32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768,
+    32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768,
+    32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768,
+    32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768,
+    32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768,
+    32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768,
+    32768, 32768, 32768, 32768, 32768,
+};
+
+// Linear interpolation in a k/16 table; arg is Q12 (1/16 = 256)
+static uint16_t lutQ15(const uint16_t* lut, uint32_t arg_q12) {
+    if (arg_q12 >= ((uint32_t)(FUZZY_Q_LUT_SIZE - 1) << 8)) return lut[FUZZY_Q_LUT_SIZE - 1];
+    uint32_t i = arg_q12 >> 8;
+    uint32_t f = arg_q12 & 0xFF;
+    return (uint16_t)((lut[i] * (256 - f) + lut[i + 1] * f + 128) >> 8);
+}
+
+int32_t fuzzy_to_q16(float v) {
+    float q = v * (float)FUZZY_Q16_ONE;
+    if (q >= 2147483520.0f) return INT32_MAX;
+    if (q <= -2147483520.0f) return INT32_MIN;
+    return (int32_t)lroundf(q);
+}
+
+// ============================================================================
+// CONSTRUCTOR / LOADING
+// ============================================================================
+
+FuzzyFixed::FuzzyFixed()
+    : _loaded(false)
+{
+    memset(&_t, 0, sizeof(_t));
+}
+
+bool FuzzyFixed::load(const FuzzyController& src) {
+    memset(&_t, 0, sizeof(_t));
+
+    for (uint8_t v = 0; v < FUZZY_MAX_INPUTS + FUZZY_MAX_OUTPUTS; v++) {
+        bool is_input = v < FUZZY_MAX_INPUTS;
+        const linguistic_var_t& fv = is_input ? src.getInputVar(v) : src.getOutputVar(v - FUZZY_MAX_INPUTS);
+        fuzzy_fixed_var_t& qv = is_input ? _t.inputs[v] : _t.outputs[v - FUZZY_MAX_INPUTS];
+
+        qv.min_value = fuzzy_to_q16(fv.min_value);
+        qv.max_value = fuzzy_to_q16(fv.max_value);
+        qv.num_sets = min(fv.num_sets, (uint8_t)FUZZY_MAX_SETS);
+        for (uint8_t s = 0; s < qv.num_sets; s++) {
+            qv.sets[s].type = (uint8_t)fv.sets[s].type;
+            for (uint8_t k = 0; k < 4; k++) qv.sets[s].params[k] = fuzzy_to_q16(fv.sets[s].params[k]);
+        }
+    }
+
+    _t.num_rules = src.getRuleCount();
+    for (uint8_t r = 0; r < _t.num_rules; r++) {
+        const fuzzy_rule_t& fr = src.getRule(r);
+        fuzzy_fixed_rule_t& qr = _t.rules[r];
+        memcpy(qr.antecedent, fr.antecedent, sizeof(qr.antecedent));
+        memcpy(qr.consequent, fr.consequent, sizeof(qr.consequent));
+        float w = constrain(fr.weight, 0.0f, 1.0f);
+        qr.weight = (uint16_t)lroundf(w * FUZZY_Q15_ONE);
+        qr.enabled = fr.enabled;
+    }
+
+    sampleOutputSets();
+    _loaded = _t.num_rules > 0;
+    return _loaded;
+}
+
+bool FuzzyFixed::loadTables(const fuzzy_fixed_tables_t& tables) {
+    if (tables.num_rules == 0 || tables.num_rules > FUZZY_MAX_RULES) return false;
+    memcpy(&_t, &tables, sizeof(_t));
+    _loaded = true;
+    return true;
+}
+
+void FuzzyFixed::sampleOutputSets() {
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+        const fuzzy_fixed_var_t& var = _t.outputs[o];
+        int64_t span = (int64_t)var.max_value - var.min_value;
+        for (uint8_t s = 0; s < var.num_sets; s++) {
+            for (int k = 0; k < FUZZY_RESOLUTION; k++) {
+                int32_t x = var.min_value + (int32_t)(span * k / (FUZZY_RESOLUTION - 1));
+                _t.out_mf[o][s][k] = evaluateMF(var.sets[s], x);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// MEMBERSHIP FUNCTION EVALUATION
+// ============================================================================
+
+// Same breakpoint tests as FuzzyController::evaluateMF(), so zero-width edges never divide
+uint16_t FuzzyFixed::evaluateMF(const fuzzy_fixed_mf_t& mf, int32_t x) {
+    const int32_t* p = mf.params;
+
+    switch (mf.type) {
+        case MF_TRIANGULAR:
+            if (x <= p[0] || x >= p[2]) return 0;
+            if (x <= p[1]) return (uint16_t)((((int64_t)x - p[0]) << 15) / ((int64_t)p[1] - p[0]));
+            return (uint16_t)((((int64_t)p[2] - x) << 15) / ((int64_t)p[2] - p[1]));
+
+        case MF_TRAPEZOIDAL:
+            if (x <= p[0] || x >= p[3]) return 0;
+            if (x >= p[1] && x <= p[2]) return FUZZY_Q15_ONE;
+            if (x < p[1]) return (uint16_t)((((int64_t)x - p[0]) << 15) / ((int64_t)p[1] - p[0]));
+            return (uint16_t)((((int64_t)p[3] - x) << 15) / ((int64_t)p[3] - p[2]));
+
+        case MF_GAUSSIAN: {
+            if (p[1] <= 0) return 0;
+            // |t| = |x - c| / sigma in Q12, exp(-t^2 / 2) from the table (0 beyond |t| = 5.6).
+            // The shift takes the magnitude: shifting a negative value is undefined
+            int64_t d = (int64_t)x - p[0];
+            int64_t t = ((d < 0 ? -d : d) << 12) / p[1];
+            if (t > (6 << 12)) return 0;
+            return lutQ15(s_exp_neg_q15, (uint32_t)((t * t) >> 13));
+        }
+
+        case MF_SIGMOID_LEFT:
+        case MF_SIGMOID_RIGHT: {
+            // z = slope * (x - c) in Q12; left sigmoid is logistic(-z)
+            int64_t z = ((int64_t)p[1] * ((int64_t)x - p[0])) >> 20;
+            if (mf.type == MF_SIGMOID_LEFT) z = -z;
+            if (z > (16 << 12)) z = 16 << 12;
+            if (z < -(16 << 12)) z = -(16 << 12);
+            if (z >= 0) return lutQ15(s_logistic_q15, (uint32_t)z);
+            return (uint16_t)(FUZZY_Q15_ONE - lutQ15(s_logistic_q15, (uint32_t)(-z)));
+        }
+
+        case MF_SINGLETON: {
+            int64_t d = (int64_t)x - p[0];
+            return (d > -66 && d < 66) ? FUZZY_Q15_ONE : 0;   // |d| < 0.001
+        }
+
+        default:
+            return 0;
+    }
+}
+
+uint16_t FuzzyFixed::getMembership(uint8_t var_idx, uint8_t set_idx, int32_t value_q16) const {
+    if (var_idx >= FUZZY_MAX_INPUTS || set_idx >= _t.inputs[var_idx].num_sets) return 0;
+    return evaluateMF(_t.inputs[var_idx].sets[set_idx], value_q16);
+}
+
+// ============================================================================
+// INFERENCE
+// ============================================================================
+
+fuzzy_result_q_t FuzzyFixed::evaluate(const fuzzy_inputs_q_t& inputs) const {
+    fuzzy_result_q_t result;
+    memset(&result, 0, sizeof(result));
+    if (!_loaded) return result;
+
+    // Step 1: Fuzzify (unknown inputs read as "Normal")
+    uint16_t mu[FUZZY_MAX_INPUTS][FUZZY_MAX_SETS];
+    memset(mu, 0, sizeof(mu));
+    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+        const fuzzy_fixed_var_t& var = _t.inputs[i];
+        if (!(inputs.valid_mask & (1u << i))) {
+            mu[i][2] = FUZZY_Q15_ONE;
+            continue;
+        }
+        for (uint8_t s = 0; s < var.num_sets; s++) mu[i][s] = evaluateMF(var.sets[s], inputs.value[i]);
+    }
+
+    // Step 2: Rules (MIN of antecedents x weight), strongest firing per output term
+    uint16_t clip[FUZZY_MAX_OUTPUTS][FUZZY_MAX_SETS];
+    memset(clip, 0, sizeof(clip));
+
+    for (uint8_t r = 0; r < _t.num_rules; r++) {
+        const fuzzy_fixed_rule_t& rule = _t.rules[r];
+        if (!rule.enabled) continue;
+
+        uint32_t strength = FUZZY_Q15_ONE;
+        for (uint8_t i = 0; i < FUZZY_MAX_INPUTS && strength > 0; i++) {
+            uint8_t term = rule.antecedent[i];
+            if (term == DONT_CARE || term >= _t.inputs[i].num_sets) continue;
+            if (mu[i][term] < strength) strength = mu[i][term];
+        }
+        strength = (strength * rule.weight) >> 15;
+        if (strength < FUZZY_Q15_MIN_FIRING) continue;
+
+        result.active_rules++;
+        if (strength > result.max_firing_strength) {
+            result.max_firing_strength = (uint16_t)strength;
+            result.dominant_rule = r;
+        }
+
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+            uint8_t term = rule.consequent[o];
+            if (term == DONT_CARE || term >= _t.outputs[o].num_sets) continue;
+            if (strength > clip[o][term]) clip[o][term] = (uint16_t)strength;
+        }
+    }
+
+    // Step 3: Integer centroid over the sampled, clipped, MAX-aggregated output sets
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+        const fuzzy_fixed_var_t& var = _t.outputs[o];
+        uint32_t sum_mu = 0;
+        uint32_t sum_k_mu = 0;      // <= 32768 * 5050 for 101 samples
+
+        for (int k = 0; k < FUZZY_RESOLUTION; k++) {
+            uint16_t agg = 0;
+            for (uint8_t t = 0; t < var.num_sets; t++) {
+                if (clip[o][t] == 0) continue;
+                uint16_t m = min(_t.out_mf[o][t][k], clip[o][t]);
+                if (m > agg) agg = m;
+            }
+            sum_mu += agg;
+            sum_k_mu += (uint32_t)agg * k;
+        }
+
+        if (sum_mu < FUZZY_Q15_MIN_FIRING) continue;   // Rate stays 0
+
+        int64_t span = (int64_t)var.max_value - var.min_value;
+        int64_t den = (int64_t)sum_mu * (FUZZY_RESOLUTION - 1);
+        result.rate[o] = var.min_value + (int32_t)((span * sum_k_mu + den / 2) / den);
+    }
+
+    return result;
+}
+
+// ============================================================================
+// CONVERSION HELPERS
+// ============================================================================
+
+void FuzzyFixed::inputsFromController(const FuzzyController& src, const fuzzy_inputs_t& inputs,
+                                      fuzzy_inputs_q_t* out) {
+    memset(out, 0, sizeof(*out));
+    for (uint8_t i = FUZZY_IN_TDS; i <= FUZZY_IN_PH; i++) {
+        float v = 0.0f;
+        bool valid = false;
+        src.getManualInput((fuzzy_input_t)i, &v, &valid);
+        out->value[i] = fuzzy_to_q16(v);
+        if (valid) out->valid_mask |= (uint8_t)(1u << i);
+    }
+    out->value[FUZZY_IN_TEMPERATURE] = fuzzy_to_q16(inputs.temperature);
+    out->value[FUZZY_IN_TREND] = fuzzy_to_q16(inputs.cond_trend);
+    out->valid_mask |= (1u << FUZZY_IN_TEMPERATURE) | (1u << FUZZY_IN_TREND);
+}
+
+fuzzy_result_t FuzzyFixed::toFloat(const fuzzy_result_q_t& r) {
+    fuzzy_result_t f;
+    memset(&f, 0, sizeof(f));
+    f.blowdown_rate = fuzzy_q16_to_float(r.rate[FUZZY_OUT_BLOWDOWN]);
+    f.caustic_rate = fuzzy_q16_to_float(r.rate[FUZZY_OUT_CAUSTIC]);
+    f.sulfite_rate = fuzzy_q16_to_float(r.rate[FUZZY_OUT_SULFITE]);
+    f.acid_rate = fuzzy_q16_to_float(r.rate[FUZZY_OUT_ACID]);
+    f.max_firing_strength = (float)r.max_firing_strength / FUZZY_Q15_ONE;
+    f.active_rules = r.active_rules;
+    f.dominant_rule = r.dominant_rule;
+    return f;
+}
@@ -13,317 +13,356 @@
 FuzzyController fuzzyController;
 
 // ============================================================================
-// CONSTRUCTOR
-// ============================================================================
-
-FuzzyController::FuzzyController()
-    : _config(nullptr)
-    , _num_rules(0)
-{
-    memset(_input_membership, 0, sizeof(_input_membership));
-    memset(_manual_values, 0, sizeof(_manual_values));
-    memset(_manual_valid, 0, sizeof(_manual_valid));
-}
-
-// ============================================================================
-// INITIALIZATION
-// ============================================================================
-
-bool FuzzyController::begin(fuzzy_config_t* config) {
-    if (!config) return false;
-
-    _config = config;
-
-    // Initialize linguistic variables
-    initInputVariables();
-    initOutputVariables();
-
-    // Update membership functions based on config setpoints
-    updateMembershipFunctions();
-
-    // Load default rule base
-    loadDefaultRules();
-
-    Serial.println("FuzzyController initialized");
-    Serial.printf("  Rules: %d\n", _num_rules);
-
-    return true;
-}
-
-// ============================================================================
-// INPUT VARIABLE INITIALIZATION
+// STATIC TABLES (flash)
 // ============================================================================
+// constexpr tables land in .rodata, which the ESP32 reads straight from flash:
+// nothing below is built at boot or copied to DRAM. The TDS, alkalinity, sulfite
+// and pH entries only carry range, set types and names; FuzzyController copies
+// them to RAM and updateMembershipFunctions() fills in the setpoint-dependent
+// breakpoints.
 
-void FuzzyController::initInputVariables() {
+static constexpr linguistic_var_t s_input_vars[FUZZY_MAX_INPUTS] = {
     // TDS (ppm) - manual entry, typical range 500-3000 for boilers
-    _inputs[FUZZY_IN_TDS].name = "TDS";
-    _inputs[FUZZY_IN_TDS].min_value = 0;
-    _inputs[FUZZY_IN_TDS].max_value = 5000;
-    _inputs[FUZZY_IN_TDS].num_sets = 5;
+    {"TDS", 0, 5000, 5, {
+        {MF_TRAPEZOIDAL, {}, "VeryLow"},
+        {MF_TRIANGULAR, {}, "Low"},
+        {MF_TRIANGULAR, {}, "Normal"},
+        {MF_TRIANGULAR, {}, "High"},
+        {MF_TRAPEZOIDAL, {}, "VeryHigh"}}},
 
     // ALKALINITY (ppm as CaCO3) - typical range 100-700
-    _inputs[FUZZY_IN_ALKALINITY].name = "Alkalinity";
-    _inputs[FUZZY_IN_ALKALINITY].min_value = 0;
-    _inputs[FUZZY_IN_ALKALINITY].max_value = 1000;
-    _inputs[FUZZY_IN_ALKALINITY].num_sets = 5;
+    {"Alkalinity", 0, 1000, 5, {
+        {MF_TRAPEZOIDAL, {}, "VeryLow"},
+        {MF_TRIANGULAR, {}, "Low"},
+        {MF_TRIANGULAR, {}, "Normal"},
+        {MF_TRIANGULAR, {}, "High"},
+        {MF_TRAPEZOIDAL, {}, "VeryHigh"}}},
 
     // SULFITE (ppm SO3) - typical range 20-60
-    _inputs[FUZZY_IN_SULFITE].name = "Sulfite";
-    _inputs[FUZZY_IN_SULFITE].min_value = 0;
-    _inputs[FUZZY_IN_SULFITE].max_value = 100;
-    _inputs[FUZZY_IN_SULFITE].num_sets = 5;
+    {"Sulfite", 0, 100, 5, {
+        {MF_TRAPEZOIDAL, {}, "VeryLow"},
+        {MF_TRIANGULAR, {}, "Low"},
+        {MF_TRIANGULAR, {}, "Normal"},
+        {MF_TRIANGULAR, {}, "High"},
+        {MF_TRAPEZOIDAL, {}, "VeryHigh"}}},
 
     // PH - typical range 10.5-11.5 for boilers
-    _inputs[FUZZY_IN_PH].name = "pH";
-    _inputs[FUZZY_IN_PH].min_value = 7.0;
-    _inputs[FUZZY_IN_PH].max_value = 14.0;
-    _inputs[FUZZY_IN_PH].num_sets = 5;
-
-    // TEMPERATURE (°C)
-    _inputs[FUZZY_IN_TEMPERATURE].name = "Temperature";
-    _inputs[FUZZY_IN_TEMPERATURE].min_value = 0;
-    _inputs[FUZZY_IN_TEMPERATURE].max_value = 100;
-    _inputs[FUZZY_IN_TEMPERATURE].num_sets = 3;
-
-    // TREND (rate of change)
-    _inputs[FUZZY_IN_TREND].name = "Trend";
-    _inputs[FUZZY_IN_TREND].min_value = -100;
-    _inputs[FUZZY_IN_TREND].max_value = 100;
-    _inputs[FUZZY_IN_TREND].num_sets = 5;
-}
-
-// ============================================================================
-// OUTPUT VARIABLE INITIALIZATION
-// ============================================================================
-
-void FuzzyController::initOutputVariables() {
-    // BLOWDOWN (0-100%)
-    _outputs[FUZZY_OUT_BLOWDOWN].name = "Blowdown";
-    _outputs[FUZZY_OUT_BLOWDOWN].min_value = 0;
-    _outputs[FUZZY_OUT_BLOWDOWN].max_value = 100;
-    _outputs[FUZZY_OUT_BLOWDOWN].num_sets = 5;
-
-    // Triangular membership functions for output
-    _outputs[FUZZY_OUT_BLOWDOWN].sets[0] = {MF_TRIANGULAR, {0, 0, 25}, "Zero"};
-    _outputs[FUZZY_OUT_BLOWDOWN].sets[1] = {MF_TRIANGULAR, {0, 25, 50}, "Low"};
-    _outputs[FUZZY_OUT_BLOWDOWN].sets[2] = {MF_TRIANGULAR, {25, 50, 75}, "Medium"};
-    _outputs[FUZZY_OUT_BLOWDOWN].sets[3] = {MF_TRIANGULAR, {50, 75, 100}, "High"};
-    _outputs[FUZZY_OUT_BLOWDOWN].sets[4] = {MF_TRIANGULAR, {75, 100, 100}, "VeryHigh"};
-
-    // CAUSTIC/NaOH (0-100%)
-    _outputs[FUZZY_OUT_CAUSTIC].name = "Caustic";
-    _outputs[FUZZY_OUT_CAUSTIC].min_value = 0;
-    _outputs[FUZZY_OUT_CAUSTIC].max_value = 100;
-    _outputs[FUZZY_OUT_CAUSTIC].num_sets = 5;
-
-    _outputs[FUZZY_OUT_CAUSTIC].sets[0] = {MF_TRIANGULAR, {0, 0, 25}, "Zero"};
-    _outputs[FUZZY_OUT_CAUSTIC].sets[1] = {MF_TRIANGULAR, {0, 25, 50}, "Low"};
-    _outputs[FUZZY_OUT_CAUSTIC].sets[2] = {MF_TRIANGULAR, {25, 50, 75}, "Medium"};
-    _outputs[FUZZY_OUT_CAUSTIC].sets[3] = {MF_TRIANGULAR, {50, 75, 100}, "High"};
-    _outputs[FUZZY_OUT_CAUSTIC].sets[4] = {MF_TRIANGULAR, {75, 100, 100}, "VeryHigh"};
-
-    // SULFITE (0-100%)
-    _outputs[FUZZY_OUT_SULFITE].name = "Sulfite";
-    _outputs[FUZZY_OUT_SULFITE].min_value = 0;
-    _outputs[FUZZY_OUT_SULFITE].max_value = 100;
-    _outputs[FUZZY_OUT_SULFITE].num_sets = 5;
-
-    _outputs[FUZZY_OUT_SULFITE].sets[0] = {MF_TRIANGULAR, {0, 0, 25}, "Zero"};
-    _outputs[FUZZY_OUT_SULFITE].sets[1] = {MF_TRIANGULAR, {0, 25, 50}, "Low"};
-    _outputs[FUZZY_OUT_SULFITE].sets[2] = {MF_TRIANGULAR, {25, 50, 75}, "Medium"};
-    _outputs[FUZZY_OUT_SULFITE].sets[3] = {MF_TRIANGULAR, {50, 75, 100}, "High"};
-    _outputs[FUZZY_OUT_SULFITE].sets[4] = {MF_TRIANGULAR, {75, 100, 100}, "VeryHigh"};
-
-    // ACID (0-100%)
-    _outputs[FUZZY_OUT_ACID].name = "Acid";
-    _outputs[FUZZY_OUT_ACID].min_value = 0;
-    _outputs[FUZZY_OUT_ACID].max_value = 100;
-    _outputs[FUZZY_OUT_ACID].num_sets = 5;
-
-    _outputs[FUZZY_OUT_ACID].sets[0] = {MF_TRIANGULAR, {0, 0, 25}, "Zero"};
-    _outputs[FUZZY_OUT_ACID].sets[1] = {MF_TRIANGULAR, {0, 25, 50}, "Low"};
-    _outputs[FUZZY_OUT_ACID].sets[2] = {MF_TRIANGULAR, {25, 50, 75}, "Medium"};
-    _outputs[FUZZY_OUT_ACID].sets[3] = {MF_TRIANGULAR, {50, 75, 100}, "High"};
-    _outputs[FUZZY_OUT_ACID].sets[4] = {MF_TRIANGULAR, {75, 100, 100}, "VeryHigh"};
-}
-
-// ============================================================================
-// UPDATE MEMBERSHIP FUNCTIONS BASED ON CONFIG
-// ============================================================================
-
-void FuzzyController::updateMembershipFunctions() {
-    if (!_config) return;
-
-    float sp, db, db_eff;
-
-    // TDS membership functions (centered on setpoint)
-    // Note: Config uses cond_setpoint for TDS target (ppm)
-    sp = _config->cond_setpoint;
-    db = _config->cond_deadband;
-    db_eff = (db * 2.0f > 1.0f) ? db : 0.5f;  // Avoid degenerate Normal triangle
-
-    _inputs[FUZZY_IN_TDS].sets[0] = {MF_TRAPEZOIDAL, {0, 0, sp*0.5f, sp*0.7f}, "VeryLow"};
-    _inputs[FUZZY_IN_TDS].sets[1] = {MF_TRIANGULAR, {sp*0.5f, sp*0.75f, sp-db_eff}, "Low"};
-    _inputs[FUZZY_IN_TDS].sets[2] = {MF_TRIANGULAR, {sp-db_eff*2, sp, sp+db_eff*2}, "Normal"};
-    _inputs[FUZZY_IN_TDS].sets[3] = {MF_TRIANGULAR, {sp+db_eff, sp*1.25f, sp*1.5f}, "High"};
-    _inputs[FUZZY_IN_TDS].sets[4] = {MF_TRAPEZOIDAL, {sp*1.3f, sp*1.5f, 5000, 5000}, "VeryHigh"};
-
-    // ALKALINITY membership functions
-    sp = _config->alk_setpoint;
-    db = _config->alk_deadband;
-    db_eff = (db * 2.0f > 1.0f) ? db : 0.5f;
-
-    _inputs[FUZZY_IN_ALKALINITY].sets[0] = {MF_TRAPEZOIDAL, {0, 0, sp*0.3f, sp*0.5f}, "VeryLow"};
-    _inputs[FUZZY_IN_ALKALINITY].sets[1] = {MF_TRIANGULAR, {sp*0.4f, sp*0.6f, sp-db_eff}, "Low"};
-    _inputs[FUZZY_IN_ALKALINITY].sets[2] = {MF_TRIANGULAR, {sp-db_eff*2, sp, sp+db_eff*2}, "Normal"};
-    _inputs[FUZZY_IN_ALKALINITY].sets[3] = {MF_TRIANGULAR, {sp+db_eff, sp*1.4f, sp*1.8f}, "High"};
-    _inputs[FUZZY_IN_ALKALINITY].sets[4] = {MF_TRAPEZOIDAL, {sp*1.5f, sp*2.0f, 1000, 1000}, "VeryHigh"};
-
-    // SULFITE membership functions
-    sp = _config->sulfite_setpoint;
-    db = _config->sulfite_deadband;
-    db_eff = (db * 2.0f > 0.5f) ? db : 0.25f;
-
-    _inputs[FUZZY_IN_SULFITE].sets[0] = {MF_TRAPEZOIDAL, {0, 0, sp*0.2f, sp*0.4f}, "VeryLow"};
-    _inputs[FUZZY_IN_SULFITE].sets[1] = {MF_TRIANGULAR, {sp*0.3f, sp*0.5f, sp-db_eff}, "Low"};
-    _inputs[FUZZY_IN_SULFITE].sets[2] = {MF_TRIANGULAR, {sp-db_eff*2, sp, sp+db_eff*2}, "Normal"};
-    _inputs[FUZZY_IN_SULFITE].sets[3] = {MF_TRIANGULAR, {sp+db_eff, sp*1.5f, sp*2.0f}, "High"};
-    _inputs[FUZZY_IN_SULFITE].sets[4] = {MF_TRAPEZOIDAL, {sp*1.8f, sp*2.5f, 100, 100}, "VeryHigh"};
-
-    // PH membership functions
-    sp = _config->ph_setpoint;
-    db = _config->ph_deadband;
-    db_eff = (db * 2.0f > 0.05f) ? db : 0.025f;
-
-    _inputs[FUZZY_IN_PH].sets[0] = {MF_TRAPEZOIDAL, {7.0f, 7.0f, 9.0f, 10.0f}, "Low"};
-    _inputs[FUZZY_IN_PH].sets[1] = {MF_TRIANGULAR, {9.5f, 10.5f, sp-db_eff}, "SlightlyLow"};
-    _inputs[FUZZY_IN_PH].sets[2] = {MF_TRIANGULAR, {sp-db_eff, sp, sp+db_eff}, "Normal"};
-    _inputs[FUZZY_IN_PH].sets[3] = {MF_TRIANGULAR, {sp+db_eff, 12.0f, 12.5f}, "SlightlyHigh"};
-    _inputs[FUZZY_IN_PH].sets[4] = {MF_TRAPEZOIDAL, {12.0f, 12.5f, 14.0f, 14.0f}, "High"};
-
-    // TEMPERATURE (simple 3-set)
-    _inputs[FUZZY_IN_TEMPERATURE].sets[0] = {MF_TRAPEZOIDAL, {0, 0, 20, 40}, "Cold"};
-    _inputs[FUZZY_IN_TEMPERATURE].sets[1] = {MF_TRIANGULAR, {30, 50, 70}, "Warm"};
-    _inputs[FUZZY_IN_TEMPERATURE].sets[2] = {MF_TRAPEZOIDAL, {60, 80, 100, 100}, "Hot"};
+    {"pH", 7.0f, 14.0f, 5, {
+        {MF_TRAPEZOIDAL, {}, "Low"},
+        {MF_TRIANGULAR, {}, "SlightlyLow"},
+        {MF_TRIANGULAR, {}, "Normal"},
+        {MF_TRIANGULAR, {}, "SlightlyHigh"},
+        {MF_TRAPEZOIDAL, {}, "High"}}},
+
+    // TEMPERATURE (°C, simple 3-set)
+    {"Temperature", 0, 100, 3, {
+        {MF_TRAPEZOIDAL, {0, 0, 20, 40}, "Cold"},
+        {MF_TRIANGULAR, {30, 50, 70}, "Warm"},
+        {MF_TRAPEZOIDAL, {60, 80, 100, 100}, "Hot"}}},
 
     // TREND (rate of change)
-    _inputs[FUZZY_IN_TREND].sets[0] = {MF_TRAPEZOIDAL, {-100, -100, -30, -10}, "Decreasing"};
-    _inputs[FUZZY_IN_TREND].sets[1] = {MF_TRIANGULAR, {-20, -5, 0}, "SlightDecrease"};
-    _inputs[FUZZY_IN_TREND].sets[2] = {MF_TRIANGULAR, {-5, 0, 5}, "Stable"};
-    _inputs[FUZZY_IN_TREND].sets[3] = {MF_TRIANGULAR, {0, 5, 20}, "SlightIncrease"};
-    _inputs[FUZZY_IN_TREND].sets[4] = {MF_TRAPEZOIDAL, {10, 30, 100, 100}, "Increasing"};
-}
-
-// ============================================================================
-// DEFAULT RULE BASE
-// ============================================================================
-
-void FuzzyController::loadDefaultRules() {
-    _num_rules = 0;
-
-    // Rule format: {antecedent[6], consequent[4], weight, enabled}
-    // Antecedent: [Cond, Alk, Sulfite, pH, Temp, Trend]
-    // Consequent: [Blowdown, Caustic, Sulfite, Acid]
-    // DC = Don't Care (255)
-
+    {"Trend", -100, 100, 5, {
+        {MF_TRAPEZOIDAL, {-100, -100, -30, -10}, "Decreasing"},
+        {MF_TRIANGULAR, {-20, -5, 0}, "SlightDecrease"},
+        {MF_TRIANGULAR, {-5, 0, 5}, "Stable"},
+        {MF_TRIANGULAR, {0, 5, 20}, "SlightIncrease"},
+        {MF_TRAPEZOIDAL, {10, 30, 100, 100}, "Increasing"}}},
+};
+
+// Triangular output sets, same for every output (0-100%)
+#define FUZZY_OUTPUT_SETS { \
+    {MF_TRIANGULAR, {0, 0, 25}, "Zero"}, \
+    {MF_TRIANGULAR, {0, 25, 50}, "Low"}, \
+    {MF_TRIANGULAR, {25, 50, 75}, "Medium"}, \
+    {MF_TRIANGULAR, {50, 75, 100}, "High"}, \
+    {MF_TRIANGULAR, {75, 100, 100}, "VeryHigh"}}
+
+static constexpr linguistic_var_t s_output_vars[FUZZY_MAX_OUTPUTS] = {
+    {"Blowdown", 0, 100, 5, FUZZY_OUTPUT_SETS},
+    {"Caustic", 0, 100, 5, FUZZY_OUTPUT_SETS},      // NaOH
+    {"Sulfite", 0, 100, 5, FUZZY_OUTPUT_SETS},
+    {"Acid", 0, 100, 5, FUZZY_OUTPUT_SETS},
+};
+
+// Rule format: {antecedent[6], consequent[4], weight, enabled}
+// Antecedent: [Cond, Alk, Sulfite, pH, Temp, Trend]
+// Consequent: [Blowdown, Caustic, Sulfite, Acid]
+// DC = Don't Care (255)
+static constexpr fuzzy_rule_t s_default_rules[] = {
     // ========================================
     // CONDUCTIVITY/TDS RULES (Blowdown control)
     // ========================================
 
     // Rule 1: IF Conductivity is VeryHigh THEN Blowdown is VeryHigh
-    _rules[_num_rules++] = {{VH, DC, DC, DC, DC, DC}, {VH, DC, DC, DC}, 1.0f, true};
+    {{VH, DC, DC, DC, DC, DC}, {VH, DC, DC, DC}, 1.0f, true},
 
     // Rule 2: IF Conductivity is High THEN Blowdown is High
-    _rules[_num_rules++] = {{HI, DC, DC, DC, DC, DC}, {HI, DC, DC, DC}, 1.0f, true};
+    {{HI, DC, DC, DC, DC, DC}, {HI, DC, DC, DC}, 1.0f, true},
 
     // Rule 3: IF Conductivity is Normal THEN Blowdown is Zero
-    _rules[_num_rules++] = {{MD, DC, DC, DC, DC, DC}, {VL, DC, DC, DC}, 1.0f, true};
+    {{MD, DC, DC, DC, DC, DC}, {VL, DC, DC, DC}, 1.0f, true},
 
     // Rule 4: IF Conductivity is Low THEN Blowdown is Zero
-    _rules[_num_rules++] = {{LO, DC, DC, DC, DC, DC}, {VL, DC, DC, DC}, 1.0f, true};
+    {{LO, DC, DC, DC, DC, DC}, {VL, DC, DC, DC}, 1.0f, true},
 
     // Rule 5: IF Conductivity is High AND Trend is Increasing THEN Blowdown is VeryHigh
-    _rules[_num_rules++] = {{HI, DC, DC, DC, DC, VH}, {VH, DC, DC, DC}, 1.0f, true};
+    {{HI, DC, DC, DC, DC, VH}, {VH, DC, DC, DC}, 1.0f, true},
 
     // ========================================
     // ALKALINITY RULES (Caustic control)
     // ========================================
 
     // Rule 6: IF Alkalinity is VeryLow THEN Caustic is VeryHigh
-    _rules[_num_rules++] = {{DC, VL, DC, DC, DC, DC}, {DC, VH, DC, DC}, 1.0f, true};
+    {{DC, VL, DC, DC, DC, DC}, {DC, VH, DC, DC}, 1.0f, true},
 
     // Rule 7: IF Alkalinity is Low THEN Caustic is High
-    _rules[_num_rules++] = {{DC, LO, DC, DC, DC, DC}, {DC, HI, DC, DC}, 1.0f, true};
+    {{DC, LO, DC, DC, DC, DC}, {DC, HI, DC, DC}, 1.0f, true},
 
     // Rule 8: IF Alkalinity is Normal THEN Caustic is Zero
-    _rules[_num_rules++] = {{DC, MD, DC, DC, DC, DC}, {DC, VL, DC, DC}, 1.0f, true};
+    {{DC, MD, DC, DC, DC, DC}, {DC, VL, DC, DC}, 1.0f, true},
 
     // Rule 9: IF Alkalinity is High THEN Caustic is Zero, Blowdown is Medium
-    _rules[_num_rules++] = {{DC, HI, DC, DC, DC, DC}, {MD, VL, DC, DC}, 0.8f, true};
+    {{DC, HI, DC, DC, DC, DC}, {MD, VL, DC, DC}, 0.8f, true},
 
     // Rule 10: IF Alkalinity is VeryHigh THEN Caustic is Zero, Blowdown is High
-    _rules[_num_rules++] = {{DC, VH, DC, DC, DC, DC}, {HI, VL, DC, DC}, 0.9f, true};
+    {{DC, VH, DC, DC, DC, DC}, {HI, VL, DC, DC}, 0.9f, true},
 
     // ========================================
     // SULFITE RULES (Oxygen scavenger control)
     // ========================================
 
     // Rule 11: IF Sulfite is VeryLow THEN Sulfite dosing is VeryHigh
-    _rules[_num_rules++] = {{DC, DC, VL, DC, DC, DC}, {DC, DC, VH, DC}, 1.0f, true};
+    {{DC, DC, VL, DC, DC, DC}, {DC, DC, VH, DC}, 1.0f, true},
 
     // Rule 12: IF Sulfite is Low THEN Sulfite dosing is High
-    _rules[_num_rules++] = {{DC, DC, LO, DC, DC, DC}, {DC, DC, HI, DC}, 1.0f, true};
+    {{DC, DC, LO, DC, DC, DC}, {DC, DC, HI, DC}, 1.0f, true},
 
     // Rule 13: IF Sulfite is Normal THEN Sulfite dosing is Low (maintenance)
-    _rules[_num_rules++] = {{DC, DC, MD, DC, DC, DC}, {DC, DC, LO, DC}, 1.0f, true};
+    {{DC, DC, MD, DC, DC, DC}, {DC, DC, LO, DC}, 1.0f, true},
 
     // Rule 14: IF Sulfite is High THEN Sulfite dosing is Zero
-    _rules[_num_rules++] = {{DC, DC, HI, DC, DC, DC}, {DC, DC, VL, DC}, 1.0f, true};
+    {{DC, DC, HI, DC, DC, DC}, {DC, DC, VL, DC}, 1.0f, true},
 
     // Rule 15: IF Sulfite is VeryHigh THEN Sulfite dosing is Zero, Blowdown is Low
-    _rules[_num_rules++] = {{DC, DC, VH, DC, DC, DC}, {LO, DC, VL, DC}, 0.7f, true};
+    {{DC, DC, VH, DC, DC, DC}, {LO, DC, VL, DC}, 0.7f, true},
 
     // ========================================
     // pH RULES (Acid/Caustic balance)
     // ========================================
 
     // Rule 16: IF pH is Low THEN Caustic is High, Acid is Zero
-    _rules[_num_rules++] = {{DC, DC, DC, VL, DC, DC}, {DC, HI, DC, VL}, 1.0f, true};
+    {{DC, DC, DC, VL, DC, DC}, {DC, HI, DC, VL}, 1.0f, true},
 
     // Rule 17: IF pH is SlightlyLow THEN Caustic is Medium
-    _rules[_num_rules++] = {{DC, DC, DC, LO, DC, DC}, {DC, MD, DC, VL}, 0.8f, true};
+    {{DC, DC, DC, LO, DC, DC}, {DC, MD, DC, VL}, 0.8f, true},
 
     // Rule 18: IF pH is Normal THEN maintain (no action)
-    _rules[_num_rules++] = {{DC, DC, DC, MD, DC, DC}, {DC, VL, DC, VL}, 0.5f, true};
+    {{DC, DC, DC, MD, DC, DC}, {DC, VL, DC, VL}, 0.5f, true},
 
     // Rule 19: IF pH is SlightlyHigh THEN Acid is Low
-    _rules[_num_rules++] = {{DC, DC, DC, HI, DC, DC}, {DC, VL, DC, LO}, 0.7f, true};
+    {{DC, DC, DC, HI, DC, DC}, {DC, VL, DC, LO}, 0.7f, true},
 
     // Rule 20: IF pH is High THEN Acid is Medium, Caustic is Zero
-    _rules[_num_rules++] = {{DC, DC, DC, VH, DC, DC}, {DC, VL, DC, MD}, 0.9f, true};
+    {{DC, DC, DC, VH, DC, DC}, {DC, VL, DC, MD}, 0.9f, true},
 
     // ========================================
     // COMBINED RULES (Multi-parameter)
     // ========================================
 
     // Rule 21: IF Conductivity is High AND Alkalinity is High THEN Blowdown is VeryHigh
-    _rules[_num_rules++] = {{HI, HI, DC, DC, DC, DC}, {VH, VL, DC, DC}, 1.0f, true};
+    {{HI, HI, DC, DC, DC, DC}, {VH, VL, DC, DC}, 1.0f, true},
 
     // Rule 22: IF Conductivity is Low AND Alkalinity is Low THEN Caustic is High
-    _rules[_num_rules++] = {{LO, LO, DC, DC, DC, DC}, {VL, HI, DC, DC}, 0.9f, true};
+    {{LO, LO, DC, DC, DC, DC}, {VL, HI, DC, DC}, 0.9f, true},
 
     // Rule 23: IF Sulfite is Low AND Temperature is Hot THEN Sulfite is VeryHigh
     // (Hot water consumes sulfite faster)
-    _rules[_num_rules++] = {{DC, DC, LO, DC, HI, DC}, {DC, DC, VH, DC}, 1.0f, true};
+    {{DC, DC, LO, DC, HI, DC}, {DC, DC, VH, DC}, 1.0f, true},
 
     // Rule 24: IF Conductivity is Normal AND Alkalinity is Normal AND Sulfite is Normal
     // THEN all dosing minimal (system in balance)
-    _rules[_num_rules++] = {{MD, MD, MD, DC, DC, DC}, {VL, VL, LO, VL}, 1.0f, true};
+    {{MD, MD, MD, DC, DC, DC}, {VL, VL, LO, VL}, 1.0f, true},
 
     // Rule 25: IF Trend is Increasing rapidly THEN Blowdown preemptive increase
-    _rules[_num_rules++] = {{DC, DC, DC, DC, DC, VH}, {MD, DC, DC, DC}, 0.8f, true};
+    {{DC, DC, DC, DC, DC, VH}, {MD, DC, DC, DC}, 0.8f, true},
+};
+
+static constexpr uint8_t s_default_rule_count = sizeof(s_default_rules) / sizeof(s_default_rules[0]);
+static_assert(s_default_rule_count <= FUZZY_MAX_RULES, "default rule base exceeds FUZZY_MAX_RULES");
+static_assert(FUZZY_SETPOINT_INPUTS == FUZZY_IN_PH + 1, "setpoint-dependent inputs are TDS..pH");
+
+// ============================================================================
+// CONSTRUCTOR
+// ============================================================================
+
+FuzzyController::FuzzyController()
+    : _config(nullptr)
+    , _outputs(s_output_vars)
+    , _rb(&_banks[0])
+    , _rb_readers{}
+    , _rb_stage(RB_STAGE_FREE)
+    , _rb_swaps(0)
+    , _centroid_impl(FUZZY_CENTROID_ANALYTIC)
+    , _rule_index_enabled(true)
+    , _last_candidates(0)
+    , _cache_enabled(true)
+    , _cache_valid(false)
+    , _cache_mode(0)
+    , _trace(nullptr)
+    , _trace_depth(0)
+    , _trace_sample(0)
+    , _trace_skip(0)
+    , _trace_head(0)
+    , _surface(nullptr)
+    , _surface_next(nullptr)
+    , _surface_enabled(false)
+    , _surface_nodes(FUZZY_SURFACE_DEFAULT_NODES)
+    , _surface_max_err(FUZZY_SURFACE_DEFAULT_MAX_ERR)
+    , _derived_gen(0)
+    , _surface_gen(0)
+    , _cache_gen(0)
+    , _surface_built_derived(0)
+    , _surface_built_gen(0)
+    , _surface_built(false)
+    , _surface_ok(false)
+    , _surface_nt(0)
+    , _surface_nr(0)
+    , _surface_err(0)
+    , _surface_build_us(0)
+    , _surface_builds(0)
+{
+    memset(_banks, 0, sizeof(_banks));
+    memset(_rule_strength, 0, sizeof(_rule_strength));
+    memset(_input_norm, 0, sizeof(_input_norm));
+    memset(_input_membership, 0, sizeof(_input_membership));
+    memset(_manual_values, 0, sizeof(_manual_values));
+    memset(_manual_valid, 0, sizeof(_manual_valid));
+    memset(_cache_value, 0, sizeof(_cache_value));
+    memset(_cache_input_valid, 0, sizeof(_cache_input_valid));
+    memset(_cache_eps, 0, sizeof(_cache_eps));
+    memset(_rule_fired, 0, sizeof(_rule_fired));
+    memset(_cache_clip, 0, sizeof(_cache_clip));
+    memset(_cache_crisp, 0, sizeof(_cache_crisp));
+    memset(&_cache_stats, 0, sizeof(_cache_stats));
+
+    // Setpoint-dependent sets start from their flash template (breakpoints set by begin())
+    memcpy(_setpoint_vars, s_input_vars, sizeof(_setpoint_vars));
+    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+        _inputs[i] = (i < FUZZY_SETPOINT_INPUTS) ? &_setpoint_vars[i] : &s_input_vars[i];
+    }
+}
+
+// ============================================================================
+// INITIALIZATION
+// ============================================================================
+
+bool FuzzyController::begin(fuzzy_config_t* config) {
+    if (!config) return false;
+
+    _config = config;
+
+    // Update membership functions based on config setpoints (the rest is in flash)
+    updateMembershipFunctions();
+
+    // Load default rule base
+    loadDefaultRules();
+    invalidateDerived();
+
+    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+        _cache_eps[i] = FUZZY_CACHE_EPS_FRACTION * (_inputs[i]->max_value - _inputs[i]->min_value);
+    }
+
+    Serial.println("FuzzyController initialized");
+    Serial.printf("  Rules: %d\n", live()->num_rules);
+
+    return true;
+}
+
+// ============================================================================
+// UPDATE MEMBERSHIP FUNCTIONS BASED ON CONFIG
+// ============================================================================
+
+static void setBreakpoints(membership_func_t& mf, float a, float b, float c, float d = 0.0f) {
+    mf.params[0] = a;
+    mf.params[1] = b;
+    mf.params[2] = c;
+    mf.params[3] = d;
+}
+
+void FuzzyController::updateMembershipFunctions() {
+    if (!_config) return;
+
+    // Set types and names come from s_input_vars; only breakpoints are written here
+    float sp, db, db_eff;
+    membership_func_t* s;
+
+    // TDS membership functions (centered on setpoint)
+    // Note: Config uses cond_setpoint for TDS target (ppm)
+    sp = _config->cond_setpoint;
+    db = _config->cond_deadband;
+    db_eff = (db * 2.0f > 1.0f) ? db : 0.5f;  // Avoid degenerate Normal triangle
+
+    s = _setpoint_vars[FUZZY_IN_TDS].sets;
+    setBreakpoints(s[0], 0, 0, sp*0.5f, sp*0.7f);               // VeryLow
+    setBreakpoints(s[1], sp*0.5f, sp*0.75f, sp-db_eff);         // Low
+    setBreakpoints(s[2], sp-db_eff*2, sp, sp+db_eff*2);         // Normal
+    setBreakpoints(s[3], sp+db_eff, sp*1.25f, sp*1.5f);         // High
+    setBreakpoints(s[4], sp*1.3f, sp*1.5f, 5000, 5000);         // VeryHigh
+
+    // ALKALINITY membership functions
+    sp = _config->alk_setpoint;
+    db = _config->alk_deadband;
+    db_eff = (db * 2.0f > 1.0f) ? db : 0.5f;
+
+    s = _setpoint_vars[FUZZY_IN_ALKALINITY].sets;
+    setBreakpoints(s[0], 0, 0, sp*0.3f, sp*0.5f);               // VeryLow
+    setBreakpoints(s[1], sp*0.4f, sp*0.6f, sp-db_eff);          // Low
+    setBreakpoints(s[2], sp-db_eff*2, sp, sp+db_eff*2);         // Normal
+    setBreakpoints(s[3], sp+db_eff, sp*1.4f, sp*1.8f);          // High
+    setBreakpoints(s[4], sp*1.5f, sp*2.0f, 1000, 1000);         // VeryHigh
+
+    // SULFITE membership functions
+    sp = _config->sulfite_setpoint;
+    db = _config->sulfite_deadband;
+    db_eff = (db * 2.0f > 0.5f) ? db : 0.25f;
+
+    s = _setpoint_vars[FUZZY_IN_SULFITE].sets;
+    setBreakpoints(s[0], 0, 0, sp*0.2f, sp*0.4f);               // VeryLow
+    setBreakpoints(s[1], sp*0.3f, sp*0.5f, sp-db_eff);          // Low
+    setBreakpoints(s[2], sp-db_eff*2, sp, sp+db_eff*2);         // Normal
+    setBreakpoints(s[3], sp+db_eff, sp*1.5f, sp*2.0f);          // High
+    setBreakpoints(s[4], sp*1.8f, sp*2.5f, 100, 100);           // VeryHigh
+
+    // PH membership functions
+    sp = _config->ph_setpoint;
+    db = _config->ph_deadband;
+    db_eff = (db * 2.0f > 0.05f) ? db : 0.025f;
+
+    s = _setpoint_vars[FUZZY_IN_PH].sets;
+    setBreakpoints(s[0], 7.0f, 7.0f, 9.0f, 10.0f);              // Low
+    setBreakpoints(s[1], 9.5f, 10.5f, sp-db_eff);               // SlightlyLow
+    setBreakpoints(s[2], sp-db_eff, sp, sp+db_eff);             // Normal
+    setBreakpoints(s[3], sp+db_eff, 12.0f, 12.5f);              // SlightlyHigh
+    setBreakpoints(s[4], 12.0f, 12.5f, 14.0f, 14.0f);           // High
+
+    // TEMPERATURE and TREND sets do not depend on the config (s_input_vars)
+}
+
+// ============================================================================
+// DEFAULT RULE BASE
+// ============================================================================
+
+void FuzzyController::loadDefaultRules() {
+    fillDefaultRules(live());
+    resetSugenoConsequents();
+    rebuildRuleIndex();
+    Serial.printf("Loaded %d default rules\n", live()->num_rules);
+}
 
-    Serial.printf("Loaded %d default rules\n", _num_rules);
+void FuzzyController::fillDefaultRules(rule_bank_t* b) {
+    // One copy from the flash table (s_default_rules)
+    memcpy(b->rules, s_default_rules, sizeof(s_default_rules));
+    b->num_rules = s_default_rule_count;
 }
 
 // ============================================================================
@@ -382,7 +421,7 @@ float FuzzyController::evaluateMF(const membership_func_t& mf, float value,
 float FuzzyController::getMembership(uint8_t var_idx, uint8_t set_idx, float value) {
     if (var_idx >= FUZZY_MAX_INPUTS || set_idx >= FUZZY_MAX_SETS) return 0.0f;
 
-    linguistic_var_t& var = _inputs[var_idx];
+    const linguistic_var_t& var = *_inputs[var_idx];
     if (set_idx >= var.num_sets) return 0.0f;
 
     return evaluateMF(var.sets[set_idx], value, var.min_value, var.max_value);
@@ -391,7 +430,7 @@ float FuzzyController::getMembership(uint8_t var_idx, uint8_t set_idx, float val
 void FuzzyController::fuzzify(uint8_t var_idx, float value, float* degrees) {
     if (var_idx >= FUZZY_MAX_INPUTS || !degrees) return;
 
-    linguistic_var_t& var = _inputs[var_idx];
+    const linguistic_var_t& var = *_inputs[var_idx];
 
     for (uint8_t i = 0; i < var.num_sets; i++) {
         degrees[i] = evaluateMF(var.sets[i], value, var.min_value, var.max_value);
@@ -403,195 +442,1654 @@ void FuzzyController::fuzzify(uint8_t var_idx, float value, float* degrees) {
 // ============================================================================
 
 fuzzy_result_t FuzzyController::evaluate(const fuzzy_inputs_t& inputs) {
+    // A rule base staged by loadRuleBase() goes live between evaluations, never during one
+    if (_rb_stage.load() == RB_STAGE_READY) applyStagedRuleBase();
+
+    // Take over a surface finished by updateSurface(); free ours once disabled
+    if (_surface_next.load(std::memory_order_relaxed)) {
+        surface_t* next = _surface_next.exchange(nullptr);
+        if (next) {
+            free(_surface);
+            _surface = next;
+        }
+    }
+    if (_surface && !_surface_enabled.load()) {
+        free(_surface);
+        _surface = nullptr;
+    }
+
+    fuzzy_result_t result;
+    bool from_surface = false;
+    if (_config && _surface && _surface->valid &&
+        _surface->derived_gen == _derived_gen.load() && _surface->surface_gen == _surface_gen.load()) {
+        // Outside the grid (or NaN) falls through to the exact path
+        const surface_t& sf = *_surface;
+        if (inputs.temperature >= sf.t[0] && inputs.temperature <= sf.t[sf.nt - 1] &&
+            inputs.cond_trend >= sf.r[0] && inputs.cond_trend <= sf.r[sf.nr - 1]) {
+            result = lookupSurface(sf, inputs.temperature, inputs.cond_trend);
+            from_surface = true;
+        }
+    }
+    if (!from_surface) result = evaluateExact(inputs);
+
+    uint16_t every = _trace_sample;
+    if (_trace && every && _config && ++_trace_skip >= every) {
+        _trace_skip = 0;
+        recordTrace(inputs, result, from_surface);
+    }
+    return result;
+}
+
+fuzzy_result_t FuzzyController::evaluateExact(const fuzzy_inputs_t& inputs) {
     fuzzy_result_t result = {0};
 
     if (!_config) return result;
 
-    // Step 1: Fuzzify all inputs (ALL MANUAL except temperature)
-
-    // TDS - manual entry required
-    if (_manual_valid[FUZZY_IN_TDS]) {
-        fuzzify(FUZZY_IN_TDS, _manual_values[FUZZY_IN_TDS], _input_membership[FUZZY_IN_TDS]);
-    } else {
-        // Unknown TDS - assume normal (conservative)
-        memset(_input_membership[FUZZY_IN_TDS], 0, sizeof(_input_membership[0]));
-        _input_membership[FUZZY_IN_TDS][2] = 1.0f;  // Normal
+    // Step 1: Fuzzify inputs (ALL MANUAL except temperature); with the cache, only inputs
+    // that moved beyond their epsilon since they were last fuzzified
+    float value[FUZZY_MAX_INPUTS];
+    bool valid[FUZZY_MAX_INPUTS];
+    for (uint8_t i = FUZZY_IN_TDS; i <= FUZZY_IN_PH; i++) {
+        value[i] = _manual_values[i];
+        valid[i] = _manual_valid[i];
+    }
+    value[FUZZY_IN_TEMPERATURE] = inputs.temperature;   // From sensor (reference only in manual mode)
+    valid[FUZZY_IN_TEMPERATURE] = true;
+    value[FUZZY_IN_TREND] = inputs.cond_trend;          // From TDS history (or zero)
+    valid[FUZZY_IN_TREND] = true;
+
+    uint8_t defuzz = (_config->defuzz_method < FUZZY_DEFUZZ_COUNT) ? _config->defuzz_method
+                                                                  : (uint8_t)FUZZY_DEFUZZ_CENTROID;
+    bool sugeno = _config->inference_method == FUZZY_INFERENCE_SUGENO;
+    uint8_t mode = (uint8_t)((sugeno ? 0x80 : 0) | (_centroid_impl << 4) | defuzz);
+
+    // Config, rule and consequent changes (possibly from another task) bump _derived_gen
+    uint32_t gen = _derived_gen.load();
+    bool full = !_cache_enabled || !_cache_valid || gen != _cache_gen || mode != _cache_mode;
+    uint8_t changed = 0;    // Bit i = input i re-fuzzified
+    _cache_stats.evaluations++;
+    if (full) _cache_stats.full_passes++;
+
+    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+        // NaN never compares within epsilon, so it is always re-fuzzified
+        if (!full && valid[i] == _cache_input_valid[i] && fabsf(value[i] - _cache_value[i]) <= _cache_eps[i]) {
+            _cache_stats.input_hits++;
+            continue;
+        }
+        _cache_stats.input_misses++;
+        changed |= (uint8_t)(1u << i);
+        _cache_value[i] = value[i];
+        _cache_input_valid[i] = valid[i];
+
+        if (valid[i]) {
+            fuzzify(i, value[i], _input_membership[i]);
+        } else {
+            // Unknown manual value - assume normal (conservative)
+            memset(_input_membership[i], 0, sizeof(_input_membership[0]));
+            _input_membership[i][2] = 1.0f;
+        }
+        // Normalized crisp input for first-order Sugeno consequents
+        _input_norm[i] = normalizeInput(i, value[i], valid[i]);
     }
 
-    // Alkalinity - manual entry required
-    if (_manual_valid[FUZZY_IN_ALKALINITY]) {
-        fuzzify(FUZZY_IN_ALKALINITY, _manual_values[FUZZY_IN_ALKALINITY], _input_membership[FUZZY_IN_ALKALINITY]);
+    // Step 2: Firing strengths (AND = MIN of antecedents, times rule weight). A rule's
+    // strength only depends on the inputs it references, so only rules touching a
+    // re-fuzzified input are recomputed; the rest keep their cached strength.
+    uint32_t candidates[FUZZY_RULE_WORDS];
+    selectCandidateRules(candidates);
+
+    uint32_t recompute[FUZZY_RULE_WORDS];
+    if (full) {
+        memset(recompute, 0xFF, sizeof(recompute));
+        memset(_rule_fired, 0, sizeof(_rule_fired));
+        memset(_rule_strength, 0, sizeof(_rule_strength));
     } else {
-        // Unknown alkalinity - assume normal
-        memset(_input_membership[FUZZY_IN_ALKALINITY], 0, sizeof(_input_membership[0]));
-        _input_membership[FUZZY_IN_ALKALINITY][2] = 1.0f;  // Normal
+        memset(recompute, 0, sizeof(recompute));
+        for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+            if (!(changed & (1u << i))) continue;
+            for (uint8_t w = 0; w < FUZZY_RULE_WORDS; w++) recompute[w] |= live()->uses_input[i][w];
+        }
     }
 
-    // Sulfite - manual entry required
-    if (_manual_valid[FUZZY_IN_SULFITE]) {
-        fuzzify(FUZZY_IN_SULFITE, _manual_values[FUZZY_IN_SULFITE], _input_membership[FUZZY_IN_SULFITE]);
-    } else {
-        memset(_input_membership[FUZZY_IN_SULFITE], 0, sizeof(_input_membership[0]));
-        _input_membership[FUZZY_IN_SULFITE][2] = 1.0f;
+    uint8_t computed = 0;
+    uint8_t recomputed = 0;
+    for (uint8_t w = 0; w < FUZZY_RULE_WORDS && w * 32 < live()->num_rules; w++) {
+        uint32_t bits = recompute[w];
+        while (bits) {
+            uint8_t r = (uint8_t)(w * 32 + __builtin_ctz(bits));
+            if (r >= live()->num_rules) break;
+            uint32_t bit = bits & (0 - bits);
+            bits &= bits - 1;
+            recomputed++;
+
+            float firing_strength = 0.0f;
+            if (candidates[w] & bit) {
+                computed++;
+                firing_strength = 1.0f;
+                for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+                    uint8_t term = live()->rules[r].antecedent[i];
+                    if (term == DONT_CARE || term >= _inputs[i]->num_sets) continue;
+
+                    firing_strength = tNormMin(firing_strength, _input_membership[i][term]);
+                }
+                firing_strength *= live()->rules[r].weight;
+                if (firing_strength < 0.001f) firing_strength = 0.0f;  // Skip weak rules
+            }
+
+            _rule_strength[r] = firing_strength;
+            if (firing_strength > 0.0f) _rule_fired[w] |= bit; else _rule_fired[w] &= ~bit;
+        }
     }
+    _last_candidates = computed;
+    _cache_stats.rule_misses += recomputed;
+    _cache_stats.rule_hits += live()->num_rules - recomputed;
 
-    // pH - manual entry required
-    if (_manual_valid[FUZZY_IN_PH]) {
-        fuzzify(FUZZY_IN_PH, _manual_values[FUZZY_IN_PH], _input_membership[FUZZY_IN_PH]);
-    } else {
-        memset(_input_membership[FUZZY_IN_PH], 0, sizeof(_input_membership[0]));
-        _input_membership[FUZZY_IN_PH][2] = 1.0f;
+    // Aggregate consequents. Max-aggregation of min-clipped consequents only depends on the
+    // strongest firing per output term, so keep one clip level per (output, term).
+    float clip[FUZZY_MAX_OUTPUTS][FUZZY_MAX_SETS];
+    memset(clip, 0, sizeof(clip));
+    float sugeno_num[FUZZY_MAX_OUTPUTS] = {0};
+    float sugeno_den[FUZZY_MAX_OUTPUTS] = {0};
+
+    result.active_rules = 0;
+    result.max_firing_strength = 0;
+
+    for (uint8_t w = 0; w < FUZZY_RULE_WORDS; w++) {
+        uint32_t bits = _rule_fired[w];
+        while (bits) {
+            uint8_t r = (uint8_t)(w * 32 + __builtin_ctz(bits));
+            bits &= bits - 1;
+            float firing_strength = _rule_strength[r];
+
+            result.active_rules++;
+            if (firing_strength > result.max_firing_strength) {
+                result.max_firing_strength = firing_strength;
+                result.dominant_rule = r;
+            }
+
+            // Mamdani: clip output MFs at firing strength, S-norm MAX
+            for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+                uint8_t term = live()->rules[r].consequent[o];
+                if (term == DONT_CARE || term >= _outputs[o].num_sets) continue;
+
+                if (sugeno) {
+                    const int16_t* p = live()->sugeno[r][o];
+                    float z = p[0];
+                    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) z += p[i + 1] * _input_norm[i];
+                    z *= FUZZY_SUGENO_LSB;
+                    sugeno_num[o] += firing_strength * z;
+                    sugeno_den[o] += firing_strength;
+                } else {
+                    clip[o][term] = sNormMax(clip[o][term], firing_strength);
+                }
+            }
+        }
     }
 
-    // Temperature - from sensor (for reference only in manual mode)
-    fuzzify(FUZZY_IN_TEMPERATURE, inputs.temperature, _input_membership[FUZZY_IN_TEMPERATURE]);
+    // Step 3: Defuzzify outputs (Sugeno weighted average, or Mamdani with defuzz_method;
+    // centroid uses the closed form unless the sampled implementation is selected).
+    // A Mamdani output whose clip levels did not change keeps its cached crisp value.
+    float crisp[FUZZY_MAX_OUTPUTS];
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+        if (sugeno) {
+            float z = (sugeno_den[o] > 0.0f) ? sugeno_num[o] / sugeno_den[o] : 0.0f;
+            crisp[o] = constrain(z, _outputs[o].min_value, _outputs[o].max_value);
+            _cache_stats.output_misses++;
+            continue;
+        }
+        if (!full && memcmp(clip[o], _cache_clip[o], sizeof(clip[o])) == 0) {
+            crisp[o] = _cache_crisp[o];
+            _cache_stats.output_hits++;
+            continue;
+        }
+        if (defuzz == FUZZY_DEFUZZ_CENTROID && _centroid_impl == FUZZY_CENTROID_ANALYTIC) {
+            crisp[o] = defuzzifyAnalytic(o, clip[o]);
+        } else {
+            float aggregated[FUZZY_RESOLUTION];
+            sampleAggregation(o, clip[o], aggregated);
+            crisp[o] = defuzzify(o, aggregated, defuzz);
+        }
+        memcpy(_cache_clip[o], clip[o], sizeof(clip[o]));
+        _cache_crisp[o] = crisp[o];
+        _cache_stats.output_misses++;
+    }
+    _cache_mode = mode;
+    _cache_gen = gen;
+    _cache_valid = true;
 
-    // Trend - calculated from TDS history (or zero if insufficient data)
-    fuzzify(FUZZY_IN_TREND, inputs.cond_trend, _input_membership[FUZZY_IN_TREND]);
+    result.blowdown_rate = crisp[FUZZY_OUT_BLOWDOWN];
+    result.caustic_rate = crisp[FUZZY_OUT_CAUSTIC];
+    result.sulfite_rate = crisp[FUZZY_OUT_SULFITE];
+    result.acid_rate = crisp[FUZZY_OUT_ACID];
 
-    // Step 2: Apply rules and aggregate outputs
-    float output_aggregation[FUZZY_MAX_OUTPUTS][FUZZY_RESOLUTION];
-    memset(output_aggregation, 0, sizeof(output_aggregation));
+    return result;
+}
 
-    result.active_rules = 0;
-    result.max_firing_strength = 0;
+// ============================================================================
+// BATCH EVALUATION
+// ============================================================================
+// Same arithmetic as evaluateExact() in the same order, so results match it bit for
+// bit; only the loop nesting differs (rule outer, point inner).
 
-    for (uint8_t r = 0; r < _num_rules; r++) {
-        if (!_rules[r].enabled) continue;
+size_t FuzzyController::evaluateBatch(const fuzzy_batch_t& batch) {
+    if (!_config || batch.count == 0) return 0;
 
-        // Calculate firing strength (AND = MIN of antecedents)
-        float firing_strength = 1.0f;
+    batch_block_t* s = (batch_block_t*)malloc(sizeof(batch_block_t));
+    if (!s) return 0;
 
-        for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
-            uint8_t term = _rules[r].antecedent[i];
-            if (term == DONT_CARE || term >= _inputs[i].num_sets) continue;
+    // One bank for the whole batch, held against restaging (evaluate() may swap meanwhile)
+    const rule_bank_t* rb = acquireReadBank();
+    for (size_t base = 0; base < batch.count; base += FUZZY_BATCH_BLOCK) {
+        size_t left = batch.count - base;
+        evaluateBlock(rb, batch, base, (uint8_t)(left < FUZZY_BATCH_BLOCK ? left : FUZZY_BATCH_BLOCK), s);
+    }
+    releaseReadBank(rb);
+    free(s);
+    return batch.count;
+}
 
-            firing_strength = tNormMin(firing_strength, _input_membership[i][term]);
+size_t FuzzyController::evaluateBatch(const fuzzy_inputs_t* inputs, fuzzy_result_t* results, size_t count) {
+    if (!_config || !inputs || !results || count == 0) return 0;
+
+    batch_block_t* s = (batch_block_t*)malloc(sizeof(batch_block_t));
+    if (!s) return 0;
+
+    // Transpose one block at a time into columns
+    float in[FUZZY_MAX_INPUTS][FUZZY_BATCH_BLOCK];
+    uint8_t mask[FUZZY_BATCH_BLOCK];
+    float out[FUZZY_MAX_OUTPUTS][FUZZY_BATCH_BLOCK];
+    float max_firing[FUZZY_BATCH_BLOCK];
+    uint8_t active[FUZZY_BATCH_BLOCK];
+    uint8_t dominant[FUZZY_BATCH_BLOCK];
+
+    fuzzy_batch_t b;
+    memset(&b, 0, sizeof(b));
+    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) b.input[i] = in[i];
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) b.output[o] = out[o];
+    b.valid_mask = mask;
+    b.max_firing = max_firing;
+    b.active_rules = active;
+    b.dominant_rule = dominant;
+
+    const rule_bank_t* rb = acquireReadBank();
+    for (size_t base = 0; base < count; base += FUZZY_BATCH_BLOCK) {
+        size_t left = count - base;
+        uint8_t n = (uint8_t)(left < FUZZY_BATCH_BLOCK ? left : FUZZY_BATCH_BLOCK);
+        const fuzzy_inputs_t* p = inputs + base;
+        for (uint8_t k = 0; k < n; k++) {
+            in[FUZZY_IN_TDS][k] = p[k].conductivity;
+            in[FUZZY_IN_ALKALINITY][k] = p[k].alkalinity;
+            in[FUZZY_IN_SULFITE][k] = p[k].sulfite;
+            in[FUZZY_IN_PH][k] = p[k].ph;
+            in[FUZZY_IN_TEMPERATURE][k] = p[k].temperature;
+            in[FUZZY_IN_TREND][k] = p[k].cond_trend;
+            mask[k] = (uint8_t)((1u << FUZZY_IN_TDS) | (1u << FUZZY_IN_TEMPERATURE) | (1u << FUZZY_IN_TREND) |
+                                (p[k].alkalinity_valid ? 1u << FUZZY_IN_ALKALINITY : 0) |
+                                (p[k].sulfite_valid ? 1u << FUZZY_IN_SULFITE : 0) |
+                                (p[k].ph_valid ? 1u << FUZZY_IN_PH : 0));
         }
+        b.count = n;
+        evaluateBlock(rb, b, 0, n, s);
+
+        fuzzy_result_t* r = results + base;
+        for (uint8_t k = 0; k < n; k++) {
+            r[k].blowdown_rate = out[FUZZY_OUT_BLOWDOWN][k];
+            r[k].caustic_rate = out[FUZZY_OUT_CAUSTIC][k];
+            r[k].sulfite_rate = out[FUZZY_OUT_SULFITE][k];
+            r[k].acid_rate = out[FUZZY_OUT_ACID][k];
+            r[k].max_firing_strength = max_firing[k];
+            r[k].active_rules = active[k];
+            r[k].dominant_rule = dominant[k];
+        }
+    }
+    releaseReadBank(rb);
+    free(s);
+    return count;
+}
 
-        // Apply rule weight
-        firing_strength *= _rules[r].weight;
+void FuzzyController::fuzzifyBlock(const membership_func_t& mf, const float* x, uint8_t n, float* mu,
+                                   float min_val, float max_val) {
+    // Triangles and trapezoids as selects (both slopes computed, no early return) so the
+    // loop vectorizes; the selected value is the one evaluateMF() returns
+    float a = mf.params[0], b = mf.params[1], c = mf.params[2], d = mf.params[3];
+    if (mf.type == MF_TRIANGULAR) {
+        for (uint8_t k = 0; k < n; k++) {
+            float v = x[k];
+            float up = (v - a) / (b - a);
+            float down = (c - v) / (c - b);
+            float m = (v <= b) ? up : down;
+            mu[k] = (v <= a || v >= c) ? 0.0f : m;
+        }
+    } else if (mf.type == MF_TRAPEZOIDAL) {
+        for (uint8_t k = 0; k < n; k++) {
+            float v = x[k];
+            float up = (v - a) / (b - a);
+            float down = (d - v) / (d - c);
+            float m = (v < b) ? up : down;
+            m = (v >= b && v <= c) ? 1.0f : m;
+            mu[k] = (v <= a || v >= d) ? 0.0f : m;
+        }
+    } else {
+        for (uint8_t k = 0; k < n; k++) mu[k] = evaluateMF(mf, x[k], min_val, max_val);
+    }
+}
 
-        if (firing_strength < 0.001f) continue;  // Skip weak rules
+void FuzzyController::evaluateBlock(const rule_bank_t* rb, const fuzzy_batch_t& batch, size_t base, uint8_t n,
+                                    batch_block_t* s) {
+    uint8_t defuzz = (_config->defuzz_method < FUZZY_DEFUZZ_COUNT) ? _config->defuzz_method
+                                                                  : (uint8_t)FUZZY_DEFUZZ_CENTROID;
+    bool sugeno = _config->inference_method == FUZZY_INFERENCE_SUGENO;
+
+    // Step 1: gather inputs and fuzzify per set across the block
+    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+        const float* col = batch.input[i];
+        if (col) {
+            for (uint8_t k = 0; k < n; k++) {
+                s->x[i][k] = col[base + k];
+                s->valid[i][k] = batch.valid_mask ? (batch.valid_mask[base + k] >> i) & 1 : 1;
+            }
+        } else {
+            bool manual = i <= FUZZY_IN_PH;
+            for (uint8_t k = 0; k < n; k++) {
+                s->x[i][k] = manual ? _manual_values[i] : 0.0f;
+                s->valid[i][k] = manual ? _manual_valid[i] : 1;
+            }
+        }
 
-        result.active_rules++;
+        const linguistic_var_t& var = *_inputs[i];
+        for (uint8_t t = 0; t < var.num_sets; t++) {
+            float* mu = s->mu[i][t];
+            fuzzifyBlock(var.sets[t], s->x[i], n, mu, var.min_value, var.max_value);
+            // Unknown manual value - assume normal (conservative)
+            float unknown = (t == 2) ? 1.0f : 0.0f;
+            for (uint8_t k = 0; k < n; k++) mu[k] = s->valid[i][k] ? mu[k] : unknown;
+        }
+        if (sugeno) {
+            for (uint8_t k = 0; k < n; k++) s->norm[i][k] = normalizeInput(i, s->x[i][k], s->valid[i][k]);
+        }
+    }
 
-        if (firing_strength > result.max_firing_strength) {
-            result.max_firing_strength = firing_strength;
-            result.dominant_rule = r;
+    // Step 2: firing strength of every enabled rule across the block, aggregated as it goes
+    memset(s->clip, 0, sizeof(s->clip));
+    memset(s->num, 0, sizeof(s->num));
+    memset(s->den, 0, sizeof(s->den));
+    memset(s->max_firing, 0, sizeof(s->max_firing));
+    memset(s->active, 0, sizeof(s->active));
+    memset(s->dominant, 0, sizeof(s->dominant));
+    memset(s->covered, 0, sizeof(s->covered));
+
+    float* st = s->strength;
+    for (uint8_t r = 0; r < rb->num_rules; r++) {
+        if (!(rb->enabled[r / 32] & (1UL << (r % 32)))) continue;
+        const fuzzy_rule_t& rule = rb->rules[r];
+
+        for (uint8_t k = 0; k < n; k++) st[k] = 1.0f;
+        for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+            uint8_t term = rule.antecedent[i];
+            if (term == DONT_CARE || term >= _inputs[i]->num_sets) continue;
+            const float* mu = s->mu[i][term];
+            for (uint8_t k = 0; k < n; k++) st[k] = (mu[k] < st[k]) ? mu[k] : st[k];
+        }
+        float weight = rule.weight;
+        bool any = false;
+        for (uint8_t k = 0; k < n; k++) {
+            float f = st[k] * weight;
+            f = (f < 0.001f) ? 0.0f : f;  // Skip weak rules
+            st[k] = f;
+            any |= f > 0.0f;
         }
+        if (!any) continue;
 
-        // Aggregate consequents (Mamdani: clip output MFs at firing strength)
+        for (uint8_t k = 0; k < n; k++) {
+            s->active[k] += st[k] > 0.0f;
+            if (st[k] > s->max_firing[k]) {
+                s->max_firing[k] = st[k];
+                s->dominant[k] = r;
+            }
+        }
         for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
-            uint8_t term = _rules[r].consequent[o];
+            uint8_t term = rule.consequent[o];
             if (term == DONT_CARE || term >= _outputs[o].num_sets) continue;
 
-            linguistic_var_t& out_var = _outputs[o];
-            membership_func_t& out_mf = out_var.sets[term];
-
-            // Sample the output MF and clip at firing strength
-            for (int x = 0; x < FUZZY_RESOLUTION; x++) {
-                float crisp_x = out_var.min_value +
-                    (out_var.max_value - out_var.min_value) * x / (FUZZY_RESOLUTION - 1);
-
-                float mf_value = evaluateMF(out_mf, crisp_x, out_var.min_value, out_var.max_value);
-                float clipped = min(mf_value, firing_strength);
-
-                // S-norm aggregation (MAX)
-                output_aggregation[o][x] = sNormMax(output_aggregation[o][x], clipped);
+            for (uint8_t k = 0; k < n; k++) s->covered[k] |= (st[k] > 0.0f) ? (uint8_t)(1u << o) : 0;
+            if (sugeno) {
+                const int16_t* p = rb->sugeno[r][o];
+                for (uint8_t k = 0; k < n; k++) {
+                    float z = p[0];
+                    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) z += p[i + 1] * s->norm[i][k];
+                    z *= FUZZY_SUGENO_LSB;
+                    // Select rather than add 0 * z: z is NaN for a NaN input
+                    s->num[o][k] += (st[k] > 0.0f) ? st[k] * z : 0.0f;
+                    s->den[o][k] += st[k];
+                }
+            } else {
+                float* c = s->clip[o][term];
+                for (uint8_t k = 0; k < n; k++) c[k] = (st[k] > c[k]) ? st[k] : c[k];
             }
         }
     }
 
-    // Step 3: Defuzzify outputs (centroid method)
-    result.blowdown_rate = defuzzify(FUZZY_OUT_BLOWDOWN, output_aggregation[FUZZY_OUT_BLOWDOWN]);
-    result.caustic_rate = defuzzify(FUZZY_OUT_CAUSTIC, output_aggregation[FUZZY_OUT_CAUSTIC]);
-    result.sulfite_rate = defuzzify(FUZZY_OUT_SULFITE, output_aggregation[FUZZY_OUT_SULFITE]);
-    result.acid_rate = defuzzify(FUZZY_OUT_ACID, output_aggregation[FUZZY_OUT_ACID]);
+    // Step 3: defuzzify per point, as evaluateExact() does
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+        float* out = batch.output[o];
+        if (!out) continue;
+        for (uint8_t k = 0; k < n; k++) {
+            if (sugeno) {
+                float z = (s->den[o][k] > 0.0f) ? s->num[o][k] / s->den[o][k] : 0.0f;
+                out[base + k] = constrain(z, _outputs[o].min_value, _outputs[o].max_value);
+                continue;
+            }
+            float clip[FUZZY_MAX_SETS];
+            for (uint8_t t = 0; t < FUZZY_MAX_SETS; t++) clip[t] = s->clip[o][t][k];
+            if (defuzz == FUZZY_DEFUZZ_CENTROID && _centroid_impl == FUZZY_CENTROID_ANALYTIC) {
+                out[base + k] = defuzzifyAnalytic(o, clip);
+            } else {
+                float aggregated[FUZZY_RESOLUTION];
+                sampleAggregation(o, clip, aggregated);
+                out[base + k] = defuzzify(o, aggregated, defuzz);
+            }
+        }
+    }
 
-    return result;
+    for (uint8_t k = 0; k < n; k++) {
+        if (batch.max_firing) batch.max_firing[base + k] = s->max_firing[k];
+        if (batch.active_rules) batch.active_rules[base + k] = s->active[k];
+        if (batch.dominant_rule) batch.dominant_rule[base + k] = s->dominant[k];
+        if (batch.covered_mask) batch.covered_mask[base + k] = s->covered[k];
+    }
 }
 
 // ============================================================================
 // DEFUZZIFICATION
 // ============================================================================
 
-float FuzzyController::defuzzify(uint8_t output_idx, float* aggregated) {
-    if (output_idx >= FUZZY_MAX_OUTPUTS || !aggregated) return 0.0f;
+void FuzzyController::sampleAggregation(uint8_t output_idx, const float* clip, float* aggregated) {
+    const linguistic_var_t& var = _outputs[output_idx];
 
-    linguistic_var_t& var = _outputs[output_idx];
+    for (int x = 0; x < FUZZY_RESOLUTION; x++) aggregated[x] = 0.0f;
 
-    // Centroid method (Center of Gravity)
-    float sum_weighted = 0.0f;
-    float sum_membership = 0.0f;
+    for (uint8_t t = 0; t < var.num_sets; t++) {
+        if (clip[t] <= 0.0f) continue;
 
-    for (int x = 0; x < FUZZY_RESOLUTION; x++) {
-        float crisp_x = var.min_value +
-            (var.max_value - var.min_value) * x / (FUZZY_RESOLUTION - 1);
+        // Sample the output MF and clip at firing strength
+        for (int x = 0; x < FUZZY_RESOLUTION; x++) {
+            float crisp_x = var.min_value +
+                (var.max_value - var.min_value) * x / (FUZZY_RESOLUTION - 1);
 
-        sum_weighted += crisp_x * aggregated[x];
-        sum_membership += aggregated[x];
+            float mf_value = evaluateMF(var.sets[t], crisp_x, var.min_value, var.max_value);
+            float clipped = min(mf_value, clip[t]);
+
+            // S-norm aggregation (MAX)
+            aggregated[x] = sNormMax(aggregated[x], clipped);
+        }
     }
+}
 
-    if (sum_membership < 0.001f) return 0.0f;
+float FuzzyController::defuzzify(uint8_t output_idx, float* aggregated, uint8_t method) {
+    if (output_idx >= FUZZY_MAX_OUTPUTS || !aggregated) return 0.0f;
+    if (method >= FUZZY_DEFUZZ_COUNT) method = FUZZY_DEFUZZ_CENTROID;
 
-    return sum_weighted / sum_membership;
-}
+    const linguistic_var_t& var = _outputs[output_idx];
 
-// ============================================================================
-// CONFIGURATION AND RULES
-// ============================================================================
+    // All methods in one pass, so switching defuzz_method does not change the per-cycle cost
+    float prefix[FUZZY_RESOLUTION];
+    fuzzy_defuzz_all_t all;
+    fuzzy_defuzz_all(aggregated, prefix, FUZZY_RESOLUTION, var.min_value, var.max_value, &all);
+
+    return all.value[method];
+}
+
+void fuzzy_defuzz_all(const float* aggregated, float* prefix, uint16_t n,
+                      float min_v, float max_v, fuzzy_defuzz_all_t* out) {
+    memset(out, 0, sizeof(*out));
+    if (!aggregated || !prefix || n < 2) return;
+
+    float step = (max_v - min_v) / (n - 1);
+    float sum_membership = 0.0f;
+    float sum_weighted = 0.0f;
+
+    // Maximum plateau: first/last index and sum of indices at the maximum
+    const float eps = 1e-6f;
+    float peak = 0.0f;
+    uint16_t first = 0, last = 0;
+    uint32_t idx_sum = 0;
+    uint16_t idx_count = 0;
+
+    for (uint16_t x = 0; x < n; x++) {
+        float mu = aggregated[x];
+        sum_membership += mu;
+        sum_weighted += (min_v + step * x) * mu;
+        prefix[x] = sum_membership;
+
+        if (mu > peak + eps) {
+            peak = mu;
+            first = last = x;
+            idx_sum = x;
+            idx_count = 1;
+        } else if (mu > 0.0f && mu >= peak - eps) {
+            last = x;
+            idx_sum += x;
+            idx_count++;
+        }
+    }
+
+    if (sum_membership < 0.001f) return;
+
+    out->value[FUZZY_DEFUZZ_CENTROID] = sum_weighted / sum_membership;
+
+    // Bisector: first sample whose cumulative area reaches half, interpolated inside its bin
+    float half = 0.5f * sum_membership;
+    uint16_t lo = 0, hi = n - 1;
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        if (prefix[mid] < half) lo = mid + 1; else hi = mid;
+    }
+    float before = (lo > 0) ? prefix[lo - 1] : 0.0f;
+    float frac = (aggregated[lo] > 0.0f) ? (half - before) / aggregated[lo] : 0.5f;
+    float bisector = min_v + step * ((float)lo - 0.5f + frac);
+    out->value[FUZZY_DEFUZZ_BISECTOR] = constrain(bisector, min_v, max_v);
+
+    out->value[FUZZY_DEFUZZ_MOM] = min_v + step * ((float)idx_sum / idx_count);
+    out->value[FUZZY_DEFUZZ_SOM] = min_v + step * first;
+    out->value[FUZZY_DEFUZZ_LOM] = min_v + step * last;
+}
+
+// ============================================================================
+// CLOSED-FORM CENTROID
+// ============================================================================
+// A triangle/trapezoid clipped at h is the polyline (a,0) (xl,h) (xr,h) (d,0).
+// The max of several such polylines is linear between consecutive breakpoints
+// (all vertices plus pairwise segment crossings), so each interval contributes
+// an exact trapezoid area and first moment.
+
+typedef struct {
+    float x[4];
+    float y[4];
+} clip_poly_t;
+
+static void clipPolyline(const membership_func_t& mf, float h, clip_poly_t* p) {
+    float a, b, c, d;
+    if (mf.type == MF_TRIANGULAR) {
+        a = mf.params[0];
+        b = mf.params[1];
+        c = mf.params[1];
+        d = mf.params[2];
+    } else {
+        a = mf.params[0];
+        b = mf.params[1];
+        c = mf.params[2];
+        d = mf.params[3];
+    }
+    p->x[0] = a;               p->y[0] = 0.0f;
+    p->x[1] = a + h * (b - a); p->y[1] = h;
+    p->x[2] = d - h * (d - c); p->y[2] = h;
+    p->x[3] = d;               p->y[3] = 0.0f;
+}
+
+// Value at x of the polyline segment containing xm (x may be an endpoint of that segment)
+static float polyLineAt(const clip_poly_t& p, float xm, float x) {
+    if (xm <= p.x[0] || xm >= p.x[3]) return 0.0f;
+    for (uint8_t k = 0; k < 3; k++) {
+        if (xm <= p.x[k + 1]) {
+            float dx = p.x[k + 1] - p.x[k];
+            return p.y[k] + (p.y[k + 1] - p.y[k]) * (x - p.x[k]) / dx;
+        }
+    }
+    return 0.0f;
+}
+
+float FuzzyController::defuzzifyAnalytic(uint8_t output_idx, const float* clip) {
+    if (output_idx >= FUZZY_MAX_OUTPUTS || !clip) return 0.0f;
+
+    const linguistic_var_t& var = _outputs[output_idx];
+    clip_poly_t poly[FUZZY_MAX_SETS];
+    uint8_t n = 0;
+
+    for (uint8_t t = 0; t < var.num_sets; t++) {
+        if (clip[t] <= 0.0f) continue;
+        const membership_func_t& mf = var.sets[t];
+        if (mf.type != MF_TRIANGULAR && mf.type != MF_TRAPEZOIDAL) {
+            // No closed form for this set: sample the whole output
+            float aggregated[FUZZY_RESOLUTION];
+            sampleAggregation(output_idx, clip, aggregated);
+            return defuzzify(output_idx, aggregated);
+        }
+        clipPolyline(mf, min(clip[t], 1.0f), &poly[n++]);
+    }
+    if (n == 0) return 0.0f;
+
+    // Breakpoints: range ends, vertices, crossings between segments of different sets
+    float bx[FUZZY_ANALYTIC_MAX_BREAKS];
+    uint8_t nb = 0;
+    bx[nb++] = var.min_value;
+    bx[nb++] = var.max_value;
+    for (uint8_t i = 0; i < n; i++) {
+        for (uint8_t k = 0; k < 4; k++) bx[nb++] = poly[i].x[k];
+    }
+    for (uint8_t i = 0; i < n; i++) {
+        for (uint8_t j = i + 1; j < n; j++) {
+            if (poly[i].x[3] <= poly[j].x[0] || poly[j].x[3] <= poly[i].x[0]) continue;
+            for (uint8_t si = 0; si < 3; si++) {
+                float x0 = poly[i].x[si], x1 = poly[i].x[si + 1];
+                if (x1 - x0 <= 0.0f) continue;
+                float m1 = (poly[i].y[si + 1] - poly[i].y[si]) / (x1 - x0);
+                for (uint8_t sj = 0; sj < 3; sj++) {
+                    float u0 = poly[j].x[sj], u1 = poly[j].x[sj + 1];
+                    if (u1 - u0 <= 0.0f) continue;
+                    float m2 = (poly[j].y[sj + 1] - poly[j].y[sj]) / (u1 - u0);
+                    if (fabsf(m1 - m2) < 1e-9f) continue;
+                    // y = y0 + m (x - x0) for both lines
+                    float xc = (poly[j].y[sj] - m2 * u0 - poly[i].y[si] + m1 * x0) / (m1 - m2);
+                    if (xc > max(x0, u0) && xc < min(x1, u1) && nb < FUZZY_ANALYTIC_MAX_BREAKS) {
+                        bx[nb++] = xc;
+                    }
+                }
+            }
+        }
+    }
+
+    // Insertion sort (nb is small) with clamping to the output range
+    for (uint8_t i = 0; i < nb; i++) {
+        float v = bx[i];
+        if (v < var.min_value) v = var.min_value;
+        if (v > var.max_value) v = var.max_value;
+        int j = i - 1;
+        while (j >= 0 && bx[j] > v) {
+            bx[j + 1] = bx[j];
+            j--;
+        }
+        bx[j + 1] = v;
+    }
+
+    float area = 0.0f;
+    float moment = 0.0f;
+    for (uint8_t i = 0; i + 1 < nb; i++) {
+        float x0 = bx[i], x1 = bx[i + 1];
+        float dx = x1 - x0;
+        if (dx <= 1e-6f) continue;
+        float xm = 0.5f * (x0 + x1);
+
+        // Envelope is a single set's segment on this interval: pick the top one at the midpoint
+        int8_t top = -1;
+        float top_val = 0.0f;
+        for (uint8_t k = 0; k < n; k++) {
+            float v = polyLineAt(poly[k], xm, xm);
+            if (v > top_val) {
+                top_val = v;
+                top = (int8_t)k;
+            }
+        }
+        if (top < 0) continue;
+        float y0 = polyLineAt(poly[top], xm, x0);
+        float y1 = polyLineAt(poly[top], xm, x1);
+
+        area += 0.5f * (y0 + y1) * dx;
+        moment += dx * (x0 * (2.0f * y0 + y1) + x1 * (y0 + 2.0f * y1)) / 6.0f;
+    }
+
+    // Same "no output" threshold as the sampled sum (which counts one unit per sample step)
+    float step = (var.max_value - var.min_value) / (FUZZY_RESOLUTION - 1);
+    if (area < 0.001f * step) return 0.0f;
+
+    return moment / area;
+}
+
+// ============================================================================
+// CONFIGURATION AND RULES
+// ============================================================================
 
 void FuzzyController::updateConfig(fuzzy_config_t* config) {
     _config = config;
     updateMembershipFunctions();
+    invalidateDerived();
 }
 
 bool FuzzyController::setRule(uint8_t rule_idx, const fuzzy_rule_t& rule) {
     if (rule_idx >= FUZZY_MAX_RULES) return false;
+    rule_bank_t* b = acquireEditBank();
+    if (!b) return false;
 
-    _rules[rule_idx] = rule;
+    b->rules[rule_idx] = rule;
 
-    if (rule_idx >= _num_rules) {
-        _num_rules = rule_idx + 1;
+    if (rule_idx >= b->num_rules) {
+        b->num_rules = rule_idx + 1;
     }
 
+    resetSugenoRule(b, rule_idx);
+    _rb_stage.store(RB_STAGE_READY);        // Indexed by the swap
+    return true;
+}
+
+bool FuzzyController::enableRule(uint8_t rule_idx, bool enabled) {
+    if (rule_idx >= FUZZY_MAX_RULES) return false;
+    rule_bank_t* b = acquireEditBank();
+    if (!b) return false;
+
+    b->rules[rule_idx].enabled = enabled;
+    _rb_stage.store(RB_STAGE_READY);
     return true;
 }
 
-void FuzzyController::enableRule(uint8_t rule_idx, bool enabled) {
-    if (rule_idx < FUZZY_MAX_RULES) {
-        _rules[rule_idx].enabled = enabled;
+// ============================================================================
+// BINARY RULE BASE
+// ============================================================================
+
+// CRC-16/CCITT, init 0xFFFF (same polynomial as the coprocessor link frames)
+static uint16_t rbCrc16(uint16_t crc, const uint8_t* data, size_t len) {
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
     }
+    return crc;
+}
+
+static uint16_t rbBlobCrc(const uint8_t* blob, size_t len) {
+    uint16_t crc = rbCrc16(0xFFFF, blob, 4);   // Magic, version, count
+    return rbCrc16(crc, blob + FUZZY_RB_HEADER_SIZE, len - FUZZY_RB_HEADER_SIZE);
+}
+
+static uint8_t rbNibble(uint8_t term) {
+    return (term < FUZZY_MAX_SETS) ? term : FUZZY_RB_DONT_CARE;
+}
+
+// Consequent parameter in table units (saturated)
+static int16_t rbSugenoValue(float v) {
+    if (isnan(v)) return 0;
+    return (int16_t)lroundf(constrain(v * FUZZY_RB_SUGENO_SCALE, -32768.0f, 32767.0f));
+}
+
+// Consequents stored in the Sugeno section: outputs each record names
+static uint16_t rbStoredConsequents(const uint8_t* data, uint8_t count) {
+    uint16_t m = 0;
+    for (uint8_t r = 0; r < count; r++) {
+        const uint8_t* rec = data + FUZZY_RB_HEADER_SIZE + r * FUZZY_RB_RECORD_SIZE;
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+            if (((rec[3 + o / 2] >> ((o % 2) * 4)) & 0x0F) != FUZZY_RB_DONT_CARE) m++;
+        }
+    }
+    return m;
+}
+
+size_t fuzzy_rb_encode(const fuzzy_rule_t* rules, uint8_t count, uint8_t* out, size_t cap,
+                       const fuzzy_sugeno_table_t* sugeno) {
+    if (!rules || !out || count > FUZZY_MAX_RULES) return 0;
+    size_t len = FUZZY_RB_HEADER_SIZE + (size_t)count * FUZZY_RB_RECORD_SIZE;
+
+    // Zero-order section unless some coefficient survives quantization
+    uint8_t params = 1;
+    if (sugeno) {
+        uint16_t stored = 0;
+        for (uint8_t r = 0; r < count; r++) {
+            for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+                if (rbNibble(rules[r].consequent[o]) == FUZZY_RB_DONT_CARE) continue;
+                stored++;
+                for (uint8_t i = 1; i < FUZZY_SUGENO_PARAMS; i++) {
+                    if ((*sugeno)[r][o][i] != 0) params = FUZZY_SUGENO_PARAMS;
+                }
+            }
+        }
+        len += 1 + (size_t)stored * params * 2;
+    }
+    if (cap < len) return 0;
+
+    out[0] = FUZZY_RB_MAGIC0;
+    out[1] = FUZZY_RB_MAGIC1;
+    out[2] = sugeno ? FUZZY_RB_VERSION_SUGENO : FUZZY_RB_VERSION;
+    out[3] = count;
+
+    for (uint8_t r = 0; r < count; r++) {
+        const fuzzy_rule_t& rule = rules[r];
+        uint8_t* rec = out + FUZZY_RB_HEADER_SIZE + r * FUZZY_RB_RECORD_SIZE;
+        for (uint8_t k = 0; k < 3; k++) {
+            rec[k] = rbNibble(rule.antecedent[2 * k]) | (rbNibble(rule.antecedent[2 * k + 1]) << 4);
+        }
+        for (uint8_t k = 0; k < 2; k++) {
+            rec[3 + k] = rbNibble(rule.consequent[2 * k]) | (rbNibble(rule.consequent[2 * k + 1]) << 4);
+        }
+        float w = rule.enabled ? constrain(rule.weight, 0.0f, 1.0f) : 0.0f;
+        rec[5] = (uint8_t)lroundf(w * FUZZY_RB_WEIGHT_ONE);
+    }
+
+    if (sugeno) {
+        uint8_t* p = out + FUZZY_RB_HEADER_SIZE + count * FUZZY_RB_RECORD_SIZE;
+        *p++ = params;
+        for (uint8_t r = 0; r < count; r++) {
+            for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+                if (rbNibble(rules[r].consequent[o]) == FUZZY_RB_DONT_CARE) continue;
+                for (uint8_t i = 0; i < params; i++) {
+                    uint16_t v = (uint16_t)(*sugeno)[r][o][i];
+                    *p++ = v & 0xFF;
+                    *p++ = v >> 8;
+                }
+            }
+        }
+    }
+
+    uint16_t crc = rbBlobCrc(out, len);
+    out[4] = crc & 0xFF;
+    out[5] = crc >> 8;
+    return len;
+}
+
+fuzzy_rb_status_t fuzzy_rb_decode(const uint8_t* data, size_t len, fuzzy_rule_t* rules, uint8_t* count,
+                                  fuzzy_sugeno_table_t* sugeno) {
+    if (!data || len < FUZZY_RB_HEADER_SIZE) return FUZZY_RB_ERR_LENGTH;
+    if (data[0] != FUZZY_RB_MAGIC0 || data[1] != FUZZY_RB_MAGIC1) return FUZZY_RB_ERR_MAGIC;
+    uint8_t version = data[2];
+    if (version != FUZZY_RB_VERSION && version != FUZZY_RB_VERSION_SUGENO) return FUZZY_RB_ERR_VERSION;
+    uint8_t n = data[3];
+    if (n == 0 || n > FUZZY_MAX_RULES) return FUZZY_RB_ERR_COUNT;
+    size_t rules_len = FUZZY_RB_HEADER_SIZE + (size_t)n * FUZZY_RB_RECORD_SIZE;
+    uint8_t params = 0;
+    if (version == FUZZY_RB_VERSION) {
+        if (len != rules_len) return FUZZY_RB_ERR_LENGTH;
+    } else {
+        if (len <= rules_len) return FUZZY_RB_ERR_LENGTH;
+        params = data[rules_len];
+        if (params != 1 && params != FUZZY_SUGENO_PARAMS) return FUZZY_RB_ERR_SUGENO;
+        if (len != rules_len + 1 + (size_t)rbStoredConsequents(data, n) * params * 2) return FUZZY_RB_ERR_LENGTH;
+    }
+    if (rbBlobCrc(data, len) != (uint16_t)(data[4] | (data[5] << 8))) return FUZZY_RB_ERR_CRC;
+
+    // Validate every record before touching the output
+    for (uint8_t r = 0; r < n; r++) {
+        const uint8_t* rec = data + FUZZY_RB_HEADER_SIZE + r * FUZZY_RB_RECORD_SIZE;
+        bool has_consequent = false;
+        for (uint8_t k = 0; k < 10; k++) {
+            uint8_t t = (rec[k / 2] >> ((k % 2) * 4)) & 0x0F;
+            if (t != FUZZY_RB_DONT_CARE && t >= FUZZY_MAX_SETS) return FUZZY_RB_ERR_TERM;
+            if (k >= FUZZY_MAX_INPUTS && t != FUZZY_RB_DONT_CARE) has_consequent = true;
+        }
+        if (!has_consequent) return FUZZY_RB_ERR_NO_CONSEQUENT;
+        if (rec[5] > FUZZY_RB_WEIGHT_ONE) return FUZZY_RB_ERR_WEIGHT;
+    }
+
+    if (!rules || !count) return FUZZY_RB_OK;
+    for (uint8_t r = 0; r < n; r++) {
+        const uint8_t* rec = data + FUZZY_RB_HEADER_SIZE + r * FUZZY_RB_RECORD_SIZE;
+        fuzzy_rule_t& rule = rules[r];
+        for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+            uint8_t t = (rec[i / 2] >> ((i % 2) * 4)) & 0x0F;
+            rule.antecedent[i] = (t == FUZZY_RB_DONT_CARE) ? DONT_CARE : t;
+        }
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+            uint8_t t = (rec[3 + o / 2] >> ((o % 2) * 4)) & 0x0F;
+            rule.consequent[o] = (t == FUZZY_RB_DONT_CARE) ? DONT_CARE : t;
+        }
+        rule.weight = (float)rec[5] / FUZZY_RB_WEIGHT_ONE;
+        rule.enabled = rec[5] > 0;
+    }
+    *count = n;
+
+    if (sugeno && params) {
+        const uint8_t* p = data + rules_len + 1;
+        for (uint8_t r = 0; r < n; r++) {
+            for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+                int16_t* c = (*sugeno)[r][o];
+                memset(c, 0, sizeof((*sugeno)[0][0]));
+                if (rules[r].consequent[o] == DONT_CARE) continue;
+                for (uint8_t i = 0; i < params; i++, p += 2) {
+                    c[i] = (int16_t)(p[0] | (p[1] << 8));
+                }
+            }
+        }
+    }
+    return FUZZY_RB_OK;
+}
+
+const char* fuzzy_rb_status_name(fuzzy_rb_status_t status) {
+    switch (status) {
+        case FUZZY_RB_OK:                   return "ok";
+        case FUZZY_RB_ERR_LENGTH:           return "bad length";
+        case FUZZY_RB_ERR_MAGIC:            return "bad magic";
+        case FUZZY_RB_ERR_VERSION:          return "unsupported version";
+        case FUZZY_RB_ERR_COUNT:            return "bad rule count";
+        case FUZZY_RB_ERR_CRC:              return "CRC mismatch";
+        case FUZZY_RB_ERR_TERM:             return "term out of range";
+        case FUZZY_RB_ERR_WEIGHT:           return "weight out of range";
+        case FUZZY_RB_ERR_NO_CONSEQUENT:    return "rule without consequent";
+        case FUZZY_RB_ERR_SUGENO:           return "bad Sugeno section";
+        case FUZZY_RB_ERR_BUSY:             return "busy";
+    }
+    return "unknown";
+}
+
+FuzzyController::rule_bank_t* FuzzyController::acquireStagingBank(bool* was_staged) {
+    // FREE → WRITING, or replace a staged bank evaluate() has not picked up yet
+    uint8_t prev = RB_STAGE_FREE;
+    if (!_rb_stage.compare_exchange_strong(prev, RB_STAGE_WRITING)) {
+        prev = RB_STAGE_READY;
+        if (!_rb_stage.compare_exchange_strong(prev, RB_STAGE_WRITING)) return nullptr;
+    }
+    if (was_staged) *was_staged = (prev == RB_STAGE_READY);
+    // No swap can happen while we hold WRITING, so _rb is stable from here on. A reader
+    // that took the spare bank while it was live still holds it: refuse rather than
+    // overwrite it under the reader (a staged bank, if any, is left as it was)
+    rule_bank_t* b = (_rb.load() == &_banks[0]) ? &_banks[1] : &_banks[0];
+    if (_rb_readers[b - _banks].load() != 0) {
+        _rb_stage.store(prev);
+        return nullptr;
+    }
+    return b;
+}
+
+FuzzyController::rule_bank_t* FuzzyController::acquireEditBank() {
+    // Edits go on top of a rule base already staged, otherwise on a copy of the live one
+    // (never written while live, so copying it beside readers is safe)
+    bool staged = false;
+    rule_bank_t* b = acquireStagingBank(&staged);
+    if (b && !staged) {
+        const rule_bank_t* src = live();
+        memcpy(b->rules, src->rules, sizeof(b->rules));
+        b->num_rules = src->num_rules;
+        memcpy(b->sugeno, src->sugeno, sizeof(b->sugeno));
+    }
+    return b;
+}
+
+const FuzzyController::rule_bank_t* FuzzyController::acquireReadBank() const {
+    // Count ourselves on the bank, then check it is still live: if a swap came in between,
+    // the bank may be restaged at any time, so let it go and take the new one
+    while (true) {
+        rule_bank_t* b = _rb.load();
+        std::atomic<uint8_t>& readers = _rb_readers[b - _banks];
+        readers.fetch_add(1);
+        if (_rb.load() == b) return b;
+        readers.fetch_sub(1);
+    }
+}
+
+void FuzzyController::releaseReadBank(const rule_bank_t* b) const {
+    _rb_readers[b - _banks].fetch_sub(1);
+}
+
+fuzzy_rb_status_t FuzzyController::loadRuleBase(const uint8_t* data, size_t len) {
+    fuzzy_rb_status_t st = fuzzy_rb_decode(data, len, nullptr, nullptr);
+    if (st != FUZZY_RB_OK) return st;
+
+    rule_bank_t* b = acquireStagingBank();
+    if (!b) return FUZZY_RB_ERR_BUSY;
+
+    memset(b->rules, 0, sizeof(b->rules));
+    memset(b->sugeno, 0, sizeof(b->sugeno));
+    fuzzy_rb_decode(data, len, b->rules, &b->num_rules, &b->sugeno);
+    if (data[2] == FUZZY_RB_VERSION) resetSugenoBank(b);    // No consequents stored: centroids
+    _rb_stage.store(RB_STAGE_READY);
+    return FUZZY_RB_OK;
+}
+
+bool FuzzyController::stageDefaultRules() {
+    rule_bank_t* b = acquireStagingBank();
+    if (!b) return false;
+
+    memset(b->rules, 0, sizeof(b->rules));
+    fillDefaultRules(b);
+    resetSugenoBank(b);
+    _rb_stage.store(RB_STAGE_READY);
+    return true;
+}
+
+size_t FuzzyController::exportRuleBase(uint8_t* out, size_t cap) const {
+    const rule_bank_t* b = acquireReadBank();
+    size_t len = fuzzy_rb_encode(b->rules, b->num_rules, out, cap, &b->sugeno);
+    releaseReadBank(b);
+    return len;
+}
+
+void FuzzyController::applyStagedRuleBase() {
+    uint8_t expected = RB_STAGE_READY;
+    if (!_rb_stage.compare_exchange_strong(expected, RB_STAGE_SWAPPING)) return;
+
+    // Indexed here rather than by the writer so the index always matches the current
+    // variables (a few us for FUZZY_MAX_RULES rules)
+    rule_bank_t* b = (live() == &_banks[0]) ? &_banks[1] : &_banks[0];
+    indexRuleBank(b);
+    _rb.store(b);
+    _rb_swaps++;
+    invalidateDerived();        // The staged bank brought its own Sugeno consequents
+    _rb_stage.store(RB_STAGE_FREE);
+    Serial.printf("Fuzzy rule base swapped in (%d rules)\n", live()->num_rules);
+}
+
+// ============================================================================
+// SUGENO CONSEQUENTS
+// ============================================================================
+
+float FuzzyController::normalizeInput(uint8_t var_idx, float value, bool valid) {
+    const linguistic_var_t& var = *_inputs[var_idx];
+    if (!valid) {
+        // Same assumption as fuzzification: unknown manual value reads as "Normal"
+        const membership_func_t& mf = var.sets[2];
+        value = (mf.type == MF_TRAPEZOIDAL) ? 0.5f * (mf.params[1] + mf.params[2])
+              : (mf.type == MF_TRIANGULAR) ? mf.params[1] : mf.params[0];
+    }
+    float span = var.max_value - var.min_value;
+    if (span <= 0.0f) return 0.0f;
+    float u = (value - var.min_value) / span;
+    return constrain(u, 0.0f, 1.0f);
+}
+
+void FuzzyController::resetSugenoRule(rule_bank_t* b, uint8_t rule_idx) {
+    // Output sets are constant tables, so this is safe on a staging bank from another task
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+        int16_t* p = b->sugeno[rule_idx][o];
+        memset(p, 0, sizeof(b->sugeno[0][0]));
+
+        uint8_t term = b->rules[rule_idx].consequent[o];
+        if (term == DONT_CARE || term >= _outputs[o].num_sets) continue;
+
+        // Centroid of the unclipped output set
+        float clip[FUZZY_MAX_SETS] = {0};
+        clip[term] = 1.0f;
+        p[0] = rbSugenoValue(defuzzifyAnalytic(o, clip));
+    }
+}
+
+void FuzzyController::resetSugenoBank(rule_bank_t* b) {
+    memset(b->sugeno, 0, sizeof(b->sugeno));
+    for (uint8_t r = 0; r < b->num_rules; r++) resetSugenoRule(b, r);
+}
+
+void FuzzyController::resetSugenoConsequents() {
+    resetSugenoBank(live());
+    invalidateDerived();
+}
+
+bool FuzzyController::setSugenoConsequent(uint8_t rule_idx, uint8_t output_idx, float c0, const float* coeffs) {
+    if (rule_idx >= FUZZY_MAX_RULES || output_idx >= FUZZY_MAX_OUTPUTS) return false;
+
+    int16_t* p = live()->sugeno[rule_idx][output_idx];
+    p[0] = rbSugenoValue(c0);
+    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) p[i + 1] = coeffs ? rbSugenoValue(coeffs[i]) : 0;
+    invalidateDerived();
+    return true;
+}
+
+bool FuzzyController::getSugenoConsequent(uint8_t rule_idx, uint8_t output_idx, float* params) const {
+    if (rule_idx >= FUZZY_MAX_RULES || output_idx >= FUZZY_MAX_OUTPUTS || !params) return false;
+    const int16_t* p = live()->sugeno[rule_idx][output_idx];
+    for (uint8_t i = 0; i < FUZZY_SUGENO_PARAMS; i++) params[i] = p[i] * FUZZY_SUGENO_LSB;
+    return true;
+}
+
+uint8_t FuzzyController::getLastRuleStrengths(float* strengths, float* inputs_norm) const {
+    if (strengths) memcpy(strengths, _rule_strength, sizeof(_rule_strength));
+    if (inputs_norm) memcpy(inputs_norm, _input_norm, sizeof(_input_norm));
+    return live()->num_rules;
+}
+
+// ============================================================================
+// RULE INDEX
+// ============================================================================
+
+void FuzzyController::rebuildRuleIndex() {
+    invalidateDerived();  // Any rule change alters the control surface and cached strengths
+    indexRuleBank(live());
+}
+
+void FuzzyController::indexRuleBank(rule_bank_t* b) {
+    memset(b->by_term, 0, sizeof(b->by_term));
+    memset(b->dont_care, 0, sizeof(b->dont_care));
+    memset(b->enabled, 0, sizeof(b->enabled));
+    memset(b->uses_input, 0, sizeof(b->uses_input));
+
+    for (uint8_t r = 0; r < b->num_rules; r++) {
+        uint8_t w = r / 32;
+        uint32_t bit = 1UL << (r % 32);
+
+        if (b->rules[r].enabled) b->enabled[w] |= bit;
+
+        for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+            uint8_t term = b->rules[r].antecedent[i];
+            // Terms beyond the variable's sets are ignored by evaluate(), same as don't care
+            if (term == DONT_CARE || term >= _inputs[i]->num_sets) {
+                b->dont_care[i][w] |= bit;
+            } else {
+                b->by_term[i][term][w] |= bit;
+                b->uses_input[i][w] |= bit;
+            }
+        }
+    }
+}
+
+void FuzzyController::selectCandidateRules(uint32_t* candidates) {
+    memcpy(candidates, live()->enabled, sizeof(live()->enabled));
+
+    if (_rule_index_enabled) {
+        for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+            uint32_t allowed[FUZZY_RULE_WORDS];
+            memcpy(allowed, live()->dont_care[i], sizeof(allowed));
+
+            // A rule whose term has zero membership cannot fire (MIN would be 0)
+            for (uint8_t t = 0; t < _inputs[i]->num_sets; t++) {
+                if (_input_membership[i][t] <= 0.0f) continue;
+                for (uint8_t w = 0; w < FUZZY_RULE_WORDS; w++) allowed[w] |= live()->by_term[i][t][w];
+            }
+            for (uint8_t w = 0; w < FUZZY_RULE_WORDS; w++) candidates[w] &= allowed[w];
+        }
+    }
+
+    uint8_t count = 0;
+    for (uint8_t w = 0; w < FUZZY_RULE_WORDS; w++) count += __builtin_popcount(candidates[w]);
+    _last_candidates = count;
 }
 
 uint8_t FuzzyController::getActiveRuleCount() {
+    // Also called from the web task
+    const rule_bank_t* b = acquireReadBank();
     uint8_t count = 0;
-    for (uint8_t i = 0; i < _num_rules; i++) {
-        if (_rules[i].enabled) count++;
+    for (uint8_t i = 0; i < b->num_rules; i++) {
+        if (b->rules[i].enabled) count++;
     }
+    releaseReadBank(b);
     return count;
 }
 
 void FuzzyController::setManualInput(fuzzy_input_t param, float value, bool valid) {
     if (param < FUZZY_MAX_INPUTS) {
+        // Callers refresh periodically (pH estimate, expiry); only real changes rebuild the surface
+        bool changed = _manual_values[param] != value || _manual_valid[param] != valid;
         _manual_values[param] = value;
         _manual_valid[param] = valid;
+        if (changed) _surface_gen.fetch_add(1);     // After the store: a build stamped with the new gen saw it
+    }
+}
+
+void FuzzyController::setCacheEpsilon(uint8_t var_idx, float epsilon) {
+    if (var_idx >= FUZZY_MAX_INPUTS) return;
+    _cache_eps[var_idx] = (epsilon > 0.0f) ? epsilon : 0.0f;
+    _cache_valid = false;
+}
+
+bool FuzzyController::getManualInput(fuzzy_input_t param, float* value, bool* valid) const {
+    if (param >= FUZZY_MAX_INPUTS) return false;
+    if (value) *value = _manual_values[param];
+    if (valid) *valid = _manual_valid[param];
+    return true;
+}
+
+// ============================================================================
+// INFERENCE TRACE
+// ============================================================================
+
+bool FuzzyController::enableTrace(uint16_t depth, uint16_t sample_every) {
+    if (depth == 0) depth = 1;
+    if (depth > FUZZY_TRACE_MAX_DEPTH) depth = FUZZY_TRACE_MAX_DEPTH;
+    if (_trace && _trace_depth != depth) disableTrace();
+    if (!_trace) {
+        // One spare slot: the record being written never overlaps the readable depth
+        _trace = (fuzzy_trace_rec_t*)calloc(depth + 1, sizeof(fuzzy_trace_rec_t));
+        if (!_trace) {
+            Serial.printf("Fuzzy trace: cannot allocate %u records\n", depth);
+            return false;
+        }
+        _trace_depth = depth;
+        _trace_head.store(0);
+    }
+    _trace_skip = 0;
+    _trace_sample = sample_every;
+    return true;
+}
+
+void FuzzyController::disableTrace() {
+    _trace_sample = 0;
+    free(_trace);
+    _trace = nullptr;
+    _trace_depth = 0;
+    _trace_head.store(0);
+}
+
+static uint16_t traceQ16(float v, float scale) {
+    float q = v * scale + 0.5f;
+    return (q <= 0.0f) ? 0 : (q >= 65535.0f) ? 65535 : (uint16_t)q;
+}
+
+void FuzzyController::recordTrace(const fuzzy_inputs_t& inputs, const fuzzy_result_t& result, bool from_surface) {
+    uint32_t seq = _trace_head.load(std::memory_order_relaxed) + 1;
+    fuzzy_trace_rec_t& t = _trace[(seq - 1) % (_trace_depth + 1)];
+
+    t.seq = seq;
+    t.t_ms = millis();
+    t.valid_mask = (1u << FUZZY_IN_TEMPERATURE) | (1u << FUZZY_IN_TREND);
+    for (uint8_t i = FUZZY_IN_TDS; i <= FUZZY_IN_PH; i++) {
+        t.input[i] = _manual_values[i];
+        if (_manual_valid[i]) t.valid_mask |= (uint8_t)(1u << i);
+    }
+    t.input[FUZZY_IN_TEMPERATURE] = inputs.temperature;
+    t.input[FUZZY_IN_TREND] = inputs.cond_trend;
+
+    t.output[FUZZY_OUT_BLOWDOWN] = traceQ16(result.blowdown_rate, 100.0f);
+    t.output[FUZZY_OUT_CAUSTIC] = traceQ16(result.caustic_rate, 100.0f);
+    t.output[FUZZY_OUT_SULFITE] = traceQ16(result.sulfite_rate, 100.0f);
+    t.output[FUZZY_OUT_ACID] = traceQ16(result.acid_rate, 100.0f);
+    t.active_rules = result.active_rules;
+
+    uint8_t defuzz = (_config->defuzz_method < FUZZY_DEFUZZ_COUNT) ? _config->defuzz_method : 0;
+    t.flags = (uint8_t)(defuzz << 4);
+    if (_config->inference_method == FUZZY_INFERENCE_SUGENO) t.flags |= FUZZY_TRACE_FLAG_SUGENO;
+
+    // Top-K by insertion over the fired rules of this evaluation (strengths stay
+    // in _rule_strength, including cached ones)
+    float top_s[FUZZY_TRACE_TOP_K];
+    uint8_t n = 0;
+    if (from_surface) {
+        t.flags |= FUZZY_TRACE_FLAG_SURFACE;
+        if (result.max_firing_strength > 0.0f) {
+            t.top_rule[0] = result.dominant_rule;
+            top_s[0] = result.max_firing_strength;
+            n = 1;
+        }
+    } else {
+        for (uint8_t w = 0; w < FUZZY_RULE_WORDS; w++) {
+            uint32_t bits = _rule_fired[w];
+            while (bits) {
+                uint8_t r = (uint8_t)(w * 32 + __builtin_ctz(bits));
+                bits &= bits - 1;
+                float st = _rule_strength[r];
+                if (n == FUZZY_TRACE_TOP_K && st <= top_s[n - 1]) continue;
+
+                uint8_t k = (n < FUZZY_TRACE_TOP_K) ? n++ : n - 1;
+                while (k > 0 && top_s[k - 1] < st) {
+                    top_s[k] = top_s[k - 1];
+                    t.top_rule[k] = t.top_rule[k - 1];
+                    k--;
+                }
+                top_s[k] = st;
+                t.top_rule[k] = r;
+            }
+        }
+    }
+    t.num_top = n;
+    for (uint8_t k = 0; k < FUZZY_TRACE_TOP_K; k++) {
+        if (k < n) {
+            t.top_strength[k] = traceQ16(top_s[k], 65535.0f);
+        } else {
+            t.top_rule[k] = 0;
+            t.top_strength[k] = 0;
+        }
+    }
+
+    _trace_head.store(seq, std::memory_order_release);
+}
+
+size_t FuzzyController::readTrace(fuzzy_trace_rec_t* out, size_t max_records, uint32_t after_seq) const {
+    if (!_trace || !out || max_records == 0) return 0;
+    const uint32_t depth = _trace_depth;
+    const uint32_t slots = depth + 1;
+
+    uint32_t head = _trace_head.load(std::memory_order_acquire);
+    uint32_t oldest = (head > depth) ? head - depth + 1 : 1;
+    uint32_t first = max(after_seq + 1, oldest);
+    if (head == 0 || first > head) return 0;
+    size_t n = min((size_t)(head - first + 1), max_records);
+
+    for (size_t k = 0; k < n; k++) out[k] = _trace[(first + k - 1) % slots];
+
+    // While we copied, the writer may have published more records and be filling the
+    // slot after the new head; anything older than that slot's previous record is intact
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t head2 = _trace_head.load(std::memory_order_acquire);
+    uint32_t intact = (head2 + 2 > slots) ? head2 + 2 - slots : 1;
+    if (intact > first) {
+        size_t drop = intact - first;
+        if (drop >= n) return 0;
+        memmove(out, out + drop, (n - drop) * sizeof(*out));
+        n -= drop;
+    }
+    return n;
+}
+
+// ============================================================================
+// CONTROL SURFACE
+// ============================================================================
+
+void FuzzyController::enableSurface(uint8_t nodes_per_axis, float max_error) {
+    if (nodes_per_axis < 2) nodes_per_axis = 2;
+    if (nodes_per_axis > FUZZY_SURFACE_MAX_NODES) nodes_per_axis = FUZZY_SURFACE_MAX_NODES;
+    _surface_nodes.store(nodes_per_axis);
+    _surface_max_err.store(max_error);
+    _surface_enabled.store(true);
+    _surface_gen.fetch_add(1);
+}
+
+void FuzzyController::disableSurface() {
+    _surface_enabled.store(false);
+    _surface_gen.fetch_add(1);
+}
+
+fuzzy_surface_status_t FuzzyController::getSurfaceStatus() const {
+    fuzzy_surface_status_t st;
+    memset(&st, 0, sizeof(st));
+    st.enabled = _surface_enabled.load();
+    st.pending = st.enabled && (!_surface_built || _surface_built_derived != _derived_gen.load() ||
+                                _surface_built_gen != _surface_gen.load());
+    st.valid = st.enabled && !st.pending && _surface_ok;
+    st.temp_nodes = _surface_nt;
+    st.trend_nodes = _surface_nr;
+    st.max_error = _surface_err;
+    st.error_bound = _surface_max_err.load();
+    st.build_us = _surface_build_us;
+    st.builds = _surface_builds;
+    return st;
+}
+
+bool FuzzyController::updateSurface() {
+    if (!_config || !_surface_enabled.load()) return false;
+
+    // Generations first: anything that changes after this makes the build out of date
+    uint32_t derived = _derived_gen.load();
+    uint32_t gen = _surface_gen.load();
+    if (_surface_built && derived == _surface_built_derived && gen == _surface_built_gen) return false;
+
+    surface_t* sf = (surface_t*)malloc(sizeof(surface_t));
+    batch_block_t* s = (batch_block_t*)malloc(sizeof(batch_block_t));
+    if (!sf || !s) {
+        free(sf);
+        free(s);
+        Serial.println("Fuzzy surface: allocation failed");
+        return false;
+    }
+
+    uint32_t t0 = micros();
+    const rule_bank_t* rb = acquireReadBank();
+    buildSurface(*sf, rb, s);
+    releaseReadBank(rb);
+    free(s);
+    sf->derived_gen = derived;
+    sf->surface_gen = gen;
+
+    _surface_built_derived = derived;
+    _surface_built_gen = gen;
+    _surface_built = true;
+    _surface_ok = sf->valid;
+    _surface_nt = sf->nt;
+    _surface_nr = sf->nr;
+    _surface_build_us = micros() - t0;
+    _surface_builds++;
+    Serial.printf("Fuzzy surface: %ux%u nodes, max err %.2f%% (bound %.2f%%) %s, %lu us\n",
+                  sf->nt, sf->nr, _surface_err, _surface_max_err.load(),
+                  sf->valid ? "in use" : "rejected", (unsigned long)_surface_build_us);
+
+    // A build evaluate() has not taken yet is superseded
+    free(_surface_next.exchange(sf));
+    return true;
+}
+
+uint8_t FuzzyController::buildSurfaceAxis(uint8_t var_idx, float* nodes, uint8_t max_nodes) {
+    const linguistic_var_t& var = *_inputs[var_idx];
+    float lo = var.min_value;
+    float hi = var.max_value;
+    float eps = (hi - lo) * 1e-3f;
+
+    // End nodes sit just inside the range: evaluateMF() returns 0 exactly at a == min
+    float pts[2 + FUZZY_MAX_SETS * 4 + FUZZY_SURFACE_MAX_NODES];
+    uint8_t n = 0;
+    pts[n++] = lo + eps;
+    pts[n++] = hi - eps;
+
+    // The surface bends where the input MFs do, so every breakpoint becomes a node
+    for (uint8_t k = 0; k < var.num_sets; k++) {
+        const membership_func_t& mf = var.sets[k];
+        uint8_t np = (mf.type == MF_TRIANGULAR) ? 3 : (mf.type == MF_TRAPEZOIDAL) ? 4 : 1;
+        for (uint8_t p = 0; p < np; p++) {
+            float x = mf.params[p];
+            if (x > lo + eps && x < hi - eps) pts[n++] = x;
+        }
+    }
+
+    // Sort and drop duplicates
+    for (uint8_t i = 1; i < n; i++) {
+        float v = pts[i];
+        int j = i - 1;
+        while (j >= 0 && pts[j] > v) {
+            pts[j + 1] = pts[j];
+            j--;
+        }
+        pts[j + 1] = v;
+    }
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        if (count == 0 || pts[i] - pts[count - 1] > eps) pts[count++] = pts[i];
+    }
+
+    // Too many breakpoints: drop the interior node whose neighbours are closest
+    while (count > max_nodes && count > 2) {
+        uint8_t best = 1;
+        float best_gap = pts[2] - pts[0];
+        for (uint8_t i = 2; i < count - 1; i++) {
+            float gap = pts[i + 1] - pts[i - 1];
+            if (gap < best_gap) {
+                best_gap = gap;
+                best = i;
+            }
+        }
+        for (uint8_t i = best; i + 1 < count; i++) pts[i] = pts[i + 1];
+        count--;
+    }
+
+    memcpy(nodes, pts, count * sizeof(float));
+    return count;
+}
+
+// Exact engine at n <= FUZZY_BATCH_BLOCK (temperature, trend) points, manual inputs as set
+void FuzzyController::surfaceExact(const rule_bank_t* rb, batch_block_t* s, const float* t, const float* r,
+                                   uint8_t n, surface_point_t* out) {
+    float o[FUZZY_MAX_OUTPUTS][FUZZY_BATCH_BLOCK];
+    float max_firing[FUZZY_BATCH_BLOCK];
+    uint8_t active[FUZZY_BATCH_BLOCK], dominant[FUZZY_BATCH_BLOCK];
+
+    fuzzy_batch_t b;
+    memset(&b, 0, sizeof(b));
+    b.input[FUZZY_IN_TEMPERATURE] = t;
+    b.input[FUZZY_IN_TREND] = r;
+    for (uint8_t c = 0; c < FUZZY_MAX_OUTPUTS; c++) b.output[c] = o[c];
+    b.max_firing = max_firing;
+    b.active_rules = active;
+    b.dominant_rule = dominant;
+    b.count = n;
+    evaluateBlock(rb, b, 0, n, s);
+
+    for (uint8_t k = 0; k < n; k++) {
+        for (uint8_t c = 0; c < FUZZY_MAX_OUTPUTS; c++) out[k].out[c] = o[c][k];
+        out[k].out[FUZZY_MAX_OUTPUTS] = max_firing[k];
+        out[k].active = active[k];
+        out[k].dominant = dominant[k];
+    }
+}
+
+// Node row i = k (temp_axis) or node column j = k
+void FuzzyController::surfaceEvalNodes(surface_t& sf, const rule_bank_t* rb, batch_block_t* s,
+                                       bool temp_axis, uint8_t k) {
+    uint8_t count = temp_axis ? sf.nr : sf.nt;
+    float t[FUZZY_BATCH_BLOCK], r[FUZZY_BATCH_BLOCK];
+    surface_point_t p[FUZZY_BATCH_BLOCK];
+    for (uint8_t base = 0; base < count; base += FUZZY_BATCH_BLOCK) {
+        uint8_t n = min((uint8_t)(count - base), (uint8_t)FUZZY_BATCH_BLOCK);
+        for (uint8_t m = 0; m < n; m++) {
+            t[m] = temp_axis ? sf.t[k] : sf.t[base + m];
+            r[m] = temp_axis ? sf.r[base + m] : sf.r[k];
+        }
+        surfaceExact(rb, s, t, r, n, p);
+        for (uint8_t m = 0; m < n; m++) {
+            uint8_t i = temp_axis ? k : base + m;
+            uint8_t j = temp_axis ? base + m : k;
+            memcpy(sf.out[i][j], p[m].out, sizeof(sf.out[0][0]));
+            sf.active[i][j] = p[m].active;
+            sf.dominant[i][j] = p[m].dominant;
+        }
+    }
+}
+
+static float surfaceResultError(const fuzzy_result_t& lk, const float* ex) {
+    float err = fabsf(ex[FUZZY_OUT_BLOWDOWN] - lk.blowdown_rate);
+    err = max(err, fabsf(ex[FUZZY_OUT_CAUSTIC] - lk.caustic_rate));
+    err = max(err, fabsf(ex[FUZZY_OUT_SULFITE] - lk.sulfite_rate));
+    err = max(err, fabsf(ex[FUZZY_OUT_ACID] - lk.acid_rate));
+    return err;
+}
+
+// |lookup - exact| at the centers of cells [i0, i1) x [j0, j1)
+void FuzzyController::surfaceCellErrors(surface_t& sf, const rule_bank_t* rb, batch_block_t* s,
+                                        uint8_t i0, uint8_t i1, uint8_t j0, uint8_t j1) {
+    float t[FUZZY_BATCH_BLOCK], r[FUZZY_BATCH_BLOCK];
+    uint8_t ci[FUZZY_BATCH_BLOCK], cj[FUZZY_BATCH_BLOCK];
+    surface_point_t p[FUZZY_BATCH_BLOCK];
+    uint8_t n = 0;
+    for (uint8_t i = i0; i < i1; i++) {
+        for (uint8_t j = j0; j < j1; j++) {
+            t[n] = 0.5f * (sf.t[i] + sf.t[i + 1]);
+            r[n] = 0.5f * (sf.r[j] + sf.r[j + 1]);
+            ci[n] = i;
+            cj[n] = j;
+            bool last = (i + 1 == i1) && (j + 1 == j1);
+            if (++n < FUZZY_BATCH_BLOCK && !last) continue;
+
+            surfaceExact(rb, s, t, r, n, p);
+            for (uint8_t m = 0; m < n; m++) {
+                sf.cell_err[ci[m]][cj[m]] = surfaceResultError(lookupSurface(sf, t[m], r[m]), p[m].out);
+            }
+            n = 0;
+        }
+    }
+}
+
+// Split the worst cell along temperature if its error at the temperature-edge midpoints
+// is at least that at the trend-edge midpoints
+bool FuzzyController::surfaceSplitTemp(const surface_t& sf, const rule_bank_t* rb, batch_block_t* s,
+                                       uint8_t wi, uint8_t wj) {
+    float tm = 0.5f * (sf.t[wi] + sf.t[wi + 1]);
+    float rm = 0.5f * (sf.r[wj] + sf.r[wj + 1]);
+    const float t[4] = { tm, tm, sf.t[wi], sf.t[wi + 1] };
+    const float r[4] = { sf.r[wj], sf.r[wj + 1], rm, rm };
+    surface_point_t p[4];
+    surfaceExact(rb, s, t, r, 4, p);
+
+    float e[4];
+    for (uint8_t m = 0; m < 4; m++) e[m] = surfaceResultError(lookupSurface(sf, t[m], r[m]), p[m].out);
+    return max(e[0], e[1]) >= max(e[2], e[3]);
+}
+
+// Insert a node in the middle of interval k of one axis; only the new row/column and the
+// two cells either side of it are evaluated
+void FuzzyController::surfaceSplit(surface_t& sf, const rule_bank_t* rb, batch_block_t* s, bool temp_axis, uint8_t k) {
+    if (temp_axis) {
+        for (uint8_t i = sf.nt; i > k + 1; i--) {
+            sf.t[i] = sf.t[i - 1];
+            memcpy(sf.out[i], sf.out[i - 1], sizeof(sf.out[0]));
+            memcpy(sf.active[i], sf.active[i - 1], sizeof(sf.active[0]));
+            memcpy(sf.dominant[i], sf.dominant[i - 1], sizeof(sf.dominant[0]));
+            memcpy(sf.cell_err[i], sf.cell_err[i - 1], sizeof(sf.cell_err[0]));
+        }
+        sf.t[k + 1] = 0.5f * (sf.t[k] + sf.t[k + 2]);
+        sf.nt++;
+        surfaceEvalNodes(sf, rb, s, true, k + 1);
+        surfaceCellErrors(sf, rb, s, k, k + 2, 0, sf.nr - 1);
+    } else {
+        for (uint8_t i = 0; i < sf.nt; i++) {
+            for (uint8_t j = sf.nr; j > k + 1; j--) {
+                memcpy(sf.out[i][j], sf.out[i][j - 1], sizeof(sf.out[0][0]));
+                sf.active[i][j] = sf.active[i][j - 1];
+                sf.dominant[i][j] = sf.dominant[i][j - 1];
+                sf.cell_err[i][j] = sf.cell_err[i][j - 1];
+            }
+        }
+        for (uint8_t j = sf.nr; j > k + 1; j--) sf.r[j] = sf.r[j - 1];
+        sf.r[k + 1] = 0.5f * (sf.r[k] + sf.r[k + 2]);
+        sf.nr++;
+        surfaceEvalNodes(sf, rb, s, false, k + 1);
+        surfaceCellErrors(sf, rb, s, 0, sf.nt - 1, k, k + 2);
     }
 }
 
+void FuzzyController::buildSurface(surface_t& sf, const rule_bank_t* rb, batch_block_t* s) {
+    uint8_t max_nodes = _surface_nodes.load();
+    float bound = _surface_max_err.load();
+
+    sf.nt = buildSurfaceAxis(FUZZY_IN_TEMPERATURE, sf.t, max_nodes);
+    sf.nr = buildSurfaceAxis(FUZZY_IN_TREND, sf.r, max_nodes);
+    for (uint8_t i = 0; i < sf.nt; i++) surfaceEvalNodes(sf, rb, s, true, i);
+
+    // Bilinear error peaks away from the nodes: check every cell center against the exact engine
+    surfaceCellErrors(sf, rb, s, 0, sf.nt - 1, 0, sf.nr - 1);
+
+    // Refine where the error is: split the worst cell along the axis with the larger edge error
+    float worst;
+    while (true) {
+        uint8_t wi = 0, wj = 0;
+        worst = 0.0f;
+        for (uint8_t i = 0; i + 1 < sf.nt; i++) {
+            for (uint8_t j = 0; j + 1 < sf.nr; j++) {
+                if (sf.cell_err[i][j] > worst) {
+                    worst = sf.cell_err[i][j];
+                    wi = i;
+                    wj = j;
+                }
+            }
+        }
+        if (worst <= bound) break;
+
+        bool can_t = sf.nt < max_nodes;
+        bool can_r = sf.nr < max_nodes;
+        if (!can_t && !can_r) break;
+
+        bool split_t = can_t && (!can_r || surfaceSplitTemp(sf, rb, s, wi, wj));
+        surfaceSplit(sf, rb, s, split_t, split_t ? wi : wj);
+    }
+
+    _surface_err = worst;
+    sf.valid = worst <= bound;
+}
+
+// Index i of the interval nodes[i]..nodes[i+1] containing x (x already within the grid)
+static uint8_t surfaceInterval(const float* nodes, uint8_t n, float x) {
+    uint8_t lo = 0, hi = n - 1;
+    while (hi - lo > 1) {
+        uint8_t mid = (lo + hi) / 2;
+        if (nodes[mid] <= x) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+fuzzy_result_t FuzzyController::lookupSurface(const surface_t& sf, float temperature, float trend) const {
+    uint8_t i = surfaceInterval(sf.t, sf.nt, temperature);
+    uint8_t j = surfaceInterval(sf.r, sf.nr, trend);
+    float fx = (temperature - sf.t[i]) / (sf.t[i + 1] - sf.t[i]);
+    float fy = (trend - sf.r[j]) / (sf.r[j + 1] - sf.r[j]);
+
+    float v[FUZZY_MAX_OUTPUTS + 1];
+    for (uint8_t c = 0; c <= FUZZY_MAX_OUTPUTS; c++) {
+        float v0 = sf.out[i][j][c] + (sf.out[i + 1][j][c] - sf.out[i][j][c]) * fx;
+        float v1 = sf.out[i][j + 1][c] + (sf.out[i + 1][j + 1][c] - sf.out[i][j + 1][c]) * fx;
+        v[c] = v0 + (v1 - v0) * fy;
+    }
+
+    fuzzy_result_t result = {0};
+    result.blowdown_rate = v[FUZZY_OUT_BLOWDOWN];
+    result.caustic_rate = v[FUZZY_OUT_CAUSTIC];
+    result.sulfite_rate = v[FUZZY_OUT_SULFITE];
+    result.acid_rate = v[FUZZY_OUT_ACID];
+    result.max_firing_strength = v[FUZZY_MAX_OUTPUTS];
+
+    // Rule diagnostics are not interpolable: report the nearest node
+    uint8_t ni = (fx < 0.5f) ? i : i + 1;
+    uint8_t nj = (fy < 0.5f) ? j : j + 1;
+    result.active_rules = sf.active[ni][nj];
+    result.dominant_rule = sf.dominant[ni][nj];
+    return result;
+}
+
 // ============================================================================
 // DEBUG OUTPUT
 // ============================================================================
 
 void FuzzyController::printDebugInfo() {
     Serial.println("\n=== Fuzzy Controller State ===");
-    Serial.printf("Rules: %d active of %d\n", getActiveRuleCount(), _num_rules);
+    Serial.printf("Rules: %d active of %d\n", getActiveRuleCount(), live()->num_rules);
 
     Serial.println("\nInput Membership Degrees:");
     for (uint8_t i = 0; i < FUZZY_INPUT_COUNT; i++) {
-        Serial.printf("  %s: ", _inputs[i].name);
-        for (uint8_t j = 0; j < _inputs[i].num_sets; j++) {
+        Serial.printf("  %s: ", _inputs[i]->name);
+        for (uint8_t j = 0; j < _inputs[i]->num_sets; j++) {
             Serial.printf("%.2f ", _input_membership[i][j]);
         }
         Serial.println();
@@ -0,0 +1,289 @@
+/**
+ * @file historian.cpp
+ * @brief In-RAM multi-resolution trend history
+ */
+
+#include "historian.h"
+
+// Global instance
+Historian historian;
+
+static const uint32_t s_period[HIST_TIERS] = { 1, 60, 3600 };
+static const uint16_t s_slots[HIST_TIERS] = { HIST_RAW_SLOTS, HIST_MINUTE_SLOTS, HIST_HOUR_SLOTS };
+
+static const float s_scale[HIST_CHANNELS] = { 1.0f, 10.0f, 100.0f, 100.0f };
+static const char* const s_names[HIST_CHANNELS] = { "conductivity", "temperature", "flow", "valve_mA" };
+static const char* const s_units[HIST_CHANNELS] = { "uS/cm", "C", "gpm", "mA" };
+
+static int16_t encode(float v, uint8_t ch) {
+    float q = roundf(v * s_scale[ch]);
+    if (q < (float)(INT16_MIN + 1)) return INT16_MIN + 1;      // INT16_MIN marks an empty slot
+    if (q > (float)INT16_MAX) return INT16_MAX;
+    return (int16_t)q;
+}
+
+static float decode(int16_t q, uint8_t ch) {
+    return q / s_scale[ch];
+}
+
+// ============================================================================
+// CONSTRUCTOR / INITIALIZATION
+// ============================================================================
+
+Historian::Historian()
+    : _mem(nullptr)
+    , _mem_bytes(0)
+    , _seq(0)
+{
+    memset(_tier, 0, sizeof(_tier));
+}
+
+bool Historian::begin() {
+    if (_mem) return true;
+
+    // One allocation for all tiers: raw keeps one value per slot, the others three
+    size_t values = 0;
+    for (uint8_t l = 0; l < HIST_TIERS; l++) {
+        values += (size_t)s_slots[l] * HIST_CHANNELS * (l == 0 ? 1 : 3);
+    }
+    int16_t* p = (int16_t*)malloc(values * sizeof(int16_t));
+    if (!p) {
+        Serial.println("Historian: allocation failed");
+        return false;
+    }
+    for (size_t i = 0; i < values; i++) p[i] = HIST_EMPTY;
+    _mem = p;
+    _mem_bytes = values * sizeof(int16_t);
+
+    for (uint8_t l = 0; l < HIST_TIERS; l++) {
+        tier_t& tr = _tier[l];
+        size_t n = (size_t)s_slots[l] * HIST_CHANNELS;
+        tr.period = s_period[l];
+        tr.slots = s_slots[l];
+        tr.started = false;
+        tr.avg = p;
+        p += n;
+        if (l > 0) {
+            tr.min = p;
+            p += n;
+            tr.max = p;
+            p += n;
+        }
+    }
+    Serial.printf("Historian: %u bytes (%us raw, %u min, %u h)\n",
+                  (unsigned)_mem_bytes, HIST_RAW_SLOTS, HIST_MINUTE_SLOTS, HIST_HOUR_SLOTS);
+    return true;
+}
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+bool Historian::record(uint32_t t_sec, const float values[HIST_CHANNELS]) {
+    if (!_mem) return false;
+    tier_t& raw = _tier[0];
+    if (raw.started && t_sec < raw.open) return false;
+
+    uint32_t s = _seq.load(std::memory_order_relaxed);
+    _seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    advance(0, t_sec);
+    for (uint8_t ch = 0; ch < HIST_CHANNELS; ch++) {
+        float v = values[ch];
+        if (isnan(v)) continue;
+        acc_t& a = raw.acc[ch];
+        a.sum += v;
+        a.min = min(a.min, v);
+        a.max = max(a.max, v);
+        a.n++;
+    }
+
+    _seq.store(s + 2, std::memory_order_release);
+    return true;
+}
+
+void Historian::advance(uint8_t level, uint32_t t_sec) {
+    tier_t& tr = _tier[level];
+    uint32_t p = t_sec / tr.period;
+    if (!tr.started) {
+        tr.started = true;
+        tr.open = p;
+        for (uint8_t ch = 0; ch < HIST_CHANNELS; ch++) tr.acc[ch] = { 0.0f, INFINITY, -INFINITY, 0 };
+        return;
+    }
+    if (p <= tr.open) return;
+
+    // Close the open bucket into its slot
+    uint32_t closed = tr.open;
+    acc_t carry[HIST_CHANNELS];
+    memcpy(carry, tr.acc, sizeof(carry));
+    size_t base = (size_t)(closed % tr.slots) * HIST_CHANNELS;
+    for (uint8_t ch = 0; ch < HIST_CHANNELS; ch++) {
+        const acc_t& a = carry[ch];
+        tr.avg[base + ch] = a.n ? encode(a.sum / a.n, ch) : HIST_EMPTY;
+        if (tr.min) {
+            tr.min[base + ch] = a.n ? encode(a.min, ch) : HIST_EMPTY;
+            tr.max[base + ch] = a.n ? encode(a.max, ch) : HIST_EMPTY;
+        }
+    }
+
+    // Periods skipped by a gap hold no data (at most one lap of the ring)
+    uint32_t gap = min(p - closed - 1, (uint32_t)tr.slots);
+    for (uint32_t k = 1; k <= gap; k++) clearSlot(tr, closed + k);
+
+    tr.open = p;
+    for (uint8_t ch = 0; ch < HIST_CHANNELS; ch++) tr.acc[ch] = { 0.0f, INFINITY, -INFINITY, 0 };
+
+    // Cascade: the closed bucket is one sample of the next tier's open bucket
+    if (level + 1 < HIST_TIERS) feed(level + 1, closed * tr.period, carry);
+}
+
+void Historian::feed(uint8_t level, uint32_t t_sec, const acc_t* carry) {
+    advance(level, t_sec);
+    tier_t& tr = _tier[level];
+    for (uint8_t ch = 0; ch < HIST_CHANNELS; ch++) {
+        if (carry[ch].n == 0) continue;
+        acc_t& a = tr.acc[ch];
+        a.sum += carry[ch].sum;
+        a.min = min(a.min, carry[ch].min);
+        a.max = max(a.max, carry[ch].max);
+        a.n += carry[ch].n;
+    }
+}
+
+void Historian::clearSlot(tier_t& tr, uint32_t period_no) {
+    size_t base = (size_t)(period_no % tr.slots) * HIST_CHANNELS;
+    for (uint8_t ch = 0; ch < HIST_CHANNELS; ch++) {
+        tr.avg[base + ch] = HIST_EMPTY;
+        if (tr.min) {
+            tr.min[base + ch] = HIST_EMPTY;
+            tr.max[base + ch] = HIST_EMPTY;
+        }
+    }
+}
+
+// ============================================================================
+// QUERIES
+// ============================================================================
+
+bool Historian::readSlot(const tier_t& tr, uint32_t period_no, uint8_t ch,
+                         float* mn, float* av, float* mx) const {
+    if (!tr.started || period_no > tr.open) return false;
+    if (period_no == tr.open) {
+        // Bucket still accumulating
+        const acc_t& a = tr.acc[ch];
+        if (a.n == 0) return false;
+        *mn = a.min;
+        *av = a.sum / a.n;
+        *mx = a.max;
+        return true;
+    }
+    if (tr.open - period_no > tr.slots) return false;      // Overwritten
+
+    size_t i = (size_t)(period_no % tr.slots) * HIST_CHANNELS + ch;
+    if (tr.avg[i] == HIST_EMPTY) return false;
+    *av = decode(tr.avg[i], ch);
+    *mn = tr.min ? decode(tr.min[i], ch) : *av;
+    *mx = tr.max ? decode(tr.max[i], ch) : *av;
+    return true;
+}
+
+uint8_t Historian::tierFor(uint32_t from) const {
+    for (uint8_t l = 0; l < HIST_TIERS; l++) {
+        const tier_t& tr = _tier[l];
+        if (!tr.started) continue;
+        uint32_t oldest = (tr.open > tr.slots ? tr.open - tr.slots : 0) * tr.period;
+        if (from >= oldest) return l;
+    }
+    return HIST_TIERS - 1;
+}
+
+uint32_t Historian::resolutionFor(uint32_t from) const {
+    return _tier[tierFor(from)].period;
+}
+
+uint32_t Historian::getOldest() const {
+    for (int8_t l = HIST_TIERS - 1; l >= 0; l--) {
+        const tier_t& tr = _tier[l];
+        if (tr.started) return (tr.open > tr.slots ? tr.open - tr.slots : 0) * tr.period;
+    }
+    return 0;
+}
+
+size_t Historian::queryOnce(uint8_t channel, uint32_t from, uint32_t to, uint32_t step_s,
+                            hist_point_t* out, size_t max_points, uint32_t* resume) const {
+    *resume = to + 1;
+    const tier_t& tr = _tier[tierFor(from)];
+    if (!tr.started) return 0;
+
+    // Only the retained periods are visited, whatever the requested range
+    uint32_t period = tr.period;
+    uint32_t step = ((max(step_s, period) + period - 1) / period) * period;
+    uint32_t oldest = (tr.open > tr.slots ? tr.open - tr.slots : 0) * period;
+    uint32_t newest = tr.open * period + (period - 1);
+    if (from < oldest) from = oldest;
+    if (to > newest) to = newest;
+
+    size_t n = 0;
+    for (uint32_t b = from / step * step; b <= to; b += step) {
+        if (n == max_points) {
+            *resume = b;
+            return n;
+        }
+        float mn = INFINITY, mx = -INFINITY, sum = 0.0f;
+        uint32_t count = 0;
+        for (uint32_t p = b / period; p < (b + step) / period; p++) {
+            float a, lo, hi;
+            if (!readSlot(tr, p, channel, &lo, &a, &hi)) continue;
+            mn = min(mn, lo);
+            mx = max(mx, hi);
+            sum += a;
+            count++;
+        }
+        if (count) out[n++] = { b, mn, sum / count, mx };
+        if (b > UINT32_MAX - step) break;
+    }
+    return n;
+}
+
+size_t Historian::query(uint8_t channel, uint32_t from, uint32_t to, uint32_t step_s,
+                        hist_point_t* out, size_t max_points, uint32_t* resume) const {
+    uint32_t next;
+    if (!resume) resume = &next;
+    *resume = to + 1;
+    if (!_mem || channel >= HIST_CHANNELS || !out || max_points == 0 || from > to) return 0;
+
+    // Sequence counter: a copy taken while record() ran is discarded and retried
+    for (uint8_t attempt = 0; attempt < 3; attempt++) {
+        uint32_t s1 = _seq.load(std::memory_order_acquire);
+        if (s1 & 1) {
+            delay(1);
+            continue;
+        }
+        size_t n = queryOnce(channel, from, to, step_s, out, max_points, resume);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_seq.load(std::memory_order_relaxed) == s1) return n;
+    }
+    *resume = from;
+    return 0;
+}
+
+// ============================================================================
+// CHANNELS
+// ============================================================================
+
+const char* Historian::channelName(uint8_t channel) {
+    return channel < HIST_CHANNELS ? s_names[channel] : "";
+}
+
+const char* Historian::channelUnit(uint8_t channel) {
+    return channel < HIST_CHANNELS ? s_units[channel] : "";
+}
+
+int Historian::channelIndex(const char* name) {
+    for (uint8_t ch = 0; ch < HIST_CHANNELS; ch++) {
+        if (strcmp(name, s_names[ch]) == 0) return ch;
+    }
+    return -1;
+}
@@ -23,6 +23,7 @@
 #include <SPI.h>
 
 #include "config.h"
+#include "config_migrate.h"
 #include "pin_definitions.h"
 #include "conductivity.h"
 #include "chemical_pump.h"
@@ -31,9 +32,14 @@
 #include "display.h"
 #include "data_logger.h"
 #include "sd_logger.h"
+#include "telemetry_spool.h"
+#include "net_outbox.h"
 #include "web_server.h"
 #include "mqtt_telemetry.h"
 #include "fuzzy_logic.h"
+#include "mpc_dosing.h"
+#include "plant_id.h"
+#include "historian.h"
 #include "device_manager.h"
 #include "encoder.h"
 #include "self_test.h"
@@ -83,12 +89,15 @@ TaskHandle_t taskControl = NULL;
 TaskHandle_t taskMeasurement = NULL;
 TaskHandle_t taskDisplay = NULL;
 TaskHandle_t taskLogging = NULL;
+TaskHandle_t taskSdWriter = NULL;
+TaskHandle_t taskNetwork = NULL;
 
 // Conductivity history for trend (rate of change µS/cm per minute)
 #define COND_HISTORY_MIN_MS 60000   // Min 1 minute between samples for trend
 static float s_cond_history_value = 0.0f;
 static uint32_t s_cond_history_time = 0;
 static bool s_cond_history_valid = false;
+static float s_cond_trend = 0.0f;           // Last computed trend (µS/cm per min), held between updates
 
 // Pending API command (executed in control task context; Modern IoT Stack)
 #define PENDING_CMD_NAME_LEN       24
@@ -119,18 +128,26 @@ static bool handleApiCommand(const char* request_id, const char* name, const Jso
 
 void loadConfiguration();
 void saveConfiguration();
+void loadFuzzyRuleBase();
+bool saveFuzzyRuleBase(const uint8_t* data, size_t len);
+void applyFuzzySurfaceConfig();
+void eraseFuzzyRuleBase();
 void initializeDefaults();
 void checkAlarms();
 void processInputs();
 void logSensorData();
 void updateFeedwaterPumpMonitor();
 void saveFeedwaterPumpNVS();
+static uint32_t forwardSpooled(const spool_record_t* recs, const uint32_t* next, uint32_t count);
+static void deliverNetMessage(const net_msg_t* msg);
 
 // FreeRTOS task functions
 void taskControlLoop(void* parameter);
 void taskMeasurementLoop(void* parameter);
 void taskDisplayLoop(void* parameter);
 void taskLoggingLoop(void* parameter);
+void taskSdWriterLoop(void* parameter);
+void taskNetworkLoop(void* parameter);
 
 // ============================================================================
 // SETUP
@@ -168,6 +185,10 @@ void setup() {
 
     // Load configuration from NVS
     loadConfiguration();
+    fuzzyController.begin(&systemConfig.fuzzy);     // Default rules, replaced by a stored rule base
+    loadFuzzyRuleBase();
+    fuzzyController.enableTrace();  // Before the control task starts evaluating
+    applyFuzzySurfaceConfig();      // Built by the logging task; exact until then
 
     // Initialize device manager (uses enabled_devices from config)
     deviceManager.begin(&systemConfig.enabled_devices);
@@ -196,11 +217,15 @@ void setup() {
 
 #ifdef USE_COPROCESSOR_LINK
     // RS-485 link to panel (conductivity/temp on panel)
+    coprocessorLink.addNode(CP_ADDR_DEFAULT, CP_LINK_POLL_INTERVAL_MS, 1);
+    for (uint8_t addr = CP_ADDR_DEFAULT + 1; addr <= CP_LINK_PANEL_COUNT && addr <= CP_ADDR_MAX; addr++) {
+        coprocessorLink.addNode(addr, CP_LINK_SECONDARY_POLL_MS, 0);
+    }
     if (!coprocessorLink.begin(CP_LINK_BAUD)) {
         Serial.println("ERROR: Coprocessor link initialization failed!");
         display.showAlarm("LINK ERROR");
     } else {
-        Serial.println("Coprocessor link initialized (2-DevKit mode)");
+        Serial.printf("Coprocessor link initialized (%u panel node(s))\n", coprocessorLink.getNodeCount());
     }
 #else
     // Conductivity sensor (hardware SPI via shared VSPI)
@@ -230,10 +255,15 @@ void setup() {
     }
     blowdownController.configure(&systemConfig.blowdown);
     blowdownController.setConductivityConfig(&systemConfig.conductivity);
+    plantId.begin(&systemConfig.blowdown, &systemConfig.conductivity);
+    historian.begin();
 #ifdef USE_COPROCESSOR_LINK
     s_last_blowdown_energized = false;
 #endif
 
+    // Outbound telemetry queue (sent by the network task)
+    netOutbox.begin();
+
     // Data logger
     if (!dataLogger.begin(&systemConfig)) {
         Serial.println("WARNING: Data logger initialization failed!");
@@ -275,6 +305,9 @@ void setup() {
         delay(500);
     }
 
+    // Telemetry spool: bridges MQTT/HTTP outages on the SD card
+    telemetrySpool.begin(forwardSpooled);
+
     // Log boot event to SD (includes reset reason)
     if (sdLogger.isAvailable()) {
         sdLogger.logEvent("BOOT", selfTest.getResetReasonString(),
@@ -357,6 +390,30 @@ void setup() {
         display.showAlarm("INIT FAIL");
         for (;;) { delay(1000); }
     }
+    if (xTaskCreatePinnedToCore(
+            taskSdWriterLoop,
+            "SDWriter",
+            TASK_STACK_SD_WRITER,
+            NULL,
+            TASK_PRIORITY_SD_WRITER,
+            &taskSdWriter,
+            0) != pdPASS) {
+        Serial.println("FATAL: SD writer task creation failed");
+        display.showAlarm("INIT FAIL");
+        for (;;) { delay(1000); }
+    }
+    if (xTaskCreatePinnedToCore(
+            taskNetworkLoop,
+            "Network",
+            TASK_STACK_NETWORK,
+            NULL,
+            TASK_PRIORITY_NETWORK,
+            &taskNetwork,
+            0) != pdPASS) {
+        Serial.println("FATAL: Network task creation failed");
+        display.showAlarm("INIT FAIL");
+        for (;;) { delay(1000); }
+    }
 
     // Initialization complete
     Serial.println("Initialization complete!");
@@ -529,18 +586,37 @@ void taskControlLoop(void* parameter) {
         uint32_t water_contacts = waterMeterManager.getContactsSinceLast(2);  // Both meters
         float water_volume = waterMeterManager.getVolumeSinceLast(2);
 
-        // Conductivity trend (µS/cm per minute)
-        float cond_trend = 0.0f;
-        uint32_t now_ms = millis();
-        if (s_cond_history_valid && (now_ms - s_cond_history_time) >= COND_HISTORY_MIN_MS) {
-            float dt_min = (now_ms - s_cond_history_time) / 60000.0f;
-            if (dt_min > 0.0f) {
-                cond_trend = (conductivity - s_cond_history_value) / dt_min;
+        // Online plant identification; a valid fit sets the MPC model's blowdown flow
+        if (plantId.update(millis(), conductivity, blowdownController.isActive(), water_volume)) {
+            const plant_id_params_t& plant = plantId.getParams();
+            if (plant.valid) {
+                mpc_model_t model = mpcDosing.getModel();
+                model.blowdown_gpm = plant.blowdown_rate * 60.0f * model.boiler_volume_gal;
+                mpcDosing.setModel(model);
             }
         }
-        s_cond_history_value = conductivity;
-        s_cond_history_time = now_ms;
-        s_cond_history_valid = true;
+
+        // Conductivity trend (µS/cm per minute)
+        // Sample time is when the reading was taken: with the coprocessor link that is the
+        // panel timestamp mapped onto our millis(), not the (jittered) arrival/poll time.
+        uint32_t sample_ms = millis();
+#ifdef USE_COPROCESSOR_LINK
+        {
+            const cp_link_telemetry_t& t = coprocessorLink.getLastTelemetry();
+            if (t.valid) sample_ms = t.sample_local_ms;
+        }
+#endif
+        if (!s_cond_history_valid) {
+            s_cond_history_value = conductivity;
+            s_cond_history_time = sample_ms;
+            s_cond_history_valid = true;
+        } else if ((int32_t)(sample_ms - s_cond_history_time) >= (int32_t)COND_HISTORY_MIN_MS) {
+            float dt_min = (int32_t)(sample_ms - s_cond_history_time) / 60000.0f;
+            s_cond_trend = (conductivity - s_cond_history_value) / dt_min;
+            s_cond_history_value = conductivity;
+            s_cond_history_time = sample_ms;
+        }
+        float cond_trend = s_cond_trend;
 
         // Build fuzzy inputs from current readings and manual test values
         fuzzy_inputs_t fuzzy_inputs;
@@ -586,13 +662,37 @@ void taskControlLoop(void* parameter) {
             }
         }
 
-        // Process pump feed modes with fuzzy rates for Mode F
+        // Model predictive dosing (Mode M): plans per 5 min step for pumps that select it,
+        // limited by the same max ml/min as Mode F
+        const float mpc_setpoint[] = {
+            systemConfig.fuzzy.ph_setpoint,
+            systemConfig.fuzzy.alk_setpoint,
+            systemConfig.fuzzy.sulfite_setpoint
+        };
+        const float mpc_deadband[] = {
+            systemConfig.fuzzy.ph_deadband,
+            systemConfig.fuzzy.alk_deadband,
+            systemConfig.fuzzy.sulfite_deadband
+        };
+        float mpc_rates[PUMP_COUNT];
+        for (int i = 0; i < PUMP_COUNT; i++) {
+            mpcDosing.setTarget(i, mpc_setpoint[i], mpc_deadband[i], max_ml_min[i]);
+            mpcDosing.setEnabled(i, systemConfig.pumps[i].feed_mode == FEED_MODE_M_MPC);
+        }
+        mpcDosing.pollManualInputs(fuzzyController);
+        mpcDosing.update(millis(), water_volume, blowdownController.isActive());
+        for (int i = 0; i < PUMP_COUNT; i++) {
+            mpc_rates[i] = mpcDosing.getRate(i);
+        }
+
+        // Process pump feed modes with fuzzy rates for Mode F, planned rates for Mode M
         pumpManager.processFeedModes(
             blowdownController.isActive(),
             blowdownController.getAccumulatedTime(),
             water_contacts,
             water_volume,
-            fuzzy_rates
+            fuzzy_rates,
+            mpc_rates
         );
 
         // Update pumps (run steppers)
@@ -614,8 +714,12 @@ void taskMeasurementLoop(void* parameter) {
         esp_task_wdt_reset();  // Feed the watchdog
 
 #ifndef USE_COPROCESSOR_LINK
-        // Read conductivity sensor (acquires shared SPI bus for MAX31865)
-        if (xSemaphoreTake(spiMutex, pdMS_TO_TICKS(500)) == pdTRUE) {
+        // Read conductivity sensor (acquires shared SPI bus for MAX31865;
+        // the wait is how long an SD block write held the bus)
+        uint32_t busWaitStart = micros();
+        bool busAcquired = xSemaphoreTake(spiMutex, pdMS_TO_TICKS(500)) == pdTRUE;
+        sdLogger.noteSensorBusWait(micros() - busWaitStart, busAcquired);
+        if (busAcquired) {
             conductivity_reading_t reading = conductivitySensor.read();
             xSemaphoreGive(spiMutex);
 
@@ -682,16 +786,6 @@ void taskLoggingLoop(void* parameter) {
     while (true) {
         esp_task_wdt_reset();  // Feed the watchdog
 
-        // Update data logger (handle WiFi reconnection, etc.)
-        dataLogger.update();
-
-        // MQTT telemetry (Phase C): maintain connection, flush buffer
-        mqttTelemetry.update();
-        webServer.setMqttConnected(mqttTelemetry.isConnected());
-
-        // Update SD logger (periodic flush)
-        sdLogger.update();
-
         // Service web server requests (AP + STA clients)
         webServer.handleClient();
         webServer.checkManualTestExpiry();
@@ -709,6 +803,18 @@ void taskLoggingLoop(void* parameter) {
             webServer.broadcastState();
         }
 
+        // Trend history for the web UI (1 s buckets, independent of WiFi and SD)
+        float trend[HIST_CHANNELS];
+        trend[HIST_CH_CONDUCTIVITY] = sensorHealth.isConductivityValid() ? systemState.conductivity_calibrated : NAN;
+        trend[HIST_CH_TEMPERATURE] = sensorHealth.isTemperatureValid() ? systemState.temperature_celsius : NAN;
+        trend[HIST_CH_FLOW] = waterMeterManager.getCombinedFlowRate();
+        trend[HIST_CH_VALVE_MA] = blowdownController.getFeedbackmA();
+        historian.record(now / 1000, trend);
+
+        // Fuzzy control surface for the current manual inputs, rules and config: built
+        // here so the control task never waits for it (no-op while it is up to date)
+        fuzzyController.updateSurface();
+
         // Log sensor data at configured interval
         if (now - lastLogTime >= systemConfig.log_interval_ms) {
             lastLogTime = now;
@@ -731,19 +837,81 @@ void taskLoggingLoop(void* parameter) {
     }
 }
 
+// Sink for the telemetry spool: the path live telemetry takes. MQTT confirms
+// records on the ack echo; an HTTP reply is the confirmation
+static uint32_t forwardSpooled(const spool_record_t* recs, const uint32_t* next, uint32_t count) {
+    if (systemConfig.use_mqtt_telemetry) {
+        return mqttTelemetry.sendSpooled(recs, next, count);
+    }
+    uint32_t done = dataLogger.sendSpooled(recs, count);
+    if (done > 0) telemetrySpool.confirm(next[done - 1]);
+    return done;
+}
+
+// Queued telemetry to the link it was queued for
+static void deliverNetMessage(const net_msg_t* msg) {
+    if (msg->sink == NET_SINK_MQTT) {
+        mqttTelemetry.deliver(msg);
+    } else {
+        dataLogger.deliver(msg);
+    }
+}
+
+void taskNetworkLoop(void* parameter) {
+    esp_task_wdt_add(NULL);  // Subscribe this task to watchdog
+    uint32_t lastUpkeep = 0;
+    net_msg_t msg;
+
+    while (true) {
+        esp_task_wdt_reset();  // Feed the watchdog
+
+        // The only task talking to the telemetry servers: connection upkeep,
+        // buffered and spooled uploads once per period, queued messages as
+        // they arrive
+        uint32_t now = millis();
+        if (now - lastUpkeep >= NET_TASK_PERIOD_MS) {
+            lastUpkeep = now;
+
+            // Update data logger (handle WiFi reconnection, etc.)
+            dataLogger.update();
+
+            // MQTT telemetry (Phase C): maintain connection, flush buffer
+            mqttTelemetry.update();
+            webServer.setMqttConnected(mqttTelemetry.isConnected());
+
+            // Replay telemetry spooled during an outage (bounded per cycle;
+            // over MQTT as much as the outbound queue has room for)
+            if (systemConfig.use_mqtt_telemetry) {
+                telemetrySpool.drain(mqttTelemetry.isConnected(), mqttTelemetry.getQueueRoom());
+            } else {
+                telemetrySpool.drain(dataLogger.isWiFiConnected());
+            }
+        }
+
+        uint32_t wait = NET_TASK_PERIOD_MS - (millis() - lastUpkeep);
+        if (wait > NET_TASK_PERIOD_MS) wait = 0;
+        if (netOutbox.pop(&msg, wait)) {
+            deliverNetMessage(&msg);
+        }
+    }
+}
+
+void taskSdWriterLoop(void* parameter) {
+    esp_task_wdt_add(NULL);  // Subscribe this task to watchdog
+
+    while (true) {
+        esp_task_wdt_reset();  // Feed the watchdog
+
+        // Sleeps until a log message is queued (or the hold timer), then
+        // writes whole blocks; the only task that writes the SD card
+        sdLogger.runWriter(SD_WRITER_WAIT_MS);
+    }
+}
+
 // ============================================================================
 // CONFIGURATION MANAGEMENT
 // ============================================================================
 
-// Apply defaults for MQTT/telemetry fields only (e.g. after migration from older config)
-static void applyMqttConfigDefaults() {
-    memset(systemConfig.mqtt_host, 0, sizeof(systemConfig.mqtt_host));
-    systemConfig.mqtt_port = MQTT_PORT_DEFAULT;
-    memset(systemConfig.mqtt_user, 0, sizeof(systemConfig.mqtt_user));
-    memset(systemConfig.mqtt_pass, 0, sizeof(systemConfig.mqtt_pass));
-    systemConfig.use_mqtt_telemetry = false;
-}
-
 void loadConfiguration() {
     Serial.println("Loading configuration from NVS...");
 
@@ -790,10 +958,10 @@ void loadConfiguration() {
             initializeDefaults();
             return;
         }
-        // Zero the remainder and set defaults for new MQTT/telemetry fields
-        memset((uint8_t*)&systemConfig + config_size, 0, sizeof(system_config_t) - config_size);
-        applyMqttConfigDefaults();
-        Serial.println("Configuration migrated (older size); MQTT defaults applied");
+        // Zero only the appended fields; MQTT defaults only if the blob predates them
+        bool mqtt_defaults = config_migrate(&systemConfig, config_size);
+        Serial.printf("Configuration migrated (%u -> %u bytes)%s\n", (unsigned)config_size,
+                      (unsigned)sizeof(system_config_t), mqtt_defaults ? "; MQTT defaults applied" : "");
         saveConfiguration();
         return;
     }
@@ -834,6 +1002,53 @@ void saveConfiguration() {
     Serial.println("Configuration saved");
 }
 
+// Fuzzy control surface settings from the config (boot and POST /api/config)
+void applyFuzzySurfaceConfig() {
+    if (systemConfig.fuzzy_surface_off) {
+        fuzzyController.disableSurface();
+        return;
+    }
+    uint8_t nodes = systemConfig.fuzzy_surface_nodes ? systemConfig.fuzzy_surface_nodes : FUZZY_SURFACE_DEFAULT_NODES;
+    float max_err = systemConfig.fuzzy_surface_max_err > 0.0f ? systemConfig.fuzzy_surface_max_err
+                                                               : FUZZY_SURFACE_DEFAULT_MAX_ERR;
+    fuzzyController.enableSurface(nodes, max_err);
+}
+
+// Uploaded fuzzy rule base (POST /api/fuzzy/rules). Stored as the validated blob; the
+// controller keeps its default rules when none is stored or the blob fails validation.
+void loadFuzzyRuleBase() {
+    preferences.begin(NVS_NAMESPACE, true);
+    size_t len = preferences.getBytesLength(NVS_KEY_FUZZY_RULES);
+    if (len > FUZZY_RB_MAX_SIZE) len = 0;
+    // Up to ~4 KB with Sugeno consequents: heap, not the setup() stack
+    uint8_t* blob = len > 0 ? (uint8_t*)malloc(len) : nullptr;
+    if (blob) len = preferences.getBytes(NVS_KEY_FUZZY_RULES, blob, len);
+    preferences.end();
+
+    if (!blob) return;
+    fuzzy_rb_status_t st = len ? fuzzyController.loadRuleBase(blob, len) : FUZZY_RB_ERR_LENGTH;
+    if (st == FUZZY_RB_OK) {
+        Serial.printf("Fuzzy rule base loaded from NVS (%d rules%s)\n", blob[3],
+                      blob[2] == FUZZY_RB_VERSION_SUGENO ? ", Sugeno consequents" : "");
+    } else {
+        Serial.printf("Stored fuzzy rule base rejected (%s) - using defaults\n", fuzzy_rb_status_name(st));
+    }
+    free(blob);
+}
+
+bool saveFuzzyRuleBase(const uint8_t* data, size_t len) {
+    preferences.begin(NVS_NAMESPACE, false);
+    size_t written = preferences.putBytes(NVS_KEY_FUZZY_RULES, data, len);
+    preferences.end();
+    return written == len;
+}
+
+void eraseFuzzyRuleBase() {
+    preferences.begin(NVS_NAMESPACE, false);
+    preferences.remove(NVS_KEY_FUZZY_RULES);
+    preferences.end();
+}
+
 // API command handler: validate and queue for execution in control task (Modern IoT Stack)
 static bool handleApiCommand(const char* request_id, const char* name, const JsonObject& params, String* outMessage) {
     if (!request_id || !name || !outMessage) return false;
@@ -1214,6 +1429,16 @@ void logSensorData() {
     sensor_reading_t reading;
 
     reading.timestamp = dataLogger.getTimestamp();
+#ifdef USE_COPROCESSOR_LINK
+    {
+        // Stamp with the panel sample time (aligned to our clock), not the log tick
+        const cp_link_telemetry_t& t = coprocessorLink.getLastTelemetry();
+        uint32_t age_ms = millis() - t.sample_local_ms;
+        if (t.valid && (int32_t)age_ms > 0 && reading.timestamp > age_ms / 1000) {
+            reading.timestamp -= age_ms / 1000;
+        }
+    }
+#endif
     reading.conductivity = systemState.conductivity_calibrated;
     reading.temperature = systemState.temperature_celsius;
     reading.water_meter1 = waterMeterManager.getMeter(0)->getTotalVolume();
@@ -1244,7 +1469,8 @@ void logSensorData() {
     // MQTT telemetry (Phase C): publish to device/{id}/metrics or buffer if offline
     mqttTelemetry.publishReading(&reading);
 
-    // Log to SD card (always-on local storage)
+    // Log to SD card (always-on local storage); format follows the config
+    sdLogger.setFormat(systemConfig.sd_log_format);
     sdLogger.logReading(&reading);
 }
 
@@ -0,0 +1,265 @@
+/**
+ * @file mpc_dosing.cpp
+ * @brief Model predictive dosing (feed mode M) implementation
+ */
+
+#include "mpc_dosing.h"
+#include "fuzzy_logic.h"
+
+// Global instance
+MpcDosing mpcDosing;
+
+// Default plant: ~10 cycles of concentration at 0.5 gpm makeup and 0.05 gpm mean blowdown
+static const mpc_model_t s_default_model = {
+    MPC_DEFAULT_BOILER_GAL,
+    MPC_DEFAULT_BLOWDOWN_GPM,
+    {
+        // H2SO3 pump ← acid rate: hydroxide, undosed ≈ cycles x load ≈ 6.3 mmol/L (pH 11.8)
+        { FUZZY_IN_PH,         true,  -0.1f,   0.63f, 0.0f,  MPC_DEFAULT_MOVE_WEIGHT },
+        // NaOH pump ← caustic rate: alkalinity, 25 % NaOH ≈ 100 ppm·gal/ml as CaCO3
+        { FUZZY_IN_ALKALINITY, false, 100.0f, 20.0f,  0.0f,  MPC_DEFAULT_MOVE_WEIGHT },
+        // Amine pump ← sulfite rate: catalysed sulfite ≈ 30 ppm·gal/ml, dissolved O2 in makeup consumes it
+        { FUZZY_IN_SULFITE,    false, 30.0f,  -4.0f,  0.05f, MPC_DEFAULT_MOVE_WEIGHT },
+    }
+};
+
+MpcDosing::MpcDosing() {
+    begin();
+}
+
+void MpcDosing::begin() {
+    _model = s_default_model;
+    memset(_ch, 0, sizeof(_ch));
+    memset(&_status, 0, sizeof(_status));
+    memset(_plan, 0, sizeof(_plan));
+    memset(_x, 0, sizeof(_x));
+    for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+        _ch[i].deadband = 1.0f;
+        _ch[i].max_ml_min = MPC_DEFAULT_MAX_ML_MIN;
+        _pending[i] = 0.0f;
+        _pending_valid[i] = false;
+        _since_test_min[i] = 0.0f;
+        _last_manual[i] = 0.0f;
+        _last_manual_valid[i] = false;
+    }
+    _started = false;
+    _last_ms = 0;
+    _step_start_ms = 0;
+    _step_makeup_gal = 0.0f;
+    _step_blowdown_ms = 0;
+}
+
+void MpcDosing::setTarget(uint8_t ch, float setpoint, float deadband, float max_ml_min) {
+    if (ch >= MPC_CHANNELS) return;
+    _ch[ch].setpoint = setpoint;
+    _ch[ch].deadband = deadband > 0.0f ? deadband : 1.0f;
+    _ch[ch].max_ml_min = max_ml_min > 0.0f ? max_ml_min : MPC_DEFAULT_MAX_ML_MIN;
+}
+
+void MpcDosing::setEnabled(uint8_t ch, bool enabled) {
+    if (ch >= MPC_CHANNELS || _ch[ch].enabled == enabled) return;
+    if (!enabled) {
+        _ch[ch].rate_ml_min = 0.0f;
+        memset(_plan[ch], 0, sizeof(_plan[ch]));
+    }
+    _ch[ch].enabled = enabled;
+}
+
+void MpcDosing::measure(uint8_t ch, float value) {
+    if (ch >= MPC_CHANNELS) return;
+    _pending[ch] = value;
+    _pending_valid[ch] = true;
+}
+
+void MpcDosing::pollManualInputs(const FuzzyController& fc) {
+    for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+        float v;
+        bool valid;
+        if (!fc.getManualInput((fuzzy_input_t)_model.ch[i].input, &v, &valid)) continue;
+        if (valid && (!_last_manual_valid[i] || v != _last_manual[i])) measure(i, v);
+        _last_manual[i] = v;
+        _last_manual_valid[i] = valid;
+    }
+}
+
+float MpcDosing::getRate(uint8_t ch) const {
+    if (ch >= MPC_CHANNELS || !_ch[ch].enabled || !_ch[ch].has_estimate) return 0.0f;
+    return _ch[ch].rate_ml_min;
+}
+
+bool MpcDosing::update(uint32_t now_ms, float makeup_gal, bool blowdown_active) {
+    if (!_started) {
+        _started = true;
+        _last_ms = now_ms;
+        _step_start_ms = now_ms;
+    }
+
+    uint32_t dt_ms = now_ms - _last_ms;
+    _last_ms = now_ms;
+    if (makeup_gal > 0.0f) _step_makeup_gal += makeup_gal;
+    if (blowdown_active) _step_blowdown_ms += dt_ms;
+
+    bool pending = false;
+    for (uint8_t i = 0; i < MPC_CHANNELS; i++) pending = pending || _pending_valid[i];
+
+    uint32_t elapsed = now_ms - _step_start_ms;
+    if (elapsed < (uint32_t)MPC_STEP_SEC * 1000UL && !pending) return false;
+
+    closeStep(elapsed);
+    return true;
+}
+
+// ============================================================================
+// STEP: OBSERVER + PLANNING
+// ============================================================================
+
+void MpcDosing::closeStep(uint32_t elapsed_ms) {
+    const float V = _model.boiler_volume_gal > 0.0f ? _model.boiler_volume_gal : MPC_DEFAULT_BOILER_GAL;
+    const float step_min = MPC_STEP_SEC / 60.0f;
+    float dt_min = elapsed_ms / 60000.0f;
+
+    // Flows over the step that just ended; a partial step (cut short by a test) counts by its length
+    float qm = 0.0f, qbd = 0.0f;
+    if (elapsed_ms > 0) {
+        qm = _step_makeup_gal / dt_min;
+        qbd = _model.blowdown_gpm * (float)_step_blowdown_ms / (float)elapsed_ms;
+        float w = min(1.0f, MPC_FLOW_SMOOTHING * dt_min / step_min);
+        if (_status.plans == 0) w = 1.0f;
+        _status.makeup_gpm += w * (qm - _status.makeup_gpm);
+        _status.blowdown_gpm += w * (qbd - _status.blowdown_gpm);
+    }
+
+    uint32_t t0 = micros();
+    for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+        const mpc_channel_model_t& m = _model.ch[i];
+        mpc_channel_status_t& s = _ch[i];
+
+        // Advance the estimate with what actually happened during the step
+        if (s.has_estimate && elapsed_ms > 0) {
+            float a = max(0.0f, 1.0f - dt_min * (qbd / V + m.decay_per_hr / 60.0f));
+            float u = getRate(i);
+            _x[i] = a * _x[i] + dt_min * (m.gain * u + qm * m.makeup_load) / V
+                  + s.bias * dt_min / step_min;
+            _since_test_min[i] += dt_min;
+        }
+
+        // Forecast model for this channel with the smoothed flows
+        float a = max(0.0f, 1.0f - step_min * (_status.blowdown_gpm / V + m.decay_per_hr / 60.0f));
+        float b = step_min * m.gain / V;
+
+        if (_pending_valid[i]) {
+            float y = toModel(i, _pending[i]);
+            if (s.has_estimate && _since_test_min[i] > 0.0f) {
+                // A constant per-step bias adds up to bias * (1 - a^n) / (1 - a) after n steps;
+                // take the bias that explains the prediction error since the previous test
+                float n = max(1.0f, _since_test_min[i] / step_min);
+                float reach = (a < 0.9999f) ? (1.0f - powf(a, n)) / (1.0f - a) : n;
+                s.bias += MPC_BIAS_GAIN * (y - _x[i]) / reach;
+                float bias_max = fabsf(m.gain) * s.max_ml_min * step_min / V;
+                s.bias = constrain(s.bias, -bias_max, bias_max);
+            }
+            _x[i] = y;
+            s.has_estimate = true;
+            _since_test_min[i] = 0.0f;
+            _pending_valid[i] = false;
+        }
+
+        s.residual = toTest(i, _x[i]);
+        if (!s.enabled || !s.has_estimate) {
+            s.rate_ml_min = 0.0f;
+            continue;
+        }
+
+        // Setpoint and deadband in model units (hydroxide: mean of the band's two sides)
+        float r = toModel(i, s.setpoint);
+        float db = s.deadband;
+        if (m.hydroxide) db = 0.5f * (toModel(i, s.setpoint + s.deadband) - toModel(i, s.setpoint - s.deadband));
+
+        // Plan over the horizon, keep the first move
+        float d = step_min * _status.makeup_gpm * m.makeup_load / V + s.bias;
+
+        // Warm start: shift the previous plan by one step
+        memmove(&_plan[i][0], &_plan[i][1], (MPC_HORIZON - 1) * sizeof(float));
+        s.cost = solve(_x[i], a, b, d, r, db, s.max_ml_min, m.move_weight, _plan[i], &s.iterations);
+        s.rate_ml_min = _plan[i][0];
+
+        float c = _x[i];
+        for (uint8_t k = 0; k < MPC_HORIZON; k++) c = a * c + b * _plan[i][k] + d;
+        s.predicted_end = toTest(i, c);
+    }
+    _status.solve_us = micros() - t0;
+    _status.max_solve_us = max(_status.max_solve_us, _status.solve_us);
+    _status.plans++;
+
+    _step_start_ms += elapsed_ms;
+    _step_makeup_gal = 0.0f;
+    _step_blowdown_ms = 0;
+}
+
+float MpcDosing::toModel(uint8_t ch, float value) const {
+    return _model.ch[ch].hydroxide ? powf(10.0f, value - 11.0f) : value;
+}
+
+float MpcDosing::toTest(uint8_t ch, float x) const {
+    return _model.ch[ch].hydroxide ? 11.0f + log10f(max(x, 1e-4f)) : x;
+}
+
+// ============================================================================
+// SOLVER
+// ============================================================================
+
+static float mpcCost(float c0, float a, float b, float d, float r, float inv_db2,
+                     float rho, const float* u, float* lambda) {
+    // Forward pass: predicted residuals and cost; lambda[k] holds dJ/dc[k+1] before the backward sweep
+    float c = c0, cost = 0.0f;
+    for (uint8_t k = 0; k < MPC_HORIZON; k++) {
+        c = a * c + b * u[k] + d;
+        float e = c - r;
+        cost += e * e * inv_db2 + rho * u[k] * u[k];
+        lambda[k] = 2.0f * e * inv_db2;
+    }
+    // Backward pass: lambda[k] = dJ/dc[k+1] through all later steps
+    for (int k = MPC_HORIZON - 2; k >= 0; k--) lambda[k] += a * lambda[k + 1];
+    return cost;
+}
+
+float MpcDosing::solve(float c0, float a, float b, float d, float setpoint, float deadband,
+                       float u_max, float move_weight, float* plan, uint8_t* iterations) {
+    const float inv_db2 = 1.0f / (deadband * deadband);
+    const float rho = move_weight / (u_max * u_max);
+
+    // Lipschitz bound of the gradient: ||G||2 <= sum |a|^k |b| for the lower-triangular step response
+    float s = 0.0f, ak = 1.0f;
+    for (uint8_t k = 0; k < MPC_HORIZON; k++) { s += ak; ak *= fabsf(a); }
+    float g = fabsf(b) * s;
+    float L = 2.0f * (g * g * inv_db2 + rho);
+    float step = 1.0f / L;
+
+    float y[MPC_HORIZON], prev[MPC_HORIZON], lambda[MPC_HORIZON];
+    for (uint8_t k = 0; k < MPC_HORIZON; k++) {
+        plan[k] = constrain(plan[k], 0.0f, u_max);
+        y[k] = plan[k];
+    }
+
+    // FISTA: projected gradient step from the extrapolated point y
+    float t = 1.0f;
+    uint8_t it = 0;
+    while (it < MPC_MAX_ITER) {
+        it++;
+        mpcCost(c0, a, b, d, setpoint, inv_db2, rho, y, lambda);
+        float moved = 0.0f;
+        for (uint8_t k = 0; k < MPC_HORIZON; k++) {
+            prev[k] = plan[k];
+            float grad = b * lambda[k] + 2.0f * rho * y[k];
+            plan[k] = constrain(y[k] - step * grad, 0.0f, u_max);
+            moved = max(moved, fabsf(plan[k] - prev[k]));
+        }
+        if (moved <= MPC_TOL * u_max) break;
+        float t_next = 0.5f * (1.0f + sqrtf(1.0f + 4.0f * t * t));
+        float beta = (t - 1.0f) / t_next;
+        for (uint8_t k = 0; k < MPC_HORIZON; k++) y[k] = plan[k] + beta * (plan[k] - prev[k]);
+        t = t_next;
+    }
+    if (iterations) *iterations = it;
+    return mpcCost(c0, a, b, d, setpoint, inv_db2, rho, plan, lambda);
+}
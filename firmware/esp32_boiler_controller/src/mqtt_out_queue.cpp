@@ -0,0 +1,103 @@
+/**
+ * @file mqtt_out_queue.cpp
+ * @brief Bounded MQTT outbound queue with in-flight window and drain rate limit
+ */
+
+#include "mqtt_out_queue.h"
+
+MqttOutQueue::MqttOutQueue() {
+    clear();
+}
+
+void MqttOutQueue::clear() {
+    _head = 0;
+    _count = 0;
+    _sent = 0;
+    _dropped = 0;
+    _resent = 0;
+    _tokens_milli = MQTT_DRAIN_BURST * 1000;
+    _refill_at = 0;
+}
+
+bool MqttOutQueue::push(const mqtt_queued_t* item, bool drop_reading) {
+    if (isFull() && !(drop_reading && dropOldestReading())) return false;
+    mqtt_queued_t* q = at(_count);
+    *q = *item;
+    q->sent_at = 0;
+    _count++;
+    return true;
+}
+
+bool MqttOutQueue::dropOldestReading() {
+    // In-flight messages may already be at the broker; only waiting ones go
+    for (int i = _sent; i < _count; i++) {
+        if (at(i)->msg.kind != NET_MSG_READING) continue;
+        for (int j = i; j + 1 < _count; j++) *at(j) = *at(j + 1);
+        _count--;
+        _dropped++;
+        return true;
+    }
+    return false;
+}
+
+const mqtt_queued_t* MqttOutQueue::next(uint32_t now) {
+    if (_sent >= _count || _sent >= MQTT_INFLIGHT_MAX) return nullptr;
+
+    // Refill the bucket for the time since the last call
+    uint32_t elapsed = now - _refill_at;
+    _refill_at = now;
+    uint32_t cap = MQTT_DRAIN_BURST * 1000;
+    uint32_t add = elapsed >= cap / MQTT_DRAIN_PER_SEC ? cap : elapsed * MQTT_DRAIN_PER_SEC;
+    _tokens_milli = (_tokens_milli + add > cap) ? cap : _tokens_milli + add;
+    if (_tokens_milli < 1000) return nullptr;
+
+    return at(_sent);
+}
+
+void MqttOutQueue::markSent(uint32_t now) {
+    if (_sent >= _count) return;
+    at(_sent)->sent_at = now;
+    _sent++;
+    _tokens_milli = _tokens_milli >= 1000 ? _tokens_milli - 1000 : 0;
+}
+
+// Oldest in-flight message delivered
+uint32_t MqttOutQueue::release() {
+    uint32_t spool_next = at(0)->spool_next;
+    _head = (_head + 1) % MQTT_QUEUE_SLOTS;
+    _count--;
+    _sent--;
+    return spool_next;
+}
+
+uint32_t MqttOutQueue::confirm(uint32_t order) {
+    // In flight in push order; wrap-safe comparison
+    uint32_t spool_next = 0;
+    while (_sent > 0 && (int32_t)(order - at(0)->order) >= 0) {
+        uint32_t next = release();
+        if (next) spool_next = next;
+    }
+    return spool_next;
+}
+
+uint32_t MqttOutQueue::confirmBefore(uint32_t now) {
+    uint32_t spool_next = 0;
+    while (_sent > 0 && now - at(0)->sent_at >= MQTT_CONFIRM_MS) {
+        uint32_t next = release();
+        if (next) spool_next = next;
+    }
+    return spool_next;
+}
+
+bool MqttOutQueue::ackOverdue(uint32_t now) {
+    return _sent > 0 && now - at(0)->sent_at >= MQTT_ACK_TIMEOUT_MS;
+}
+
+uint32_t MqttOutQueue::lastSentOrder() {
+    return _sent > 0 ? at(_sent - 1)->order : 0;
+}
+
+void MqttOutQueue::resend() {
+    _resent += _sent;
+    _sent = 0;
+}
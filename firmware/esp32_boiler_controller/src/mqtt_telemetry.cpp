@@ -5,9 +5,11 @@
 
 #include "mqtt_telemetry.h"
 #include "device_identity.h"
+#include "telemetry_spool.h"
 #include <WiFi.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
+#include <esp_system.h>
 
 static WiFiClient s_mqttWifiClient;
 static PubSubClient s_mqttClient(s_mqttWifiClient);
@@ -23,6 +25,10 @@ MqttTelemetry::MqttTelemetry()
     : _config(nullptr)
     , _connected(false)
     , _sequence(0)
+    , _boot_id(0)
+    , _order(0)
+    , _ack_seen(false)
+    , _ack_timed(false)
     , _last_reconnect(0)
     , _backoff_ms(MQTT_RECONNECT_INITIAL_MS)
 {
@@ -36,9 +42,13 @@ bool MqttTelemetry::begin(system_config_t* config) {
         return false;
     }
     device_id_get(_device_id, sizeof(_device_id));
+    _boot_id = esp_random();
     s_mqttClient.setServer(_config->mqtt_host, _config->mqtt_port);
     s_mqttClient.setBufferSize(MQTT_PAYLOAD_MAX);
     s_mqttClient.setKeepAlive(MQTT_KEEPALIVE_SEC);
+    s_mqttClient.setCallback([](char*, uint8_t* payload, unsigned int len) {
+        mqttTelemetry.onAck((const char*)payload, len);     // Only subscription
+    });
     if (strlen(_config->mqtt_user) > 0) {
         s_mqttClient.setCredentials(_config->mqtt_user, _config->mqtt_pass);
     }
@@ -58,6 +68,7 @@ void MqttTelemetry::update() {
     if (s_mqttClient.connected()) {
         s_mqttClient.loop();
         _connected = true;
+        drainQueue();
         return;
     }
     _connected = false;
@@ -79,6 +90,13 @@ bool MqttTelemetry::connect() {
     String clientId = String("boiler-") + _device_id;
     if (s_mqttClient.connect(clientId.c_str())) {
         _connected = true;
+        // Messages in flight on the old connection are not confirmed: resend
+        _queue.resend();
+        _ack_seen = false;
+        _ack_timed = false;
+        snprintf(_topic_buf, sizeof(_topic_buf), "device/%s/ack", _device_id);
+        s_mqttClient.subscribe(_topic_buf);
+        drainQueue();
         return true;
     }
     return false;
@@ -95,11 +113,13 @@ bool MqttTelemetry::publish(const char* topic_suffix, const char* payload) {
     return s_mqttClient.publish(_topic_buf, payload, false);
 }
 
-void MqttTelemetry::buildMetricsPayload(const sensor_reading_t* reading, char* buf, size_t buf_len) {
+void MqttTelemetry::buildMetricsPayload(const sensor_reading_t* reading, uint32_t boot_id, uint32_t sequence,
+                                        char* buf, size_t buf_len) {
     JsonDocument doc;
     doc["timestamp"] = reading->timestamp;
     doc["device_id"] = _device_id;
-    doc["sequence"] = _sequence++;
+    doc["boot_id"] = boot_id;
+    doc["sequence"] = sequence;
     JsonArray metrics = doc["metrics"].to<JsonArray>();
     JsonObject m;
     m = metrics.add<JsonObject>();
@@ -155,71 +175,292 @@ void MqttTelemetry::buildMetricsPayload(const sensor_reading_t* reading, char* b
     serializeJson(doc, buf, buf_len);
 }
 
+bool MqttTelemetry::spoolEnabled() const {
+    return strlen(_config->mqtt_host) > 0 && telemetrySpool.isAvailable();
+}
+
+// The publishX calls come from the control and logging tasks: they only queue
+// the message; the network task hands it to deliver()
+static void queueMessage(net_msg_t* msg, uint8_t kind, uint32_t timestamp) {
+    msg->kind = kind;
+    msg->sink = NET_SINK_MQTT;
+    msg->timestamp = timestamp;
+    netOutbox.push(msg);
+}
+
 void MqttTelemetry::publishReading(const sensor_reading_t* reading) {
     if (!_config || !_config->use_mqtt_telemetry || !reading) return;
-    char payload[MQTT_PAYLOAD_MAX];
-    buildMetricsPayload(reading, payload, sizeof(payload));
-    if (publish("metrics", payload)) {
-        /* published */
-    }
+    net_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.reading = *reading;
+    queueMessage(&msg, NET_MSG_READING, reading->timestamp);
 }
 
 void MqttTelemetry::publishAlarm(uint16_t alarm_code, const char* alarm_name, bool active, float trigger_value, uint32_t timestamp) {
     if (!_config || !_config->use_mqtt_telemetry) return;
+    net_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.alarm.code = alarm_code;
+    strncpy(msg.alarm.name, alarm_name, sizeof(msg.alarm.name) - 1);
+    msg.alarm.active = active;
+    msg.alarm.trigger_value = trigger_value;
+    queueMessage(&msg, NET_MSG_ALARM, timestamp);
+}
+
+void MqttTelemetry::publishEvent(const char* event_type, const char* description, int32_t value, uint32_t timestamp) {
+    if (!_config || !_config->use_mqtt_telemetry) return;
+    net_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    strncpy(msg.event.type, event_type, sizeof(msg.event.type) - 1);
+    strncpy(msg.event.description, description, sizeof(msg.event.description) - 1);
+    msg.event.value = value;
+    queueMessage(&msg, NET_MSG_EVENT, timestamp);
+}
+
+void MqttTelemetry::publishHealth(uint32_t uptime_sec, int free_heap, bool wifi_ok, uint16_t active_alarms) {
+    if (!_config || !_config->use_mqtt_telemetry) return;
+    net_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.health.uptime_sec = uptime_sec;
+    msg.health.free_heap = free_heap;
+    msg.health.wifi_ok = wifi_ok;
+    msg.health.active_alarms = active_alarms;
+    queueMessage(&msg, NET_MSG_HEALTH, (uint32_t)(millis() / 1000));
+}
+
+void MqttTelemetry::publishCommandResult(const char* request_id, const char* result, const char* message) {
+    if (!_config || !_config->use_mqtt_telemetry) return;
+    net_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    strncpy(msg.command.request_id, request_id, sizeof(msg.command.request_id) - 1);
+    strncpy(msg.command.result, result, sizeof(msg.command.result) - 1);
+    if (message) strncpy(msg.command.message, message, sizeof(msg.command.message) - 1);
+    queueMessage(&msg, NET_MSG_COMMAND_RESULT, (uint32_t)(millis() / 1000));
+}
+
+// Readings, alarms and events go through the outbound queue, numbered in
+// order, connected or not. While a spool backlog is pending they are spooled
+// behind it (keeps order), and with a card a full queue spools the overflow,
+// numbered the same way; without one the oldest queued reading makes room.
+// Health and command results are current state only and are neither queued
+// nor spooled.
+void MqttTelemetry::deliver(const net_msg_t* msg) {
+    if (!_config || !_config->use_mqtt_telemetry || !msg) return;
+    if (msg->kind == NET_MSG_HEALTH) {
+        sendHealth(msg);
+        return;
+    }
+    if (msg->kind == NET_MSG_COMMAND_RESULT) {
+        sendCommandResult(msg);
+        return;
+    }
+
+    bool spool = spoolEnabled();
+    if (!(spool && telemetrySpool.hasBacklog()) && enqueue(msg, _boot_id, _sequence, 0, !spool)) {
+        _sequence++;
+        drainQueue();
+        return;
+    }
+    if (!spool) return;                 // Queue full of alarms and events: dropped
+    switch (msg->kind) {
+        case NET_MSG_READING:
+            telemetrySpool.appendReading(&msg->reading, _boot_id, _sequence++);
+            break;
+        case NET_MSG_ALARM:
+            telemetrySpool.appendAlarm(msg->timestamp, msg->alarm.code, msg->alarm.name,
+                                       msg->alarm.active, msg->alarm.trigger_value, _boot_id, _sequence++);
+            break;
+        case NET_MSG_EVENT:
+            telemetrySpool.appendEvent(msg->timestamp, msg->event.type, msg->event.description,
+                                       msg->event.value, _boot_id, _sequence++);
+            break;
+    }
+}
+
+bool MqttTelemetry::enqueue(const net_msg_t* msg, uint32_t boot_id, uint32_t sequence, uint32_t spool_next,
+                            bool drop_reading) {
+    mqtt_queued_t item;
+    item.msg = *msg;
+    item.order = _order;
+    item.boot_id = boot_id;
+    item.sequence = sequence;
+    item.spool_next = spool_next;
+    item.sent_at = 0;
+    if (!_queue.push(&item, drop_reading)) return false;
+    _order++;
+    return true;
+}
+
+// Spooled records delivered: the spool may move on past them
+void MqttTelemetry::confirmed(uint32_t spool_next) {
+    if (spool_next) telemetrySpool.confirm(spool_next);
+}
+
+// Publish what the window and rate allow; in-flight messages are released
+// by the ack echo (onAck) or, if the broker does not echo, by time
+void MqttTelemetry::drainQueue() {
+    if (!_connected || !s_mqttClient.connected()) return;
+    uint32_t now = millis();
+
+    if (_ack_timed) {
+        confirmed(_queue.confirmBefore(now));
+    } else if (_queue.ackOverdue(now)) {
+        if (_ack_seen) {
+            // Echo stopped: the link is gone even if the socket is not
+            Serial.printf("MQTT: ack overdue, resending %d messages\n", _queue.inFlight());
+            _queue.resend();
+            disconnect();
+            return;
+        }
+        Serial.println("MQTT: broker does not echo acks, confirming by time");
+        _ack_timed = true;
+        confirmed(_queue.confirmBefore(now));
+    }
+
+    int sent = 0;
+    const mqtt_queued_t* q;
+    while ((q = _queue.next(now)) != nullptr && sendQueued(q)) {
+        _queue.markSent(now);
+        sent++;
+    }
+    if (sent > 0 && !_ack_timed) {
+        char seq[12];
+        snprintf(seq, sizeof(seq), "%lu", (unsigned long)_queue.lastSentOrder());
+        publish("ack", seq);
+    }
+}
+
+bool MqttTelemetry::sendQueued(const mqtt_queued_t* q) {
+    const net_msg_t* msg = &q->msg;
+    switch (msg->kind) {
+        case NET_MSG_READING:
+            return sendReading(&msg->reading, q->boot_id, q->sequence);
+        case NET_MSG_ALARM:
+            return sendAlarm(msg->alarm.code, msg->alarm.name, msg->alarm.active,
+                             msg->alarm.trigger_value, msg->timestamp, q->boot_id, q->sequence);
+        case NET_MSG_EVENT:
+            return sendEvent(msg->event.type, msg->event.description, msg->event.value,
+                             msg->timestamp, q->boot_id, q->sequence);
+    }
+    return true;                        // Unknown kind: nothing to publish
+}
+
+void MqttTelemetry::onAck(const char* payload, unsigned int len) {
+    char buf[12];
+    if (len == 0 || len >= sizeof(buf)) return;
+    memcpy(buf, payload, len);
+    buf[len] = '\0';
+    _ack_seen = true;
+    confirmed(_queue.confirm((uint32_t)strtoul(buf, nullptr, 10)));
+}
+
+// Spooled records join the queue behind what is already there (older) and
+// keep the numbering they were spooled with; records spooled by the HTTP
+// path have none and are numbered now. The spool moves on once they are
+// confirmed, so after a reset they are sent again as the same messages.
+uint32_t MqttTelemetry::sendSpooled(const spool_record_t* recs, const uint32_t* next, uint32_t count) {
+    if (!_config) return 0;
+    uint32_t done = 0;
+    for (; done < count; done++) {
+        const spool_record_t* rec = &recs[done];
+        net_msg_t msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.sink = NET_SINK_MQTT;
+        msg.timestamp = rec->timestamp;
+        switch (rec->kind) {
+            case SPOOL_READING:
+                msg.kind = NET_MSG_READING;
+                sdlog_unpack(&rec->reading, &msg.reading);
+                break;
+            case SPOOL_EVENT:
+                msg.kind = NET_MSG_EVENT;
+                strncpy(msg.event.type, rec->event.type, sizeof(msg.event.type) - 1);
+                strncpy(msg.event.description, rec->event.description, sizeof(msg.event.description) - 1);
+                msg.event.value = rec->event.value;
+                break;
+            case SPOOL_ALARM:
+                msg.kind = NET_MSG_ALARM;
+                msg.alarm.code = rec->alarm.code;
+                strncpy(msg.alarm.name, rec->alarm.name, sizeof(msg.alarm.name) - 1);
+                msg.alarm.active = rec->alarm.active != 0;
+                msg.alarm.trigger_value = rec->alarm.trigger_value;
+                break;
+        }
+        bool numbered = rec->boot_id != 0;
+        if (!enqueue(&msg, numbered ? rec->boot_id : _boot_id, numbered ? rec->sequence : _sequence,
+                     next[done], false)) {
+            break;
+        }
+        if (!numbered) _sequence++;
+    }
+    drainQueue();
+    return done;
+}
+
+bool MqttTelemetry::sendReading(const sensor_reading_t* reading, uint32_t boot_id, uint32_t sequence) {
+    char payload[MQTT_PAYLOAD_MAX];
+    buildMetricsPayload(reading, boot_id, sequence, payload, sizeof(payload));
+    return publish("metrics", payload);
+}
+
+bool MqttTelemetry::sendAlarm(uint16_t alarm_code, const char* alarm_name, bool active, float trigger_value,
+                              uint32_t timestamp, uint32_t boot_id, uint32_t sequence) {
     JsonDocument doc;
     doc["type"] = "alarm";
     doc["timestamp"] = timestamp;
     doc["device_id"] = _device_id;
-    doc["sequence"] = _sequence++;
+    doc["boot_id"] = boot_id;
+    doc["sequence"] = sequence;
     doc["alarm_code"] = alarm_code;
     doc["alarm_name"] = alarm_name;
     doc["active"] = active;
     doc["trigger_value"] = trigger_value;
     String pl;
     serializeJson(doc, pl);
-    publish("alarm", pl.c_str());
+    return publish("alarm", pl.c_str());
 }
 
-void MqttTelemetry::publishHealth(uint32_t uptime_sec, int free_heap, bool wifi_ok, uint16_t active_alarms) {
-    if (!_config || !_config->use_mqtt_telemetry) return;
+bool MqttTelemetry::sendHealth(const net_msg_t* msg) {
     JsonDocument doc;
-    doc["timestamp"] = (uint32_t)(millis() / 1000);
+    doc["timestamp"] = msg->timestamp;
     doc["device_id"] = _device_id;
+    doc["boot_id"] = _boot_id;
     doc["sequence"] = _sequence++;
-    doc["uptime_sec"] = uptime_sec;
-    doc["free_heap"] = free_heap;
-    doc["wifi_connected"] = wifi_ok;
+    doc["uptime_sec"] = msg->health.uptime_sec;
+    doc["free_heap"] = msg->health.free_heap;
+    doc["wifi_connected"] = msg->health.wifi_ok;
     doc["mqtt_connected"] = _connected;
-    doc["active_alarms"] = active_alarms;
+    doc["active_alarms"] = msg->health.active_alarms;
     String pl;
     serializeJson(doc, pl);
-    publish("health", pl.c_str());
+    return publish("health", pl.c_str());
 }
 
-void MqttTelemetry::publishCommandResult(const char* request_id, const char* result, const char* message) {
-    if (!_config || !_config->use_mqtt_telemetry) return;
+bool MqttTelemetry::sendCommandResult(const net_msg_t* msg) {
     JsonDocument doc;
-    doc["request_id"] = request_id;
-    doc["result"] = result;
-    if (message && message[0]) doc["message"] = message;
-    doc["timestamp"] = (uint32_t)(millis() / 1000);
+    doc["request_id"] = msg->command.request_id;
+    doc["result"] = msg->command.result;
+    if (msg->command.message[0]) doc["message"] = msg->command.message;
+    doc["timestamp"] = msg->timestamp;
     doc["device_id"] = _device_id;
+    doc["boot_id"] = _boot_id;
     doc["sequence"] = _sequence++;
     String pl;
     serializeJson(doc, pl);
-    publish("command_result", pl.c_str());
+    return publish("command_result", pl.c_str());
 }
 
-void MqttTelemetry::publishEvent(const char* event_type, const char* description, int32_t value, uint32_t timestamp) {
-    if (!_config || !_config->use_mqtt_telemetry) return;
+bool MqttTelemetry::sendEvent(const char* event_type, const char* description, int32_t value,
+                              uint32_t timestamp, uint32_t boot_id, uint32_t sequence) {
     JsonDocument doc;
     doc["timestamp"] = timestamp;
     doc["device_id"] = _device_id;
-    doc["sequence"] = _sequence++;
+    doc["boot_id"] = boot_id;
+    doc["sequence"] = sequence;
     doc["event_type"] = event_type;
     doc["description"] = description;
     doc["value"] = value;
     String pl;
     serializeJson(doc, pl);
-    publish("state", pl.c_str());
+    return publish("state", pl.c_str());
 }
@@ -0,0 +1,58 @@
+/**
+ * @file net_outbox.cpp
+ * @brief Outbound telemetry queue serviced by the network task
+ */
+
+#include "net_outbox.h"
+
+// Global instance
+NetOutbox netOutbox;
+
+NetOutbox::NetOutbox()
+    : _queue(nullptr)
+    , _queued(0)
+    , _dropped(0)
+    , _high_water(0)
+{
+}
+
+bool NetOutbox::begin() {
+    if (!_queue) _queue = xQueueCreate(NET_OUTBOX_SLOTS, sizeof(net_msg_t));
+    if (!_queue) {
+        Serial.println("NetOutbox: queue allocation failed");
+        return false;
+    }
+    return true;
+}
+
+bool NetOutbox::push(const net_msg_t* msg) {
+    if (!_queue || xQueueSend(_queue, msg, 0) != pdTRUE) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    _queued.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t depth = (uint32_t)uxQueueMessagesWaiting(_queue);
+    // Producers run on several tasks: a plain load/store could lower a peak another raised
+    uint32_t hw = _high_water.load(std::memory_order_relaxed);
+    while (depth > hw &&
+           !_high_water.compare_exchange_weak(hw, depth, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+bool NetOutbox::pop(net_msg_t* out, uint32_t wait_ms) {
+    if (!_queue) {
+        delay(wait_ms);
+        return false;
+    }
+    return xQueueReceive(_queue, out, pdMS_TO_TICKS(wait_ms)) == pdTRUE;
+}
+
+net_outbox_stats_t NetOutbox::getStats() const {
+    net_outbox_stats_t s;
+    s.queued = _queued.load(std::memory_order_relaxed);
+    s.dropped = _dropped.load(std::memory_order_relaxed);
+    s.high_water = _high_water.load(std::memory_order_relaxed);
+    return s;
+}
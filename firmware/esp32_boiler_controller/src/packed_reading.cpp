@@ -0,0 +1,161 @@
+/**
+ * @file packed_reading.cpp
+ * @brief 24-byte delta-packed reading and the RAM ring that holds them
+ */
+
+#include "packed_reading.h"
+
+// Delta of a 32-bit total; false if it went backwards or does not fit 16 bits
+static bool delta16(uint32_t from, uint32_t to, uint16_t* out) {
+    uint32_t d = to - from;
+    if (to < from || d > UINT16_MAX) return false;
+    *out = (uint16_t)d;
+    return true;
+}
+
+static void baseOf(const sd_log_record_t* rec, packed_base_t* base) {
+    base->timestamp = rec->timestamp;
+    base->water_meter1 = rec->water_meter1;
+    base->water_meter2 = rec->water_meter2;
+    base->fw_pump_cycle_count = rec->fw_pump_cycle_count;
+    base->fw_pump_on_time_sec = rec->fw_pump_on_time_sec;
+}
+
+PackedReadingRing::PackedReadingRing() {
+    clear();
+}
+
+void PackedReadingRing::clear() {
+    _tail = 0;
+    _used = 0;
+    _count = 0;
+    _dropped = 0;
+    memset(&_base, 0, sizeof(_base));
+    memset(&_last, 0, sizeof(_last));
+}
+
+void PackedReadingRing::push(const sensor_reading_t* reading) {
+    // Same quantization as the SD log record
+    sd_log_record_t rec;
+    sdlog_pack(reading, &rec);
+    packed_base_t abs;
+    baseOf(&rec, &abs);
+
+    packed_reading_t slot;
+    memset(&slot, 0, sizeof(slot));
+    float cond = isnan(rec.conductivity) ? 0.0f : roundf(rec.conductivity);
+    slot.d.conductivity = (uint16_t)constrain(cond, 0.0f, (float)UINT16_MAX);
+    slot.d.temperature_d = rec.temperature_d;
+    slot.d.flow_cgpm = rec.flow_cgpm;
+    slot.valve_dmA = (uint8_t)constrain(rec.valve_dmA, 0, UINT8_MAX);
+    slot.flags = rec.flags;
+    slot.devices = (uint8_t)((constrain(rec.devices_operational, 0, 15) << 4) |
+                             constrain(rec.devices_faulted, 0, 15));
+    slot.d.active_alarms = rec.active_alarms;
+    slot.d.devices_faulted_mask = rec.devices_faulted_mask;
+    slot.d.measurement_age_ms = rec.measurement_age_ms > UINT16_MAX ? UINT16_MAX : (uint16_t)rec.measurement_age_ms;
+
+    uint16_t dt = 0, dwm1 = 0, dwm2 = 0, don = 0, cycles = 0;
+    bool fits = _count > 0 &&
+                delta16(_last.timestamp, abs.timestamp, &dt) &&
+                delta16(_last.water_meter1, abs.water_meter1, &dwm1) &&
+                delta16(_last.water_meter2, abs.water_meter2, &dwm2) &&
+                delta16(_last.fw_pump_on_time_sec, abs.fw_pump_on_time_sec, &don) &&
+                delta16(_last.fw_pump_cycle_count, abs.fw_pump_cycle_count, &cycles) &&
+                cycles <= PACKED_FW_CYCLES_MAX;
+    if (!fits) {
+        // Deltas from the absolute values: zero, after a keyframe
+        dt = dwm1 = dwm2 = don = cycles = 0;
+        if (_count == 0) {
+            _base = abs;                // Empty ring: the base is the reading itself
+        } else {
+            packed_reading_t key;
+            memset(&key, 0, sizeof(key));
+            key.flags = PACKED_KEYFRAME;
+            key.key.timestamp = abs.timestamp;
+            key.key.water_meter1 = abs.water_meter1;
+            key.key.water_meter2 = abs.water_meter2;
+            key.key.fw_pump_cycle_count = abs.fw_pump_cycle_count;
+            key.key.fw_pump_on_time_sec = abs.fw_pump_on_time_sec;
+            put(&key);
+        }
+    }
+    slot.d.dt_s = dt;
+    slot.d.d_water_meter1 = dwm1;
+    slot.d.d_water_meter2 = dwm2;
+    slot.d.d_fw_on_time_sec = don;
+    slot.status = (uint8_t)((rec.safe_mode & 0x07) | (cycles << 3));
+    put(&slot);
+    _count++;
+    _last = abs;
+}
+
+void PackedReadingRing::put(const packed_reading_t* slot) {
+    // A reading takes at most two slots, so dropping always makes room
+    while (_used >= PACKED_RING_SLOTS) {
+        drop(1);
+        _dropped++;
+    }
+    _slots[(_tail + _used) % PACKED_RING_SLOTS] = *slot;
+    _used++;
+}
+
+void PackedReadingRing::decode(uint16_t* pos, packed_base_t* base, sensor_reading_t* out) const {
+    const packed_reading_t* s = &_slots[*pos];
+    if (s->flags & PACKED_KEYFRAME) {
+        base->timestamp = s->key.timestamp;
+        base->water_meter1 = s->key.water_meter1;
+        base->water_meter2 = s->key.water_meter2;
+        base->fw_pump_cycle_count = s->key.fw_pump_cycle_count;
+        base->fw_pump_on_time_sec = s->key.fw_pump_on_time_sec;
+        *pos = (*pos + 1) % PACKED_RING_SLOTS;
+        s = &_slots[*pos];
+    }
+    base->timestamp += s->d.dt_s;
+    base->water_meter1 += s->d.d_water_meter1;
+    base->water_meter2 += s->d.d_water_meter2;
+    base->fw_pump_cycle_count += s->status >> 3;
+    base->fw_pump_on_time_sec += s->d.d_fw_on_time_sec;
+    *pos = (*pos + 1) % PACKED_RING_SLOTS;
+    if (!out) return;
+
+    sd_log_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp = base->timestamp;
+    rec.conductivity = (float)s->d.conductivity;
+    rec.water_meter1 = base->water_meter1;
+    rec.water_meter2 = base->water_meter2;
+    rec.fw_pump_cycle_count = base->fw_pump_cycle_count;
+    rec.fw_pump_on_time_sec = base->fw_pump_on_time_sec;
+    rec.measurement_age_ms = s->d.measurement_age_ms;
+    rec.temperature_d = s->d.temperature_d;
+    rec.flow_cgpm = s->d.flow_cgpm;
+    rec.valve_dmA = s->valve_dmA;
+    rec.active_alarms = s->d.active_alarms;
+    rec.devices_faulted_mask = s->d.devices_faulted_mask;
+    rec.flags = s->flags;
+    rec.safe_mode = s->status & 0x07;
+    rec.devices_operational = s->devices >> 4;
+    rec.devices_faulted = s->devices & 0x0F;
+    sdlog_unpack(&rec, out);
+}
+
+int PackedReadingRing::peek(sensor_reading_t* out, int max) const {
+    uint16_t pos = _tail;
+    packed_base_t base = _base;
+    int n = 0;
+    for (; n < max && n < _count; n++) {
+        decode(&pos, &base, &out[n]);
+    }
+    return n;
+}
+
+void PackedReadingRing::drop(int n) {
+    for (; n > 0 && _count > 0; n--) {
+        uint16_t pos = _tail;
+        decode(&pos, &_base, nullptr);
+        _used -= (uint16_t)((pos + PACKED_RING_SLOTS - _tail) % PACKED_RING_SLOTS);
+        _tail = pos;
+        _count--;
+    }
+}
@@ -0,0 +1,191 @@
+/**
+ * @file plant_id.cpp
+ * @brief Online RLS identification of the boiler concentration dynamics
+ */
+
+#include "plant_id.h"
+
+// Global instance
+PlantIdentifier plantId;
+
+// Regressor scaling: open_sec * C is ~1e4 per sample, the others ~1
+#define PLANT_ID_KB_SCALE   1000.0f
+
+PlantIdentifier::PlantIdentifier() {
+    begin();
+}
+
+void PlantIdentifier::begin(const blowdown_config_t* bd_config,
+                            const conductivity_config_t* cond_config) {
+    _bd_config = bd_config;
+    _cond_config = cond_config;
+
+    memset(_rls, 0, sizeof(_rls));
+    for (uint8_t d = 0; d < PLANT_ID_MAX_DELAY; d++) {
+        for (uint8_t i = 0; i < PLANT_ID_PARAMS; i++) _rls[d].P[i][i] = PLANT_ID_P0;
+    }
+    memset(_hist_gal, 0, sizeof(_hist_gal));
+    memset(_hist_open, 0, sizeof(_hist_open));
+    _head = 0;
+    _filled = 0;
+    memset(&_params, 0, sizeof(_params));
+
+    _started = false;
+    _last_ms = 0;
+    _sample_start_ms = 0;
+    _sample_cond = 0.0f;
+    _sample_gal = 0.0f;
+    _sample_open_ms = 0;
+    _pulse_ms = 0;
+    _pulse_gal = 0.0f;
+    _flow_gal_ms = 0.0f;
+}
+
+bool PlantIdentifier::update(uint32_t now_ms, float conductivity, bool blowdown_open, float makeup_gal) {
+    if (!_started) {
+        _started = true;
+        _last_ms = now_ms;
+        _sample_start_ms = now_ms;
+        _sample_cond = conductivity;
+        return false;
+    }
+
+    uint32_t dt_ms = now_ms - _last_ms;
+    _last_ms = now_ms;
+    integrateMakeup(now_ms, dt_ms, makeup_gal);
+    if (blowdown_open) _sample_open_ms += dt_ms;
+
+    if (now_ms - _sample_start_ms < (uint32_t)PLANT_ID_SAMPLE_SEC * 1000UL) return false;
+
+    processSample(conductivity);
+    _sample_start_ms = now_ms;
+    _sample_cond = conductivity;
+    _sample_gal = 0.0f;
+    _sample_open_ms = 0;
+    return true;
+}
+
+void PlantIdentifier::integrateMakeup(uint32_t now_ms, uint32_t dt_ms, float makeup_gal) {
+    // A contact-head meter reports a whole gallon after it has flowed; as a spike
+    // the regressor is uncorrelated with the steady rise it caused. Use the flow
+    // between the last two pulses instead, decaying once the next pulse is overdue
+    if (makeup_gal > 0.0f) {
+        if (_pulse_ms != 0) _flow_gal_ms = makeup_gal / (float)max(now_ms - _pulse_ms, (uint32_t)1);
+        _pulse_ms = now_ms;
+        _pulse_gal = makeup_gal;
+    }
+    if (_pulse_ms == 0) return;
+    uint32_t since = now_ms - _pulse_ms;
+    float flow = _flow_gal_ms;
+    if (since > 0) flow = min(flow, _pulse_gal / (float)since);
+    _sample_gal += flow * dt_ms;
+}
+
+void PlantIdentifier::getCandidate(uint8_t delay, float theta[PLANT_ID_PARAMS], float* error) const {
+    if (delay >= PLANT_ID_MAX_DELAY) return;
+    if (theta) memcpy(theta, _rls[delay].theta, sizeof(_rls[delay].theta));
+    if (error) *error = sqrtf(_rls[delay].err);
+}
+
+// ============================================================================
+// RLS
+// ============================================================================
+
+void PlantIdentifier::processSample(float cond_now) {
+    // Newest sample into the ring; delay d reads the sample d steps back
+    _hist_gal[_head] = _sample_gal;
+    _hist_open[_head] = _sample_open_ms / 1000.0f;
+    if (_filled < PLANT_ID_MAX_DELAY) _filled++;
+
+    float y = cond_now - _sample_cond;
+    for (uint8_t d = 0; d < _filled; d++) {
+        uint8_t idx = (uint8_t)((_head + PLANT_ID_MAX_DELAY - d) % PLANT_ID_MAX_DELAY);
+        const float phi[PLANT_ID_PARAMS] = {
+            _hist_gal[idx],
+            -_hist_open[idx] * _sample_cond / PLANT_ID_KB_SCALE,
+            1.0f
+        };
+        rlsUpdate(_rls[d], phi, y);
+    }
+    _head = (uint8_t)((_head + 1) % PLANT_ID_MAX_DELAY);
+
+    _params.samples++;
+    if (_sample_open_ms > 0) _params.blowdown_samples++;
+    publish(cond_now);
+}
+
+void PlantIdentifier::rlsUpdate(rls_t& r, const float phi[PLANT_ID_PARAMS], float y) {
+    const float lambda = PLANT_ID_FORGETTING;
+
+    float e = y;
+    for (uint8_t i = 0; i < PLANT_ID_PARAMS; i++) e -= phi[i] * r.theta[i];
+
+    // Forget only while the covariance is bounded: without excitation (valve
+    // closed for hours) the unexcited direction would otherwise grow as 1/lambda^n
+    float trace = 0.0f;
+    for (uint8_t i = 0; i < PLANT_ID_PARAMS; i++) trace += r.P[i][i];
+    float forget = (trace < PLANT_ID_TRACE_MAX) ? lambda : 1.0f;
+
+    float Pphi[PLANT_ID_PARAMS];
+    float denom = forget;
+    for (uint8_t i = 0; i < PLANT_ID_PARAMS; i++) {
+        Pphi[i] = 0.0f;
+        for (uint8_t j = 0; j < PLANT_ID_PARAMS; j++) Pphi[i] += r.P[i][j] * phi[j];
+        denom += phi[i] * Pphi[i];
+    }
+
+    for (uint8_t i = 0; i < PLANT_ID_PARAMS; i++) r.theta[i] += Pphi[i] / denom * e;
+    for (uint8_t i = 0; i < PLANT_ID_PARAMS; i++) {
+        for (uint8_t j = i; j < PLANT_ID_PARAMS; j++) {
+            float p = (r.P[i][j] - Pphi[i] * Pphi[j] / denom) / forget;
+            r.P[i][j] = p;
+            r.P[j][i] = p;          // Keep P exactly symmetric
+        }
+    }
+
+    r.err = lambda * r.err + (1.0f - lambda) * e * e;
+}
+
+// ============================================================================
+// PUBLISH
+// ============================================================================
+
+void PlantIdentifier::publish(float cond_now) {
+    uint8_t best = 0;
+    for (uint8_t d = 1; d < _filled; d++) {
+        if (_rls[d].err < _rls[best].err) best = d;
+    }
+    const rls_t& r = _rls[best];
+
+    _params.makeup_gain = r.theta[0];
+    _params.blowdown_rate = r.theta[1] / PLANT_ID_KB_SCALE;
+    _params.tau_blowdown_sec = _params.blowdown_rate > 0.0f ? 1.0f / _params.blowdown_rate : 0.0f;
+    _params.dead_time_sec = (float)best * PLANT_ID_SAMPLE_SEC;
+    _params.drift_per_min = r.theta[2] * 60.0f / PLANT_ID_SAMPLE_SEC;
+    _params.rms_error = sqrtf(r.err);
+    _params.valid = _params.samples >= PLANT_ID_MIN_SAMPLES &&
+                    _params.blowdown_samples >= PLANT_ID_MIN_BLOWDOWNS &&
+                    _params.makeup_gain > 0.0f && _params.blowdown_rate > 0.0f;
+
+    if (!_params.valid) {
+        _params.suggested_deadband = 0.0f;
+        _params.suggested_prop_band = 0.0f;
+        return;
+    }
+
+    // At the setpoint the valve keeps removing Kb*C per second until it has closed
+    // and the sensor has seen it: the deadband should cover that fall
+    float c_sp = (_bd_config && _bd_config->setpoint > 0) ? (float)_bd_config->setpoint : cond_now;
+    float lag_sec = _params.dead_time_sec + (_bd_config ? _bd_config->ball_valve_delay : 0);
+    _params.suggested_deadband = constrain(c_sp * _params.blowdown_rate * lag_sec,
+                                           (float)BLOW_DEADBAND_MIN, (float)BLOW_DEADBAND_MAX);
+
+    // Mode P blows for deviation / prop_band * max_time; removing the deviation in
+    // one cycle (deadbeat) needs prop_band = C * Kb * max_time
+    if (_cond_config && _cond_config->max_prop_time_seconds > 0) {
+        _params.suggested_prop_band = PLANT_ID_PROP_MARGIN * c_sp * _params.blowdown_rate *
+                                      _cond_config->max_prop_time_seconds;
+    } else {
+        _params.suggested_prop_band = 0.0f;
+    }
+}
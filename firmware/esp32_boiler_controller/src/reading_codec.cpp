@@ -0,0 +1,316 @@
+/**
+ * @file reading_codec.cpp
+ * @brief Streaming block compression of readings (Gorilla-style)
+ */
+
+#include "reading_codec.h"
+#include "coprocessor_protocol.h"   // cp_crc16
+
+// ============================================================================
+// BIT STREAM
+// ============================================================================
+
+void RCodecBitWriter::begin(uint8_t* buf, size_t cap) {
+    _buf = buf;
+    _cap = cap * 8;
+    _pos = 0;
+    _overflow = false;
+}
+
+void RCodecBitWriter::put(uint32_t value, uint8_t bits) {
+    while (bits > 0) {
+        if (_pos >= _cap) {
+            _overflow = true;
+            return;
+        }
+        bits--;
+        uint8_t mask = (uint8_t)(0x80 >> (_pos & 7));
+        if ((value >> bits) & 1) _buf[_pos >> 3] |= mask;
+        else _buf[_pos >> 3] &= (uint8_t)~mask;
+        _pos++;
+    }
+}
+
+void RCodecBitReader::begin(const uint8_t* buf, size_t len) {
+    _buf = buf;
+    _len = len * 8;
+    _pos = 0;
+    _overrun = false;
+}
+
+uint32_t RCodecBitReader::get(uint8_t bits) {
+    uint32_t v = 0;
+    while (bits-- > 0) {
+        if (_pos >= _len) {
+            _overrun = true;
+            return 0;
+        }
+        v = (v << 1) | ((_buf[_pos >> 3] >> (7 - (_pos & 7))) & 1);
+        _pos++;
+    }
+    return v;
+}
+
+// ============================================================================
+// FIELD CODING
+// ============================================================================
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// '0' for zero, else '1' + 4-bit groups (low first), each followed by a
+// continuation bit
+static void putVar(RCodecBitWriter& w, uint32_t v) {
+    if (v == 0) {
+        w.put(0, 1);
+        return;
+    }
+    w.put(1, 1);
+    do {
+        w.put(v & 0x0F, 4);
+        v >>= 4;
+        w.put(v != 0, 1);
+    } while (v != 0);
+}
+
+static uint32_t getVar(RCodecBitReader& r) {
+    if (r.get(1) == 0) return 0;
+    uint32_t v = 0;
+    for (uint8_t shift = 0; shift < 32; shift += 4) {
+        v |= r.get(4) << shift;
+        if (r.get(1) == 0 || r.overrun()) break;
+    }
+    return v;
+}
+
+// Difference of wrapping 32-bit totals, coded as a signed delta
+static void putDelta(RCodecBitWriter& w, uint32_t prev, uint32_t cur) {
+    putVar(w, zigzag((int32_t)(cur - prev)));
+}
+
+static uint32_t getDelta(RCodecBitReader& r, uint32_t prev) {
+    return prev + (uint32_t)unzigzag(getVar(r));
+}
+
+static void putTimestamp(RCodecBitWriter& w, rcodec_state_t* s, uint32_t t, bool first) {
+    if (first) {
+        w.put(t, 32);
+        s->prev_delta = 0;
+        return;
+    }
+    int32_t delta = (int32_t)(t - s->prev.timestamp);
+    int32_t dod = (int32_t)((uint32_t)delta - (uint32_t)s->prev_delta);
+    if (dod == 0) {
+        w.put(0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        w.put(0x2, 2);
+        w.put((uint32_t)(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        w.put(0x6, 3);
+        w.put((uint32_t)(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        w.put(0xE, 4);
+        w.put((uint32_t)(dod + 2047), 12);
+    } else {
+        w.put(0xF, 4);
+        w.put((uint32_t)dod, 32);
+    }
+    s->prev_delta = delta;
+}
+
+static uint32_t getTimestamp(RCodecBitReader& r, rcodec_state_t* s, bool first) {
+    if (first) {
+        s->prev_delta = 0;
+        return r.get(32);
+    }
+    int32_t dod;
+    if (r.get(1) == 0) dod = 0;
+    else if (r.get(1) == 0) dod = (int32_t)r.get(7) - 63;
+    else if (r.get(1) == 0) dod = (int32_t)r.get(9) - 255;
+    else if (r.get(1) == 0) dod = (int32_t)r.get(12) - 2047;
+    else dod = (int32_t)r.get(32);
+    s->prev_delta = (int32_t)((uint32_t)s->prev_delta + (uint32_t)dod);
+    return s->prev.timestamp + (uint32_t)s->prev_delta;
+}
+
+static uint32_t floatBits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static float bitsFloat(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static void putFloat(RCodecBitWriter& w, rcodec_state_t* s, float prev, float cur) {
+    uint32_t x = floatBits(cur) ^ floatBits(prev);
+    if (x == 0) {
+        w.put(0, 1);
+        return;
+    }
+    uint8_t leading = (uint8_t)__builtin_clz(x);
+    uint8_t trailing = (uint8_t)__builtin_ctz(x);
+    if (leading > 31) leading = 31;
+    if (s->xor_length > 0 && leading >= s->xor_leading &&
+        trailing >= 32 - s->xor_leading - s->xor_length) {
+        // Fits the previous window
+        w.put(0x2, 2);
+        w.put(x >> (32 - s->xor_leading - s->xor_length), s->xor_length);
+        return;
+    }
+    uint8_t length = (uint8_t)(32 - leading - trailing);
+    w.put(0x3, 2);
+    w.put(leading, 5);
+    w.put(length - 1, 5);
+    w.put(x >> trailing, length);
+    s->xor_leading = leading;
+    s->xor_length = length;
+}
+
+static float getFloat(RCodecBitReader& r, rcodec_state_t* s, float prev) {
+    if (r.get(1) == 0) return prev;
+    if (r.get(1) == 1) {
+        s->xor_leading = (uint8_t)r.get(5);
+        s->xor_length = (uint8_t)(r.get(5) + 1);
+    }
+    if (s->xor_length == 0 || s->xor_leading + s->xor_length > 32) {
+        r.fail();                               // Corrupt block
+        return prev;
+    }
+    uint32_t x = r.get(s->xor_length) << (32 - s->xor_leading - s->xor_length);
+    return bitsFloat(floatBits(prev) ^ x);
+}
+
+static void putState(RCodecBitWriter& w, const sd_log_record_t* p, const sd_log_record_t* c) {
+    bool changed = c->flags != p->flags || c->safe_mode != p->safe_mode ||
+                   c->devices_operational != p->devices_operational ||
+                   c->devices_faulted != p->devices_faulted ||
+                   c->active_alarms != p->active_alarms ||
+                   c->devices_faulted_mask != p->devices_faulted_mask;
+    w.put(changed, 1);
+    if (!changed) return;
+    struct { uint32_t prev, cur; uint8_t bits; } f[] = {
+        { p->flags, c->flags, 8 },
+        { p->safe_mode, c->safe_mode, 8 },
+        { p->devices_operational, c->devices_operational, 8 },
+        { p->devices_faulted, c->devices_faulted, 8 },
+        { p->active_alarms, c->active_alarms, 16 },
+        { p->devices_faulted_mask, c->devices_faulted_mask, 16 },
+    };
+    for (auto& e : f) {
+        w.put(e.cur != e.prev, 1);
+        if (e.cur != e.prev) w.put(e.cur, e.bits);
+    }
+}
+
+static void getState(RCodecBitReader& r, sd_log_record_t* c) {
+    if (r.get(1) == 0) return;                  // c holds the previous values
+    if (r.get(1)) c->flags = (uint8_t)r.get(8);
+    if (r.get(1)) c->safe_mode = (uint8_t)r.get(8);
+    if (r.get(1)) c->devices_operational = (uint8_t)r.get(8);
+    if (r.get(1)) c->devices_faulted = (uint8_t)r.get(8);
+    if (r.get(1)) c->active_alarms = (uint16_t)r.get(16);
+    if (r.get(1)) c->devices_faulted_mask = (uint16_t)r.get(16);
+}
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+void ReadingEncoder::begin(uint8_t* buf, size_t cap) {
+    _buf = buf;
+    _count = 0;
+    memset(&_state, 0, sizeof(_state));
+    _bits.begin(buf + RCODEC_HEADER_SIZE, cap > RCODEC_HEADER_SIZE ? cap - RCODEC_HEADER_SIZE : 0);
+}
+
+bool ReadingEncoder::append(const sd_log_record_t* rec) {
+    if (_count == RCODEC_MAX_READINGS) return false;
+    size_t mark = _bits.bitPos();
+    rcodec_state_t saved = _state;
+    const sd_log_record_t* p = &_state.prev;
+    bool first = _count == 0;
+
+    putTimestamp(_bits, &_state, rec->timestamp, first);
+    if (first) _bits.put(floatBits(rec->conductivity), 32);
+    else putFloat(_bits, &_state, p->conductivity, rec->conductivity);
+    putVar(_bits, zigzag((int32_t)rec->temperature_d - p->temperature_d));
+    putVar(_bits, zigzag((int32_t)rec->flow_cgpm - p->flow_cgpm));
+    putVar(_bits, zigzag((int32_t)rec->valve_dmA - p->valve_dmA));
+    putDelta(_bits, p->measurement_age_ms, rec->measurement_age_ms);
+    putDelta(_bits, p->water_meter1, rec->water_meter1);
+    putDelta(_bits, p->water_meter2, rec->water_meter2);
+    putDelta(_bits, p->fw_pump_cycle_count, rec->fw_pump_cycle_count);
+    putDelta(_bits, p->fw_pump_on_time_sec, rec->fw_pump_on_time_sec);
+    putState(_bits, p, rec);
+
+    if (_bits.overflow()) {
+        _bits.rewind(mark);
+        _state = saved;
+        return false;
+    }
+    _state.prev = *rec;
+    _count++;
+    return true;
+}
+
+size_t ReadingEncoder::finish() {
+    _buf[0] = RCODEC_VERSION;
+    _buf[1] = (uint8_t)(_count & 0xFF);
+    _buf[2] = (uint8_t)(_count >> 8);
+    // Zero the padding of the last byte
+    size_t pos = _bits.bitPos();
+    if (pos & 7) _bits.put(0, (uint8_t)(8 - (pos & 7)));
+    return RCODEC_HEADER_SIZE + _bits.bytes();
+}
+
+// ============================================================================
+// DECODER
+// ============================================================================
+
+bool ReadingDecoder::begin(const uint8_t* buf, size_t len) {
+    _count = 0;
+    _read = 0;
+    memset(&_state, 0, sizeof(_state));
+    if (len < RCODEC_HEADER_SIZE || buf[0] != RCODEC_VERSION) return false;
+    _count = (uint16_t)(buf[1] | (buf[2] << 8));
+    _bits.begin(buf + RCODEC_HEADER_SIZE, len - RCODEC_HEADER_SIZE);
+    return true;
+}
+
+bool ReadingDecoder::next(sd_log_record_t* rec) {
+    if (_read >= _count) return false;
+    const sd_log_record_t* p = &_state.prev;
+    bool first = _read == 0;
+    sd_log_record_t c = *p;
+
+    c.timestamp = getTimestamp(_bits, &_state, first);
+    c.conductivity = first ? bitsFloat(_bits.get(32)) : getFloat(_bits, &_state, p->conductivity);
+    c.temperature_d = (int16_t)(p->temperature_d + unzigzag(getVar(_bits)));
+    c.flow_cgpm = (uint16_t)(p->flow_cgpm + unzigzag(getVar(_bits)));
+    c.valve_dmA = (int16_t)(p->valve_dmA + unzigzag(getVar(_bits)));
+    c.measurement_age_ms = getDelta(_bits, p->measurement_age_ms);
+    c.water_meter1 = getDelta(_bits, p->water_meter1);
+    c.water_meter2 = getDelta(_bits, p->water_meter2);
+    c.fw_pump_cycle_count = getDelta(_bits, p->fw_pump_cycle_count);
+    c.fw_pump_on_time_sec = getDelta(_bits, p->fw_pump_on_time_sec);
+    getState(_bits, &c);
+    if (_bits.overrun()) {
+        _read = _count;
+        return false;
+    }
+
+    c.crc = cp_crc16((const uint8_t*)&c, offsetof(sd_log_record_t, crc));
+    _state.prev = c;
+    _read++;
+    *rec = c;
+    return true;
+}
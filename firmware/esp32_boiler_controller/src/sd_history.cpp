@@ -0,0 +1,333 @@
+/**
+ * @file sd_history.cpp
+ * @brief Time-range reader over the SD reading logs
+ */
+
+#include "sd_history.h"
+#include <time.h>
+
+void sdhist_date(uint32_t t, char* buf, size_t len) {
+    time_t tt = (time_t)t;
+    struct tm tm;
+    localtime_r(&tt, &tm);
+    strftime(buf, len, "%Y-%m-%d", &tm);
+}
+
+// Noon of the local day of t, plus days (noon steps across DST changes safely)
+static uint32_t noonOf(uint32_t t, int days) {
+    time_t tt = (time_t)t;
+    struct tm tm;
+    localtime_r(&tt, &tm);
+    tm.tm_mday += days;
+    tm.tm_hour = 12;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return (uint32_t)mktime(&tm);
+}
+
+// ============================================================================
+// CONSTRUCTOR / QUERY SETUP
+// ============================================================================
+
+SDHistoryReader::SDHistoryReader(SDHistorySource* src, const char* dir)
+    : _src(src)
+    , _dir(dir)
+    , _from(0)
+    , _to(0)
+    , _fields(0)
+    , _step(1)
+    , _next_emit(0)
+    , _day(0)
+    , _next_kind(FILE_CSV)
+    , _open_kind(FILE_NONE)
+    , _done(true)
+    , _error(false)
+    , _pos(0)
+    , _size(0)
+    , _rec_size(SD_BIN_RECORD_SIZE)
+    , _rows(0)
+    , _reads(0)
+    , _block_len(0)
+    , _block_pos(0)
+    , _line_len(0)
+    , _out_len(0)
+    , _out_pos(0)
+{
+    memset(_last_date, 0, sizeof(_last_date));
+}
+
+bool SDHistoryReader::begin(uint32_t from, uint32_t to, uint32_t fields, uint32_t step_s) {
+    if (from > to || (to - from) / 86400 > SD_HIST_MAX_DAYS) return false;
+
+    closeFile();
+    _from = from;
+    _to = to;
+    _fields = (fields ? fields : (1UL << SD_CSV_FIELDS) - 1) | 1;     // Timestamp always
+    _step = step_s > 1 ? step_s : 1;
+    _next_emit = 0;
+    _day = noonOf(from, 0);
+    sdhist_date(to, _last_date, sizeof(_last_date));
+    _next_kind = FILE_CSV;
+    _done = false;
+    _error = false;
+    _rows = 0;
+    _reads = 0;
+    formatHeader();
+    return true;
+}
+
+bool SDHistoryReader::parseFields(const char* list, uint32_t* fields) {
+    *fields = 0;
+    const char* p = list;
+    while (*p) {
+        const char* end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len > 0) {
+            int i = sdlog_field_index(p, len);
+            if (i < 0) return false;
+            *fields |= 1UL << i;
+        }
+        if (!end) break;
+        p = end + 1;
+    }
+    return true;
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+size_t SDHistoryReader::read(char* out, size_t max_len) {
+    size_t n = 0;
+    while (n < max_len) {
+        if (_out_pos < _out_len) {
+            size_t k = min(_out_len - _out_pos, max_len - n);
+            memcpy(out + n, _out + _out_pos, k);
+            _out_pos += k;
+            n += k;
+            continue;
+        }
+        if (_done) break;
+        sd_log_record_t rec;
+        if (!nextRow(&rec)) {
+            closeFile();
+            _done = true;
+            break;
+        }
+        formatRow(&rec);
+    }
+    return n;
+}
+
+void SDHistoryReader::formatHeader() {
+    size_t len = 0;
+    for (uint8_t i = 0; i < SD_CSV_FIELDS; i++) {
+        if (!(_fields & (1UL << i))) continue;
+        len += snprintf(_out + len, sizeof(_out) - len, "%s%s", len ? "," : "", sdlog_field_name(i));
+        len = min(len, sizeof(_out) - 2);
+    }
+    _out[len++] = '\n';
+    _out_len = len;
+    _out_pos = 0;
+}
+
+void SDHistoryReader::formatRow(const sd_log_record_t* rec) {
+    size_t len = 0;
+    for (uint8_t i = 0; i < SD_CSV_FIELDS; i++) {
+        if (!(_fields & (1UL << i))) continue;
+        if (len) _out[len++] = ',';
+        int k = sdlog_format_field(rec, i, _out + len, sizeof(_out) - 1 - len);
+        len = min(len + (size_t)max(k, 0), sizeof(_out) - 2);
+    }
+    _out[len++] = '\n';
+    _out_len = len;
+    _out_pos = 0;
+    _rows++;
+}
+
+// ============================================================================
+// ROWS
+// ============================================================================
+
+bool SDHistoryReader::nextRow(sd_log_record_t* rec) {
+    for (;;) {
+        if (_error) return false;
+        if (_open_kind == FILE_NONE) {
+            if (!openNextFile()) return false;
+            continue;
+        }
+
+        if (_open_kind == FILE_BIN) {
+            if (_block_pos + _rec_size > _block_len && !fillBlock()) {
+                closeFile();
+                continue;
+            }
+            memcpy(rec, _block + _block_pos, sizeof(*rec));
+            _block_pos += _rec_size;
+            if (!sdlog_record_valid(rec)) continue;     // Torn by power loss
+        } else {
+            // Next complete line; a row longer than the buffer is dropped
+            bool have_line = false;
+            while (!have_line) {
+                if (_block_pos >= _block_len && !fillBlock()) break;
+                char c = (char)_block[_block_pos++];
+                if (c == '\n') {
+                    _line[min(_line_len, sizeof(_line) - 1)] = 0;
+                    have_line = _line_len < sizeof(_line);
+                    _line_len = 0;
+                } else if (_line_len < sizeof(_line)) {
+                    _line[_line_len++] = c;
+                }
+            }
+            if (!have_line) {
+                closeFile();                            // End of file (a trailing partial row is skipped)
+                continue;
+            }
+            if (!sdlog_parse_csv(_line, rec)) continue; // Header or damaged row
+        }
+
+        if (rec->timestamp < _from) continue;
+        if (rec->timestamp > _to) {
+            closeFile();                                // Rest of this file is later
+            continue;
+        }
+        if (_step > 1) {
+            if (rec->timestamp < _next_emit) continue;
+            _next_emit = (rec->timestamp / _step + 1) * _step;
+        }
+        return true;
+    }
+}
+
+// ============================================================================
+// FILES
+// ============================================================================
+
+bool SDHistoryReader::openNextFile() {
+    for (;;) {
+        if (_error) return false;
+        char date[12];
+        sdhist_date(_day, date, sizeof(date));
+        if (strcmp(date, _last_date) > 0) return false;
+
+        // Advance first, so a missing file just moves on
+        uint8_t kind = _next_kind;
+        if (kind == FILE_CSV) {
+            _next_kind = FILE_BIN;
+        } else {
+            _next_kind = FILE_CSV;
+            _day = noonOf(_day, 1);
+        }
+
+        _block_len = _block_pos = 0;
+        _line_len = 0;
+        if (kind == FILE_CSV ? openCsv(date) : openBin(date)) {
+            _open_kind = kind;
+            return true;
+        }
+    }
+}
+
+void SDHistoryReader::closeFile() {
+    if (_open_kind != FILE_NONE) _src->close();
+    _open_kind = FILE_NONE;
+}
+
+int32_t SDHistoryReader::readAt(uint32_t offset, uint8_t* buf, size_t len) {
+    _reads++;
+    int32_t n = _src->read(offset, buf, len);
+    if (n < 0) _error = true;
+    return n;
+}
+
+bool SDHistoryReader::fillBlock() {
+    if (_pos >= _size) return false;
+    size_t want = min((uint32_t)SD_HIST_BLOCK, _size - _pos);
+    if (_open_kind == FILE_BIN) {
+        want -= want % _rec_size;                       // Whole records per block
+        if (want == 0) return false;
+    }
+    int32_t n = readAt(_pos, _block, want);
+    if (n <= 0) return false;
+    _pos += n;
+    _block_len = n;
+    _block_pos = 0;
+    return true;
+}
+
+bool SDHistoryReader::openBin(const char* date) {
+    char path[48];
+
+    // Index: last entry before `from`, probed entry by entry (no index = from the start)
+    uint32_t start = 0;
+    snprintf(path, sizeof(path), "%s/%s.idx", _dir, date);
+    if (_src->open(path)) {
+        uint32_t lo = 0, hi = _src->size() / sizeof(sd_log_index_entry_t);
+        while (lo < hi && !_error) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            sd_log_index_entry_t e;
+            if (readAt(mid * sizeof(e), (uint8_t*)&e, sizeof(e)) != (int32_t)sizeof(e)) break;
+            if (e.timestamp < _from) {
+                start = e.record;
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        _src->close();
+    }
+
+    snprintf(path, sizeof(path), "%s/%s.bin", _dir, date);
+    if (!_src->open(path)) return false;
+    _size = _src->size();
+    sd_log_file_header_t hdr;
+    if (_size < SD_BIN_HEADER_SIZE ||
+        readAt(0, (uint8_t*)&hdr, sizeof(hdr)) != (int32_t)sizeof(hdr) ||
+        (_rec_size = sdlog_check_header(&hdr)) == 0) {
+        _src->close();
+        _rec_size = SD_BIN_RECORD_SIZE;
+        return false;
+    }
+    _pos = SD_BIN_HEADER_SIZE + start * _rec_size;
+    if (_pos > _size) _pos = SD_BIN_HEADER_SIZE;        // Index ahead of the data (torn write)
+    return true;
+}
+
+bool SDHistoryReader::csvTimestampAfter(uint32_t offset, uint32_t* ts, uint32_t* line_start) {
+    size_t want = min((uint32_t)SD_HIST_BLOCK, _size - offset);
+    int32_t n = readAt(offset, _block, want);
+    if (n <= 0) return false;
+    const char* b = (const char*)_block;
+    const char* nl = (const char*)memchr(b, '\n', n);
+    if (!nl) return false;
+    const char* p = nl + 1;
+    const char* comma = (const char*)memchr(p, ',', b + n - p);
+    if (!comma || comma == p) return false;             // Timestamp not complete in this block
+    char* end;
+    *ts = (uint32_t)strtoul(p, &end, 10);
+    if (end != comma) return false;
+    *line_start = offset + (uint32_t)(p - b);
+    return true;
+}
+
+bool SDHistoryReader::openCsv(const char* date) {
+    char path[48];
+    snprintf(path, sizeof(path), "%s/%s.csv", _dir, date);
+    if (!_src->open(path)) return false;
+    _size = _src->size();
+
+    // Bisect by offset: lo is always at or before the first row >= from
+    uint32_t lo = 0, hi = _size;
+    while (lo + SD_HIST_BLOCK < hi && !_error) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t ts, line_start;
+        if (!csvTimestampAfter(mid, &ts, &line_start) || ts >= _from) {
+            hi = mid;
+        } else {
+            lo = line_start;
+        }
+    }
+    _pos = lo;
+    return !_error;
+}
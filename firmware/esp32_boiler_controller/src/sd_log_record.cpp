@@ -0,0 +1,217 @@
+/**
+ * @file sd_log_record.cpp
+ * @brief Binary SD log record packing, CRC, CSV formatting and index search
+ */
+
+#include "sd_log_record.h"
+#include "coprocessor_protocol.h"   // cp_crc16
+
+static int32_t quantize(float v, float scale, int32_t lo, int32_t hi) {
+    if (isnan(v)) return 0;
+    float q = roundf(v * scale);
+    if (q < (float)lo) return lo;
+    if (q > (float)hi) return hi;
+    return (int32_t)q;
+}
+
+void sdlog_pack(const sensor_reading_t* r, sd_log_record_t* rec) {
+    rec->timestamp = r->timestamp;
+    rec->conductivity = r->conductivity;
+    rec->water_meter1 = r->water_meter1;
+    rec->water_meter2 = r->water_meter2;
+    rec->fw_pump_cycle_count = r->fw_pump_cycle_count;
+    rec->fw_pump_on_time_sec = r->fw_pump_on_time_sec;
+    rec->measurement_age_ms = r->measurement_age_ms;
+    rec->temperature_d = (int16_t)quantize(r->temperature, 10.0f, INT16_MIN, INT16_MAX);
+    rec->flow_cgpm = (uint16_t)quantize(r->flow_rate, 100.0f, 0, UINT16_MAX);
+    rec->valve_dmA = (int16_t)quantize(r->valve_position_mA, 10.0f, INT16_MIN, INT16_MAX);
+    rec->active_alarms = r->active_alarms;
+    rec->devices_faulted_mask = r->devices_faulted_mask;
+    rec->flags = (r->blowdown_active ? SD_REC_BLOWDOWN : 0) |
+                 (r->pump1_active ? SD_REC_PUMP1 : 0) |
+                 (r->pump2_active ? SD_REC_PUMP2 : 0) |
+                 (r->pump3_active ? SD_REC_PUMP3 : 0) |
+                 (r->feedwater_pump_on ? SD_REC_FW_PUMP : 0) |
+                 (r->cond_sensor_valid ? SD_REC_COND_VALID : 0) |
+                 (r->temp_sensor_valid ? SD_REC_TEMP_VALID : 0);
+    rec->safe_mode = r->safe_mode;
+    rec->devices_operational = r->devices_operational;
+    rec->devices_faulted = r->devices_faulted;
+    rec->crc = cp_crc16((const uint8_t*)rec, offsetof(sd_log_record_t, crc));
+}
+
+void sdlog_unpack(const sd_log_record_t* rec, sensor_reading_t* r) {
+    r->timestamp = rec->timestamp;
+    r->conductivity = rec->conductivity;
+    r->temperature = rec->temperature_d / 10.0f;
+    r->water_meter1 = rec->water_meter1;
+    r->water_meter2 = rec->water_meter2;
+    r->flow_rate = rec->flow_cgpm / 100.0f;
+    r->blowdown_active = (rec->flags & SD_REC_BLOWDOWN) != 0;
+    r->valve_position_mA = rec->valve_dmA / 10.0f;
+    r->pump1_active = (rec->flags & SD_REC_PUMP1) != 0;
+    r->pump2_active = (rec->flags & SD_REC_PUMP2) != 0;
+    r->pump3_active = (rec->flags & SD_REC_PUMP3) != 0;
+    r->feedwater_pump_on = (rec->flags & SD_REC_FW_PUMP) != 0;
+    r->fw_pump_cycle_count = rec->fw_pump_cycle_count;
+    r->fw_pump_on_time_sec = rec->fw_pump_on_time_sec;
+    r->active_alarms = rec->active_alarms;
+    r->safe_mode = rec->safe_mode;
+    r->cond_sensor_valid = (rec->flags & SD_REC_COND_VALID) != 0;
+    r->temp_sensor_valid = (rec->flags & SD_REC_TEMP_VALID) != 0;
+    r->devices_operational = rec->devices_operational;
+    r->devices_faulted = rec->devices_faulted;
+    r->devices_faulted_mask = rec->devices_faulted_mask;
+    r->measurement_age_ms = rec->measurement_age_ms;
+}
+
+bool sdlog_record_valid(const sd_log_record_t* rec) {
+    return cp_crc16((const uint8_t*)rec, offsetof(sd_log_record_t, crc)) == rec->crc;
+}
+
+int sdlog_format_csv(const sd_log_record_t* rec, char* buf, size_t len) {
+    return snprintf(buf, len,
+        "%lu,%.1f,%.1f,%lu,%lu,%.2f,%d,%.1f,%d,%d,%d,%d,%lu,%lu,0x%04X,"
+        "%u,%d,%d,%u,%u,0x%04X,%lu",
+        (unsigned long)rec->timestamp,
+        rec->conductivity,
+        rec->temperature_d / 10.0f,
+        (unsigned long)rec->water_meter1,
+        (unsigned long)rec->water_meter2,
+        rec->flow_cgpm / 100.0f,
+        (rec->flags & SD_REC_BLOWDOWN) ? 1 : 0,
+        rec->valve_dmA / 10.0f,
+        (rec->flags & SD_REC_PUMP1) ? 1 : 0,
+        (rec->flags & SD_REC_PUMP2) ? 1 : 0,
+        (rec->flags & SD_REC_PUMP3) ? 1 : 0,
+        (rec->flags & SD_REC_FW_PUMP) ? 1 : 0,
+        (unsigned long)rec->fw_pump_cycle_count,
+        (unsigned long)rec->fw_pump_on_time_sec,
+        rec->active_alarms,
+        rec->safe_mode,
+        (rec->flags & SD_REC_COND_VALID) ? 1 : 0,
+        (rec->flags & SD_REC_TEMP_VALID) ? 1 : 0,
+        rec->devices_operational,
+        rec->devices_faulted,
+        rec->devices_faulted_mask,
+        (unsigned long)rec->measurement_age_ms
+    );
+}
+
+static const char* const s_fields[SD_CSV_FIELDS] = {
+    "timestamp", "conductivity", "temperature", "wm1_gal", "wm2_gal",
+    "flow_gpm", "blowdown", "valve_mA", "pump1", "pump2", "pump3",
+    "fw_pump", "fw_cycles", "fw_ontime_s", "alarms",
+    "safe_mode", "cond_valid", "temp_valid",
+    "dev_operational", "dev_faulted", "dev_faulted_mask", "meas_age_ms"
+};
+
+const char* sdlog_field_name(uint8_t field) {
+    return field < SD_CSV_FIELDS ? s_fields[field] : "";
+}
+
+int sdlog_field_index(const char* name, size_t len) {
+    for (uint8_t i = 0; i < SD_CSV_FIELDS; i++) {
+        if (strlen(s_fields[i]) == len && strncmp(s_fields[i], name, len) == 0) return i;
+    }
+    return -1;
+}
+
+int sdlog_format_field(const sd_log_record_t* rec, uint8_t field, char* buf, size_t len) {
+    switch (field) {
+        case 0:  return snprintf(buf, len, "%lu", (unsigned long)rec->timestamp);
+        case 1:  return snprintf(buf, len, "%.1f", rec->conductivity);
+        case 2:  return snprintf(buf, len, "%.1f", rec->temperature_d / 10.0f);
+        case 3:  return snprintf(buf, len, "%lu", (unsigned long)rec->water_meter1);
+        case 4:  return snprintf(buf, len, "%lu", (unsigned long)rec->water_meter2);
+        case 5:  return snprintf(buf, len, "%.2f", rec->flow_cgpm / 100.0f);
+        case 6:  return snprintf(buf, len, "%d", (rec->flags & SD_REC_BLOWDOWN) ? 1 : 0);
+        case 7:  return snprintf(buf, len, "%.1f", rec->valve_dmA / 10.0f);
+        case 8:  return snprintf(buf, len, "%d", (rec->flags & SD_REC_PUMP1) ? 1 : 0);
+        case 9:  return snprintf(buf, len, "%d", (rec->flags & SD_REC_PUMP2) ? 1 : 0);
+        case 10: return snprintf(buf, len, "%d", (rec->flags & SD_REC_PUMP3) ? 1 : 0);
+        case 11: return snprintf(buf, len, "%d", (rec->flags & SD_REC_FW_PUMP) ? 1 : 0);
+        case 12: return snprintf(buf, len, "%lu", (unsigned long)rec->fw_pump_cycle_count);
+        case 13: return snprintf(buf, len, "%lu", (unsigned long)rec->fw_pump_on_time_sec);
+        case 14: return snprintf(buf, len, "0x%04X", rec->active_alarms);
+        case 15: return snprintf(buf, len, "%u", rec->safe_mode);
+        case 16: return snprintf(buf, len, "%d", (rec->flags & SD_REC_COND_VALID) ? 1 : 0);
+        case 17: return snprintf(buf, len, "%d", (rec->flags & SD_REC_TEMP_VALID) ? 1 : 0);
+        case 18: return snprintf(buf, len, "%u", rec->devices_operational);
+        case 19: return snprintf(buf, len, "%u", rec->devices_faulted);
+        case 20: return snprintf(buf, len, "0x%04X", rec->devices_faulted_mask);
+        case 21: return snprintf(buf, len, "%lu", (unsigned long)rec->measurement_age_ms);
+        default: break;
+    }
+    if (len) buf[0] = 0;
+    return 0;
+}
+
+bool sdlog_parse_csv(const char* line, sd_log_record_t* rec) {
+    // Column values in SD_CSV_HEADER order; alarms and the fault mask are 0x hex
+    double v[SD_CSV_FIELDS];
+    const char* p = line;
+    for (uint8_t i = 0; i < SD_CSV_FIELDS; i++) {
+        char* end;
+        v[i] = (i == 14 || i == 20) ? (double)strtoul(p, &end, 16) : strtod(p, &end);
+        if (end == p) return false;                 // Header, or a row cut short
+        if (i + 1 < SD_CSV_FIELDS) {
+            if (*end != ',') return false;
+            p = end + 1;
+        } else if (*end != 0 && *end != '\r' && *end != '\n') {
+            return false;
+        }
+    }
+
+    memset(rec, 0, sizeof(*rec));
+    rec->timestamp = (uint32_t)v[0];
+    rec->conductivity = (float)v[1];
+    rec->temperature_d = (int16_t)lround(v[2] * 10.0);
+    rec->water_meter1 = (uint32_t)v[3];
+    rec->water_meter2 = (uint32_t)v[4];
+    rec->flow_cgpm = (uint16_t)lround(v[5] * 100.0);
+    rec->valve_dmA = (int16_t)lround(v[7] * 10.0);
+    rec->fw_pump_cycle_count = (uint32_t)v[12];
+    rec->fw_pump_on_time_sec = (uint32_t)v[13];
+    rec->active_alarms = (uint16_t)v[14];
+    rec->safe_mode = (uint8_t)v[15];
+    rec->devices_operational = (uint8_t)v[18];
+    rec->devices_faulted = (uint8_t)v[19];
+    rec->devices_faulted_mask = (uint16_t)v[20];
+    rec->measurement_age_ms = (uint32_t)v[21];
+    rec->flags = (v[6] != 0 ? SD_REC_BLOWDOWN : 0) |
+                 (v[8] != 0 ? SD_REC_PUMP1 : 0) |
+                 (v[9] != 0 ? SD_REC_PUMP2 : 0) |
+                 (v[10] != 0 ? SD_REC_PUMP3 : 0) |
+                 (v[11] != 0 ? SD_REC_FW_PUMP : 0) |
+                 (v[16] != 0 ? SD_REC_COND_VALID : 0) |
+                 (v[17] != 0 ? SD_REC_TEMP_VALID : 0);
+    rec->crc = cp_crc16((const uint8_t*)rec, offsetof(sd_log_record_t, crc));
+    return true;
+}
+
+void sdlog_init_header(sd_log_file_header_t* hdr) {
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = SD_BIN_MAGIC;
+    hdr->version = SD_BIN_VERSION;
+    hdr->record_size = SD_BIN_RECORD_SIZE;
+    hdr->index_interval = SD_BIN_INDEX_INTERVAL;
+}
+
+uint8_t sdlog_check_header(const sd_log_file_header_t* hdr) {
+    if (hdr->magic != SD_BIN_MAGIC || hdr->version < SD_BIN_VERSION) return 0;
+    // A later version may only append fields (after the CRC): readers step by the
+    // header's record size and use the known prefix
+    return hdr->record_size >= SD_BIN_RECORD_SIZE ? hdr->record_size : 0;
+}
+
+uint32_t sdlog_index_start(const sd_log_index_entry_t* index, size_t count, uint32_t t) {
+    // First entry with timestamp >= t; the one before it bounds the scan
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index[mid].timestamp < t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo > 0 ? index[lo - 1].record : 0;
+}
@@ -2,15 +2,27 @@
  * @file sd_logger.cpp
  * @brief SD Card Data Logger Implementation
  *
- * Logs sensor readings, events, and alarms to a micro-SD card as CSV files.
+ * Logs sensor readings, events, and alarms to a micro-SD card as CSV files
+ * (readings optionally as fixed-size binary records, see sd_log_record.h).
  * Shares the ESP32 VSPI bus with the MAX31865 PT1000 RTD; all SPI access
  * is protected by a FreeRTOS mutex.
+ *
+ * Callers never touch the card: logReading/logEvent/logAlarm pack or format
+ * the message and push it onto a lock-free queue. The SD writer task
+ * (runWriter) stages messages into two block buffers per file and writes a
+ * block when it is full, holding the SPI mutex once per block.
  */
 
 #include "sd_logger.h"
 #include "data_logger.h"
 #include "pin_definitions.h"
 #include <time.h>
+#include "ff.h"                 // f_getfree: FAT cluster size
+
+// Staging buffers (writer task only)
+static uint8_t s_dataBlocks[2][SD_BLOCK_MAX];
+static uint8_t s_eventBlocks[2][SD_EVENT_BLOCK];
+static uint8_t s_spoolBlocks[2][SD_EVENT_BLOCK];
 
 // Global instance
 SDLogger sdLogger;
@@ -24,14 +36,33 @@ SDLogger::SDLogger()
     , _spi(nullptr)
     , _spiMutex(nullptr)
     , _available(false)
-    , _headerWritten(false)
+    , _format(SD_LOG_FORMAT_CSV)
+    , _fileFormat(SD_LOG_FORMAT_CSV)
     , _card_status(SD_STATUS_NOT_INITIALIZED)
     , _recordsToday(0)
-    , _lastFlushTime(0)
     , _bootSequence(0)
+    , _writerTask(nullptr)
+    , _flushRequested(false)
+    , _dataStagedSince(0)
+    , _eventStagedSince(0)
+    , _dataStagedEnd(0)
+    , _dataWritten(0)
+    , _spoolStagedSince(0)
+    , _spoolSegment(UINT32_MAX)
+    , _spoolNext(0)
+    , _spoolWritten(0)
+    , _spoolFirst(0)
+    , _spoolHead(0)
+    , _spoolQueued(0)
+    , _spoolDone(0)
+    , _pendingIndexCount(0)
 {
     memset(_currentFilename, 0, sizeof(_currentFilename));
+    memset(_indexFilename, 0, sizeof(_indexFilename));
     memset(_currentDate, 0, sizeof(_currentDate));
+    memset(_eventFilename, 0, sizeof(_eventFilename));
+    memset(_eventDate, 0, sizeof(_eventDate));
+    memset(&_stats, 0, sizeof(_stats));
 }
 
 // ============================================================================
@@ -110,8 +141,19 @@ bool SDLogger::begin(uint8_t csPin, SPIClass& spi, SemaphoreHandle_t mutex) {
     if (!takeSPI()) { _available = false; return false; }
     ensureDirectory(SD_LOG_DIR);
     ensureDirectory(SD_EVENT_DIR);
+    ensureDirectory(SD_SPOOL_DIR);
+    scanSpool();
+    _stats.cluster_size = detectClusterSize();
     giveSPI();
 
+    // Block = cluster (capped): every full write fills whole sectors of one cluster
+    size_t block = min((size_t)_stats.cluster_size, (size_t)SD_BLOCK_MAX);
+    _dataStage.begin(s_dataBlocks[0], s_dataBlocks[1], block);
+    _eventStage.begin(s_eventBlocks[0], s_eventBlocks[1], SD_EVENT_BLOCK);
+    _spoolStage.begin(s_spoolBlocks[0], s_spoolBlocks[1], SD_EVENT_BLOCK);
+    Serial.printf("  FAT cluster %lu bytes, write block %u bytes\n",
+                  (unsigned long)_stats.cluster_size, (unsigned)block);
+
     Serial.println("  SD card logger initialized successfully");
     return true;
 }
@@ -121,131 +163,293 @@ bool SDLogger::isAvailable() {
 }
 
 // ============================================================================
-// SENSOR READING LOGGING
+// PRODUCERS (any task: pack/format and queue, no SPI)
 // ============================================================================
 
+bool SDLogger::queue(uint8_t kind, const void* payload, size_t len) {
+    if (!_available) return false;
+    if (!_queue.push(kind, payload, len)) return false;
+    if (_writerTask) xTaskNotifyGive(_writerTask);
+    return true;
+}
+
 bool SDLogger::logReading(const sensor_reading_t* reading) {
     if (!_available || !reading) return false;
 
-    if (!takeSPI()) return false;
+    // Both formats come from the same quantized record, so a converted
+    // binary log matches the CSV byte for byte
+    sd_log_record_t rec;
+    sdlog_pack(reading, &rec);
+    return queue(SD_MSG_READING, &rec, sizeof(rec));
+}
 
-    // Ensure we have the right daily file open
-    if (!ensureDailyFile()) {
-        giveSPI();
-        return false;
-    }
+void SDLogger::setFormat(uint8_t format) {
+    if (format > SD_LOG_FORMAT_BINARY) format = SD_LOG_FORMAT_CSV;
+    if (format == _format) return;
+    // The writer starts a file of the other kind at the next reading
+    _format = format;
+    Serial.printf("SD log format: %s\n", _format == SD_LOG_FORMAT_BINARY ? "binary" : "CSV");
+}
 
-    // Format CSV row
-    char line[384];
-    snprintf(line, sizeof(line),
-        "%lu,%.1f,%.1f,%lu,%lu,%.2f,%d,%.1f,%d,%d,%d,%d,%lu,%lu,0x%04X,"
-        "%u,%d,%d,%u,%u,0x%04X,%lu",
-        reading->timestamp,
-        reading->conductivity,
-        reading->temperature,
-        reading->water_meter1,
-        reading->water_meter2,
-        reading->flow_rate,
-        reading->blowdown_active ? 1 : 0,
-        reading->valve_position_mA,
-        reading->pump1_active ? 1 : 0,
-        reading->pump2_active ? 1 : 0,
-        reading->pump3_active ? 1 : 0,
-        reading->feedwater_pump_on ? 1 : 0,
-        reading->fw_pump_cycle_count,
-        reading->fw_pump_on_time_sec,
-        reading->active_alarms,
-        reading->safe_mode,
-        reading->cond_sensor_valid ? 1 : 0,
-        reading->temp_sensor_valid ? 1 : 0,
-        reading->devices_operational,
-        reading->devices_faulted,
-        reading->devices_faulted_mask,
-        reading->measurement_age_ms
-    );
-
-    bool ok = writeCSVRow(line);
-    giveSPI();
+bool SDLogger::logEvent(const char* event_type, const char* description, int32_t value) {
+    if (!_available) return false;
 
-    if (ok) {
-        _recordsToday++;
-    }
+    char line[SD_MSG_PAYLOAD];
+    int len = snprintf(line, sizeof(line), "%lu,%.31s,\"%.96s\",%ld",
+                       (unsigned long)(millis() / 1000), event_type, description, (long)value);
+    if (len < 0) return false;
+    return queue(SD_MSG_EVENT, line, min((size_t)len, sizeof(line) - 1));
+}
 
-    return ok;
+bool SDLogger::logAlarm(uint16_t alarm_code, const char* alarm_name,
+                         bool active, float trigger_value) {
+    if (!_available) return false;
+
+    char line[SD_MSG_PAYLOAD];
+    int len = snprintf(line, sizeof(line), "%lu,ALARM_%s,\"%.96s %s\",%.1f",
+                       (unsigned long)(millis() / 1000),
+                       active ? "ON" : "OFF",
+                       alarm_name,
+                       active ? "ACTIVE" : "CLEARED",
+                       trigger_value);
+    if (len < 0) return false;
+    return queue(SD_MSG_EVENT, line, min((size_t)len, sizeof(line) - 1));
+}
+
+bool SDLogger::logSpool(const spool_record_t* rec) {
+    if (!_available) return false;
+
+    // Counted before the push so the writer can never finish it first
+    _spoolQueued++;
+    if (queue(SD_MSG_SPOOL, rec, sizeof(*rec))) return true;
+    _spoolQueued--;
+    return false;
+}
+
+void SDLogger::trimSpool(uint32_t record) {
+    queue(SD_MSG_SPOOL_TRIM, &record, sizeof(record));
+}
+
+void SDLogger::flush() {
+    _flushRequested = true;
+    if (_writerTask) xTaskNotifyGive(_writerTask);
 }
 
 // ============================================================================
-// EVENT LOGGING
+// WRITER TASK
 // ============================================================================
 
-bool SDLogger::logEvent(const char* event_type, const char* description, int32_t value) {
-    if (!_available) return false;
+void SDLogger::runWriter(uint32_t wait_ms) {
+    if (!_writerTask) _writerTask = xTaskGetCurrentTaskHandle();
 
-    char dateStr[12];
-    getDateString(dateStr, sizeof(dateStr));
+    // Producers notify per message; the timeout drives the hold timer
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
 
-    char filename[SD_MAX_FILENAME_LEN];
-    snprintf(filename, sizeof(filename), "%s/%s_events.csv", SD_EVENT_DIR, dateStr);
+    sd_msg_t msg;
+    while (_queue.pop(&msg)) {
+        _stats.messages++;
+        if (!_available) {
+            if (msg.kind == SD_MSG_SPOOL) _spoolDone++;
+            continue;
+        }
+        if (msg.kind == SD_MSG_READING && msg.len == sizeof(sd_log_record_t)) {
+            sd_log_record_t rec;
+            memcpy(&rec, msg.payload, sizeof(rec));
+            stageReading(&rec);
+        } else if (msg.kind == SD_MSG_EVENT) {
+            stageEvent((const char*)msg.payload, msg.len);
+        } else if (msg.kind == SD_MSG_SPOOL && msg.len == sizeof(spool_record_t)) {
+            spool_record_t rec;
+            memcpy(&rec, msg.payload, sizeof(rec));
+            stageSpool(&rec);
+        } else if (msg.kind == SD_MSG_SPOOL_TRIM && msg.len == sizeof(uint32_t)) {
+            uint32_t record;
+            memcpy(&record, msg.payload, sizeof(record));
+            if (takeSPI()) {
+                removeSpoolSegments(record / SPOOL_SEGMENT_RECORDS);
+                giveSPI();
+            }
+        }
+    }
 
-    char line[256];
-    snprintf(line, sizeof(line), "%lu,%s,\"%s\",%ld",
-             (unsigned long)(millis() / 1000), event_type, description, (long)value);
+    bool force = _flushRequested;
+    _flushRequested = false;
+    uint32_t now = millis();
+    bool dataTail = force || (_dataStagedSince && now - _dataStagedSince >= SD_HOLD_MS);
+    bool eventTail = force || (_eventStagedSince && now - _eventStagedSince >= SD_HOLD_MS);
+    bool spoolTail = force || (_spoolStagedSince && now - _spoolStagedSince >= SD_HOLD_MS);
+
+    // Full blocks go out as soon as they are complete; partial ones when held long enough
+    writeStaged(_dataStage, _dataFile, _dataStagedSince, dataTail);
+    writeStaged(_eventStage, _eventFile, _eventStagedSince, eventTail);
+    writeStaged(_spoolStage, _spoolFile, _spoolStagedSince, spoolTail);
+}
 
-    if (!takeSPI()) return false;
-    bool ok = writeEventLine(filename, line);
-    giveSPI();
+void SDLogger::stageReading(const sd_log_record_t* rec) {
+    char date[12];
+    getDateString(date, sizeof(date));
+    uint8_t format = _format;
+
+    // New day or format: finish the old file, then start the new one
+    if (strcmp(date, _currentDate) != 0 || format != _fileFormat || !_dataFile) {
+        writeStaged(_dataStage, _dataFile, _dataStagedSince, true);
+        if (!takeSPI()) {
+            _stats.write_errors++;
+            return;
+        }
+        strncpy(_currentDate, date, sizeof(_currentDate));
+        _fileFormat = format;
+        bool ok = ensureDailyFile();
+        giveSPI();
+        if (!ok) return;
+    }
 
-    return ok;
+    if (_fileFormat == SD_LOG_FORMAT_BINARY) {
+        stage(_dataStage, _dataFile, _dataStagedSince, (const uint8_t*)rec, sizeof(*rec));
+
+        // Sparse time index: every SD_BIN_INDEX_INTERVAL-th record, written
+        // only after the record it points to is on the card
+        if (_recordsToday % SD_BIN_INDEX_INTERVAL == 0 && _pendingIndexCount < SD_INDEX_PENDING) {
+            _pendingIndex[_pendingIndexCount].entry = { rec->timestamp, _recordsToday };
+            _pendingIndex[_pendingIndexCount].end = _dataStagedEnd;
+            _pendingIndexCount++;
+        }
+    } else {
+        char line[SD_CSV_MAX_LINE + 2];
+        int len = sdlog_format_csv(rec, line, SD_CSV_MAX_LINE);
+        if (len < 0) return;
+        len = min(len, SD_CSV_MAX_LINE - 1);
+        line[len++] = '\r';
+        line[len++] = '\n';
+        stage(_dataStage, _dataFile, _dataStagedSince, (const uint8_t*)line, len);
+    }
+    _recordsToday++;
 }
 
-bool SDLogger::logAlarm(uint16_t alarm_code, const char* alarm_name,
-                         bool active, float trigger_value) {
-    if (!_available) return false;
+void SDLogger::stageEvent(const char* line, size_t len) {
+    char date[12];
+    getDateString(date, sizeof(date));
 
-    char dateStr[12];
-    getDateString(dateStr, sizeof(dateStr));
+    if (strcmp(date, _eventDate) != 0 || !_eventFile) {
+        writeStaged(_eventStage, _eventFile, _eventStagedSince, true);
+        if (!takeSPI()) {
+            _stats.write_errors++;
+            return;
+        }
+        strncpy(_eventDate, date, sizeof(_eventDate));
+        bool ok = ensureEventFile();
+        giveSPI();
+        if (!ok) return;
+    }
 
-    char filename[SD_MAX_FILENAME_LEN];
-    snprintf(filename, sizeof(filename), "%s/%s_events.csv", SD_EVENT_DIR, dateStr);
+    stage(_eventStage, _eventFile, _eventStagedSince, (const uint8_t*)line, len);
+    stage(_eventStage, _eventFile, _eventStagedSince, (const uint8_t*)"\r\n", 2);
+}
 
-    char line[256];
-    snprintf(line, sizeof(line), "%lu,ALARM_%s,\"%s %s\",%.1f",
-             (unsigned long)(millis() / 1000),
-             active ? "ON" : "OFF",
-             alarm_name,
-             active ? "ACTIVE" : "CLEARED",
-             trigger_value);
+void SDLogger::stageSpool(const spool_record_t* rec) {
+    uint32_t segment = _spoolNext / SPOOL_SEGMENT_RECORDS;
 
-    if (!takeSPI()) return false;
-    bool ok = writeEventLine(filename, line);
-    giveSPI();
+    if (segment != _spoolSegment || !_spoolFile) {
+        writeStaged(_spoolStage, _spoolFile, _spoolStagedSince, true);
+        bool ok = takeSPI();
+        if (ok) {
+            ok = openSpoolSegment(segment);
+            giveSPI();
+        }
+        if (!ok) {
+            _stats.write_errors++;
+            _spoolDone++;
+            return;
+        }
+    }
 
-    return ok;
+    stage(_spoolStage, _spoolFile, _spoolStagedSince, (const uint8_t*)rec, sizeof(*rec));
+    _spoolNext++;
 }
 
-// ============================================================================
-// MAINTENANCE
-// ============================================================================
+void SDLogger::stage(SDBlockStager& st, File& f, uint32_t& since,
+                     const uint8_t* data, size_t len) {
+    if (!since) since = millis() | 1;
+    if (&st == &_dataStage) _dataStagedEnd += len;
 
-void SDLogger::flush() {
-    if (!_available) return;
+    size_t n = st.append(data, len);
+    while (n < len) {
+        // Both buffers full: write the older block, then keep staging
+        writeStaged(st, f, since, false);
+        n += st.append(data + n, len - n);
+    }
+}
+
+void SDLogger::writeStaged(SDBlockStager& st, File& f, uint32_t& since, bool tail) {
+    const uint8_t* data;
+    size_t len;
+    while (st.peek(&data, &len, tail)) {
+        uint32_t t0 = micros();
+        bool locked = takeSPI();
+        uint32_t t1 = micros();
+        _stats.writer_wait_us_max = max(_stats.writer_wait_us_max, t1 - t0);
+
+        size_t written = 0;
+        if (locked) {
+            if (f) {
+                written = f.write(data, len);
+                f.flush();              // Commit data and directory entry once per block
+            }
+            if (&st == &_dataStage) {
+                _dataWritten += written;
+                writePendingIndex();
+            }
+            if (&st == &_spoolStage) {
+                _spoolWritten += written;
+                _spoolHead = _spoolSegment * SPOOL_SEGMENT_RECORDS + _spoolWritten / SPOOL_RECORD_SIZE;
+                if (written != len && f) f.close();     // Misaligned now: the next record opens a new segment
+            }
+            giveSPI();
+        }
+        if (&st == &_spoolStage) _spoolDone += len / SPOOL_RECORD_SIZE;
+
+        uint32_t us = micros() - t1;
+        _stats.write_us_last = us;
+        _stats.write_us_max = max(_stats.write_us_max, us);
+        _stats.write_us_avg = _stats.write_us_avg ? _stats.write_us_avg + ((int32_t)(us - _stats.write_us_avg) >> 3) : us;
+        _stats.bytes += written;
+        if (written != len) _stats.write_errors++;   // Bus timeout or no file: the data is dropped
 
-    if (!takeSPI()) return;
-    if (_dataFile) {
-        _dataFile.flush();
+        if (st.consume(len)) {
+            _stats.blocks++;
+        } else {
+            _stats.partial_writes++;
+        }
     }
-    giveSPI();
+    if (st.getStaged() == 0) since = 0;
+}
 
-    _lastFlushTime = millis();
+void SDLogger::writePendingIndex() {
+    uint8_t n = 0;
+    while (n < _pendingIndexCount && _pendingIndex[n].end <= _dataWritten) {
+        if (_indexFile) _indexFile.write((const uint8_t*)&_pendingIndex[n].entry, sizeof(sd_log_index_entry_t));
+        n++;
+    }
+    if (n == 0) return;
+    if (_indexFile) _indexFile.flush();
+    _pendingIndexCount -= n;
+    memmove(&_pendingIndex[0], &_pendingIndex[n], _pendingIndexCount * sizeof(_pendingIndex[0]));
 }
 
-void SDLogger::update() {
-    if (!_available) return;
+sd_writer_stats_t SDLogger::getWriterStats() {
+    sd_writer_stats_t s = _stats;
+    s.dropped = _queue.getDropped();
+    s.queue_high_water = _queue.getHighWater();
+    s.block_size = _dataStage.getBlockSize();
+    return s;
+}
 
-    // Periodic flush
-    if (millis() - _lastFlushTime >= SD_FLUSH_INTERVAL_MS) {
-        flush();
-    }
+void SDLogger::noteSensorBusWait(uint32_t wait_us, bool acquired) {
+    _stats.sensor_wait_us_last = wait_us;
+    _stats.sensor_wait_us_max = max(_stats.sensor_wait_us_max, wait_us);
+    _stats.sensor_waits++;
+    if (wait_us > 1000) _stats.sensor_waits_blocked++;
+    if (!acquired) _stats.sensor_timeouts++;
 }
 
 // ============================================================================
@@ -287,11 +491,9 @@ bool SDLogger::formatCard() {
         return false;
     }
 
-    // Close any open file handles
-    if (_dataFile) {
-        _dataFile.flush();
-        _dataFile.close();
-    }
+    // Close any open file handles; data the writer still has staged is
+    // dropped when its next write finds no file
+    closeFiles();
 
     // Tear down existing mount
     SD.end();
@@ -322,14 +524,14 @@ bool SDLogger::formatCard() {
     // Format + mount succeeded — create log directories
     ensureDirectory(SD_LOG_DIR);
     ensureDirectory(SD_EVENT_DIR);
+    ensureDirectory(SD_SPOOL_DIR);
+    _stats.cluster_size = detectClusterSize();
 
     giveSPI();
 
     _available = true;
     _card_status = SD_STATUS_OK;
-    _headerWritten = false;
     _recordsToday = 0;
-    memset(_currentDate, 0, sizeof(_currentDate));
 
     const char* typeStr = "UNKNOWN";
     if (cardType == CARD_MMC)  typeStr = "MMC";
@@ -345,47 +547,168 @@ bool SDLogger::formatCard() {
 // ============================================================================
 
 bool SDLogger::ensureDailyFile() {
-    // Get current date string
-    char dateStr[12];
-    getDateString(dateStr, sizeof(dateStr));
-
-    // Check if we need to open a new file (date changed or first call)
-    if (strcmp(dateStr, _currentDate) != 0) {
-        // Close previous file if open
-        if (_dataFile) {
-            _dataFile.flush();
-            _dataFile.close();
-        }
-
-        strncpy(_currentDate, dateStr, sizeof(_currentDate));
-        snprintf(_currentFilename, sizeof(_currentFilename),
-                 "%s/%s.csv", SD_LOG_DIR, dateStr);
-
-        _headerWritten = false;
-        _recordsToday = 0;
-    }
+    // Called by the writer with the SPI mutex held, after the old file's
+    // staged data was written; _currentDate and _fileFormat name the new one
+    if (_dataFile) _dataFile.close();
+    if (_indexFile) _indexFile.close();
+    _pendingIndexCount = 0;
+
+    bool binary = (_fileFormat == SD_LOG_FORMAT_BINARY);
+    snprintf(_currentFilename, sizeof(_currentFilename),
+             "%s/%s.%s", SD_LOG_DIR, _currentDate, binary ? "bin" : "csv");
+    snprintf(_indexFilename, sizeof(_indexFilename), "%s/%s.idx", SD_LOG_DIR, _currentDate);
+    _recordsToday = 0;
 
-    // Open file if not already open
-    if (!_dataFile) {
+    if (binary) {
+        if (!openBinaryFile()) return false;
+        _indexFile = SD.open(_indexFilename, FILE_APPEND);
+    } else {
         // Check if file already exists (to skip header)
-        _headerWritten = SD.exists(_currentFilename);
+        bool headerWritten = SD.exists(_currentFilename);
 
         _dataFile = SD.open(_currentFilename, FILE_APPEND);
         if (!_dataFile) {
             Serial.printf("ERROR: Could not open SD log file: %s\n", _currentFilename);
             return false;
         }
+        if (!headerWritten) _dataFile.println(SD_CSV_HEADER);
+    }
+
+    // Staged blocks continue from the end of the file
+    _dataFile.flush();
+    _dataWritten = _dataStagedEnd = (uint32_t)_dataFile.size();
+    _dataStage.reset(_dataWritten);
+    return true;
+}
+
+bool SDLogger::ensureEventFile() {
+    // Writer task, SPI mutex held; one handle stays open for the day
+    if (_eventFile) _eventFile.close();
+    snprintf(_eventFilename, sizeof(_eventFilename), "%s/%s_events.csv", SD_EVENT_DIR, _eventDate);
+
+    _eventFile = SD.open(_eventFilename, FILE_APPEND);
+    if (!_eventFile) {
+        Serial.printf("ERROR: Could not open SD event file: %s\n", _eventFilename);
+        return false;
     }
+    _eventStage.reset((uint32_t)_eventFile.size());
+    return true;
+}
 
-    // Write CSV header if this is a new file
-    if (!_headerWritten) {
-        _dataFile.println(SD_CSV_HEADER);
-        _headerWritten = true;
+void SDLogger::closeFiles() {
+    if (_dataFile) _dataFile.close();
+    if (_indexFile) _indexFile.close();
+    if (_eventFile) _eventFile.close();
+    if (_spoolFile) _spoolFile.close();
+    _spoolSegment = UINT32_MAX;
+    memset(_currentDate, 0, sizeof(_currentDate));
+    memset(_eventDate, 0, sizeof(_eventDate));
+}
+
+bool SDLogger::openSpoolSegment(uint32_t segment) {
+    // Writer task, SPI mutex held; segment holds record _spoolNext
+    if (_spoolFile) _spoolFile.close();
+    _spoolSegment = UINT32_MAX;
+    ensureDirectory(SD_SPOOL_DIR);
+
+    char path[SD_MAX_FILENAME_LEN];
+    spool_segment_path(SD_SPOOL_DIR, segment, path, sizeof(path));
+    _spoolFile = SD.open(path, FILE_APPEND);
+    if (!_spoolFile) {
+        Serial.printf("ERROR: Could not open spool segment: %s\n", path);
+        return false;
     }
 
+    // Record n must land at its slot: a torn tail, a failed write or a
+    // formatted card continue in the next, fresh segment instead
+    uint32_t size = (uint32_t)_spoolFile.size();
+    if (size != (_spoolNext % SPOOL_SEGMENT_RECORDS) * SPOOL_RECORD_SIZE) {
+        _spoolFile.close();
+        segment++;
+        _spoolNext = segment * SPOOL_SEGMENT_RECORDS;
+        spool_segment_path(SD_SPOOL_DIR, segment, path, sizeof(path));
+        SD.remove(path);
+        _spoolFile = SD.open(path, FILE_APPEND);
+        if (!_spoolFile) return false;
+        size = 0;
+    }
+    _spoolSegment = segment;
+    _spoolWritten = size;
+    _spoolHead = _spoolNext;
+    _spoolStage.reset(size);
+
+    // Bounded backlog: the oldest segment goes when a new one would exceed the limit
+    uint32_t first = _spoolFirst / SPOOL_SEGMENT_RECORDS;
+    if (segment >= first + SPOOL_MAX_SEGMENTS) {
+        _stats.spool_segments_dropped += segment - SPOOL_MAX_SEGMENTS + 1 - first;
+        removeSpoolSegments(segment - SPOOL_MAX_SEGMENTS + 1);
+    }
     return true;
 }
 
+void SDLogger::removeSpoolSegments(uint32_t before_segment) {
+    // Writer task, SPI mutex held; never the open segment
+    uint32_t first = _spoolFirst / SPOOL_SEGMENT_RECORDS;
+    if (before_segment > _spoolSegment) before_segment = _spoolSegment;
+    for (uint32_t seg = first; seg < before_segment; seg++) {
+        char path[SD_MAX_FILENAME_LEN];
+        spool_segment_path(SD_SPOOL_DIR, seg, path, sizeof(path));
+        SD.remove(path);
+    }
+    if (before_segment > first) _spoolFirst = before_segment * SPOOL_SEGMENT_RECORDS;
+}
+
+void SDLogger::scanSpool() {
+    // begin(), SPI mutex held: oldest and newest segment on the card
+    uint32_t lo = UINT32_MAX, hi = 0, hi_size = 0;
+    File dir = SD.open(SD_SPOOL_DIR);
+    if (dir) {
+        File f;
+        while ((f = dir.openNextFile())) {
+            const char* name = strrchr(f.name(), '/');
+            name = name ? name + 1 : f.name();
+            char* end;
+            uint32_t seg = strtoul(name, &end, 10);
+            if (end != name && strcmp(end, ".q") == 0) {
+                lo = min(lo, seg);
+                if (seg >= hi) {
+                    hi = seg;
+                    hi_size = (uint32_t)f.size();
+                }
+            }
+            f.close();
+        }
+        dir.close();
+    }
+    if (lo == UINT32_MAX) return;       // Empty: numbering starts at 0
+
+    _spoolFirst = lo * SPOOL_SEGMENT_RECORDS;
+    _spoolNext = hi * SPOOL_SEGMENT_RECORDS + hi_size / SPOOL_RECORD_SIZE;
+    _spoolHead = _spoolNext;
+    Serial.printf("  Telemetry spool: segments %lu..%lu, %lu records on card\n",
+                  (unsigned long)lo, (unsigned long)hi, (unsigned long)(_spoolNext - _spoolFirst));
+}
+
+uint32_t SDLogger::detectClusterSize() {
+    // The SD library does not expose its FatFs drive number: take the
+    // mounted volume whose size matches the card's
+    uint64_t total = SD.totalBytes();
+    for (uint8_t pdrv = 0; pdrv < FF_VOLUMES; pdrv++) {
+        char drv[3] = { (char)('0' + pdrv), ':', 0 };
+        FATFS* fs;
+        DWORD free_clusters;
+        if (f_getfree(drv, &free_clusters, &fs) != FR_OK) continue;
+#if FF_MAX_SS != FF_MIN_SS
+        uint32_t sector = fs->ssize;
+#else
+        uint32_t sector = FF_MAX_SS;
+#endif
+        uint32_t cluster = (uint32_t)fs->csize * sector;
+        if ((uint64_t)(fs->n_fatent - 2) * cluster == total) return cluster;
+    }
+    return SD_DEFAULT_CLUSTER;
+}
+
 bool SDLogger::ensureDirectory(const char* dir) {
     if (!SD.exists(dir)) {
         return SD.mkdir(dir);
@@ -416,16 +739,68 @@ void SDLogger::giveSPI() {
     }
 }
 
-bool SDLogger::writeCSVRow(const char* line) {
-    if (!_dataFile) return false;
-    _dataFile.println(line);
+bool SDLogger::openBinaryFile() {
+    _dataFile = SD.open(_currentFilename, FILE_APPEND);
+    if (!_dataFile) {
+        Serial.printf("ERROR: Could not open SD log file: %s\n", _currentFilename);
+        return false;
+    }
+
+    size_t size = _dataFile.size();
+    if (size < SD_BIN_HEADER_SIZE) {
+        // New file (or a header torn by power loss: start over)
+        if (size > 0) {
+            _dataFile.close();
+            SD.remove(_currentFilename);
+            SD.remove(_indexFilename);
+            _dataFile = SD.open(_currentFilename, FILE_APPEND);
+            if (!_dataFile) return false;
+        }
+        sd_log_file_header_t hdr;
+        sdlog_init_header(&hdr);
+        _dataFile.write((const uint8_t*)&hdr, sizeof(hdr));
+        _recordsToday = 0;
+        return true;
+    }
+
+    // Reopened after a reboot: continue the record count. A record torn by
+    // power loss is padded to the boundary; its CRC fails and readers skip it.
+    size_t body = size - SD_BIN_HEADER_SIZE;
+    size_t partial = body % SD_BIN_RECORD_SIZE;
+    if (partial) {
+        uint8_t pad[SD_BIN_RECORD_SIZE];
+        memset(pad, 0xFF, sizeof(pad));
+        _dataFile.write(pad, SD_BIN_RECORD_SIZE - partial);
+        body += SD_BIN_RECORD_SIZE - partial;
+    }
+    _recordsToday = body / SD_BIN_RECORD_SIZE;
     return true;
 }
 
-bool SDLogger::writeEventLine(const char* filename, const char* line) {
-    File f = SD.open(filename, FILE_APPEND);
-    if (!f) return false;
-    f.println(line);
-    f.close();
-    return true;
+// ============================================================================
+// HISTORY READS
+// ============================================================================
+
+bool SDCardHistorySource::open(const char* path) {
+    close();
+    if (!sdLogger.isAvailable() || !sdLogger.takeSPI()) return false;
+    if (SD.exists(path)) _file = SD.open(path, FILE_READ);
+    _size = _file ? (uint32_t)_file.size() : 0;
+    sdLogger.giveSPI();
+    return (bool)_file;
+}
+
+int32_t SDCardHistorySource::read(uint32_t offset, uint8_t* buf, size_t len) {
+    if (!_file || !sdLogger.takeSPI()) return -1;
+    int32_t n = _file.seek(offset) ? (int32_t)_file.read(buf, len) : -1;
+    sdLogger.giveSPI();
+    return n;
+}
+
+void SDCardHistorySource::close() {
+    if (!_file) return;
+    bool locked = sdLogger.takeSPI();
+    _file.close();                  // Read-only: nothing to flush, so closed even without the bus
+    if (locked) sdLogger.giveSPI();
+    _size = 0;
 }
@@ -0,0 +1,153 @@
+/**
+ * @file sd_write_buffer.cpp
+ * @brief Lock-free SD message queue and double-buffered block staging
+ */
+
+#include "sd_write_buffer.h"
+
+static_assert((SD_QUEUE_SLOTS & (SD_QUEUE_SLOTS - 1)) == 0, "SD_QUEUE_SLOTS must be a power of two");
+static_assert(SD_MSG_PAYLOAD <= 255, "sd_msg_t.len is 8 bits");
+
+// ============================================================================
+// LOCK-FREE MESSAGE QUEUE
+// ============================================================================
+
+SDWriteQueue::SDWriteQueue()
+    : _enqueue(0)
+    , _dequeue(0)
+    , _dropped(0)
+    , _high_water(0)
+{
+    for (uint32_t i = 0; i < SD_QUEUE_SLOTS; i++) _cells[i].seq.store(i, std::memory_order_relaxed);
+}
+
+bool SDWriteQueue::push(uint8_t kind, const void* payload, size_t len) {
+    if (len > SD_MSG_PAYLOAD) len = SD_MSG_PAYLOAD;
+
+    // Claim slot pos: free when its sequence equals pos (the consumer has released it)
+    uint32_t pos = _enqueue.load(std::memory_order_relaxed);
+    cell_t* cell;
+    for (;;) {
+        cell = &_cells[pos & (SD_QUEUE_SLOTS - 1)];
+        uint32_t seq = cell->seq.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;                   // Full: consumer is a whole lap behind
+        } else {
+            pos = _enqueue.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->msg.kind = kind;
+    cell->msg.len = (uint8_t)len;
+    memcpy(cell->msg.payload, payload, len);
+    cell->seq.store(pos + 1, std::memory_order_release);     // Publish
+
+    uint32_t depth = pos + 1 - _dequeue.load(std::memory_order_relaxed);
+    uint32_t hw = _high_water.load(std::memory_order_relaxed);
+    if (depth <= SD_QUEUE_SLOTS && depth > hw) _high_water.store(depth, std::memory_order_relaxed);
+    return true;
+}
+
+bool SDWriteQueue::pop(sd_msg_t* out) {
+    uint32_t pos = _dequeue.load(std::memory_order_relaxed);
+    cell_t* cell = &_cells[pos & (SD_QUEUE_SLOTS - 1)];
+    uint32_t seq = cell->seq.load(std::memory_order_acquire);
+    if ((int32_t)(seq - (pos + 1)) < 0) return false;       // Empty, or claimed but not yet published
+
+    memcpy(out, &cell->msg, offsetof(sd_msg_t, payload) + cell->msg.len);
+    cell->seq.store(pos + SD_QUEUE_SLOTS, std::memory_order_release);   // Free for the next lap
+    _dequeue.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+// ============================================================================
+// DOUBLE-BUFFERED BLOCK STAGING
+// ============================================================================
+
+SDBlockStager::SDBlockStager()
+    : _block(0)
+    , _active(0)
+{
+    _buf[0] = _buf[1] = nullptr;
+    reset(0);
+}
+
+void SDBlockStager::begin(uint8_t* buf0, uint8_t* buf1, size_t block_size) {
+    _buf[0] = buf0;
+    _buf[1] = buf1;
+    _block = block_size;
+    reset(0);
+}
+
+void SDBlockStager::reset(uint32_t file_size) {
+    for (uint8_t b = 0; b < 2; b++) {
+        _fill[b] = 0;
+        _done[b] = 0;
+        _full[b] = false;
+        _cap[b] = _block;
+    }
+    _active = 0;
+    size_t into = _block ? file_size % _block : 0;
+    if (into) _cap[0] = _block - into;
+}
+
+size_t SDBlockStager::append(const uint8_t* data, size_t len) {
+    size_t n = 0;
+    while (n < len && _block) {
+        uint8_t a = _active;
+        if (_full[a]) break;                // Both buffers wait to be written
+
+        size_t k = min(_cap[a] - _fill[a], len - n);
+        memcpy(_buf[a] + _fill[a], data + n, k);
+        _fill[a] += k;
+        n += k;
+
+        if (_fill[a] == _cap[a]) {
+            _full[a] = true;
+            if (!_full[a ^ 1]) _active = a ^ 1;
+        }
+    }
+    return n;
+}
+
+int8_t SDBlockStager::oldest(bool tail) const {
+    uint8_t other = _active ^ 1;
+    if (_full[other]) return other;         // Filled before the active one
+    if (_full[_active]) return _active;
+    if (tail && _fill[_active] > _done[_active]) return _active;
+    return -1;
+}
+
+bool SDBlockStager::peek(const uint8_t** data, size_t* len, bool tail) const {
+    int8_t b = oldest(tail);
+    if (b < 0) return false;
+    *data = _buf[b] + _done[b];
+    *len = _fill[b] - _done[b];
+    return true;
+}
+
+bool SDBlockStager::consume(size_t len) {
+    int8_t b = oldest(true);
+    if (b < 0) return false;
+    _done[b] = min(_done[b] + len, _fill[b]);
+    if (!_full[b] || _done[b] < _fill[b]) return false;
+    release(b);
+    return true;
+}
+
+void SDBlockStager::release(uint8_t b) {
+    _fill[b] = 0;
+    _done[b] = 0;
+    _full[b] = false;
+    _cap[b] = _block;
+    // Both were full: appending resumes in the one just written
+    if (_full[_active]) _active = b;
+}
+
+size_t SDBlockStager::getStaged() const {
+    return (_fill[0] - _done[0]) + (_fill[1] - _done[1]);
+}
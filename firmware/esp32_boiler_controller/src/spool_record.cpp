@@ -0,0 +1,153 @@
+/**
+ * @file spool_record.cpp
+ * @brief Telemetry spool record packing and replay reader
+ */
+
+#include "spool_record.h"
+#include "coprocessor_protocol.h"   // cp_crc16
+
+// CRC of the whole record with the crc field zeroed, so kind is covered too
+static uint16_t recordCrc(const spool_record_t* rec) {
+    spool_record_t tmp = *rec;
+    tmp.crc = 0;
+    return cp_crc16((const uint8_t*)&tmp, sizeof(tmp));
+}
+
+static void seal(spool_record_t* rec) {
+    rec->crc = recordCrc(rec);
+}
+
+void spool_pack_reading(const sensor_reading_t* reading, spool_record_t* rec) {
+    memset(rec, 0, sizeof(*rec));
+    rec->kind = SPOOL_READING;
+    rec->timestamp = reading->timestamp;
+    sdlog_pack(reading, &rec->reading);
+    seal(rec);
+}
+
+void spool_pack_event(uint32_t timestamp, const char* event_type, const char* description,
+                      int32_t value, spool_record_t* rec) {
+    memset(rec, 0, sizeof(*rec));
+    rec->kind = SPOOL_EVENT;
+    rec->timestamp = timestamp;
+    rec->event.value = value;
+    strncpy(rec->event.type, event_type, sizeof(rec->event.type) - 1);
+    strncpy(rec->event.description, description, sizeof(rec->event.description) - 1);
+    seal(rec);
+}
+
+void spool_pack_alarm(uint32_t timestamp, uint16_t alarm_code, const char* alarm_name,
+                      bool active, float trigger_value, spool_record_t* rec) {
+    memset(rec, 0, sizeof(*rec));
+    rec->kind = SPOOL_ALARM;
+    rec->timestamp = timestamp;
+    rec->alarm.code = alarm_code;
+    rec->alarm.active = active ? 1 : 0;
+    rec->alarm.trigger_value = trigger_value;
+    strncpy(rec->alarm.name, alarm_name, sizeof(rec->alarm.name) - 1);
+    seal(rec);
+}
+
+void spool_stamp(spool_record_t* rec, uint32_t boot_id, uint32_t sequence) {
+    rec->boot_id = boot_id;
+    rec->sequence = sequence;
+    seal(rec);
+}
+
+bool spool_record_valid(const spool_record_t* rec) {
+    if (rec->kind < SPOOL_READING || rec->kind > SPOOL_ALARM) return false;
+    return recordCrc(rec) == rec->crc;
+}
+
+void spool_segment_path(const char* dir, uint32_t segment, char* buf, size_t len) {
+    snprintf(buf, len, "%s/%08lu.q", dir, (unsigned long)segment);
+}
+
+// ============================================================================
+// READER
+// ============================================================================
+
+SpoolReader::SpoolReader(SDHistorySource* src, const char* dir)
+    : _src(src)
+    , _dir(dir)
+    , _cursor(0)
+    , _openSegment(UINT32_MAX)
+    , _fresh(false)
+    , _blockFirst(0)
+    , _blockCount(0)
+    , _skipped(0)
+    , _reads(0)
+{
+}
+
+void SpoolReader::seek(uint32_t record) {
+    _cursor = record;
+    _blockCount = 0;
+}
+
+void SpoolReader::advance() {
+    _cursor++;
+}
+
+void SpoolReader::close() {
+    if (_openSegment != UINT32_MAX) _src->close();
+    _openSegment = UINT32_MAX;
+    _blockCount = 0;
+}
+
+void SpoolReader::skipTo(uint32_t record) {
+    _skipped += record - _cursor;
+    _cursor = record;
+}
+
+bool SpoolReader::peek(uint32_t first, uint32_t head, spool_record_t* rec) {
+    if (_cursor < first) skipTo(first);
+
+    while (_cursor < head) {
+        if (_cursor >= _blockFirst && _cursor < _blockFirst + _blockCount) {
+            *rec = _block[_cursor - _blockFirst];
+            if (spool_record_valid(rec)) return true;
+            _skipped++;                                 // Torn or damaged
+            _cursor++;
+            continue;
+        }
+
+        uint32_t segment = _cursor / SPOOL_SEGMENT_RECORDS;
+        uint32_t index = _cursor % SPOOL_SEGMENT_RECORDS;
+        bool later = head > (segment + 1) * SPOOL_SEGMENT_RECORDS;   // Writer has moved past it
+        if (_openSegment != segment) {
+            close();
+            char path[40];
+            spool_segment_path(_dir, segment, path, sizeof(path));
+            if (!_src->open(path)) {
+                if (!later) return false;
+                skipTo((segment + 1) * SPOOL_SEGMENT_RECORDS);     // Segment lost (card formatted)
+                continue;
+            }
+            _openSegment = segment;
+            _fresh = true;
+        }
+
+        uint32_t want = min(min((uint32_t)SPOOL_BLOCK_RECORDS, head - _cursor), SPOOL_SEGMENT_RECORDS - index);
+        _reads++;
+        int32_t got = _src->read(index * SPOOL_RECORD_SIZE, (uint8_t*)_block, want * SPOOL_RECORD_SIZE);
+        if (got < 0) {
+            close();
+            return false;
+        }
+        _blockFirst = _cursor;
+        _blockCount = (uint32_t)got / SPOOL_RECORD_SIZE;
+        if (_blockCount == 0) {
+            if (!_fresh) {
+                close();                                // Size seen at open is stale: reopen
+                continue;
+            }
+            close();
+            if (!later) return false;
+            skipTo((segment + 1) * SPOOL_SEGMENT_RECORDS);         // Segment ends early (write error)
+            continue;
+        }
+        _fresh = false;
+    }
+    return false;
+}
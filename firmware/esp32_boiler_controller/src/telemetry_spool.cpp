@@ -0,0 +1,190 @@
+/**
+ * @file telemetry_spool.cpp
+ * @brief Store-and-forward telemetry backlog on the SD card
+ */
+
+#include "telemetry_spool.h"
+#include <Preferences.h>
+
+// Global instance
+TelemetrySpool telemetrySpool;
+
+// ============================================================================
+// CONSTRUCTOR / INITIALIZATION
+// ============================================================================
+
+TelemetrySpool::TelemetrySpool()
+    : _reader(&_src, SD_SPOOL_DIR)
+    , _sink(nullptr)
+    , _ready(false)
+    , _cursor(0)
+    , _taken(0)
+    , _savedCursor(0)
+    , _trimmedSegment(0)
+    , _retryAt(0)
+    , _lastFlush(0)
+    , _appended(0)
+    , _append_failures(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool TelemetrySpool::begin(SinkFn sink) {
+    _sink = sink;
+    if (!sdLogger.isAvailable()) {
+        Serial.println("Telemetry spool: no SD card, outages are not bridged");
+        return false;
+    }
+
+    Preferences prefs;
+    prefs.begin(NVS_NAMESPACE, true);
+    uint32_t cursor = prefs.getUInt(NVS_KEY_SPOOL_CURSOR, 0);
+    prefs.end();
+
+    // A cursor past the card's records means another card: start at its end
+    uint32_t first = sdLogger.getSpoolFirst();
+    uint32_t head = sdLogger.getSpoolHead();
+    if (cursor > head) cursor = head;
+    if (cursor < first) cursor = first;
+
+    _reader.seek(cursor);
+    _cursor = cursor;
+    _taken = cursor;
+    _savedCursor = cursor;
+    _trimmedSegment = cursor / SPOOL_SEGMENT_RECORDS;
+    _ready = true;
+    Serial.printf("Telemetry spool: %lu records to replay\n", (unsigned long)(head - cursor));
+    return true;
+}
+
+// ============================================================================
+// PRODUCERS (any task)
+// ============================================================================
+
+bool TelemetrySpool::hasBacklog() const {
+    if (!_ready) return false;
+    return sdLogger.getSpoolHead() != _cursor.load() || sdLogger.getSpoolInFlight() > 0;
+}
+
+bool TelemetrySpool::append(spool_record_t* rec, uint32_t boot_id, uint32_t sequence) {
+    if (!_ready) return false;
+    if (boot_id != 0) spool_stamp(rec, boot_id, sequence);
+    if (!sdLogger.logSpool(rec)) {
+        _append_failures.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    _appended.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool TelemetrySpool::appendReading(const sensor_reading_t* reading, uint32_t boot_id, uint32_t sequence) {
+    spool_record_t rec;
+    spool_pack_reading(reading, &rec);
+    return append(&rec, boot_id, sequence);
+}
+
+bool TelemetrySpool::appendEvent(uint32_t timestamp, const char* event_type, const char* description,
+                                 int32_t value, uint32_t boot_id, uint32_t sequence) {
+    spool_record_t rec;
+    spool_pack_event(timestamp, event_type, description, value, &rec);
+    return append(&rec, boot_id, sequence);
+}
+
+bool TelemetrySpool::appendAlarm(uint32_t timestamp, uint16_t alarm_code, const char* alarm_name,
+                                 bool active, float trigger_value, uint32_t boot_id, uint32_t sequence) {
+    spool_record_t rec;
+    spool_pack_alarm(timestamp, alarm_code, alarm_name, active, trigger_value, &rec);
+    return append(&rec, boot_id, sequence);
+}
+
+// ============================================================================
+// REPLAY (network task)
+// ============================================================================
+
+uint32_t TelemetrySpool::drain(bool online, uint32_t room) {
+    if (!_ready || !_sink || !online) return 0;
+    uint32_t start = millis();
+    if (_retryAt && (int32_t)(start - _retryAt) < 0) return 0;
+    _retryAt = 0;
+
+    uint32_t first = sdLogger.getSpoolFirst();
+    uint32_t head = sdLogger.getSpoolHead();
+    uint32_t sent = 0;
+    uint32_t skipped = _reader.getSkipped();
+    uint32_t limit = min(room, (uint32_t)SPOOL_DRAIN_MAX_RECORDS);
+    uint32_t next[SPOOL_DRAIN_BATCH];
+    while (sent < limit && millis() - start < SPOOL_DRAIN_BUDGET_MS) {
+        uint32_t n = 0;
+        while (n < SPOOL_DRAIN_BATCH && sent + n < limit &&
+               _reader.peek(first, head, &_batch[n])) {
+            _reader.advance();
+            next[n] = _reader.tell();
+            n++;
+        }
+        if (n == 0) break;
+
+        uint32_t done = _sink(_batch, next, n);
+        sent += done;
+        if (done > 0) _taken = next[done - 1];
+        if (done < n) {
+            _reader.seek(next[done] - 1);       // First record not taken
+            _stats.sink_failures++;
+            _retryAt = (millis() + SPOOL_RETRY_MS) | 1;
+            break;
+        }
+    }
+    _stats.replayed += sent;
+    _stats.skipped += _reader.getSkipped() - skipped;
+
+    // Nothing awaiting confirmation: records skipped since are done with too
+    if (_cursor.load() == _taken) {
+        _taken = _reader.tell();
+        _cursor = _taken;
+    }
+
+    if (_reader.tell() >= head) {
+        // Caught up with the card: release the file, and have records still
+        // staged in the writer written now rather than after SD_HOLD_MS
+        _reader.close();
+        if (sdLogger.getSpoolInFlight() > 0 && millis() - _lastFlush >= 1000) {
+            _lastFlush = millis();
+            sdLogger.flush();
+        }
+    }
+    saveCursor();
+    return sent;
+}
+
+void TelemetrySpool::confirm(uint32_t next) {
+    // Confirmations arrive in order; a stale one never moves the cursor back
+    if (!_ready || (int32_t)(next - _cursor.load()) <= 0) return;
+    _cursor = next;
+    saveCursor();
+}
+
+void TelemetrySpool::saveCursor() {
+    uint32_t cursor = _cursor.load();
+    if (cursor == _savedCursor) return;
+    if (cursor - _savedCursor < SPOOL_CURSOR_SAVE_RECORDS && cursor < sdLogger.getSpoolHead()) return;
+
+    Preferences prefs;
+    prefs.begin(NVS_NAMESPACE, false);
+    prefs.putUInt(NVS_KEY_SPOOL_CURSOR, cursor);
+    prefs.end();
+    _savedCursor = cursor;
+
+    // Segments behind the saved cursor are no longer needed
+    uint32_t segment = cursor / SPOOL_SEGMENT_RECORDS;
+    if (segment > _trimmedSegment) {
+        sdLogger.trimSpool(cursor);
+        _trimmedSegment = segment;
+    }
+}
+
+spool_stats_t TelemetrySpool::getStats() const {
+    spool_stats_t s = _stats;
+    s.appended = _appended.load(std::memory_order_relaxed);
+    s.append_failures = _append_failures.load(std::memory_order_relaxed);
+    s.backlog = _ready ? sdLogger.getSpoolHead() - _cursor.load() : 0;
+    return s;
+}
@@ -10,11 +10,22 @@
 #include "sensor_health.h"
 #include "self_test.h"
 #include "sd_logger.h"
+#include "telemetry_spool.h"
+#include "net_outbox.h"
+#include "plant_id.h"
+#include "historian.h"
+#include "data_logger.h"
 #include "config.h"
 #include <WiFi.h>
+#include <memory>
+#include <atomic>
+#include <stdarg.h>
 
 extern system_state_t_runtime systemState;
 extern void saveConfiguration();
+extern bool saveFuzzyRuleBase(const uint8_t* data, size_t len);
+extern void eraseFuzzyRuleBase();
+extern void applyFuzzySurfaceConfig();
 
 // Global instance
 BoilerWebServer webServer;
@@ -35,6 +46,8 @@ BoilerWebServer::BoilerWebServer()
     , _current_flow_rate(0)
     , _test_input_callback(nullptr)
     , _command_handler(nullptr)
+    , _rb_upload_len(0)
+    , _rb_upload_overflow(false)
 {
     memset(&_current_fuzzy_result, 0, sizeof(_current_fuzzy_result));
     memset(_manual_tests, 0, sizeof(_manual_tests));
@@ -110,7 +123,20 @@ void BoilerWebServer::setupRoutes() {
     _server.on("/api/status", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetStatus(r); });
     _server.on("/api/state", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetState(r); });
     _server.on("/api/health", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetHealth(r); });
+    // Registered before /api/fuzzy, which would also match /api/fuzzy/rules
+    _server.on("/api/fuzzy/rules", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetFuzzyRules(r); });
+    _server.on("/api/fuzzy/rules", HTTP_POST, [this](AsyncWebServerRequest* r) { handlePostFuzzyRules(r); }, nullptr,
+               [this](AsyncWebServerRequest* r, uint8_t* d, size_t l, size_t i, size_t t) { handleFuzzyRulesBody(r, d, l, i, t); });
+    _server.on("/api/fuzzy/rules", HTTP_DELETE, [this](AsyncWebServerRequest* r) { handleDeleteFuzzyRules(r); });
+    _server.on("/api/fuzzy/rules", HTTP_OPTIONS, [this](AsyncWebServerRequest* r) { sendCORSHeaders(r); r->send(204); });
+    _server.on("/api/fuzzy/trace", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetFuzzyTrace(r); });
+    _server.on("/api/fuzzy/trace", HTTP_POST, [this](AsyncWebServerRequest* r) { handlePostFuzzyTrace(r); });
+    _server.on("/api/fuzzy/trace", HTTP_OPTIONS, [this](AsyncWebServerRequest* r) { sendCORSHeaders(r); r->send(204); });
+    _server.on("/api/fuzzy/sweep", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetFuzzySweep(r); });
     _server.on("/api/fuzzy", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetFuzzy(r); });
+    _server.on("/api/plant", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetPlant(r); });
+    _server.on("/api/trend", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetTrend(r); });
+    _server.on("/api/history", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetHistory(r); });
     _server.on("/api/devices", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetDevices(r); });
     _server.on("/api/sd/status", HTTP_GET, [this](AsyncWebServerRequest* r) { handleGetSDStatus(r); });
     _server.on("/api/sd/format", HTTP_POST, [this](AsyncWebServerRequest* r) { handlePostSDFormat(r); });
@@ -381,6 +407,53 @@ void BoilerWebServer::handleGetFuzzy(AsyncWebServerRequest* request) {
         setpoints["alkalinity"] = _config->fuzzy.alk_setpoint;
         setpoints["sulfite"] = _config->fuzzy.sulfite_setpoint;
         setpoints["ph"] = _config->fuzzy.ph_setpoint;
+
+        static const char* const inference_names[] = {"mamdani", "sugeno"};
+        static const char* const defuzz_names[] = {"centroid", "bisector", "mom", "som", "lom"};
+        uint8_t im = _config->fuzzy.inference_method;
+        uint8_t dm = _config->fuzzy.defuzz_method;
+        doc["inference_method"] = (im <= FUZZY_INFERENCE_SUGENO) ? inference_names[im] : "mamdani";
+        doc["defuzz_method"] = (dm < FUZZY_DEFUZZ_COUNT) ? defuzz_names[dm] : "centroid";
+    }
+
+    // Incremental evaluation savings (fraction of inputs/rules/outputs reused)
+    if (_fuzzy) {
+        fuzzy_cache_stats_t cs = _fuzzy->getCacheStats();
+        JsonObject cache = doc["cache"].to<JsonObject>();
+        uint32_t in_total = cs.input_hits + cs.input_misses;
+        uint32_t rule_total = cs.rule_hits + cs.rule_misses;
+        uint32_t out_total = cs.output_hits + cs.output_misses;
+        cache["enabled"] = _fuzzy->isCacheEnabled();
+        cache["evaluations"] = cs.evaluations;
+        cache["full_passes"] = cs.full_passes;
+        cache["input_hit_rate"] = in_total ? (float)cs.input_hits / in_total : 0.0f;
+        cache["rule_hit_rate"] = rule_total ? (float)cs.rule_hits / rule_total : 0.0f;
+        cache["output_hit_rate"] = out_total ? (float)cs.output_hits / out_total : 0.0f;
+
+        JsonObject rb = doc["rule_base"].to<JsonObject>();
+        rb["rules"] = _fuzzy->getRuleCount();
+        rb["active"] = _fuzzy->getActiveRuleCount();
+        rb["swaps"] = _fuzzy->getRuleBaseSwaps();
+        rb["pending"] = _fuzzy->hasPendingRuleBase();
+
+        JsonObject tr = doc["trace"].to<JsonObject>();
+        tr["depth"] = _fuzzy->getTraceDepth();
+        tr["sample_every"] = _fuzzy->getTraceSampling();
+        tr["head"] = _fuzzy->getTraceHead();
+
+        fuzzy_surface_status_t ss = _fuzzy->getSurfaceStatus();
+        JsonObject sf = doc["surface"].to<JsonObject>();
+        sf["enabled"] = ss.enabled;
+        sf["in_use"] = ss.valid;
+        sf["pending"] = ss.pending;
+        sf["nodes"] = _config && _config->fuzzy_surface_nodes ? _config->fuzzy_surface_nodes
+                                                              : FUZZY_SURFACE_DEFAULT_NODES;
+        sf["temp_nodes"] = ss.temp_nodes;
+        sf["trend_nodes"] = ss.trend_nodes;
+        sf["max_error"] = ss.max_error;
+        sf["error_bound"] = ss.error_bound;
+        sf["build_us"] = ss.build_us;
+        sf["builds"] = ss.builds;
     }
 
     String response;
@@ -388,6 +461,389 @@ void BoilerWebServer::handleGetFuzzy(AsyncWebServerRequest* request) {
     request->send(200, "application/json", response);
 }
 
+// ============================================================================
+// FUZZY RULE BASE (binary, see fuzzy_rb_encode)
+// ============================================================================
+
+void BoilerWebServer::handleGetFuzzyRules(AsyncWebServerRequest* request) {
+    sendCORSHeaders(request);
+    if (!_fuzzy) {
+        request->send(503, "application/json", "{\"error\":\"Fuzzy controller not available\"}");
+        return;
+    }
+
+    // Up to ~4 KB with Sugeno consequents: heap, not the async_tcp stack
+    uint8_t* blob = (uint8_t*)malloc(FUZZY_RB_MAX_SIZE);
+    if (!blob) {
+        request->send(503, "application/json", "{\"error\":\"Out of memory\"}");
+        return;
+    }
+    size_t len = _fuzzy->exportRuleBase(blob, FUZZY_RB_MAX_SIZE);
+    AsyncResponseStream* response = request->beginResponseStream("application/octet-stream");
+    response->addHeader("Content-Disposition", "attachment; filename=\"fuzzy_rules.bin\"");
+    response->write(blob, len);
+    free(blob);
+    request->send(response);
+}
+
+void BoilerWebServer::handleFuzzyRulesBody(AsyncWebServerRequest* request, uint8_t* data, size_t len,
+                                           size_t index, size_t total) {
+    (void)request;
+    if (index == 0) {
+        _rb_upload_len = 0;
+        _rb_upload_overflow = total > sizeof(_rb_upload);
+    }
+    if (_rb_upload_overflow || index + len > sizeof(_rb_upload)) {
+        _rb_upload_overflow = true;
+        return;
+    }
+    memcpy(_rb_upload + index, data, len);
+    _rb_upload_len = index + len;
+}
+
+void BoilerWebServer::handlePostFuzzyRules(AsyncWebServerRequest* request) {
+    sendCORSHeaders(request);
+
+    // Binary body: only the X-API-Key header can authenticate
+    if (!checkPostAuth(request, String())) {
+        request->send(401, "application/json", "{\"error\":\"Authentication required\"}");
+        return;
+    }
+    if (!_fuzzy) {
+        request->send(503, "application/json", "{\"error\":\"Fuzzy controller not available\"}");
+        return;
+    }
+    if (_rb_upload_overflow) {
+        _rb_upload_overflow = false;
+        request->send(413, "application/json", "{\"error\":\"Rule base too large\"}");
+        return;
+    }
+
+    fuzzy_rb_status_t st = _fuzzy->loadRuleBase(_rb_upload, _rb_upload_len);
+    if (st != FUZZY_RB_OK) {
+        JsonDocument err;
+        err["error"] = fuzzy_rb_status_name(st);
+        String s;
+        serializeJson(err, s);
+        request->send(st == FUZZY_RB_ERR_BUSY ? 409 : 400, "application/json", s);
+        return;
+    }
+
+    // Validated and staged: persist so the rule base survives a reboot
+    bool saved = saveFuzzyRuleBase(_rb_upload, _rb_upload_len);
+    JsonDocument doc;
+    doc["success"] = true;
+    doc["rules"] = _rb_upload[3];
+    doc["saved"] = saved;
+    String s;
+    serializeJson(doc, s);
+    request->send(200, "application/json", s);
+    broadcastWs("fuzzy_rules", s.c_str());
+}
+
+void BoilerWebServer::handleDeleteFuzzyRules(AsyncWebServerRequest* request) {
+    sendCORSHeaders(request);
+
+    if (!checkPostAuth(request, String())) {
+        request->send(401, "application/json", "{\"error\":\"Authentication required\"}");
+        return;
+    }
+    if (!_fuzzy || !_fuzzy->stageDefaultRules()) {
+        request->send(409, "application/json", "{\"error\":\"busy\"}");
+        return;
+    }
+    eraseFuzzyRuleBase();
+    request->send(200, "application/json", "{\"success\":true,\"defaults\":true}");
+}
+
+// ============================================================================
+// CHUNKED JSON RESPONSES
+// ============================================================================
+
+// Base for JSON bodies produced piece by piece in the chunked response callback, so a
+// large body is never held in RAM: next() formats the next piece (header, one record or
+// grid row, trailer) into text and returns false once nothing follows it.
+struct JsonChunkStream {
+    char text[WEB_CHUNK_TEXT_SIZE];
+    size_t len = 0, pos = 0;
+    bool done = false;
+
+    virtual ~JsonChunkStream() {}
+    virtual bool next() = 0;
+
+    void appendf(const char* fmt, ...) {
+        if (len >= sizeof(text)) return;
+        va_list ap;
+        va_start(ap, fmt);
+        int k = vsnprintf(text + len, sizeof(text) - len, fmt, ap);
+        va_end(ap);
+        if (k > 0) len = min(len + (size_t)k, sizeof(text) - 1);
+    }
+
+    // Response callback: copy pending text, produce more while the TCP window has room
+    size_t fill(uint8_t* buf, size_t maxLen) {
+        size_t out = 0;
+        while (out < maxLen) {
+            if (pos == len) {
+                if (done) break;
+                len = pos = 0;
+                done = !next();
+                continue;
+            }
+            size_t k = min(len - pos, maxLen - out);
+            memcpy(buf + out, text + pos, k);
+            out += k;
+            pos += k;
+        }
+        return out;
+    }
+};
+
+static void sendJsonChunks(AsyncWebServerRequest* request, std::shared_ptr<JsonChunkStream> ctx) {
+    AsyncWebServerResponse* response = request->beginChunkedResponse("application/json",
+        [ctx](uint8_t* buf, size_t maxLen, size_t index) -> size_t {
+            return ctx->fill(buf, maxLen);
+        });
+    request->send(response);
+}
+
+// ============================================================================
+// FUZZY INFERENCE TRACE
+// ============================================================================
+
+// One record per piece, read from the ring as the client drains the response
+struct TraceStream : JsonChunkStream {
+    FuzzyController* fuzzy;
+    uint32_t since;
+    size_t limit, sent = 0;
+    bool started = false;
+
+    bool next() override {
+        if (!started) {
+            started = true;
+            appendf("{\"sample_every\":%u,\"depth\":%u,\"head\":%lu,\"records\":[",
+                    fuzzy->getTraceSampling(), fuzzy->getTraceDepth(), (unsigned long)fuzzy->getTraceHead());
+            return true;
+        }
+        fuzzy_trace_rec_t t;
+        if (sent >= limit || fuzzy->readTrace(&t, 1, since) == 0) {
+            appendf("]}");
+            return false;
+        }
+        appendf("%s{\"seq\":%lu,\"t\":%lu,\"in\":[%.2f,%.2f,%.2f,%.3f,%.2f,%.2f],\"valid\":%u,"
+                "\"out\":[%.2f,%.2f,%.2f,%.2f],\"active\":%u,\"flags\":%u,\"top\":[",
+                sent ? "," : "", (unsigned long)t.seq, (unsigned long)t.t_ms,
+                t.input[0], t.input[1], t.input[2], t.input[3], t.input[4], t.input[5],
+                t.valid_mask, t.output[0] / 100.0f, t.output[1] / 100.0f,
+                t.output[2] / 100.0f, t.output[3] / 100.0f, t.active_rules, t.flags);
+        for (uint8_t j = 0; j < t.num_top; j++) {
+            appendf("%s[%u,%.4f]", j ? "," : "", t.top_rule[j], t.top_strength[j] / 65535.0f);
+        }
+        appendf("]}");
+        sent++;
+        since = t.seq;
+        return true;
+    }
+};
+
+void BoilerWebServer::handleGetFuzzyTrace(AsyncWebServerRequest* request) {
+    sendCORSHeaders(request);
+    if (!_fuzzy) {
+        request->send(503, "application/json", "{\"error\":\"Fuzzy controller not available\"}");
+        return;
+    }
+
+    // ?since=<seq> returns records after seq (poll with the last seq received); ?limit caps the page
+    std::shared_ptr<TraceStream> ctx = std::make_shared<TraceStream>();
+    ctx->fuzzy = _fuzzy;
+    ctx->since = request->hasParam("since") ? strtoul(request->getParam("since")->value().c_str(), nullptr, 10) : 0;
+    ctx->limit = WEB_TRACE_DEFAULT_LIMIT;
+    if (request->hasParam("limit")) {
+        ctx->limit = constrain(atoi(request->getParam("limit")->value().c_str()), 1, WEB_TRACE_MAX_LIMIT);
+    }
+    sendJsonChunks(request, ctx);
+}
+
+void BoilerWebServer::handlePostFuzzyTrace(AsyncWebServerRequest* request) {
+    sendCORSHeaders(request);
+
+    String body = request->arg("plain");
+    if (!checkPostAuth(request, body)) {
+        request->send(401, "application/json", "{\"error\":\"Authentication required\"}");
+        return;
+    }
+    JsonDocument doc;
+    if (!_fuzzy || body.length() == 0 || deserializeJson(doc, body) != DeserializationError::Ok ||
+        !doc.containsKey("sample_every")) {
+        request->send(400, "application/json", "{\"error\":\"JSON body with sample_every required\"}");
+        return;
+    }
+    // The ring itself is allocated at boot; only the sampling rate changes here (0 = paused)
+    _fuzzy->setTraceSampling(doc["sample_every"].as<uint16_t>());
+    request->send(200, "application/json", "{\"success\":true}");
+}
+
+// ============================================================================
+// FUZZY CONTROL SURFACE SWEEP (FuzzyController::evaluateBatch)
+// ============================================================================
+
+static const char* const s_sweep_inputs[FUZZY_MAX_INPUTS] = {
+    "tds", "alkalinity", "sulfite", "ph", "temperature", "trend"
+};
+
+static int sweepInputIndex(const String& name) {
+    for (int i = 0; i < FUZZY_MAX_INPUTS; i++) {
+        if (name.equalsIgnoreCase(s_sweep_inputs[i])) return i;
+    }
+    return -1;
+}
+
+// One sweep at a time: each holds its grid row buffers (~3 KB) while the client reads
+static std::atomic<int> s_sweepStreams(0);
+
+// One grid row per piece: the row is evaluated when the client is ready for it, so the
+// async_tcp task never runs more than one evaluateBatch() call per callback
+struct SweepStream : JsonChunkStream {
+    FuzzyController* fuzzy;
+    int ax[2];
+    uint8_t n, ny, row = 0;
+    float lo[2], step[2];
+    float base[FUZZY_MAX_INPUTS];
+    bool known[FUZZY_MAX_INPUTS];
+    bool started = false;
+    uint32_t gaps = 0, eval_us = 0;
+    uint32_t uncovered[FUZZY_MAX_OUTPUTS] = {0};
+
+    float col[FUZZY_MAX_INPUTS][WEB_SWEEP_MAX_POINTS];
+    uint8_t mask[WEB_SWEEP_MAX_POINTS];
+    float out[FUZZY_MAX_OUTPUTS][WEB_SWEEP_MAX_POINTS];
+    uint8_t active[WEB_SWEEP_MAX_POINTS], covered[WEB_SWEEP_MAX_POINTS];
+
+    SweepStream() { s_sweepStreams++; }
+    ~SweepStream() { s_sweepStreams--; }
+
+    bool next() override {
+        if (!started) {
+            started = true;
+            appendf("{\"x\":{\"input\":\"%s\",\"min\":%.3f,\"step\":%.4f,\"n\":%u},",
+                    s_sweep_inputs[ax[0]], lo[0], step[0], n);
+            if (ax[1] >= 0) {
+                appendf("\"y\":{\"input\":\"%s\",\"min\":%.3f,\"step\":%.4f,\"n\":%u},",
+                        s_sweep_inputs[ax[1]], lo[1], step[1], ny);
+            }
+            appendf("\"columns\":[\"blowdown\",\"caustic\",\"sulfite\",\"acid\",\"active\",\"covered\"],\"rows\":[");
+            return true;
+        }
+        if (row < ny && evaluateRow()) {
+            appendf(row ? ",[" : "[");
+            for (uint8_t k = 0; k < n; k++) {
+                appendf("%s[%.2f,%.2f,%.2f,%.2f,%u,%u]", k ? "," : "",
+                        out[0][k], out[1][k], out[2][k], out[3][k], active[k], covered[k]);
+                if (active[k] == 0) gaps++;
+                for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+                    if (!(covered[k] & (1u << o))) uncovered[o]++;
+                }
+            }
+            appendf("]");
+            row++;
+            return true;
+        }
+        // gaps: points where no rule fired; uncovered: points where no fired rule sets that output
+        appendf("],\"gaps\":%lu,\"uncovered\":[%lu,%lu,%lu,%lu],\"eval_us\":%lu}",
+                (unsigned long)gaps, (unsigned long)uncovered[0], (unsigned long)uncovered[1],
+                (unsigned long)uncovered[2], (unsigned long)uncovered[3], (unsigned long)eval_us);
+        return false;
+    }
+
+    // Row `row` of the grid (x varies fastest)
+    bool evaluateRow() {
+        for (uint8_t k = 0; k < n; k++) {
+            uint8_t m = 0;
+            for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+                col[i][k] = base[i];
+                if (known[i]) m |= (uint8_t)(1u << i);
+            }
+            col[ax[0]][k] = lo[0] + step[0] * k;
+            m |= (uint8_t)(1u << ax[0]);
+            if (ax[1] >= 0) {
+                col[ax[1]][k] = lo[1] + step[1] * row;
+                m |= (uint8_t)(1u << ax[1]);
+            }
+            mask[k] = m;
+        }
+        fuzzy_batch_t b;
+        memset(&b, 0, sizeof(b));
+        for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) b.input[i] = col[i];
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) b.output[o] = out[o];
+        b.valid_mask = mask;
+        b.active_rules = active;
+        b.covered_mask = covered;
+        b.count = n;
+        uint32_t t0 = micros();
+        size_t done = fuzzy->evaluateBatch(b);
+        eval_us += micros() - t0;
+        return done == n;
+    }
+};
+
+void BoilerWebServer::handleGetFuzzySweep(AsyncWebServerRequest* request) {
+    sendCORSHeaders(request);
+    if (!_fuzzy || !_config) {
+        request->send(503, "application/json", "{\"error\":\"Fuzzy controller not available\"}");
+        return;
+    }
+
+    // ?x=<input>[&y=<input>]&n=<points per axis>; axis centers default to the setpoint (current
+    // temperature, zero trend), half-widths to a quarter of the input range (?xc/xr, ?yc/yr)
+    int ax[2] = { -1, -1 };
+    ax[0] = request->hasParam("x") ? sweepInputIndex(request->getParam("x")->value()) : -1;
+    if (request->hasParam("y")) ax[1] = sweepInputIndex(request->getParam("y")->value());
+    if (ax[0] < 0 || (request->hasParam("y") && (ax[1] < 0 || ax[1] == ax[0]))) {
+        request->send(400, "application/json",
+                      "{\"error\":\"x (and optional y) must be tds, alkalinity, sulfite, ph, temperature or trend\"}");
+        return;
+    }
+    if (s_sweepStreams.load() > 0) {
+        request->send(503, "application/json", "{\"error\":\"Sweep already in progress\"}");
+        return;
+    }
+    std::shared_ptr<SweepStream> ctx = std::make_shared<SweepStream>();
+    ctx->fuzzy = _fuzzy;
+    ctx->ax[0] = ax[0];
+    ctx->ax[1] = ax[1];
+    uint8_t n = WEB_SWEEP_DEFAULT_POINTS;
+    if (request->hasParam("n")) n = constrain(atoi(request->getParam("n")->value().c_str()), 2, WEB_SWEEP_MAX_POINTS);
+    ctx->n = n;
+    ctx->ny = ax[1] >= 0 ? n : 1;
+
+    // Inputs not swept stay at the controller's current values
+    for (uint8_t i = FUZZY_IN_TDS; i <= FUZZY_IN_PH; i++) {
+        _fuzzy->getManualInput((fuzzy_input_t)i, &ctx->base[i], &ctx->known[i]);
+    }
+    ctx->base[FUZZY_IN_TEMPERATURE] = _current_temperature;
+    ctx->base[FUZZY_IN_TREND] = 0.0f;
+    ctx->known[FUZZY_IN_TEMPERATURE] = ctx->known[FUZZY_IN_TREND] = true;
+
+    const float setpoint[FUZZY_MAX_INPUTS] = {
+        _config->fuzzy.cond_setpoint, _config->fuzzy.alk_setpoint, _config->fuzzy.sulfite_setpoint,
+        _config->fuzzy.ph_setpoint, _current_temperature, 0.0f
+    };
+    const char* const center_arg[2] = { "xc", "yc" };
+    const char* const range_arg[2] = { "xr", "yr" };
+    ctx->lo[0] = ctx->lo[1] = ctx->step[0] = ctx->step[1] = 0.0f;
+    for (uint8_t a = 0; a < 2 && ax[a] >= 0; a++) {
+        const linguistic_var_t& var = _fuzzy->getInputVar(ax[a]);
+        float c = request->hasParam(center_arg[a]) ? request->getParam(center_arg[a])->value().toFloat() : setpoint[ax[a]];
+        float r = request->hasParam(range_arg[a]) ? fabsf(request->getParam(range_arg[a])->value().toFloat())
+                                                  : 0.25f * (var.max_value - var.min_value);
+        ctx->lo[a] = max(c - r, var.min_value);
+        float hi = min(c + r, var.max_value);
+        if (hi < ctx->lo[a]) hi = ctx->lo[a];
+        ctx->step[a] = (hi - ctx->lo[a]) / (n - 1);
+    }
+    sendJsonChunks(request, ctx);
+}
+
 void BoilerWebServer::handleGetDevices(AsyncWebServerRequest* request) {
     sendCORSHeaders(request);
 
@@ -427,6 +883,181 @@ void BoilerWebServer::handleGetDevices(AsyncWebServerRequest* request) {
     request->send(200, "application/json", response);
 }
 
+void BoilerWebServer::handleGetPlant(AsyncWebServerRequest* request) {
+    sendCORSHeaders(request);
+
+    JsonDocument doc;
+    const plant_id_params_t& p = plantId.getParams();
+    doc["valid"] = p.valid;
+    doc["samples"] = p.samples;
+    doc["blowdown_samples"] = p.blowdown_samples;
+    doc["makeup_gain"] = p.makeup_gain;
+    doc["blowdown_rate"] = p.blowdown_rate;
+    doc["tau_blowdown_sec"] = p.tau_blowdown_sec;
+    doc["dead_time_sec"] = p.dead_time_sec;
+    doc["drift_per_min"] = p.drift_per_min;
+    doc["rms_error"] = p.rms_error;
+
+    // Suggestions next to the values currently configured
+    JsonObject tuning = doc["tuning"].to<JsonObject>();
+    tuning["suggested_deadband"] = p.suggested_deadband;
+    tuning["suggested_prop_band"] = p.suggested_prop_band;
+    if (_config) {
+        tuning["setpoint"] = _config->blowdown.setpoint;
+        tuning["deadband"] = _config->blowdown.deadband;
+        tuning["prop_band"] = _config->conductivity.prop_band;
+    }
+
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
+
+// ============================================================================
+// TREND HISTORY (in-RAM historian)
+// ============================================================================
+
+// Up to one query chunk (16 points) per piece
+struct TrendStream : JsonChunkStream {
+    int ch;
+    uint32_t from, to, step, offset;
+    size_t points, sent = 0;
+    bool started = false;
+
+    bool next() override {
+        if (!started) {
+            started = true;
+            appendf("{\"channel\":\"%s\",\"unit\":\"%s\",\"step\":%lu,\"oldest\":%lu,\"points\":[",
+                    Historian::channelName(ch), Historian::channelUnit(ch), (unsigned long)step,
+                    (unsigned long)(historian.getOldest() + offset));
+            return true;
+        }
+        if (sent >= points || from > to) {
+            appendf("]}");
+            return false;
+        }
+        hist_point_t chunk[16];
+        uint32_t resume;
+        size_t n = historian.query(ch, from, to, step, chunk,
+                                   min(points - sent, sizeof(chunk) / sizeof(chunk[0])), &resume);
+        for (size_t k = 0; k < n; k++) {
+            appendf("%s[%lu,%.2f,%.2f,%.2f]", sent + k ? "," : "",
+                    (unsigned long)(chunk[k].t + offset), chunk[k].min, chunk[k].avg, chunk[k].max);
+        }
+        sent += n;
+        if (resume <= from) {
+            appendf("]}");
+            return false;
+        }
+        from = resume;
+        return true;
+    }
+};
+
+void BoilerWebServer::handleGetTrend(AsyncWebServerRequest* request) {
+    sendCORSHeaders(request);
+    if (!historian.isReady()) {
+        request->send(503, "application/json", "{\"error\":\"Historian not available\"}");
+        return;
+    }
+    int ch = request->hasParam("ch") ? Historian::channelIndex(request->getParam("ch")->value().c_str())
+                                     : HIST_CH_CONDUCTIVITY;
+    if (ch < 0) {
+        request->send(400, "application/json",
+                      "{\"error\":\"ch: conductivity, temperature, flow or valve_mA\"}");
+        return;
+    }
+
+    // Times are log timestamps (epoch once NTP is synced, else uptime); the historian runs on uptime
+    uint32_t up = millis() / 1000;
+    uint32_t offset = dataLogger.getTimestamp() - up;
+    uint32_t to = up, from;
+    if (request->hasParam("to")) {
+        uint32_t v = strtoul(request->getParam("to")->value().c_str(), nullptr, 10);
+        to = v > offset ? v - offset : 0;
+    }
+    if (request->hasParam("from")) {
+        uint32_t v = strtoul(request->getParam("from")->value().c_str(), nullptr, 10);
+        from = v > offset ? v - offset : 0;
+    } else {
+        uint32_t span = request->hasParam("span") ? strtoul(request->getParam("span")->value().c_str(), nullptr, 10) : 3600;
+        from = to > span ? to - span : 0;
+    }
+    size_t points = WEB_TREND_DEFAULT_POINTS;
+    if (request->hasParam("points")) {
+        points = constrain(atoi(request->getParam("points")->value().c_str()), 1, WEB_TREND_MAX_POINTS);
+    }
+    if (from > to) from = to;
+
+    // Step: requested, else the range over the point budget; never finer than the tier
+    uint32_t res = historian.resolutionFor(from);
+    uint32_t step = request->hasParam("step") ? strtoul(request->getParam("step")->value().c_str(), nullptr, 10)
+                                              : (to - from) / points + 1;
+    step = ((max(step, res) + res - 1) / res) * res;
+
+    std::shared_ptr<TrendStream> ctx = std::make_shared<TrendStream>();
+    ctx->ch = ch;
+    ctx->from = from;
+    ctx->to = to;
+    ctx->step = step;
+    ctx->offset = offset;
+    ctx->points = points;
+    sendJsonChunks(request, ctx);
+}
+
+// ============================================================================
+// SD LOG HISTORY (streamed CSV)
+// ============================================================================
+
+// One download at a time: each holds a reader (~1 KB) and a file handle
+static std::atomic<int> s_historyStreams(0);
+
+struct HistoryStream {
+    SDCardHistorySource src;
+    SDHistoryReader reader;
+    HistoryStream() : reader(&src, SD_LOG_DIR) { s_historyStreams++; }
+    ~HistoryStream() { s_historyStreams--; }     // Response finished or client gone; src closes its file
+};
+
+void BoilerWebServer::handleGetHistory(AsyncWebServerRequest* request) {
+    sendCORSHeaders(request);
+    if (!sdLogger.isAvailable()) {
+        request->send(503, "application/json", "{\"error\":\"SD card not available\"}");
+        return;
+    }
+
+    // Times are log timestamps, as in the files (epoch once NTP is synced)
+    uint32_t to = request->hasParam("to") ? strtoul(request->getParam("to")->value().c_str(), nullptr, 10)
+                                          : dataLogger.getTimestamp();
+    uint32_t from = request->hasParam("from") ? strtoul(request->getParam("from")->value().c_str(), nullptr, 10)
+                                              : (to > WEB_HISTORY_DEFAULT_SPAN ? to - WEB_HISTORY_DEFAULT_SPAN : 0);
+    uint32_t fields = 0;
+    if (request->hasParam("fields") &&
+        !SDHistoryReader::parseFields(request->getParam("fields")->value().c_str(), &fields)) {
+        request->send(400, "application/json", "{\"error\":\"fields: comma-separated SD log column names\"}");
+        return;
+    }
+    uint32_t step = request->hasParam("step") ? strtoul(request->getParam("step")->value().c_str(), nullptr, 10) : 0;
+
+    if (s_historyStreams.load() > 0) {
+        request->send(503, "application/json", "{\"error\":\"History download already in progress\"}");
+        return;
+    }
+    std::shared_ptr<HistoryStream> ctx = std::make_shared<HistoryStream>();
+    if (!ctx->reader.begin(from, to, fields, step)) {
+        request->send(400, "application/json", "{\"error\":\"from/to: empty range or over 400 days\"}");
+        return;
+    }
+    sdLogger.flush();               // Staged rows reach the card while the older days stream
+
+    // Chunked: each callback fills the TCP window from the reader, one card block per SPI hold
+    AsyncWebServerResponse* response = request->beginChunkedResponse("text/csv",
+        [ctx](uint8_t* buf, size_t maxLen, size_t index) -> size_t {
+            return ctx->reader.read((char*)buf, maxLen);
+        });
+    request->send(response);
+}
+
 void BoilerWebServer::handleGetSDStatus(AsyncWebServerRequest* request) {
     sendCORSHeaders(request);
 
@@ -450,8 +1081,50 @@ void BoilerWebServer::handleGetSDStatus(AsyncWebServerRequest* request) {
         doc["used_mb"] = sdLogger.getUsedSpaceMB();
         doc["records_today"] = sdLogger.getRecordsToday();
         doc["current_file"] = sdLogger.getCurrentFilename();
+        doc["format"] = sdLogger.getFormat() == SD_LOG_FORMAT_BINARY ? "binary" : "csv";
+
+        // SD writer task: queue, block writes, latency, MAX31865 bus contention
+        sd_writer_stats_t ws = sdLogger.getWriterStats();
+        JsonObject w = doc["writer"].to<JsonObject>();
+        w["messages"] = ws.messages;
+        w["dropped"] = ws.dropped;
+        w["queue_high_water"] = ws.queue_high_water;
+        w["cluster_bytes"] = ws.cluster_size;
+        w["block_bytes"] = ws.block_size;
+        w["blocks"] = ws.blocks;
+        w["partial_writes"] = ws.partial_writes;
+        w["bytes"] = ws.bytes;
+        w["write_errors"] = ws.write_errors;
+        w["write_us_last"] = ws.write_us_last;
+        w["write_us_avg"] = ws.write_us_avg;
+        w["write_us_max"] = ws.write_us_max;
+        w["writer_wait_us_max"] = ws.writer_wait_us_max;
+        JsonObject b = doc["sensor_bus"].to<JsonObject>();
+        b["wait_us_last"] = ws.sensor_wait_us_last;
+        b["wait_us_max"] = ws.sensor_wait_us_max;
+        b["waits"] = ws.sensor_waits;
+        b["waits_blocked"] = ws.sensor_waits_blocked;
+        b["timeouts"] = ws.sensor_timeouts;
+
+        // Telemetry spool: outage backlog and its replay
+        spool_stats_t ss = telemetrySpool.getStats();
+        JsonObject q = doc["spool"].to<JsonObject>();
+        q["backlog"] = ss.backlog;
+        q["appended"] = ss.appended;
+        q["append_failures"] = ss.append_failures;
+        q["replayed"] = ss.replayed;
+        q["skipped"] = ss.skipped;
+        q["sink_failures"] = ss.sink_failures;
+        q["segments_dropped"] = ws.spool_segments_dropped;
     }
 
+    // Network outbox (sensor/control tasks -> network task); works without a card
+    net_outbox_stats_t os = netOutbox.getStats();
+    JsonObject o = doc["outbox"].to<JsonObject>();
+    o["queued"] = os.queued;
+    o["dropped"] = os.dropped;
+    o["high_water"] = os.high_water;
+
     String response;
     serializeJson(doc, response);
     request->send(200, "application/json", response);
@@ -738,6 +1411,26 @@ void BoilerWebServer::handlePostConfig(AsyncWebServerRequest* request) {
         if (v >= 1000 && v <= 86400000) _config->log_interval_ms = v;
     }
     if (doc.containsKey("display_in_ppm")) _config->display_in_ppm = doc["display_in_ppm"].as<bool>();
+    // SD reading log: "csv" or "binary" (new file from the next reading)
+    if (doc.containsKey("sd_log_format")) {
+        const char* f = doc["sd_log_format"].as<const char*>();
+        if (f && strcmp(f, "csv") == 0) _config->sd_log_format = SD_LOG_FORMAT_CSV;
+        if (f && strcmp(f, "binary") == 0) _config->sd_log_format = SD_LOG_FORMAT_BINARY;
+    }
+    // HTTP upload batches (0 = default)
+    if (doc.containsKey("tsdb_batch_size")) {
+        uint32_t v = doc["tsdb_batch_size"].as<uint32_t>();
+        if (v <= TSDB_BATCH_MAX) _config->tsdb_batch_size = (uint8_t)v;
+    }
+    if (doc.containsKey("tsdb_batch_bytes")) {
+        uint32_t v = doc["tsdb_batch_bytes"].as<uint32_t>();
+        if (v == 0 || (v >= TSDB_BATCH_BYTES_MIN && v <= TSDB_BATCH_BYTES)) _config->tsdb_batch_bytes = (uint16_t)v;
+    }
+    if (doc.containsKey("tsdb_encoding")) {
+        const char* e = doc["tsdb_encoding"].as<const char*>();
+        if (e && strcmp(e, "json") == 0) _config->tsdb_encoding = TSDB_ENCODING_JSON;
+        if (e && strcmp(e, "packed") == 0) _config->tsdb_encoding = TSDB_ENCODING_PACKED;
+    }
     // MQTT telemetry (Modern IoT Stack)
     if (doc.containsKey("mqtt_host")) {
         const char* s = doc["mqtt_host"].as<const char*>();
@@ -765,6 +1458,32 @@ void BoilerWebServer::handlePostConfig(AsyncWebServerRequest* request) {
         }
     }
     if (doc.containsKey("use_mqtt_telemetry")) _config->use_mqtt_telemetry = doc["use_mqtt_telemetry"].as<bool>();
+    // Fuzzy engine method selection (takes effect on the next evaluation)
+    if (doc.containsKey("fuzzy_inference_method")) {
+        uint8_t v = doc["fuzzy_inference_method"].as<uint8_t>();
+        if (v <= FUZZY_INFERENCE_SUGENO) _config->fuzzy.inference_method = v;
+    }
+    if (doc.containsKey("fuzzy_defuzz_method")) {
+        uint8_t v = doc["fuzzy_defuzz_method"].as<uint8_t>();
+        if (v < FUZZY_DEFUZZ_COUNT) _config->fuzzy.defuzz_method = v;
+    }
+    if (_fuzzy && (doc.containsKey("fuzzy_inference_method") || doc.containsKey("fuzzy_defuzz_method"))) {
+        _fuzzy->notifyConfigChanged();
+    }
+    // Control surface: on/off, node budget per axis (0 = default), error bound in % output (0 = default)
+    if (doc.containsKey("fuzzy_surface")) _config->fuzzy_surface_off = doc["fuzzy_surface"].as<bool>() ? 0 : 1;
+    if (doc.containsKey("fuzzy_surface_nodes")) {
+        uint32_t v = doc["fuzzy_surface_nodes"].as<uint32_t>();
+        if (v == 0 || (v >= 2 && v <= FUZZY_SURFACE_MAX_NODES)) _config->fuzzy_surface_nodes = (uint8_t)v;
+    }
+    if (doc.containsKey("fuzzy_surface_max_err")) {
+        float v = doc["fuzzy_surface_max_err"].as<float>();
+        if (v >= 0.0f && v <= 10.0f) _config->fuzzy_surface_max_err = v;
+    }
+    if (doc.containsKey("fuzzy_surface") || doc.containsKey("fuzzy_surface_nodes") ||
+        doc.containsKey("fuzzy_surface_max_err")) {
+        applyFuzzySurfaceConfig();
+    }
     saveConfiguration();
     request->send(200, "application/json", "{\"success\":true}");
     JsonDocument payload;
@@ -906,6 +1625,15 @@ String BoilerWebServer::generateIndexHTML() {
             </div>
             <div class="rules-info">
                 <span>Active Rules: <strong id="active-rules">0</strong></span>
+                <label>Defuzz:
+                    <select id="defuzz-method" onchange="setFuzzyMethod('fuzzy_defuzz_method', this.value)">
+                        <option value="0">Centroid</option>
+                        <option value="1">Bisector</option>
+                        <option value="2">MOM</option>
+                        <option value="3">SOM</option>
+                        <option value="4">LOM</option>
+                    </select>
+                </label>
             </div>
         </section>
 
@@ -1278,6 +2006,13 @@ header h1 {
     color: #4CAF50;
     font-family: 'SF Mono', 'Monaco', monospace;
 }
+.rules-info select {
+    background: rgba(255,255,255,0.08);
+    color: #ccc;
+    border: 1px solid rgba(255,255,255,0.15);
+    border-radius: 4px;
+    font-size: 1em;
+}
 
 .reference-table {
     width: 100%;
@@ -1509,6 +2244,13 @@ async function fetchFuzzy() {
 
         document.getElementById('active-rules').textContent = data.active_rules;
 
+        const defuzzSel = document.getElementById('defuzz-method');
+        const defuzzNames = ['centroid', 'bisector', 'mom', 'som', 'lom'];
+        if (data.defuzz_method && document.activeElement !== defuzzSel) {
+            defuzzSel.value = String(Math.max(0, defuzzNames.indexOf(data.defuzz_method)));
+        }
+        defuzzSel.disabled = (data.inference_method === 'sugeno');
+
         // Update setpoints (show — when config not loaded)
         const spIds = ['sp-tds', 'sp-alk', 'sp-sulf', 'sp-ph'];
         if (data.setpoints) {
@@ -1681,6 +2423,20 @@ async function clearTests() {
     }
 }
 
+async function setFuzzyMethod(key, value) {
+    try {
+        const res = await fetch('/api/config', {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/json' },
+            body: JSON.stringify({ [key]: parseInt(value) })
+        });
+        showToast(res.ok ? 'Fuzzy method updated' : 'Update failed', res.ok ? 'success' : 'error');
+        fetchFuzzy();
+    } catch (err) {
+        showToast('Connection error', 'error');
+    }
+}
+
 function toggleCard(header) {
     const card = header.parentElement;
     card.classList.toggle('collapsed');
@@ -5,14 +5,23 @@
  * Target: ESP32 DevKit (esp32dev). RS-485 on Serial2 (GPIO16/17), no DE pin.
  * EZO-EC on Serial1 (GPIO9/10). Valve 4–20 mA from internal ADC (GPIO36). No ADS1115.
  *
- * Build: pio run -e esp32dev_coprocessor
+ * Multi-drop: answers only frames addressed to C3_NODE_ADDR (or broadcast). Telemetry is sent
+ * in reply to POLL from the main bus master, never unsolicited.
+ *
+ * Build: pio run -e esp32dev_coprocessor   (set node address with -DC3_NODE_ADDR=n,
+ * log each TIME_SYNC with -DC3_DEBUG_TIME_SYNC=1)
  */
 
 #include <Arduino.h>
 #include "../include/coprocessor_protocol.h"
 #include "../include/c3_pin_definitions.h"
 
-#define C3_TELEMETRY_HZ  5
+#ifndef C3_NODE_ADDR
+#define C3_NODE_ADDR  CP_ADDR_DEFAULT
+#endif
+#ifndef C3_DEBUG_TIME_SYNC
+#define C3_DEBUG_TIME_SYNC  0   // Serial print in the RX path delays the reply on the bus
+#endif
 #define C3_MAIN_HEARTBEAT_TIMEOUT_MS  3000
 #define C3_EZO_POLL_INTERVAL_MS  1000
 #define C3_EZO_RESPONSE_TIMEOUT_MS  800
@@ -28,7 +37,8 @@ static uint16_t s_telemetry_sequence = 0;
 static uint8_t s_blowdown_open = 0;
 static uint8_t s_solenoid_on = 0;
 static uint32_t s_last_main_frame_ms = 0;
-static uint32_t s_last_telemetry_ms = 0;
+static uint32_t s_unix_sync_sec = 0;      // Wall time from last TIME_SYNC (0 = never)
+static uint32_t s_unix_sync_millis = 0;   // millis() corresponding to s_unix_sync_sec
 
 static float s_cached_conductivity_uS_cm = 1500.0f;
 static float s_cached_temperature_c = 25.0f;
@@ -54,32 +64,32 @@ static void set_de_re(bool drive) {
 }
 
 static void send_frame(uint8_t type, const uint8_t* payload, uint8_t plen) {
-    if (plen > CP_MAX_PAYLOAD) return;
     uint8_t frame[CP_MAX_FRAME];
-    frame[0] = CP_SYNC_0;
-    frame[1] = CP_SYNC_1;
-    frame[2] = type;
-    frame[3] = plen;
-    if (plen && payload) memcpy(frame + CP_HEADER_SIZE, payload, plen);
-    uint16_t crc = cp_crc16(frame, CP_HEADER_SIZE + plen);
-    frame[CP_HEADER_SIZE + plen]     = (uint8_t)(crc & 0xFF);
-    frame[CP_HEADER_SIZE + plen + 1] = (uint8_t)(crc >> 8);
+    size_t flen = cp_frame_build(frame, C3_NODE_ADDR, type, payload, plen);
+    if (flen == 0) return;
     set_de_re(true);
     delay(1);
-    C3Serial.write(frame, CP_HEADER_SIZE + plen + CP_CRC_SIZE);
+    C3Serial.write(frame, flen);
     C3Serial.flush();
     delay(2);
     set_de_re(false);
 }
 
+static void send_telemetry();
+
 static void process_rx_frame(const uint8_t* frame, size_t len) {
     if (!cp_frame_valid(frame, len)) return;
+    uint8_t addr = cp_frame_addr(frame);
+    if (addr != C3_NODE_ADDR && addr != CP_ADDR_BROADCAST) return;  // Another panel's slot
     uint8_t type = cp_frame_type(frame);
     uint8_t plen = cp_frame_payload_len(frame);
     const uint8_t* pl = cp_frame_payload(frame);
     s_last_main_frame_ms = millis();
 
     switch (type) {
+    case CP_TYPE_POLL:
+        if (addr == C3_NODE_ADDR) send_telemetry();
+        break;
     case CP_TYPE_CMD_BLOWDOWN_OPEN: {
         s_blowdown_open = 1;
         cp_ack_nak_payload_t ack;
@@ -114,6 +124,19 @@ static void process_rx_frame(const uint8_t* frame, size_t len) {
         send_frame(CP_TYPE_ACK, (const uint8_t*)&ack, sizeof(ack));
         break;
     }
+    case CP_TYPE_TIME_SYNC:
+        // timestamp_ms in telemetry stays on raw millis(): main fits offset/skew against it.
+        // Only record the wall-clock anchor for local use.
+        if (plen >= sizeof(cp_time_sync_payload_t)) {
+            const cp_time_sync_payload_t* ts = (const cp_time_sync_payload_t*)pl;
+            s_unix_sync_sec = ts->unix_time_sec;
+            s_unix_sync_millis = millis() - ts->unix_time_subsec_ms;
+#if C3_DEBUG_TIME_SYNC
+            Serial.printf("TIME_SYNC: unix=%lu at millis=%lu\n",
+                          (unsigned long)s_unix_sync_sec, (unsigned long)s_unix_sync_millis);
+#endif
+        }
+        break;
     default:
         break;
     }
@@ -180,7 +203,6 @@ void setup() {
     }
     C3Serial.begin(115200, SERIAL_8N1, C3_RS485_RX_PIN, C3_RS485_TX_PIN);
     s_rx_len = 0;
-    s_last_telemetry_ms = millis();
 
     analogReadResolution(12);
     analogSetAttenuation(ADC_11db);
@@ -208,7 +230,7 @@ void setup() {
     s_ezo_poll_start_ms = millis();
     s_ezo_poll_state = 0;
 
-    Serial.println("ESP32 DevKit coprocessor stub ready");
+    Serial.printf("ESP32 DevKit coprocessor stub ready (node %u)\n", (unsigned)C3_NODE_ADDR);
 }
 
 void loop() {
@@ -220,7 +242,7 @@ void loop() {
         if (s_rx_len == 1 && b != CP_SYNC_1) { s_rx_len = 0; continue; }
         s_rx_buf[s_rx_len++] = b;
         if (s_rx_len >= CP_HEADER_SIZE) {
-            uint8_t plen = s_rx_buf[3];
+            uint8_t plen = s_rx_buf[CP_HDR_LEN];
             if (plen > CP_MAX_PAYLOAD) { s_rx_len = 0; continue; }
             size_t need = CP_HEADER_SIZE + plen + CP_CRC_SIZE;
             if (s_rx_len >= need) {
@@ -231,11 +253,5 @@ void loop() {
         }
         if (s_rx_len >= CP_MAX_FRAME) s_rx_len = 0;
     }
-
-    uint32_t now = millis();
-    if (now - s_last_telemetry_ms >= (1000 / C3_TELEMETRY_HZ)) {
-        s_last_telemetry_ms = now;
-        send_telemetry();
-    }
     delay(1);
 }
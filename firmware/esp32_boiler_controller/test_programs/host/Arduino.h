@@ -0,0 +1,67 @@
+/**
+ * @file Arduino.h
+ * @brief Minimal Arduino shim for building pure-logic modules on the host
+ *
+ * Only what the control/inference modules use: Serial printing, millis()/micros(),
+ * delay(), the min/max/constrain helpers and opaque FreeRTOS handle types. Serial goes to stderr so host tools
+ * can keep stdout for generated output. Host tools in this directory compile
+ * firmware sources directly, e.g.
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/host/bench_fuzzy_defuzz.cpp src/fuzzy_logic.cpp -o /tmp/bench_fuzzy_defuzz
+ */
+
+#ifndef HOST_ARDUINO_SHIM_H
+#define HOST_ARDUINO_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using std::min;
+using std::max;
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+class HostSerial {
+public:
+    void begin(unsigned long) {}
+    template <typename... A>
+    int printf(const char* fmt, A... args) { return ::fprintf(stderr, fmt, args...); }
+    void print(const char* s) { fputs(s, stderr); }
+    void print(float v) { ::fprintf(stderr, "%.2f", v); }
+    void print(int v) { ::fprintf(stderr, "%d", v); }
+    void println(const char* s = "") { fprintf(stderr, "%s\n", s); }
+    void println(float v) { ::fprintf(stderr, "%.2f\n", v); }
+    void println(int v) { ::fprintf(stderr, "%d\n", v); }
+};
+
+inline HostSerial Serial;
+
+static inline uint32_t millis() {
+    using namespace std::chrono;
+    static const steady_clock::time_point t0 = steady_clock::now();
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now() - t0).count();
+}
+
+static inline uint32_t micros() {
+    using namespace std::chrono;
+    static const steady_clock::time_point t0 = steady_clock::now();
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now() - t0).count();
+}
+
+static inline void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// FreeRTOS handles, opaque, so headers declaring them compile (net_outbox.h)
+typedef void* QueueHandle_t;
+
+#endif // HOST_ARDUINO_SHIM_H
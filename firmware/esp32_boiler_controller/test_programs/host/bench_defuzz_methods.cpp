@@ -0,0 +1,121 @@
+/**
+ * @file bench_defuzz_methods.cpp
+ * @brief Host benchmark: single-pass fuzzy_defuzz_all() vs one pass per method
+ *
+ * Times fuzzy_defuzz_all() (centroid, bisector, MOM, SOM, LOM together) at
+ * growing sample counts against a naive implementation that scans the
+ * aggregated output once per method, with a linear bisector walk. ns/sample
+ * staying flat across n confirms the O(resolution) bound; both columns are
+ * checked for identical results.
+ *
+ * Build/run from firmware/esp32_boiler_controller:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/host/bench_defuzz_methods.cpp src/fuzzy_logic.cpp -o /tmp/bench_defuzz_methods
+ *   /tmp/bench_defuzz_methods [iterations]
+ */
+
+#include <Arduino.h>
+#include "fuzzy_logic.h"
+
+#define BENCH_MAX_N    1601
+#define BENCH_SHAPES   64
+
+static uint32_t s_seed = 7;
+static float frand(float lo, float hi) {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return lo + (hi - lo) * (float)(s_seed >> 8) / 16777216.0f;
+}
+
+// Max of a few clipped triangles, like a Mamdani aggregation
+static void makeShape(float* mu, uint16_t n) {
+    float c[3], w[3], h[3];
+    for (int s = 0; s < 3; s++) {
+        c[s] = frand(0, 1);
+        w[s] = frand(0.1f, 0.4f);
+        h[s] = frand(0.1f, 1.0f);
+    }
+    for (uint16_t k = 0; k < n; k++) {
+        float x = (float)k / (n - 1);
+        float m = 0.0f;
+        for (int s = 0; s < 3; s++) m = max(m, min(h[s], max(0.0f, 1.0f - fabsf(x - c[s]) / w[s])));
+        mu[k] = m;
+    }
+}
+
+// One scan per method, as a straightforward implementation would do it
+static void naiveAll(const float* mu, uint16_t n, float min_v, float max_v, fuzzy_defuzz_all_t* out) {
+    memset(out, 0, sizeof(*out));
+    float step = (max_v - min_v) / (n - 1);
+
+    float area = 0, moment = 0;
+    for (uint16_t k = 0; k < n; k++) { area += mu[k]; moment += (min_v + step * k) * mu[k]; }
+    if (area < 0.001f) return;
+    out->value[FUZZY_DEFUZZ_CENTROID] = moment / area;
+
+    float acc = 0;
+    for (uint16_t k = 0; k < n; k++) {
+        if (acc + mu[k] >= 0.5f * area) {
+            float frac = mu[k] > 0 ? (0.5f * area - acc) / mu[k] : 0.5f;
+            out->value[FUZZY_DEFUZZ_BISECTOR] = constrain(min_v + step * (k - 0.5f + frac), min_v, max_v);
+            break;
+        }
+        acc += mu[k];
+    }
+
+    float peak = 0;
+    for (uint16_t k = 0; k < n; k++) if (mu[k] > peak) peak = mu[k];
+    uint32_t idx_sum = 0, idx_count = 0;
+    for (uint16_t k = 0; k < n; k++) if (mu[k] >= peak - 1e-6f) { idx_sum += k; idx_count++; }
+    out->value[FUZZY_DEFUZZ_MOM] = min_v + step * ((float)idx_sum / idx_count);
+    for (uint16_t k = 0; k < n; k++) if (mu[k] >= peak - 1e-6f) { out->value[FUZZY_DEFUZZ_SOM] = min_v + step * k; break; }
+    for (int k = n - 1; k >= 0; k--) if (mu[k] >= peak - 1e-6f) { out->value[FUZZY_DEFUZZ_LOM] = min_v + step * k; break; }
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    if (iterations < 1) iterations = 1;
+
+    static float shapes[BENCH_SHAPES][BENCH_MAX_N];
+    static float prefix[BENCH_MAX_N];
+    const uint16_t sizes[] = { 101, 201, 401, 801, 1601 };
+
+    printf("fuzzy_defuzz_all() vs one pass per method, %d shapes x %d iterations\n",
+           BENCH_SHAPES, iterations);
+    printf("     n   single us  ns/sample    naive us  ns/sample   max |diff|\n");
+    for (uint16_t n : sizes) {
+        for (int s = 0; s < BENCH_SHAPES; s++) makeShape(shapes[s], n);
+
+        volatile float sink = 0;
+        fuzzy_defuzz_all_t a, b;
+        uint32_t t0 = micros();
+        for (int it = 0; it < iterations; it++) {
+            for (int s = 0; s < BENCH_SHAPES; s++) {
+                fuzzy_defuzz_all(shapes[s], prefix, n, 0, 100, &a);
+                sink = sink + a.value[FUZZY_DEFUZZ_BISECTOR];
+            }
+        }
+        uint32_t t1 = micros();
+        for (int it = 0; it < iterations; it++) {
+            for (int s = 0; s < BENCH_SHAPES; s++) {
+                naiveAll(shapes[s], n, 0, 100, &b);
+                sink = sink + b.value[FUZZY_DEFUZZ_BISECTOR];
+            }
+        }
+        uint32_t t2 = micros();
+        (void)sink;
+
+        float max_diff = 0;
+        for (int s = 0; s < BENCH_SHAPES; s++) {
+            fuzzy_defuzz_all(shapes[s], prefix, n, 0, 100, &a);
+            naiveAll(shapes[s], n, 0, 100, &b);
+            for (int m = 0; m < FUZZY_DEFUZZ_COUNT; m++) max_diff = max(max_diff, fabsf(a.value[m] - b.value[m]));
+        }
+
+        double calls = (double)iterations * BENCH_SHAPES;
+        double us_single = (t1 - t0) / calls;
+        double us_naive = (t2 - t1) / calls;
+        printf("  %4u  %10.3f  %9.2f  %10.3f  %9.2f   %.4f\n", n,
+               us_single, 1000.0 * us_single / n, us_naive, 1000.0 * us_naive / n, max_diff);
+    }
+    return 0;
+}
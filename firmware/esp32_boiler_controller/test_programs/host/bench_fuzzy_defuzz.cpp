@@ -0,0 +1,183 @@
+/**
+ * @file bench_fuzzy_defuzz.cpp
+ * @brief Host benchmark: sampled vs closed-form centroid in FuzzyController::evaluate()
+ *
+ * Evaluates the same pseudo-random operating points with both centroid
+ * implementations and reports time per evaluate() and the output difference.
+ * A third run repeats the analytic pass with the rule index disabled to show
+ * what sparse rule selection saves, then Sugeno inference. The last runs hold the manual inputs fixed and
+ * sweep temperature/trend with the incremental cache off/on, with the inference trace recording every evaluation, and through the precomputed control surface. Absolute times are host times; the ratio is what carries over to the ESP32
+ * (the sampled path is FUZZY_RESOLUTION MF evaluations per clipped set).
+ *
+ * Build/run from firmware/esp32_boiler_controller:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/host/bench_fuzzy_defuzz.cpp src/fuzzy_logic.cpp -o /tmp/bench_fuzzy_defuzz
+ *   /tmp/bench_fuzzy_defuzz [iterations]
+ */
+
+#include <Arduino.h>
+#include "fuzzy_logic.h"
+
+#define BENCH_POINTS 256
+
+static uint32_t s_seed = 1;
+static float frand(float lo, float hi) {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return lo + (hi - lo) * (float)(s_seed >> 8) / 16777216.0f;
+}
+
+typedef struct {
+    float manual[4];
+    fuzzy_inputs_t in;
+} bench_point_t;
+
+static bench_point_t s_points[BENCH_POINTS];
+
+static void applyPoint(FuzzyController& fc, const bench_point_t& p) {
+    fc.setManualInput(FUZZY_IN_TDS, p.manual[0]);
+    fc.setManualInput(FUZZY_IN_ALKALINITY, p.manual[1]);
+    fc.setManualInput(FUZZY_IN_SULFITE, p.manual[2]);
+    fc.setManualInput(FUZZY_IN_PH, p.manual[3]);
+}
+
+static double runImpl(FuzzyController& fc, fuzzy_centroid_impl_t impl, int iterations,
+                      fuzzy_result_t* results) {
+    fc.setCentroidImpl(impl);
+    volatile float sink = 0;
+    uint32_t t0 = micros();
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < BENCH_POINTS; i++) {
+            applyPoint(fc, s_points[i]);
+            fuzzy_result_t r = fc.evaluate(s_points[i].in);
+            sink = sink + r.blowdown_rate;
+            if (it == 0) results[i] = r;
+        }
+    }
+    uint32_t t1 = micros();
+    (void)sink;
+    return (double)(t1 - t0) / ((double)iterations * BENCH_POINTS);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    if (iterations < 1) iterations = 1;
+
+    fuzzy_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.cond_setpoint = 2500;
+    cfg.alk_setpoint = 300;
+    cfg.sulfite_setpoint = 30;
+    cfg.ph_setpoint = 11.0f;
+    cfg.cond_deadband = 200;
+    cfg.alk_deadband = 50;
+    cfg.sulfite_deadband = 5;
+    cfg.ph_deadband = 0.3f;
+
+    FuzzyController fc;
+    fc.begin(&cfg);
+
+    for (int i = 0; i < BENCH_POINTS; i++) {
+        bench_point_t& p = s_points[i];
+        p.manual[0] = frand(0, 5000);
+        p.manual[1] = frand(0, 1000);
+        p.manual[2] = frand(0, 100);
+        p.manual[3] = frand(7, 14);
+        memset(&p.in, 0, sizeof(p.in));
+        p.in.temperature = frand(0, 100);
+        p.in.cond_trend = frand(-100, 100);
+    }
+
+    // Engine variants are compared without the incremental cache (measured separately below)
+    fc.setCacheEnabled(false);
+    static fuzzy_result_t rs[BENCH_POINTS], ra[BENCH_POINTS];
+    double us_sampled = runImpl(fc, FUZZY_CENTROID_SAMPLED, iterations, rs);
+    double us_analytic = runImpl(fc, FUZZY_CENTROID_ANALYTIC, iterations, ra);
+    fc.setRuleIndexEnabled(false);
+    static fuzzy_result_t rf[BENCH_POINTS];
+    double us_full_scan = runImpl(fc, FUZZY_CENTROID_ANALYTIC, iterations, rf);
+    fc.setRuleIndexEnabled(true);
+    cfg.inference_method = FUZZY_INFERENCE_SUGENO;
+    static fuzzy_result_t rz[BENCH_POINTS];
+    double us_sugeno = runImpl(fc, FUZZY_CENTROID_ANALYTIC, iterations, rz);
+    cfg.inference_method = FUZZY_INFERENCE_MAMDANI;
+
+    // Control-loop pattern (manual inputs fixed, temperature/trend move): cache off vs on
+    applyPoint(fc, s_points[0]);
+    double us_loop[2];
+    for (int c = 0; c < 2; c++) {
+        fc.setCacheEnabled(c == 1);
+        fc.resetCacheStats();
+        volatile float sink = 0;
+        uint32_t t0 = micros();
+        for (int it = 0; it < iterations; it++) {
+            for (int i = 0; i < BENCH_POINTS; i++) sink = sink + fc.evaluate(s_points[i].in).blowdown_rate;
+        }
+        us_loop[c] = (double)(micros() - t0) / ((double)iterations * BENCH_POINTS);
+        (void)sink;
+    }
+    fuzzy_cache_stats_t cs = fc.getCacheStats();
+
+    // Same loop with every evaluation traced (cache on)
+    fc.enableTrace(FUZZY_TRACE_DEFAULT_DEPTH, 1);
+    double us_trace;
+    {
+        volatile float sink = 0;
+        uint32_t t0 = micros();
+        for (int it = 0; it < iterations; it++) {
+            for (int i = 0; i < BENCH_POINTS; i++) sink = sink + fc.evaluate(s_points[i].in).blowdown_rate;
+        }
+        us_trace = (double)(micros() - t0) / ((double)iterations * BENCH_POINTS);
+        (void)sink;
+    }
+    fc.disableTrace();
+
+    // Control surface: manual inputs fixed, only temperature/trend move
+    applyPoint(fc, s_points[0]);
+    fc.enableSurface();
+    fc.updateSurface();           // Build outside the timed loop
+    fc.evaluate(s_points[0].in);
+    fuzzy_surface_status_t st = fc.getSurfaceStatus();
+    volatile float sink = 0;
+    uint32_t t0 = micros();
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < BENCH_POINTS; i++) {
+            sink = sink + fc.evaluate(s_points[i].in).blowdown_rate;
+        }
+    }
+    double us_surface = (double)(micros() - t0) / ((double)iterations * BENCH_POINTS);
+    (void)sink;
+    fc.disableSurface();
+
+    double sum_diff = 0, max_diff = 0;
+    for (int i = 0; i < BENCH_POINTS; i++) {
+        const float d[4] = {
+            fabsf(ra[i].blowdown_rate - rs[i].blowdown_rate),
+            fabsf(ra[i].caustic_rate - rs[i].caustic_rate),
+            fabsf(ra[i].sulfite_rate - rs[i].sulfite_rate),
+            fabsf(ra[i].acid_rate - rs[i].acid_rate)
+        };
+        for (int o = 0; o < 4; o++) {
+            sum_diff += d[o];
+            if (d[o] > max_diff) max_diff = d[o];
+        }
+    }
+
+    printf("evaluate() over %d points x %d iterations\n", BENCH_POINTS, iterations);
+    printf("  sampled  (%d pts): %8.2f us/eval\n", FUZZY_RESOLUTION, us_sampled);
+    printf("  analytic         : %8.2f us/eval  (%.1fx)\n", us_analytic,
+           us_analytic > 0 ? us_sampled / us_analytic : 0.0);
+    printf("  analytic, no rule index: %8.2f us/eval\n", us_full_scan);
+    printf("  Sugeno (0th order centroid constants): %8.2f us/eval\n", us_sugeno);
+    printf("  control loop, cache off: %8.2f us/eval, on: %8.2f us/eval (hit rate inputs %.2f, rules %.2f, outputs %.2f)\n",
+           us_loop[0], us_loop[1],
+           (double)cs.input_hits / (cs.input_hits + cs.input_misses),
+           (double)cs.rule_hits / (cs.rule_hits + cs.rule_misses),
+           (double)cs.output_hits / (cs.output_hits + cs.output_misses));
+    printf("  control loop, cache on, traced every evaluation: %8.2f us/eval (+%.2f us)\n",
+           us_trace, us_trace - us_loop[1]);
+    printf("  surface lookup   : %8.2f us/eval  (%ux%u nodes, err %.2f %%, build %lu us)\n",
+           us_surface, st.temp_nodes, st.trend_nodes, st.max_error, (unsigned long)st.build_us);
+    printf("  |analytic - sampled| mean %.3f %%, max %.3f %%\n",
+           sum_diff / (4.0 * BENCH_POINTS), max_diff);
+    return 0;
+}
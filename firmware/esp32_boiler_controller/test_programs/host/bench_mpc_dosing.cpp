@@ -0,0 +1,237 @@
+/**
+ * @file bench_mpc_dosing.cpp
+ * @brief Host benchmark: MPC dosing (feed mode M) vs fuzzy Mode F on a simulated boiler
+ *
+ * Simulates a 16 gal boiler for several days in 10 s steps: makeup flow with a
+ * daily swing, conductivity blowdown valve (on/off around the setpoint), and
+ * pH / alkalinity / sulfite residuals with the same structure as the MPC model
+ * but different true parameters (product strength, makeup load, decay), so the
+ * MPC runs with model error. Lab tests every 8 h with measurement noise are the
+ * only residual feedback for both controllers.
+ *
+ *   Mode F: FuzzyController with the default rules, ml = makeup gal x
+ *           ml_per_gallon_at_100pct x rate, clamped to *_max_ml_min
+ *   Mode M: MpcDosing with the default model
+ *
+ * Prints chemical used, mean residual, RMS error from setpoint, residual
+ * standard deviation and time inside the deadband per pump (first day
+ * excluded), and the MPC planning time.
+ *
+ * Build/run from firmware/esp32_boiler_controller:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/host/bench_mpc_dosing.cpp src/mpc_dosing.cpp src/fuzzy_logic.cpp -o /tmp/bench_mpc_dosing
+ *   /tmp/bench_mpc_dosing [days] [lab_test_hours]
+ */
+
+#include <Arduino.h>
+#include "fuzzy_logic.h"
+#include "mpc_dosing.h"
+
+#define SIM_DT_SEC          10
+#define SIM_WARMUP_DAYS     1
+
+static const char* const s_pump_names[MPC_CHANNELS] = { "H2SO3/pH", "NaOH/alk", "amine/SO3" };
+
+// Plant truth: differs from the default MPC model on purpose. The pH channel is simulated
+// as hydroxide (mmol/L) and tested as pH = 11 + log10(OH).
+static const float s_true_gain[MPC_CHANNELS]  = { -0.085f, 85.0f, 26.0f };
+static const float s_true_load[MPC_CHANNELS]  = { 0.66f, 23.0f, -4.8f };
+static const float s_late_load[MPC_CHANNELS]  = { 0.72f, 28.0f, -5.8f };    // Second half: makeup chemistry changes
+static const float s_true_decay[MPC_CHANNELS] = { 0.0f, 0.0f, 0.08f };      // per hour
+static const float s_noise[MPC_CHANNELS]      = { 0.05f, 5.0f, 1.5f };      // Lab test sd (pH, ppm, ppm)
+static const float s_start[MPC_CHANNELS]      = { 4.0f, 200.0f, 10.0f };
+
+// Mode F product per gallon of makeup at 100 % fuzzy output (pump_config_t.ml_per_gallon_at_100pct)
+static const float s_ml_per_gal[MPC_CHANNELS] = { 13.0f, 1.0f, 4.0f };
+
+static uint32_t s_seed = 2024;
+static float frand(float lo, float hi) {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return lo + (hi - lo) * (float)(s_seed >> 8) / 16777216.0f;
+}
+static float gauss(float sd) {
+    float s = 0.0f;
+    for (int i = 0; i < 6; i++) s += frand(-1.0f, 1.0f);
+    return s * sd / sqrtf(2.0f);
+}
+
+typedef struct {
+    double ml[MPC_CHANNELS];
+    double sum[MPC_CHANNELS], sum2[MPC_CHANNELS], err2[MPC_CHANNELS];
+    uint32_t inside[MPC_CHANNELS];
+    uint32_t samples;
+} sim_stats_t;
+
+static void simulate(bool use_mpc, int days, float test_hours, const fuzzy_config_t& cfg,
+                     sim_stats_t* st, mpc_status_t* mpc_out, float* avg_iter, float* avg_us) {
+    static FuzzyController fc;
+    static fuzzy_config_t fcfg;
+    fcfg = cfg;
+    fc.begin(&fcfg);
+    MpcDosing mpc;
+    mpc.begin();
+
+    const float sp[MPC_CHANNELS] = { cfg.ph_setpoint, cfg.alk_setpoint, cfg.sulfite_setpoint };
+    const float db[MPC_CHANNELS] = { cfg.ph_deadband, cfg.alk_deadband, cfg.sulfite_deadband };
+    const float max_ml_min[MPC_CHANNELS] = { cfg.acid_max_ml_min, cfg.caustic_max_ml_min, cfg.sulfite_max_ml_min };
+    for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+        mpc.setTarget(i, sp[i], db[i], max_ml_min[i]);
+        mpc.setEnabled(i, true);
+    }
+
+    s_seed = 2024;  // Same disturbances and test noise for both controllers
+    memset(st, 0, sizeof(*st));
+    const float V = MPC_DEFAULT_BOILER_GAL;
+    const float dt_min = SIM_DT_SEC / 60.0f;
+    float x[MPC_CHANNELS], c[MPC_CHANNELS];  // Plant state, residual as tested
+    for (uint8_t i = 0; i < MPC_CHANNELS; i++) x[i] = s_start[i];
+    c[0] = 11.0f + log10f(x[0]);
+    c[1] = x[1];
+    c[2] = x[2];
+    float cond = 2500.0f, cond_prev = cond;
+    bool valve = false;
+    float pending_ml[MPC_CHANNELS] = { 0, 0, 0 };
+    uint32_t next_test = 0, next_trend = 0;
+    float trend = 0.0f;
+    double iter_sum = 0, us_sum = 0;
+    uint32_t iter_n = 0;
+
+    const uint32_t steps = (uint32_t)days * 86400UL / SIM_DT_SEC;
+    for (uint32_t n = 0; n < steps; n++) {
+        uint32_t t_sec = n * SIM_DT_SEC;
+        uint32_t now_ms = t_sec * 1000UL;
+        float hours = t_sec / 3600.0f;
+
+        // Makeup: daily load swing plus noise
+        float qm = max(0.0f, 0.5f * (1.0f + 0.5f * sinf(2.0f * (float)M_PI * hours / 24.0f)) + gauss(0.05f));
+        float makeup_gal = qm * dt_min;
+
+        // Conductivity blowdown (setpoint 2500, deadband 100)
+        if (cond > 2600.0f) valve = true;
+        else if (cond < 2400.0f) valve = false;
+        float qbd = valve ? MPC_DEFAULT_BLOWDOWN_GPM : 0.0f;
+        cond += dt_min * (qm * 250.0f - qbd * cond) / V;
+
+        // Lab tests
+        if (t_sec >= next_test) {
+            next_test += (uint32_t)(test_hours * 3600.0f);
+            const fuzzy_input_t in[MPC_CHANNELS] = { FUZZY_IN_PH, FUZZY_IN_ALKALINITY, FUZZY_IN_SULFITE };
+            for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+                float v = max(0.0f, c[i] + gauss(s_noise[i]));
+                fc.setManualInput(in[i], v, true);
+            }
+            fc.setManualInput(FUZZY_IN_TDS, cond * 0.7f, true);
+        }
+        if (t_sec >= next_trend) {
+            next_trend += 60;
+            trend = cond - cond_prev;
+            cond_prev = cond;
+        }
+
+        // Controller: ml dispensed this step per pump
+        float dose_ml[MPC_CHANNELS];
+        if (use_mpc) {
+            mpc.pollManualInputs(fc);
+            if (mpc.update(now_ms, makeup_gal, valve)) {
+                us_sum += mpc.getStatus().solve_us;
+                for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+                    iter_sum += mpc.getChannelStatus(i).iterations;
+                    iter_n++;
+                }
+            }
+            for (uint8_t i = 0; i < MPC_CHANNELS; i++) dose_ml[i] = mpc.getRate(i) * dt_min;
+        } else {
+            fuzzy_inputs_t fin;
+            memset(&fin, 0, sizeof(fin));
+            fin.conductivity = cond;
+            fin.temperature = 80.0f;
+            fin.cond_trend = trend;
+            fuzzy_result_t r = fc.evaluate(fin);
+            const float rate[MPC_CHANNELS] = { r.acid_rate, r.caustic_rate, r.sulfite_rate };
+            for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+                dose_ml[i] = min(makeup_gal * s_ml_per_gal[i] * rate[i] / 100.0f, max_ml_min[i] * dt_min);
+            }
+        }
+
+        // Pumps dispense in MPC_MIN_DOSE_ML lots, like processModeF/processModeM
+        float dosed[MPC_CHANNELS];
+        for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+            pending_ml[i] += dose_ml[i];
+            dosed[i] = 0.0f;
+            if (pending_ml[i] >= MPC_MIN_DOSE_ML) { dosed[i] = pending_ml[i]; pending_ml[i] = 0.0f; }
+        }
+
+        // Residuals
+        const float* load = (n >= steps / 2) ? s_late_load : s_true_load;
+        for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+            x[i] += (s_true_gain[i] * dosed[i] + dt_min * (qm * load[i] - qbd * x[i])) / V
+                  - dt_min * s_true_decay[i] / 60.0f * x[i];
+            x[i] = max(x[i], i == 0 ? 1e-3f : 0.0f);
+        }
+        c[0] = 11.0f + log10f(x[0]);
+        c[1] = x[1];
+        c[2] = x[2];
+
+        if (hours >= SIM_WARMUP_DAYS * 24.0f) {
+            st->samples++;
+            for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+                st->ml[i] += dosed[i];
+                st->sum[i] += c[i];
+                st->sum2[i] += (double)c[i] * c[i];
+                st->err2[i] += (double)(c[i] - sp[i]) * (c[i] - sp[i]);
+                if (fabsf(c[i] - sp[i]) <= db[i]) st->inside[i]++;
+            }
+        }
+    }
+    if (mpc_out) *mpc_out = mpc.getStatus();
+    if (avg_iter) *avg_iter = iter_n ? (float)(iter_sum / iter_n) : 0.0f;
+    if (avg_us) *avg_us = iter_n ? (float)(us_sum * MPC_CHANNELS / iter_n) : 0.0f;
+}
+
+static void printStats(const char* name, const sim_stats_t& st, float days) {
+    printf("%s\n", name);
+    printf("  pump          ml/day   mean      rms err   std dev   in band\n");
+    for (uint8_t i = 0; i < MPC_CHANNELS; i++) {
+        double mean = st.sum[i] / st.samples;
+        double var = st.sum2[i] / st.samples - mean * mean;
+        printf("  %-10s %9.1f %9.2f %9.3f %9.3f %8.1f %%\n", s_pump_names[i], st.ml[i] / days, mean,
+               sqrt(st.err2[i] / st.samples), sqrt(max(0.0, var)), 100.0 * st.inside[i] / st.samples);
+    }
+}
+
+int main(int argc, char** argv) {
+    int days = argc > 1 ? atoi(argv[1]) : 14;
+    float test_hours = argc > 2 ? (float)atof(argv[2]) : 8.0f;
+    if (days <= SIM_WARMUP_DAYS) days = SIM_WARMUP_DAYS + 1;
+    if (test_hours < 0.5f) test_hours = 0.5f;
+
+    fuzzy_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.cond_setpoint = 2500;
+    cfg.alk_setpoint = 300;
+    cfg.sulfite_setpoint = 30;
+    cfg.ph_setpoint = 11.0f;
+    cfg.cond_deadband = 200;
+    cfg.alk_deadband = 50;
+    cfg.sulfite_deadband = 5;
+    cfg.ph_deadband = 0.3f;
+    cfg.caustic_max_ml_min = 10.0f;
+    cfg.sulfite_max_ml_min = 5.0f;
+    cfg.acid_max_ml_min = 5.0f;
+
+    printf("Simulated %d days (first %d excluded), lab tests every %.1f h, %d s steps\n\n",
+           days, SIM_WARMUP_DAYS, test_hours, SIM_DT_SEC);
+
+    static sim_stats_t fuzzy, mpc;
+    mpc_status_t ms;
+    float avg_iter = 0.0f, avg_us = 0.0f;
+    simulate(false, days, test_hours, cfg, &fuzzy, nullptr, nullptr, nullptr);
+    simulate(true, days, test_hours, cfg, &mpc, &ms, &avg_iter, &avg_us);
+
+    float stat_days = (float)(days - SIM_WARMUP_DAYS);
+    printStats("Fuzzy Mode F", fuzzy, stat_days);
+    printStats("MPC Mode M", mpc, stat_days);
+    printf("\nMPC: %lu plans, %.1f solver iterations per channel, planning pass %.1f us mean, %lu us worst (host)\n",
+           (unsigned long)ms.plans, avg_iter, avg_us, (unsigned long)ms.max_solve_us);
+    return 0;
+}
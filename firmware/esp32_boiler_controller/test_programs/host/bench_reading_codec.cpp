@@ -0,0 +1,147 @@
+/**
+ * @file bench_reading_codec.cpp
+ * @brief Host benchmark: reading block compression (reading_codec) on CSV logs
+ *
+ * Reads SD CSV logs (SD_CSV_HEADER rows, as the logger or `sd_log_tool csv`
+ * writes them) and compresses their readings in blocks of 20 (one HTTP batch),
+ * 100, 1000 and 8640 (a day at 10 s) readings. Every block is decoded and
+ * compared with the parsed records. Prints per block size:
+ *
+ *   bytes as CSV, as 44-byte binary records, compressed; ratio to both;
+ *   bytes per reading; encode and decode ns per reading
+ *
+ * Without files a day is synthesized: 10 s readings with sensor noise, pump
+ * and blowdown switching, and an hour-long outage.
+ *
+ * Build/run from firmware/esp32_boiler_controller:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/host/bench_reading_codec.cpp src/reading_codec.cpp src/sd_log_record.cpp \
+ *       src/coprocessor_protocol.cpp -o /tmp/bench_reading_codec
+ *   /tmp/bench_reading_codec [log.csv ...]
+ */
+
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+#include "reading_codec.h"
+
+static const int s_block_sizes[] = { 20, 100, 1000, 8640 };
+
+static double nowNs() {
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t loadCsv(const char* path, std::vector<sd_log_record_t>* recs) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return 0;
+    }
+    char line[512];                             // The header is longer than a row
+    size_t bytes = 0, rejected = 0;
+    sd_log_record_t rec;
+    while (fgets(line, sizeof(line), f)) {
+        bytes += strlen(line);
+        if (sdlog_parse_csv(line, &rec)) recs->push_back(rec);
+        else rejected++;
+    }
+    fclose(f);
+    fprintf(stderr, "%s: %zu readings, %zu lines skipped\n", path, recs->size(), rejected);
+    return bytes;
+}
+
+static uint32_t s_seed = 12345;
+static uint32_t rnd() {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return s_seed >> 8;
+}
+
+static void synthesizeDay(std::vector<sd_log_record_t>* recs) {
+    sensor_reading_t r;
+    memset(&r, 0, sizeof(r));
+    r.timestamp = 1748736000;
+    r.conductivity = 2500.0f;
+    r.temperature = 180.0f;
+    r.water_meter1 = 123456;
+    r.water_meter2 = 7890;
+    r.fw_pump_cycle_count = 4000;
+    r.fw_pump_on_time_sec = 900000;
+    r.cond_sensor_valid = true;
+    r.temp_sensor_valid = true;
+    r.devices_operational = 11;
+    for (int i = 0; i < 8640; i++) {
+        r.timestamp += (i == 4000) ? 3600 : 10;         // Outage: nothing logged
+        r.conductivity += (float)((int)(rnd() % 21) - 10) / 10.0f;
+        r.temperature += (float)((int)(rnd() % 3) - 1) / 10.0f;
+        r.flow_rate = 12.0f + (float)(rnd() % 20) / 100.0f;
+        r.water_meter1 += rnd() % 3;
+        if (rnd() % 30 == 0) r.water_meter2++;
+        if (rnd() % 60 == 0) r.blowdown_active = !r.blowdown_active;
+        r.valve_position_mA = r.blowdown_active ? 20.0f : 4.0f;
+        if (rnd() % 40 == 0) {
+            r.feedwater_pump_on = !r.feedwater_pump_on;
+            if (r.feedwater_pump_on) r.fw_pump_cycle_count++;
+        }
+        if (r.feedwater_pump_on) r.fw_pump_on_time_sec += 10;
+        r.measurement_age_ms = 200 + rnd() % 10;
+        sd_log_record_t rec;
+        sdlog_pack(&r, &rec);
+        recs->push_back(rec);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<sd_log_record_t> recs;
+    size_t csv_bytes = 0;
+    for (int i = 1; i < argc; i++) csv_bytes += loadCsv(argv[i], &recs);
+    if (argc < 2) {
+        synthesizeDay(&recs);
+        fprintf(stderr, "no logs given: synthesized %zu readings\n", recs.size());
+    }
+    if (recs.empty()) return 1;
+    if (csv_bytes == 0) {
+        char line[SD_CSV_MAX_LINE];
+        csv_bytes = strlen(SD_CSV_HEADER) + 2;
+        for (const sd_log_record_t& rec : recs) csv_bytes += sdlog_format_csv(&rec, line, sizeof(line)) + 2;
+    }
+    size_t n = recs.size();
+    size_t bin_bytes = n * SD_BIN_RECORD_SIZE;
+
+    printf("%zu readings: %zu bytes CSV, %zu bytes binary\n\n", n, csv_bytes, bin_bytes);
+    printf("block   compressed  vs CSV  vs bin  B/reading  enc ns  dec ns  round trip\n");
+
+    std::vector<uint8_t> buf(8640 * SD_BIN_RECORD_SIZE);
+    for (int block : s_block_sizes) {
+        size_t total = 0, mismatches = 0;
+        double enc_ns = 0, dec_ns = 0;
+        for (size_t start = 0; start < n; start += block) {
+            size_t len = std::min((size_t)block, n - start);
+            ReadingEncoder enc;
+            double t0 = nowNs();
+            enc.begin(buf.data(), buf.size());
+            for (size_t i = 0; i < len; i++) enc.append(&recs[start + i]);
+            size_t size = enc.finish();
+            double t1 = nowNs();
+            total += size;
+
+            ReadingDecoder dec;
+            sd_log_record_t out;
+            size_t got = 0;
+            dec.begin(buf.data(), size);
+            while (dec.next(&out)) {
+                if (memcmp(&out, &recs[start + got], sizeof(out)) != 0) mismatches++;
+                got++;
+            }
+            double t2 = nowNs();
+            if (got != len) mismatches += len - got;
+            enc_ns += t1 - t0;
+            dec_ns += t2 - t1;
+        }
+        printf("%5d   %10zu  %5.1fx  %5.1fx  %9.2f  %6.0f  %6.0f  %s\n",
+               block, total, (double)csv_bytes / total, (double)bin_bytes / total,
+               (double)total / n, enc_ns / n, dec_ns / n,
+               mismatches ? "MISMATCH" : "exact");
+    }
+    return 0;
+}
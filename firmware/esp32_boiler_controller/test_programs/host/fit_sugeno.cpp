@@ -0,0 +1,304 @@
+/**
+ * @file fit_sugeno.cpp
+ * @brief Host tool: fit Sugeno consequents to the current Mamdani rule base
+ *
+ * Samples operating points over the input ranges, runs the Mamdani engine as the
+ * reference and solves, per output, the linear least-squares problem
+ *   y_mamdani ≈ sum_r wn_r * (c0_r + sum_i c_ri * u_i)
+ * where wn_r are the normalized firing strengths of the rules driving that output
+ * (the consequent part of ANFIS hybrid learning). Ridge regularization pulls rules
+ * that rarely fire toward the zero-order defaults (Mamdani set centroids), and every
+ * consequent is kept within 0..100 % over the whole normalized input range, so a
+ * rule never asks for more than the actuator can do however far it extrapolates.
+ *
+ * The fitted table is loaded into the controller and checked on a separate
+ * validation set; the report goes to stderr, the C table to stdout. With a file
+ * name, the rule base and its consequents are also written in the binary upload
+ * format (POST /api/fuzzy/rules stores both).
+ *
+ * Build/run from firmware/esp32_boiler_controller:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/host/fit_sugeno.cpp src/fuzzy_logic.cpp -o /tmp/fit_sugeno
+ *   /tmp/fit_sugeno [order 0|1] [samples] [rules.bin] > sugeno_fit.h
+ */
+
+#include <Arduino.h>
+#include <algorithm>
+#include <vector>
+#include "fuzzy_logic.h"
+
+#define FIT_RIDGE       1e-3    // Relative to mean diagonal of the normal matrix
+#define FIT_VALIDATION  2000
+#define FIT_SWEEPS      20000   // Projected Gauss-Seidel sweeps (bounded solve)
+#define FIT_OUT_MIN     0.0
+#define FIT_OUT_MAX     100.0
+
+static uint32_t s_seed = 7;
+static float frand(float lo, float hi) {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return lo + (hi - lo) * (float)(s_seed >> 8) / 16777216.0f;
+}
+
+static void randomPoint(FuzzyController& fc, fuzzy_inputs_t* in) {
+    fc.setManualInput(FUZZY_IN_TDS, frand(0, 5000), frand(0, 1) > 0.05f);
+    fc.setManualInput(FUZZY_IN_ALKALINITY, frand(0, 1000), frand(0, 1) > 0.05f);
+    fc.setManualInput(FUZZY_IN_SULFITE, frand(0, 100), frand(0, 1) > 0.05f);
+    fc.setManualInput(FUZZY_IN_PH, frand(7, 14), frand(0, 1) > 0.05f);
+    memset(in, 0, sizeof(*in));
+    in->temperature = frand(0, 100);
+    in->cond_trend = frand(-100, 100);
+}
+
+static float outputOf(const fuzzy_result_t& r, uint8_t o) {
+    switch (o) {
+        case FUZZY_OUT_BLOWDOWN: return r.blowdown_rate;
+        case FUZZY_OUT_CAUSTIC:  return r.caustic_rate;
+        case FUZZY_OUT_SULFITE:  return r.sulfite_rate;
+        default:                 return r.acid_rate;
+    }
+}
+
+// Solve A x = b (n x n, row-major) by Gaussian elimination with partial pivoting
+static bool solve(std::vector<double>& A, std::vector<double>& b, int n) {
+    for (int c = 0; c < n; c++) {
+        int piv = c;
+        for (int r = c + 1; r < n; r++) {
+            if (fabs(A[r * n + c]) > fabs(A[piv * n + c])) piv = r;
+        }
+        if (fabs(A[piv * n + c]) < 1e-12) return false;
+        if (piv != c) {
+            for (int k = 0; k < n; k++) std::swap(A[c * n + k], A[piv * n + k]);
+            std::swap(b[c], b[piv]);
+        }
+        for (int r = c + 1; r < n; r++) {
+            double f = A[r * n + c] / A[c * n + c];
+            if (f == 0) continue;
+            for (int k = c; k < n; k++) A[r * n + k] -= f * A[c * n + k];
+            b[r] -= f * b[c];
+        }
+    }
+    for (int c = n - 1; c >= 0; c--) {
+        double v = b[c];
+        for (int k = c + 1; k < n; k++) v -= A[c * n + k] * b[k];
+        b[c] = v / A[c * n + c];
+    }
+    return true;
+}
+
+// Minimize 0.5 x'Ax - b'x with each consequent (c0 + sum c_i u_i, per_rule values per
+// rule) within FIT_OUT_MIN..FIT_OUT_MAX for every u in [0,1]^n, i.e. at the corners:
+//   c0 + sum min(c_i, 0) >= FIT_OUT_MIN,  c0 + sum max(c_i, 0) <= FIT_OUT_MAX
+// Projected Gauss-Seidel from a feasible x (the centroid defaults); A includes the ridge
+static int solveBounded(const std::vector<double>& A, const std::vector<double>& b,
+                        std::vector<double>& x, int n, int per_rule) {
+    int sweep = 0;
+    while (sweep++ < FIT_SWEEPS) {
+        double step = 0;
+        for (int a = 0; a < n; a++) {
+            double g = b[a];
+            for (int c = 0; c < n; c++) if (c != a) g -= A[(size_t)a * n + c] * x[c];
+            double v = g / A[(size_t)a * n + a];
+
+            int base = a - a % per_rule;
+            double pos = 0, neg = 0;    // Coefficients other than x[a]
+            for (int k = base + 1; k < base + per_rule; k++) {
+                if (k == a) continue;
+                pos += std::max(x[k], 0.0);
+                neg += std::min(x[k], 0.0);
+            }
+            double lo, hi;
+            if (a == base) {
+                lo = FIT_OUT_MIN - neg;
+                hi = FIT_OUT_MAX - pos;
+            } else {
+                lo = FIT_OUT_MIN - (x[base] + neg);
+                hi = FIT_OUT_MAX - (x[base] + pos);
+            }
+            v = std::min(std::max(v, lo), hi);
+            step = std::max(step, fabs(v - x[a]));
+            x[a] = v;
+        }
+        if (step < 1e-6) break;  // Output %
+    }
+    return sweep;
+}
+
+typedef struct {
+    double rms[FUZZY_MAX_OUTPUTS];
+    double max[FUZZY_MAX_OUTPUTS];
+} fit_error_t;
+
+// Sugeno (current consequents) vs Mamdani on a fixed validation set
+static fit_error_t validate(FuzzyController& fc, fuzzy_config_t& cfg) {
+    fit_error_t e;
+    memset(&e, 0, sizeof(e));
+    uint32_t saved_seed = s_seed;
+    s_seed = 99991;
+    for (int k = 0; k < FIT_VALIDATION; k++) {
+        fuzzy_inputs_t in;
+        randomPoint(fc, &in);
+        cfg.inference_method = FUZZY_INFERENCE_MAMDANI;
+        fuzzy_result_t m = fc.evaluate(in);
+        cfg.inference_method = FUZZY_INFERENCE_SUGENO;
+        fuzzy_result_t s = fc.evaluate(in);
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+            double d = fabs(outputOf(s, o) - outputOf(m, o));
+            e.rms[o] += d * d;
+            if (d > e.max[o]) e.max[o] = d;
+        }
+    }
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) e.rms[o] = sqrt(e.rms[o] / FIT_VALIDATION);
+    cfg.inference_method = FUZZY_INFERENCE_MAMDANI;
+    s_seed = saved_seed;
+    return e;
+}
+
+int main(int argc, char** argv) {
+    int order = argc > 1 ? atoi(argv[1]) : 1;
+    int samples = argc > 2 ? atoi(argv[2]) : 5000;
+    const char* blob_path = argc > 3 ? argv[3] : nullptr;
+    if (order != 0) order = 1;
+    if (samples < 100) samples = 100;
+
+    fuzzy_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.cond_setpoint = 2500.0f;
+    cfg.alk_setpoint = 300.0f;
+    cfg.sulfite_setpoint = 30.0f;
+    cfg.ph_setpoint = 11.0f;
+    cfg.cond_deadband = 200.0f;
+    cfg.alk_deadband = 50.0f;
+    cfg.sulfite_deadband = 5.0f;
+    cfg.ph_deadband = 0.3f;
+
+    FuzzyController fc;
+    fc.begin(&cfg);
+    uint8_t nr = fc.getActiveRuleCount();
+    const int per_rule = order ? FUZZY_SUGENO_PARAMS : 1;
+
+    // Which rules drive which output: zero-order defaults are non-zero centroids
+    float prior[FUZZY_MAX_RULES][FUZZY_MAX_OUTPUTS][FUZZY_SUGENO_PARAMS];
+    bool drives[FUZZY_MAX_RULES][FUZZY_MAX_OUTPUTS];
+    for (uint8_t r = 0; r < nr; r++) {
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+            fc.getSugenoConsequent(r, o, prior[r][o]);
+            drives[r][o] = prior[r][o][0] != 0.0f;
+        }
+    }
+
+    fit_error_t before = validate(fc, cfg);
+
+    // Collect normalized strengths, inputs and the Mamdani reference
+    std::vector<float> W((size_t)samples * nr), U((size_t)samples * FUZZY_MAX_INPUTS), Y((size_t)samples * FUZZY_MAX_OUTPUTS);
+    for (int k = 0; k < samples; k++) {
+        fuzzy_inputs_t in;
+        randomPoint(fc, &in);
+        fuzzy_result_t m = fc.evaluate(in);
+        float w[FUZZY_MAX_RULES];
+        fc.getLastRuleStrengths(w, &U[(size_t)k * FUZZY_MAX_INPUTS]);
+        for (uint8_t r = 0; r < nr; r++) W[(size_t)k * nr + r] = w[r];
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) Y[(size_t)k * FUZZY_MAX_OUTPUTS + o] = outputOf(m, o);
+    }
+
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+        std::vector<int> rules;
+        for (uint8_t r = 0; r < nr; r++) if (drives[r][o]) rules.push_back(r);
+        int n = (int)rules.size() * per_rule;
+        if (n == 0) continue;
+
+        std::vector<double> A((size_t)n * n, 0.0), b(n, 0.0), x(n);
+        for (int k = 0; k < samples; k++) {
+            double den = 0;
+            for (int r : rules) den += W[(size_t)k * nr + r];
+            if (den <= 0) continue;  // Nothing fires: Sugeno and Mamdani both give 0
+
+            const float* u = &U[(size_t)k * FUZZY_MAX_INPUTS];
+            for (size_t q = 0; q < rules.size(); q++) {
+                double wn = W[(size_t)k * nr + rules[q]] / den;
+                x[q * per_rule] = wn;
+                for (int i = 1; i < per_rule; i++) x[q * per_rule + i] = wn * u[i - 1];
+            }
+            double y = Y[(size_t)k * FUZZY_MAX_OUTPUTS + o];
+            for (int a = 0; a < n; a++) {
+                if (x[a] == 0) continue;
+                b[a] += x[a] * y;
+                for (int c = 0; c < n; c++) A[(size_t)a * n + c] += x[a] * x[c];
+            }
+        }
+
+        // Ridge toward the zero-order defaults
+        double diag = 0;
+        for (int a = 0; a < n; a++) diag += A[(size_t)a * n + a];
+        double lambda = FIT_RIDGE * (diag / n + 1e-9);
+        for (size_t q = 0; q < rules.size(); q++) {
+            for (int i = 0; i < per_rule; i++) {
+                int a = (int)q * per_rule + i;
+                A[(size_t)a * n + a] += lambda;
+                b[a] += lambda * prior[rules[q]][o][i];
+            }
+        }
+
+        // Unconstrained optimum for the report, then the bounded fit that is applied
+        std::vector<double> A0 = A, b0 = b;
+        double c0_min = 0, c0_max = 0;
+        if (solve(A0, b0, n)) {
+            for (size_t q = 0; q < rules.size(); q++) {
+                c0_min = std::min(c0_min, b0[q * per_rule]);
+                c0_max = std::max(c0_max, b0[q * per_rule]);
+            }
+        }
+        std::vector<double> c(n);
+        for (size_t q = 0; q < rules.size(); q++) {
+            for (int i = 0; i < per_rule; i++) c[q * per_rule + i] = prior[rules[q]][o][i];
+        }
+        int sweeps = solveBounded(A, b, c, n, per_rule);
+        fprintf(stderr, "output %u: %d consequents, %d sweeps (unbounded c0 %.1f..%.1f)\n",
+                o, (int)rules.size(), sweeps, c0_min, c0_max);
+
+        for (size_t q = 0; q < rules.size(); q++) {
+            float coeffs[FUZZY_MAX_INPUTS] = {0};
+            for (int i = 1; i < per_rule; i++) coeffs[i - 1] = (float)c[q * per_rule + i];
+            fc.setSugenoConsequent(rules[q], o, (float)c[q * per_rule], coeffs);
+        }
+    }
+
+    fit_error_t after = validate(fc, cfg);
+
+    const char* names[FUZZY_MAX_OUTPUTS] = {"blowdown", "caustic", "sulfite", "acid"};
+    fprintf(stderr, "\nSugeno vs Mamdani on %d validation points (output %%)\n", FIT_VALIDATION);
+    fprintf(stderr, "  %-9s  %18s  %18s\n", "", "centroid constants", order ? "fitted 1st order" : "fitted 0th order");
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+        fprintf(stderr, "  %-9s  rms %5.2f max %5.2f  rms %5.2f max %5.2f\n", names[o],
+                before.rms[o], before.max[o], after.rms[o], after.max[o]);
+    }
+
+    printf("// Generated by test_programs/host/fit_sugeno (order %d, %d samples, default rule base)\n", order, samples);
+    printf("// {rule, output, c0, c_tds, c_alk, c_sulfite, c_ph, c_temp, c_trend}; inputs normalized 0..1\n");
+    printf("// Apply: for (auto& e : FUZZY_SUGENO_FIT) fuzzyController.setSugenoConsequent(e[0], e[1], e[2], &e[3]);\n");
+    printf("static const float FUZZY_SUGENO_FIT[][2 + FUZZY_SUGENO_PARAMS] = {\n");
+    for (uint8_t r = 0; r < nr; r++) {
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+            if (!drives[r][o]) continue;
+            float p[FUZZY_SUGENO_PARAMS];
+            fc.getSugenoConsequent(r, o, p);
+            printf("    {%2u, %u", r, o);
+            for (int i = 0; i < FUZZY_SUGENO_PARAMS; i++) printf(", %9.4ff", p[i]);
+            printf("},\n");
+        }
+    }
+    printf("};\n");
+
+    if (blob_path) {
+        static uint8_t blob[FUZZY_RB_MAX_SIZE];
+        size_t len = fc.exportRuleBase(blob, sizeof(blob));
+        FILE* f = fopen(blob_path, "wb");
+        if (!len || !f || fwrite(blob, 1, len, f) != len) {
+            fprintf(stderr, "cannot write %s\n", blob_path);
+            if (f) fclose(f);
+            return 1;
+        }
+        fclose(f);
+        fprintf(stderr, "%s: %u bytes (upload with POST /api/fuzzy/rules)\n", blob_path, (unsigned)len);
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+/**
+ * @file fuzzy_rules_tool.cpp
+ * @brief Host tool: convert fuzzy rule bases between text and the binary upload format
+ *
+ * Text format, one rule per line ('#' starts a comment):
+ *   <6 antecedent terms> -> <4 consequent terms> <weight>
+ *   HI DC DC DC DC VH -> VH DC DC DC 1.0
+ * Terms: VL LO ML MD MH HI VH, DC = don't care. Inputs in order TDS, alkalinity,
+ * sulfite, pH, temperature, trend; outputs blowdown, caustic, sulfite, acid.
+ * Weight 0 disables the rule. Weights are stored in steps of 0.005.
+ *
+ * Optional Sugeno consequents, after the rules (rule and output are 0-based indices):
+ *   S <rule> <output> <c0> [<c_tds> <c_alk> <c_sulfite> <c_ph> <c_temp> <c_trend>]
+ *   S 0 0 82.5
+ * Consequents not listed keep the output set centroid. With any S line the blob is
+ * version 2 (rules + consequents, steps of 0.01); otherwise rules only.
+ *
+ *   defaults           print the built-in rule base as text
+ *   encode             text on stdin → binary on stdout (upload with POST /api/fuzzy/rules)
+ *   decode             binary on stdin → text on stdout (e.g. from GET /api/fuzzy/rules)
+ *
+ * Build/run from firmware/esp32_boiler_controller:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/host/fuzzy_rules_tool.cpp src/fuzzy_logic.cpp -o /tmp/fuzzy_rules_tool
+ *   /tmp/fuzzy_rules_tool defaults > rules.txt
+ *   /tmp/fuzzy_rules_tool encode < rules.txt > rules.bin
+ *   curl -X POST -H "X-API-Key: <key>" -H "Content-Type: application/octet-stream" \
+ *       --data-binary @rules.bin http://<controller>/api/fuzzy/rules
+ */
+
+#include <Arduino.h>
+#include "fuzzy_logic.h"
+
+static const char* const s_terms[TERM_COUNT] = { "VL", "LO", "ML", "MD", "MH", "HI", "VH" };
+
+static void printTerm(uint8_t t) {
+    printf("%s ", t < TERM_COUNT ? s_terms[t] : "DC");
+}
+
+static const char* const s_outputs[FUZZY_MAX_OUTPUTS] = { "BLOW", "NAOH", "SO3", "ACID" };
+
+static void printRules(const fuzzy_rule_t* rules, uint8_t count) {
+    printf("# TDS ALK SO3 PH TEMP TREND -> BLOW NAOH SO3 ACID WEIGHT\n");
+    for (uint8_t r = 0; r < count; r++) {
+        for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) printTerm(rules[r].antecedent[i]);
+        printf("-> ");
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) printTerm(rules[r].consequent[o]);
+        printf("%.3f\n", rules[r].enabled ? rules[r].weight : 0.0f);
+    }
+}
+
+static void printSugeno(const fuzzy_rule_t* rules, uint8_t count, const fuzzy_sugeno_table_t& sugeno) {
+    printf("# S RULE OUTPUT C0 [C_TDS C_ALK C_SO3 C_PH C_TEMP C_TREND]\n");
+    for (uint8_t r = 0; r < count; r++) {
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+            if (rules[r].consequent[o] == DONT_CARE) continue;
+            const int16_t* p = sugeno[r][o];
+            uint8_t n = 1;
+            for (uint8_t i = 1; i < FUZZY_SUGENO_PARAMS; i++) if (p[i] != 0) n = FUZZY_SUGENO_PARAMS;
+            printf("S %2u %u", r, o);
+            for (uint8_t i = 0; i < n; i++) printf(" %.2f", p[i] * FUZZY_SUGENO_LSB);
+            printf("  # %s\n", s_outputs[o]);
+        }
+    }
+}
+
+static bool parseTerm(const char* tok, uint8_t* out) {
+    if (strcmp(tok, "DC") == 0) { *out = DONT_CARE; return true; }
+    for (uint8_t t = 0; t < TERM_COUNT; t++) {
+        if (strcmp(tok, s_terms[t]) == 0) { *out = t; return true; }
+    }
+    return false;
+}
+
+typedef struct {
+    uint8_t rule;
+    uint8_t output;
+    float params[FUZZY_SUGENO_PARAMS];
+} sugeno_line_t;
+
+static int encode() {
+    static fuzzy_rule_t rules[FUZZY_MAX_RULES];
+    static sugeno_line_t sugeno[FUZZY_MAX_RULES * FUZZY_MAX_OUTPUTS];
+    uint8_t count = 0;
+    uint16_t sugeno_count = 0;
+    char line[256];
+    int line_no = 0;
+
+    while (fgets(line, sizeof(line), stdin)) {
+        line_no++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        char* tok[12];
+        int n = 0;
+        for (char* t = strtok(line, " \t\r\n"); t && n < 12; t = strtok(nullptr, " \t\r\n")) tok[n++] = t;
+        if (n == 0) continue;
+        if (strcmp(tok[0], "S") == 0) {
+            if (n != 4 && n != 3 + FUZZY_SUGENO_PARAMS) {
+                fprintf(stderr, "line %d: expected S rule output c0 [%d coefficients]\n", line_no, FUZZY_MAX_INPUTS);
+                return 1;
+            }
+            sugeno_line_t& e = sugeno[sugeno_count];
+            int r = atoi(tok[1]), o = atoi(tok[2]);
+            if (r < 0 || r >= FUZZY_MAX_RULES || o < 0 || o >= FUZZY_MAX_OUTPUTS ||
+                sugeno_count >= FUZZY_MAX_RULES * FUZZY_MAX_OUTPUTS) {
+                fprintf(stderr, "line %d: bad rule or output index\n", line_no);
+                return 1;
+            }
+            e.rule = (uint8_t)r;
+            e.output = (uint8_t)o;
+            memset(e.params, 0, sizeof(e.params));
+            for (int i = 3; i < n; i++) e.params[i - 3] = (float)atof(tok[i]);
+            sugeno_count++;
+            continue;
+        }
+        if (n != 12 || strcmp(tok[6], "->") != 0) {
+            fprintf(stderr, "line %d: expected 6 terms -> 4 terms weight\n", line_no);
+            return 1;
+        }
+        if (count >= FUZZY_MAX_RULES) {
+            fprintf(stderr, "line %d: more than %d rules\n", line_no, FUZZY_MAX_RULES);
+            return 1;
+        }
+
+        fuzzy_rule_t& rule = rules[count];
+        bool ok = true;
+        for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) ok = ok && parseTerm(tok[i], &rule.antecedent[i]);
+        for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) ok = ok && parseTerm(tok[7 + o], &rule.consequent[o]);
+        rule.weight = (float)atof(tok[11]);
+        rule.enabled = rule.weight > 0.0f;
+        if (!ok || rule.weight < 0.0f || rule.weight > 1.0f) {
+            fprintf(stderr, "line %d: bad term or weight\n", line_no);
+            return 1;
+        }
+        count++;
+    }
+
+    static uint8_t blob[FUZZY_RB_MAX_SIZE];
+    size_t len = fuzzy_rb_encode(rules, count, blob, sizeof(blob));
+    // Same checks the controller applies on upload (e.g. rules without a consequent)
+    fuzzy_rb_status_t st = fuzzy_rb_decode(blob, len, nullptr, nullptr);
+    if (st != FUZZY_RB_OK) {
+        fprintf(stderr, "rule base rejected: %s\n", fuzzy_rb_status_name(st));
+        return 1;
+    }
+
+    if (sugeno_count > 0) {
+        // Let the controller fill in the centroids, then export rules + consequents
+        static fuzzy_config_t cfg;
+        static FuzzyController fc;
+        fc.begin(&cfg);
+        fc.loadRuleBase(blob, len);
+        fuzzy_inputs_t in;
+        memset(&in, 0, sizeof(in));
+        fc.evaluate(in);        // Swaps the staged rules in
+        for (uint16_t k = 0; k < sugeno_count; k++) {
+            const sugeno_line_t& e = sugeno[k];
+            if (e.rule >= count || rules[e.rule].consequent[e.output] == DONT_CARE) {
+                fprintf(stderr, "S %u %u: rule has no consequent for that output\n", e.rule, e.output);
+                return 1;
+            }
+            fc.setSugenoConsequent(e.rule, e.output, e.params[0], &e.params[1]);
+        }
+        len = fc.exportRuleBase(blob, sizeof(blob));
+    }
+    fwrite(blob, 1, len, stdout);
+    fprintf(stderr, "%u rules, %u bytes\n", (unsigned)count, (unsigned)len);
+    return 0;
+}
+
+static int decode() {
+    static uint8_t blob[FUZZY_RB_MAX_SIZE + 1];
+    size_t len = fread(blob, 1, sizeof(blob), stdin);
+    static fuzzy_rule_t rules[FUZZY_MAX_RULES];
+    static fuzzy_sugeno_table_t sugeno;
+    uint8_t count = 0;
+    fuzzy_rb_status_t st = fuzzy_rb_decode(blob, len, rules, &count, &sugeno);
+    if (st != FUZZY_RB_OK) {
+        fprintf(stderr, "invalid rule base: %s\n", fuzzy_rb_status_name(st));
+        return 1;
+    }
+    printRules(rules, count);
+    if (blob[2] == FUZZY_RB_VERSION_SUGENO) printSugeno(rules, count, sugeno);
+    return 0;
+}
+
+static int defaults() {
+    static fuzzy_config_t cfg;
+    static FuzzyController fc;
+    fc.begin(&cfg);
+    static fuzzy_rule_t rules[FUZZY_MAX_RULES];
+    for (uint8_t r = 0; r < fc.getRuleCount(); r++) rules[r] = fc.getRule(r);
+    printRules(rules, fc.getRuleCount());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* cmd = argc > 1 ? argv[1] : "";
+    if (strcmp(cmd, "encode") == 0) return encode();
+    if (strcmp(cmd, "decode") == 0) return decode();
+    if (strcmp(cmd, "defaults") == 0) return defaults();
+    fprintf(stderr, "usage: %s defaults | encode < rules.txt > rules.bin | decode < rules.bin\n", argv[0]);
+    return 2;
+}
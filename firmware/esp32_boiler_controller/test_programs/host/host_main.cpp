@@ -0,0 +1,16 @@
+/**
+ * @file host_main.cpp
+ * @brief Host entry point for on-device test programs: runs setup() once
+ *
+ * Link next to a test_programs/test_*.cpp that uses only host-shimmed APIs.
+ * Results are printed by the test itself ("All passed." / "FAILURES").
+ */
+
+#include <Arduino.h>
+
+void setup();
+
+int main() {
+    setup();
+    return 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file sd_log_tool.cpp
+ * @brief Host tool: convert binary SD reading logs (/logs/YYYY-MM-DD.bin) back to CSV, archive them
+ *
+ *   csv  <file.bin> [from [to]]   SD_CSV_HEADER CSV on stdout, optionally only
+ *                                 timestamps from..to (inclusive); the range start
+ *                                 is found through <file>.idx when present
+ *   info <file.bin>               record count, CRC failures, time range, index
+ *   pack <file.bin> <file.rcz>    compressed archive (reading_codec blocks of
+ *                                 up to ARCHIVE_BLOCK_BYTES, each preceded by
+ *                                 its uint16 LE length)
+ *   unpack <file.rcz>             archive back to the same CSV as `csv`
+ *
+ * Records that fail their CRC (torn by power loss) are skipped and counted on
+ * stderr. The CSV is identical to what the logger writes in CSV mode.
+ *
+ * Build/run from firmware/esp32_boiler_controller:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/host/sd_log_tool.cpp src/sd_log_record.cpp src/coprocessor_protocol.cpp \
+ *       src/reading_codec.cpp -o /tmp/sd_log_tool
+ *   /tmp/sd_log_tool csv 2025-06-01.bin > 2025-06-01.csv
+ *   /tmp/sd_log_tool csv 2025-06-01.bin 1748772000 1748775600
+ *   /tmp/sd_log_tool pack 2025-06-01.bin 2025-06-01.rcz
+ */
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "sd_log_record.h"
+#include "reading_codec.h"
+
+#define ARCHIVE_BLOCK_BYTES     4096
+
+typedef struct {
+    FILE* f;
+    uint8_t record_size;
+    uint32_t records;
+} bin_file_t;
+
+static bool openBin(const char* path, bin_file_t* b) {
+    b->f = fopen(path, "rb");
+    if (!b->f) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    sd_log_file_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, b->f) != 1 || (b->record_size = sdlog_check_header(&hdr)) == 0) {
+        fprintf(stderr, "%s: not a binary SD log (version %d expected)\n", path, SD_BIN_VERSION);
+        fclose(b->f);
+        return false;
+    }
+    fseek(b->f, 0, SEEK_END);
+    long size = ftell(b->f);
+    b->records = (uint32_t)((size - SD_BIN_HEADER_SIZE) / b->record_size);
+    return true;
+}
+
+static bool readRecord(bin_file_t* b, uint32_t n, sd_log_record_t* rec) {
+    if (fseek(b->f, SD_BIN_HEADER_SIZE + (long)n * b->record_size, SEEK_SET) != 0) return false;
+    if (fread(rec, sizeof(*rec), 1, b->f) != 1) return false;
+    if (b->record_size > sizeof(*rec)) fseek(b->f, b->record_size - sizeof(*rec), SEEK_CUR);
+    return true;
+}
+
+static std::vector<sd_log_index_entry_t> loadIndex(const char* bin_path) {
+    std::vector<sd_log_index_entry_t> index;
+    std::string path(bin_path);
+    size_t dot = path.rfind('.');
+    path = (dot == std::string::npos ? path : path.substr(0, dot)) + ".idx";
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return index;
+    sd_log_index_entry_t e;
+    while (fread(&e, sizeof(e), 1, f) == 1) index.push_back(e);
+    fclose(f);
+    return index;
+}
+
+static int toCsv(const char* path, uint32_t from, uint32_t to) {
+    bin_file_t b;
+    if (!openBin(path, &b)) return 1;
+
+    uint32_t start = 0;
+    std::vector<sd_log_index_entry_t> index = loadIndex(path);
+    if (from > 0 && !index.empty()) start = sdlog_index_start(index.data(), index.size(), from);
+
+    printf("%s\n", SD_CSV_HEADER);
+    char line[SD_CSV_MAX_LINE];
+    uint32_t bad = 0, rows = 0, scanned = 0;
+    sd_log_record_t rec;
+    for (uint32_t n = start; n < b.records && readRecord(&b, n, &rec); n++) {
+        scanned++;
+        if (!sdlog_record_valid(&rec)) { bad++; continue; }
+        if (rec.timestamp < from) continue;
+        if (rec.timestamp > to) break;
+        sdlog_format_csv(&rec, line, sizeof(line));
+        printf("%s\n", line);
+        rows++;
+    }
+    fclose(b.f);
+    fprintf(stderr, "%u rows, %u records read (from record %u of %u), %u failed CRC\n",
+            rows, scanned, start, b.records, bad);
+    return 0;
+}
+
+static int info(const char* path) {
+    bin_file_t b;
+    if (!openBin(path, &b)) return 1;
+
+    uint32_t bad = 0, first = 0, last = 0, backwards = 0;
+    bool any = false;
+    size_t csv_bytes = strlen(SD_CSV_HEADER) + 2;
+    char line[SD_CSV_MAX_LINE];
+    sd_log_record_t rec;
+    for (uint32_t n = 0; n < b.records && readRecord(&b, n, &rec); n++) {
+        if (!sdlog_record_valid(&rec)) { bad++; continue; }
+        if (!any) first = rec.timestamp;
+        else if (rec.timestamp < last) backwards++;
+        last = rec.timestamp;
+        any = true;
+        csv_bytes += sdlog_format_csv(&rec, line, sizeof(line)) + 2;
+    }
+    fclose(b.f);
+
+    std::vector<sd_log_index_entry_t> index = loadIndex(path);
+    printf("records:        %u (%u failed CRC)\n", b.records, bad);
+    printf("time range:     %u .. %u\n", first, last);
+    printf("out of order:   %u\n", backwards);
+    printf("index entries:  %zu\n", index.size());
+    printf("size:           %u bytes binary, %zu bytes as CSV (%.1fx)\n",
+           SD_BIN_HEADER_SIZE + b.records * b.record_size, csv_bytes,
+           b.records ? (double)csv_bytes / (SD_BIN_HEADER_SIZE + b.records * b.record_size) : 0.0);
+    return 0;
+}
+
+static bool writeBlock(FILE* out, ReadingEncoder* enc, uint8_t* buf, size_t* written) {
+    size_t size = enc->finish();
+    uint8_t len[2] = { (uint8_t)(size & 0xFF), (uint8_t)(size >> 8) };
+    if (fwrite(len, 1, 2, out) != 2 || fwrite(buf, 1, size, out) != size) return false;
+    *written += 2 + size;
+    return true;
+}
+
+static int pack(const char* path, const char* out_path) {
+    bin_file_t b;
+    if (!openBin(path, &b)) return 1;
+    FILE* out = fopen(out_path, "wb");
+    if (!out) {
+        fprintf(stderr, "%s: cannot create\n", out_path);
+        fclose(b.f);
+        return 1;
+    }
+
+    static uint8_t buf[ARCHIVE_BLOCK_BYTES];
+    ReadingEncoder enc;
+    enc.begin(buf, sizeof(buf));
+    uint32_t bad = 0, packed = 0, blocks = 0;
+    size_t written = 0;
+    bool ok = true;
+    sd_log_record_t rec;
+    for (uint32_t n = 0; ok && n < b.records && readRecord(&b, n, &rec); n++) {
+        if (!sdlog_record_valid(&rec)) { bad++; continue; }
+        if (!enc.append(&rec)) {
+            ok = writeBlock(out, &enc, buf, &written);
+            blocks++;
+            enc.begin(buf, sizeof(buf));
+            enc.append(&rec);
+        }
+        packed++;
+    }
+    if (ok && enc.count() > 0) {
+        ok = writeBlock(out, &enc, buf, &written);
+        blocks++;
+    }
+    fclose(b.f);
+    fclose(out);
+    if (!ok) {
+        fprintf(stderr, "%s: write failed\n", out_path);
+        return 1;
+    }
+    size_t bin_bytes = SD_BIN_HEADER_SIZE + (size_t)b.records * b.record_size;
+    fprintf(stderr, "%u records in %u blocks, %u failed CRC: %zu -> %zu bytes (%.1fx)\n",
+            packed, blocks, bad, bin_bytes, written, written ? (double)bin_bytes / written : 0.0);
+    return 0;
+}
+
+static int unpack(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return 1;
+    }
+    printf("%s\n", SD_CSV_HEADER);
+    static uint8_t buf[UINT16_MAX];
+    char line[SD_CSV_MAX_LINE];
+    uint32_t rows = 0, blocks = 0;
+    uint8_t len[2];
+    int status = 0;
+    while (fread(len, 1, 2, f) == 2) {
+        size_t size = len[0] | (len[1] << 8);
+        ReadingDecoder dec;
+        if (fread(buf, 1, size, f) != size || !dec.begin(buf, size)) {
+            fprintf(stderr, "%s: block %u truncated or not a reading archive\n", path, blocks);
+            status = 1;
+            break;
+        }
+        sd_log_record_t rec;
+        uint16_t got = 0;
+        while (dec.next(&rec)) {
+            sdlog_format_csv(&rec, line, sizeof(line));
+            printf("%s\n", line);
+            got++;
+        }
+        rows += got;
+        blocks++;
+        if (got != dec.count()) {
+            fprintf(stderr, "%s: block %u damaged after %u of %u readings\n", path, blocks - 1, got, dec.count());
+            status = 1;
+        }
+    }
+    fclose(f);
+    fprintf(stderr, "%u rows from %u blocks\n", rows, blocks);
+    return status;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && strcmp(argv[1], "csv") == 0) {
+        uint32_t from = argc > 3 ? (uint32_t)strtoul(argv[3], nullptr, 10) : 0;
+        uint32_t to = argc > 4 ? (uint32_t)strtoul(argv[4], nullptr, 10) : UINT32_MAX;
+        return toCsv(argv[2], from, to);
+    }
+    if (argc == 3 && strcmp(argv[1], "info") == 0) return info(argv[2]);
+    if (argc == 4 && strcmp(argv[1], "pack") == 0) return pack(argv[2], argv[3]);
+    if (argc == 3 && strcmp(argv[1], "unpack") == 0) return unpack(argv[2]);
+
+    fprintf(stderr, "usage: %s csv <file.bin> [from [to]] | info <file.bin> | "
+                    "pack <file.bin> <file.rcz> | unpack <file.rcz>\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file sweep_fuzzy.cpp
+ * @brief Host tool: sweep the fuzzy controller over a full input grid and report rule gaps
+ *
+ * Runs FuzzyController::evaluateBatch() over points^6 combinations of TDS, alkalinity,
+ * sulfite, pH, temperature and trend, each spanning its variable range (default 11
+ * points per axis = 1.77 M combinations), with the default setpoints and rules or a
+ * rule base from the controller (GET /api/fuzzy/rules). Reports throughput, points
+ * where no rule fires, points where no fired rule sets an output, and a spot check of
+ * the batch against evaluate().
+ *
+ *   sweep_fuzzy [points] [rules.bin] [--csv]
+ *
+ * --csv writes every gap point to stdout (inputs, active rules, covered-output mask).
+ *
+ * Build/run from firmware/esp32_boiler_controller:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/host/sweep_fuzzy.cpp src/fuzzy_logic.cpp -o /tmp/sweep_fuzzy
+ *   /tmp/sweep_fuzzy 11 > /dev/null
+ *   /tmp/sweep_fuzzy 9 rules.bin --csv > gaps.csv
+ */
+
+#include <Arduino.h>
+#include "fuzzy_logic.h"
+
+#define SWEEP_BATCH         4096    // Points per evaluateBatch() call
+#define SWEEP_MAX_POINTS    64      // Per axis
+#define SWEEP_CHECK_EVERY   997     // Spot check one point in this many against evaluate()
+
+static fuzzy_config_t s_cfg;
+static FuzzyController s_fc;
+
+static float s_col[FUZZY_MAX_INPUTS][SWEEP_BATCH];
+static float s_out[FUZZY_MAX_OUTPUTS][SWEEP_BATCH];
+static uint8_t s_active[SWEEP_BATCH];
+static uint8_t s_covered[SWEEP_BATCH];
+
+static bool loadRules(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) { fprintf(stderr, "cannot open %s\n", path); return false; }
+    static uint8_t blob[FUZZY_RB_MAX_SIZE + 1];
+    size_t len = fread(blob, 1, sizeof(blob), f);
+    fclose(f);
+    fuzzy_rb_status_t st = s_fc.loadRuleBase(blob, len);
+    if (st != FUZZY_RB_OK) { fprintf(stderr, "invalid rule base: %s\n", fuzzy_rb_status_name(st)); return false; }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int points = 11;
+    const char* rules_path = nullptr;
+    bool csv = false;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--csv") == 0) csv = true;
+        else if (argv[a][0] >= '0' && argv[a][0] <= '9') points = atoi(argv[a]);
+        else rules_path = argv[a];
+    }
+    points = constrain(points, 2, SWEEP_MAX_POINTS);
+
+    s_cfg.cond_setpoint = 2500;
+    s_cfg.alk_setpoint = 300;
+    s_cfg.sulfite_setpoint = 30;
+    s_cfg.ph_setpoint = 11.0f;
+    s_cfg.cond_deadband = 200;
+    s_cfg.alk_deadband = 50;
+    s_cfg.sulfite_deadband = 5;
+    s_cfg.ph_deadband = 0.3f;
+    s_fc.begin(&s_cfg);
+    if (rules_path) {
+        if (!loadRules(rules_path)) return 1;
+        fuzzy_inputs_t dummy;
+        memset(&dummy, 0, sizeof(dummy));
+        s_fc.evaluate(dummy);   // Staged rule base goes live on the next evaluate()
+    }
+    s_fc.setCacheEnabled(false);
+
+    float axis[FUZZY_MAX_INPUTS][SWEEP_MAX_POINTS];
+    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+        const linguistic_var_t& var = s_fc.getInputVar(i);
+        for (int k = 0; k < points; k++) {
+            axis[i][k] = var.min_value + (var.max_value - var.min_value) * k / (points - 1);
+        }
+    }
+
+    fuzzy_batch_t b;
+    memset(&b, 0, sizeof(b));
+    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) b.input[i] = s_col[i];
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) b.output[o] = s_out[o];
+    b.active_rules = s_active;
+    b.covered_mask = s_covered;
+
+    uint64_t total = 1;
+    for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) total *= points;
+    fprintf(stderr, "%d points per axis, %llu combinations, %u rules\n",
+            points, (unsigned long long)total, s_fc.getRuleCount());
+    if (csv) printf("tds,alkalinity,sulfite,ph,temperature,trend,active,covered\n");
+
+    uint64_t gaps = 0, checked = 0, mismatches = 0;
+    uint64_t uncovered[FUZZY_MAX_OUTPUTS] = {0};
+    uint64_t eval_us = 0;
+    float worst = 0.0f;
+    for (uint64_t start = 0; start < total; start += SWEEP_BATCH) {
+        size_t n = (size_t)min((uint64_t)SWEEP_BATCH, total - start);
+        for (size_t k = 0; k < n; k++) {
+            uint64_t idx = start + k;
+            for (uint8_t i = 0; i < FUZZY_MAX_INPUTS; i++) {
+                s_col[i][k] = axis[i][idx % points];
+                idx /= points;
+            }
+        }
+        b.count = n;
+        uint32_t t0 = micros();
+        s_fc.evaluateBatch(b);
+        eval_us += micros() - t0;
+
+        for (size_t k = 0; k < n; k++) {
+            if (s_active[k] == 0) {
+                gaps++;
+                if (csv) {
+                    printf("%.2f,%.2f,%.2f,%.3f,%.2f,%.2f,%u,%u\n", s_col[0][k], s_col[1][k], s_col[2][k],
+                           s_col[3][k], s_col[4][k], s_col[5][k], s_active[k], s_covered[k]);
+                }
+            }
+            for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+                if (!(s_covered[k] & (1u << o))) uncovered[o]++;
+            }
+            if ((start + k) % SWEEP_CHECK_EVERY == 0) {
+                for (uint8_t i = FUZZY_IN_TDS; i <= FUZZY_IN_PH; i++) s_fc.setManualInput((fuzzy_input_t)i, s_col[i][k]);
+                fuzzy_inputs_t in;
+                memset(&in, 0, sizeof(in));
+                in.temperature = s_col[FUZZY_IN_TEMPERATURE][k];
+                in.cond_trend = s_col[FUZZY_IN_TREND][k];
+                fuzzy_result_t r = s_fc.evaluate(in);
+                const float ref[FUZZY_MAX_OUTPUTS] = { r.blowdown_rate, r.caustic_rate, r.sulfite_rate, r.acid_rate };
+                bool same = r.active_rules == s_active[k];
+                for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+                    worst = max(worst, fabsf(ref[o] - s_out[o][k]));
+                    same = same && ref[o] == s_out[o][k];
+                }
+                checked++;
+                if (!same) mismatches++;
+            }
+        }
+    }
+
+    double secs = eval_us / 1e6;
+    fprintf(stderr, "evaluateBatch: %.2f s, %.2f M points/s, %.3f us/point\n",
+            secs, total / secs / 1e6, (double)eval_us / total);
+    fprintf(stderr, "no rule fires: %llu points (%.3f %%)\n",
+            (unsigned long long)gaps, 100.0 * gaps / total);
+    static const char* const out_names[FUZZY_MAX_OUTPUTS] = { "blowdown", "caustic", "sulfite", "acid" };
+    for (uint8_t o = 0; o < FUZZY_MAX_OUTPUTS; o++) {
+        fprintf(stderr, "no fired rule sets %-8s: %llu points (%.3f %%)\n", out_names[o],
+                (unsigned long long)uncovered[o], 100.0 * uncovered[o] / total);
+    }
+    fprintf(stderr, "spot check vs evaluate(): %llu points, %llu mismatches, worst %.6f %%\n",
+            (unsigned long long)checked, (unsigned long long)mismatches, worst);
+    return mismatches ? 1 : 0;
+}
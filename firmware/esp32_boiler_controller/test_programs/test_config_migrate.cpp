@@ -0,0 +1,129 @@
+/**
+ * @file test_config_migrate.cpp
+ * @brief Stored configuration migration (src/config_migrate.cpp) tests
+ *
+ *   - A blob from any earlier size with the MQTT block keeps broker, user,
+ *     password and the MQTT telemetry switch; only the appended bytes are zeroed
+ *   - A blob that ends before the MQTT block gets the MQTT defaults and keeps
+ *     everything it does hold
+ *
+ * Runs on the ESP32 (env test_config_migrate) or on the host:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/test_config_migrate.cpp src/config_migrate.cpp \
+ *       test_programs/host/host_main.cpp -o /tmp/test_config_migrate && /tmp/test_config_migrate
+ */
+
+#include <Arduino.h>
+#include <stddef.h>
+#include "config_migrate.h"
+
+#define ASSERT_TRUE(x) do { if (x) passed++; else { Serial.printf("FAIL line %d: expected true\n", __LINE__); failed++; } } while(0)
+
+static int passed = 0;
+static int failed = 0;
+
+// A deployed unit's config: every byte non-zero so a stray clear shows up
+static void fillDeployed(system_config_t* cfg) {
+    memset(cfg, 0xA5, sizeof(*cfg));
+    cfg->magic = CONFIG_MAGIC;
+    cfg->version = 1;
+    strcpy(cfg->mqtt_host, "broker.plant.local");
+    cfg->mqtt_port = 8883;
+    strcpy(cfg->mqtt_user, "ct6-unit-07");
+    strcpy(cfg->mqtt_pass, "s3cret");
+    cfg->use_mqtt_telemetry = true;
+}
+
+static bool tailIsZero(const system_config_t* cfg, size_t from) {
+    const uint8_t* p = (const uint8_t*)cfg;
+    for (size_t i = from; i < sizeof(*cfg); i++) if (p[i] != 0) return false;
+    return true;
+}
+
+static void testKeepsMqtt() {
+    Serial.println("Test 1: blobs with the MQTT block keep it");
+    static system_config_t deployed, cfg;
+    fillDeployed(&deployed);
+
+    // Every size from just past the MQTT block up to one byte short (covers the
+    // padded sizes of each appended field: sd_log_format, tsdb_*, fuzzy_surface_*)
+    size_t first = offsetof(system_config_t, use_mqtt_telemetry) + sizeof(bool);
+    int bad = 0, sizes = 0;
+    for (size_t n = first; n < sizeof(system_config_t); n++, sizes++) {
+        memset(&cfg, 0xFF, sizeof(cfg));
+        memcpy(&cfg, &deployed, n);
+        bool defaults = config_migrate(&cfg, n);
+        bool ok = !defaults &&
+                  strcmp(cfg.mqtt_host, deployed.mqtt_host) == 0 &&
+                  cfg.mqtt_port == deployed.mqtt_port &&
+                  strcmp(cfg.mqtt_user, deployed.mqtt_user) == 0 &&
+                  strcmp(cfg.mqtt_pass, deployed.mqtt_pass) == 0 &&
+                  cfg.use_mqtt_telemetry &&
+                  memcmp(&cfg.conductivity, &deployed.conductivity, sizeof(cfg.conductivity)) == 0 &&
+                  cfg.version == CONFIG_VERSION &&
+                  memcmp((uint8_t*)&cfg + offsetof(system_config_t, checksum),
+                         (uint8_t*)&deployed + offsetof(system_config_t, checksum),
+                         n - offsetof(system_config_t, checksum)) == 0 &&
+                  tailIsZero(&cfg, n);
+        if (!ok) {
+            if (bad < 3) Serial.printf("  FAIL stored size %u\n", (unsigned)n);
+            bad++;
+        }
+    }
+    Serial.printf("  %d stored sizes (%u..%u bytes), failures %d\n", sizes, (unsigned)first,
+                  (unsigned)sizeof(system_config_t) - 1, bad);
+    ASSERT_TRUE(bad == 0);
+
+    // The size the previous firmware wrote: everything up to the surface settings
+    size_t prev = offsetof(system_config_t, fuzzy_surface_off);
+    memcpy(&cfg, &deployed, prev);
+    config_migrate(&cfg, prev);
+    ASSERT_TRUE(cfg.use_mqtt_telemetry && strcmp(cfg.mqtt_host, "broker.plant.local") == 0);
+    ASSERT_TRUE(cfg.fuzzy_surface_off == 0 && cfg.fuzzy_surface_nodes == 0 && cfg.fuzzy_surface_max_err == 0.0f);
+    Serial.println();
+}
+
+static void testPredatesMqtt() {
+    Serial.println("Test 2: blob older than the MQTT block gets MQTT defaults");
+    static system_config_t deployed, cfg;
+    fillDeployed(&deployed);
+    size_t n = offsetof(system_config_t, mqtt_host);
+    memset(&cfg, 0xFF, sizeof(cfg));
+    memcpy(&cfg, &deployed, n);
+    bool defaults = config_migrate(&cfg, n);
+    ASSERT_TRUE(defaults);
+    ASSERT_TRUE(cfg.mqtt_host[0] == '\0' && cfg.mqtt_user[0] == '\0' && cfg.mqtt_pass[0] == '\0');
+    ASSERT_TRUE(cfg.mqtt_port == MQTT_PORT_DEFAULT && !cfg.use_mqtt_telemetry);
+    ASSERT_TRUE(cfg.log_interval_ms == deployed.log_interval_ms &&
+                memcmp(cfg.wifi_ssid, deployed.wifi_ssid, sizeof(cfg.wifi_ssid)) == 0);
+    ASSERT_TRUE(cfg.sd_log_format == 0 && cfg.tsdb_encoding == 0);
+
+    // Current size: nothing to migrate
+    memcpy(&cfg, &deployed, sizeof(cfg));
+    ASSERT_TRUE(!config_migrate(&cfg, sizeof(cfg)) && memcmp(&cfg, &deployed, sizeof(cfg)) == 0);
+    Serial.println();
+}
+
+void run_config_migrate_tests() {
+    Serial.println("\n========================================");
+    Serial.println("Stored configuration migration tests");
+    Serial.println("========================================");
+
+    testKeepsMqtt();
+    testPredatesMqtt();
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_config_migrate_tests();
+}
+
+void loop() {
+    delay(10000);
+}
@@ -7,6 +7,7 @@
 
 #include <Arduino.h>
 #include "../include/coprocessor_protocol.h"
+#include "../include/cp_clock_sync.h"
 
 static int s_fails = 0;
 #define ASSERT(c) do { if (!(c)) { Serial.printf("FAIL: %s:%d %s\n", __FILE__, __LINE__, #c); s_fails++; } } while(0)
@@ -18,31 +19,36 @@ void test_crc16() {
     uint8_t aa55[] = { 0xAA, 0x55 };
     uint16_t c = cp_crc16(aa55, 2);
     ASSERT(c != 0xFFFF && c != 0);
-    uint8_t frame[26];
+    uint8_t frame[27];
     frame[0] = CP_SYNC_0;
     frame[1] = CP_SYNC_1;
-    frame[2] = 0x01;
-    frame[3] = 20;
-    for (size_t i = 0; i < 20; i++) frame[4 + i] = (uint8_t)i;
-    uint16_t crc = cp_crc16(frame, 4 + 20);
-    frame[24] = (uint8_t)(crc & 0xFF);
-    frame[25] = (uint8_t)(crc >> 8);
-    ASSERT(cp_frame_valid(frame, 26));
+    frame[CP_HDR_ADDR] = CP_ADDR_DEFAULT;
+    frame[CP_HDR_TYPE] = 0x01;
+    frame[CP_HDR_LEN] = 20;
+    for (size_t i = 0; i < 20; i++) frame[CP_HEADER_SIZE + i] = (uint8_t)i;
+    uint16_t crc = cp_crc16(frame, CP_HEADER_SIZE + 20);
+    frame[25] = (uint8_t)(crc & 0xFF);
+    frame[26] = (uint8_t)(crc >> 8);
+    ASSERT(cp_frame_valid(frame, 27));
 }
 
 void test_frame_valid() {
     Serial.println("  frame_valid");
-    uint8_t bad_sync[] = { 0x00, 0x00, CP_TYPE_TELEMETRY, 0, 0xFF, 0xFF };
-    ASSERT(!cp_frame_valid(bad_sync, 6));
+    uint8_t bad_sync[] = { 0x00, 0x00, CP_ADDR_DEFAULT, CP_TYPE_TELEMETRY, 0, 0xFF, 0xFF };
+    ASSERT(!cp_frame_valid(bad_sync, 7));
     uint8_t good[CP_HEADER_SIZE + CP_CRC_SIZE];
     good[0] = CP_SYNC_0;
     good[1] = CP_SYNC_1;
-    good[2] = CP_TYPE_TELEMETRY;
-    good[3] = 0;
-    uint16_t crc = cp_crc16(good, 4);
-    good[4] = (uint8_t)(crc & 0xFF);
-    good[5] = (uint8_t)(crc >> 8);
-    ASSERT(cp_frame_valid(good, 6));
+    good[CP_HDR_ADDR] = CP_ADDR_DEFAULT;
+    good[CP_HDR_TYPE] = CP_TYPE_TELEMETRY;
+    good[CP_HDR_LEN] = 0;
+    uint16_t crc = cp_crc16(good, CP_HEADER_SIZE);
+    good[CP_HEADER_SIZE] = (uint8_t)(crc & 0xFF);
+    good[CP_HEADER_SIZE + 1] = (uint8_t)(crc >> 8);
+    ASSERT(cp_frame_valid(good, sizeof(good)));
+    // Address is covered by the CRC
+    good[CP_HDR_ADDR] = 0x02;
+    ASSERT(!cp_frame_valid(good, sizeof(good)));
 }
 
 void test_telemetry_build_parse() {
@@ -62,17 +68,12 @@ void test_telemetry_build_parse() {
     t.timestamp_ms = 10000;
 
     uint8_t frame[CP_MAX_FRAME];
-    frame[0] = CP_SYNC_0;
-    frame[1] = CP_SYNC_1;
-    frame[2] = CP_TYPE_TELEMETRY;
-    frame[3] = (uint8_t)sizeof(cp_telemetry_payload_t);
-    memcpy(frame + CP_HEADER_SIZE, &t, sizeof(t));
-    uint16_t crc = cp_crc16(frame, CP_HEADER_SIZE + sizeof(t));
-    frame[CP_HEADER_SIZE + sizeof(t)] = (uint8_t)(crc & 0xFF);
-    frame[CP_HEADER_SIZE + sizeof(t) + 1] = (uint8_t)(crc >> 8);
+    size_t flen = cp_frame_build(frame, 0x07, CP_TYPE_TELEMETRY, (const uint8_t*)&t, sizeof(t));
+    ASSERT(flen == CP_HEADER_SIZE + sizeof(t) + CP_CRC_SIZE);
 
     ASSERT(cp_frame_valid(frame, CP_HEADER_SIZE + sizeof(t) + CP_CRC_SIZE));
     ASSERT(cp_frame_type(frame) == CP_TYPE_TELEMETRY);
+    ASSERT(cp_frame_addr(frame) == 0x07);
     ASSERT(cp_frame_payload_len(frame) == sizeof(cp_telemetry_payload_t));
     const cp_telemetry_payload_t* r = (const cp_telemetry_payload_t*)cp_frame_payload(frame);
     ASSERT(r->conductivity_uS_cm == t.conductivity_uS_cm);
@@ -86,18 +87,62 @@ void test_ack_nak_build() {
     a.ack_sequence = 3;
     a.result = 0;
     uint8_t frame[CP_HEADER_SIZE + CP_ACK_NAK_PAYLOAD_SIZE + CP_CRC_SIZE];
-    frame[0] = CP_SYNC_0;
-    frame[1] = CP_SYNC_1;
-    frame[2] = CP_TYPE_ACK;
-    frame[3] = (uint8_t)sizeof(cp_ack_nak_payload_t);
-    memcpy(frame + CP_HEADER_SIZE, &a, sizeof(a));
-    uint16_t crc = cp_crc16(frame, CP_HEADER_SIZE + sizeof(a));
-    frame[CP_HEADER_SIZE + sizeof(a)] = (uint8_t)(crc & 0xFF);
-    frame[CP_HEADER_SIZE + sizeof(a) + 1] = (uint8_t)(crc >> 8);
+    ASSERT(cp_frame_build(frame, CP_ADDR_DEFAULT, CP_TYPE_ACK, (const uint8_t*)&a, sizeof(a)) == sizeof(frame));
     ASSERT(cp_frame_valid(frame, sizeof(frame)));
     ASSERT(cp_frame_type(frame) == CP_TYPE_ACK);
 }
 
+void test_poll_and_broadcast() {
+    Serial.println("  POLL / broadcast framing");
+    uint8_t frame[CP_MAX_FRAME];
+    size_t flen = cp_frame_build(frame, CP_ADDR_MAX, CP_TYPE_POLL, NULL, 0);
+    ASSERT(flen == CP_HEADER_SIZE + CP_CRC_SIZE);
+    ASSERT(cp_frame_valid(frame, flen));
+    ASSERT(cp_frame_type(frame) == CP_TYPE_POLL);
+    ASSERT(cp_frame_addr(frame) == CP_ADDR_MAX);
+
+    cp_time_sync_payload_t ts;
+    ts.unix_time_sec = 1700000000UL;
+    ts.unix_time_subsec_ms = 250;
+    flen = cp_frame_build(frame, CP_ADDR_BROADCAST, CP_TYPE_TIME_SYNC, (const uint8_t*)&ts, sizeof(ts));
+    ASSERT(cp_frame_valid(frame, flen));
+    ASSERT(cp_frame_addr(frame) == CP_ADDR_BROADCAST);
+
+    // Oversized payload is refused
+    ASSERT(cp_frame_build(frame, CP_ADDR_DEFAULT, CP_TYPE_CMD_CONFIG, frame, CP_MAX_PAYLOAD + 1) == 0);
+}
+
+void test_clock_estimator() {
+    Serial.println("  clock offset/skew");
+    CpClockEstimator est;
+    // Panel runs 100 ppm fast, booted 12345 ms after main; arrival adds 0..90 ms jitter.
+    // 5 Hz for 200 s fills the bucketed window.
+    const uint32_t boot_offset = 12345;
+    for (uint32_t i = 0; i < 1000; i++) {
+        uint32_t local_true = 20000 + i * 200;
+        uint32_t panel_ms = (uint32_t)((local_true - boot_offset) * 1.0001);
+        uint32_t arrival = local_true + (i * 37) % 91;
+        ASSERT(est.addSample(panel_ms, arrival));
+    }
+    ASSERT(est.isValid());
+    ASSERT(fabsf(est.getSkewPpm() - 100.0f) < 30.0f);
+    Serial.printf("    skew=%.1f ppm offset=%ld ms\n", est.getSkewPpm(), (long)est.getOffsetMs());
+    uint32_t panel_probe = (uint32_t)((210000 - boot_offset) * 1.0001);
+    int32_t err = (int32_t)(est.toLocal(panel_probe) - 210000);
+    ASSERT(err >= -20 && err <= 20);
+
+    // Drift accumulates only after a sync and scales with elapsed panel time
+    ASSERT(est.getDriftMs() == 0.0f);
+    est.markSynced(220000);
+    ASSERT(est.isSynced());
+    ASSERT(est.getDriftMs() < 5.0f);
+
+    // Panel reboot: millis() goes backwards → model reset, sync cleared
+    ASSERT(!est.addSample(500, 221000));
+    ASSERT(!est.isValid());
+    ASSERT(!est.isSynced());
+}
+
 void setup() {
     Serial.begin(115200);
     delay(2000);
@@ -111,6 +156,10 @@ void setup() {
     test_telemetry_build_parse();
     Serial.println("test_ack_nak_build");
     test_ack_nak_build();
+    Serial.println("test_poll_and_broadcast");
+    test_poll_and_broadcast();
+    Serial.println("test_clock_estimator");
+    test_clock_estimator();
 
     Serial.println(s_fails == 0 ? "All passed." : "Some failed.");
 }
@@ -0,0 +1,235 @@
+/**
+ * @file test_fuzzy_fixed.cpp
+ * @brief Error bound of the fixed-point fuzzy engine (src/fuzzy_fixed.cpp) against the float engine
+ *
+ *   - Membership functions: triangular/trapezoidal from the default variables, Gaussian and
+ *     sigmoid (table exp / logistic) against expf
+ *   - Full inference over random operating points vs the float sampled centroid (same
+ *     algorithm, tight bound) and the default closed-form centroid
+ *   - Determinism: signature over integer-generated inputs; the host, the ESP32 and the
+ *     ESP32-C3 must print the same value for the same tables
+ *
+ * Runs on the ESP32 (env test_fuzzy_fixed), the ESP32-C3 (env test_fuzzy_fixed_c3) or on the host:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/test_fuzzy_fixed.cpp src/fuzzy_fixed.cpp src/fuzzy_logic.cpp \
+ *       test_programs/host/host_main.cpp -o /tmp/test_fuzzy_fixed && /tmp/test_fuzzy_fixed
+ */
+
+#include <Arduino.h>
+#include "fuzzy_logic.h"
+#include "fuzzy_fixed.h"
+
+#define ASSERT_NEAR(a, b, tol) do { \
+    float _a = (a), _b = (b), _t = (tol); \
+    if (fabsf(_a - _b) > _t) { \
+        Serial.printf("FAIL line %d: %.4f not near %.4f (tol %.4f)\n", __LINE__, _a, _b, _t); \
+        failed++; \
+    } else { passed++; } \
+} while(0)
+
+// Bounds (output %, membership fraction)
+#define FIXED_MAX_ERR_SAMPLED   0.1f    // vs float engine with the same sampled centroid
+#define FIXED_MAX_ERR_ANALYTIC  1.1f    // vs default closed-form centroid (sampling error dominates)
+#define FIXED_MAX_ERR_MF        0.001f
+
+static int passed = 0;
+static int failed = 0;
+
+static fuzzy_config_t s_cfg;
+static FuzzyController s_fc;
+static FuzzyFixed s_fx;
+
+// Deterministic LCG so host and device runs see the same operating points
+static uint32_t s_seed = 4242;
+static uint32_t urand() {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return s_seed;
+}
+static float frand(float lo, float hi) {
+    return lo + (hi - lo) * (float)(urand() >> 8) / 16777216.0f;
+}
+
+static uint32_t fnv1a(uint32_t h, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) { h ^= p[i]; h *= 16777619UL; }
+    return h;
+}
+
+static void setupController() {
+    memset(&s_cfg, 0, sizeof(s_cfg));
+    s_cfg.cond_setpoint = 2500;
+    s_cfg.alk_setpoint = 300;
+    s_cfg.sulfite_setpoint = 30;
+    s_cfg.ph_setpoint = 11.0f;
+    s_cfg.cond_deadband = 200;
+    s_cfg.alk_deadband = 50;
+    s_cfg.sulfite_deadband = 5;
+    s_cfg.ph_deadband = 0.3f;
+    s_fc.begin(&s_cfg);
+    s_fx.load(s_fc);
+}
+
+void test_membership() {
+    Serial.println("Test 1: membership functions (tol 0.001)");
+    float worst = 0.0f;
+
+    // Triangular / trapezoidal sets of every input, swept across (and past) the range
+    for (uint8_t v = 0; v < FUZZY_MAX_INPUTS; v++) {
+        const linguistic_var_t& var = s_fc.getInputVar(v);
+        float span = var.max_value - var.min_value;
+        for (int k = -10; k <= 1010; k++) {
+            float x = var.min_value + span * k / 1000.0f;
+            for (uint8_t s = 0; s < var.num_sets; s++) {
+                float f = s_fc.getMembership(v, s, x);
+                float q = s_fx.getMembership(v, s, fuzzy_to_q16(x)) / (float)FUZZY_Q15_ONE;
+                worst = max(worst, fabsf(f - q));
+            }
+        }
+    }
+    Serial.printf("  triangular/trapezoidal worst %.6f\n", worst);
+    ASSERT_NEAR(worst, 0.0f, FIXED_MAX_ERR_MF);
+
+    // Gaussian and sigmoids: patch one set of a table copy, compare against expf
+    static fuzzy_fixed_tables_t t;
+    memcpy(&t, &s_fx.getTables(), sizeof(t));
+    FuzzyFixed probe;
+    const struct { uint8_t type; float c, p; } shapes[] = {
+        { MF_GAUSSIAN, 30.0f, 7.5f },
+        { MF_GAUSSIAN, 55.0f, 0.8f },
+        { MF_SIGMOID_LEFT, 40.0f, 0.25f },
+        { MF_SIGMOID_RIGHT, 60.0f, 1.5f },
+    };
+    for (uint8_t n = 0; n < sizeof(shapes) / sizeof(shapes[0]); n++) {
+        t.inputs[FUZZY_IN_TEMPERATURE].sets[0].type = shapes[n].type;
+        t.inputs[FUZZY_IN_TEMPERATURE].sets[0].params[0] = fuzzy_to_q16(shapes[n].c);
+        t.inputs[FUZZY_IN_TEMPERATURE].sets[0].params[1] = fuzzy_to_q16(shapes[n].p);
+        probe.loadTables(t);
+
+        float w = 0.0f;
+        for (int k = 0; k <= 2000; k++) {
+            float x = k * 0.05f;
+            float f;
+            if (shapes[n].type == MF_GAUSSIAN) {
+                float z = (x - shapes[n].c) / shapes[n].p;
+                f = expf(-0.5f * z * z);
+            } else {
+                float z = shapes[n].p * (x - shapes[n].c);
+                f = 1.0f / (1.0f + expf(shapes[n].type == MF_SIGMOID_LEFT ? z : -z));
+            }
+            float q = probe.getMembership(FUZZY_IN_TEMPERATURE, 0, fuzzy_to_q16(x)) / (float)FUZZY_Q15_ONE;
+            w = max(w, fabsf(f - q));
+        }
+        Serial.printf("  %s c=%.1f p=%.2f worst %.6f\n",
+                      shapes[n].type == MF_GAUSSIAN ? "gaussian" :
+                      shapes[n].type == MF_SIGMOID_LEFT ? "sigmoid-left" : "sigmoid-right",
+                      shapes[n].c, shapes[n].p, w);
+        ASSERT_NEAR(w, 0.0f, FIXED_MAX_ERR_MF);
+    }
+    Serial.println();
+}
+
+void test_inference_error() {
+    Serial.println("Test 2: fixed vs float inference (2000 random points)");
+    const int N = 2000;
+    float worst_sampled = 0.0f, worst_analytic = 0.0f;
+    int rule_mismatch = 0;
+    uint32_t us_float = 0, us_fixed = 0;
+
+    for (int i = 0; i < N; i++) {
+        s_fc.setManualInput(FUZZY_IN_TDS, frand(0, 5000), frand(0, 1) > 0.1f);
+        s_fc.setManualInput(FUZZY_IN_ALKALINITY, frand(0, 1000), frand(0, 1) > 0.1f);
+        s_fc.setManualInput(FUZZY_IN_SULFITE, frand(0, 100), frand(0, 1) > 0.1f);
+        s_fc.setManualInput(FUZZY_IN_PH, frand(7, 14), frand(0, 1) > 0.1f);
+        fuzzy_inputs_t in;
+        memset(&in, 0, sizeof(in));
+        in.temperature = frand(0, 100);
+        in.cond_trend = frand(-100, 100);
+
+        fuzzy_inputs_q_t qin;
+        FuzzyFixed::inputsFromController(s_fc, in, &qin);
+
+        uint32_t t0 = micros();
+        fuzzy_result_q_t rq = s_fx.evaluate(qin);
+        uint32_t t1 = micros();
+        s_fc.setCentroidImpl(FUZZY_CENTROID_SAMPLED);
+        fuzzy_result_t rs = s_fc.evaluate(in);
+        uint32_t t2 = micros();
+        s_fc.setCentroidImpl(FUZZY_CENTROID_ANALYTIC);
+        fuzzy_result_t ra = s_fc.evaluate(in);
+        us_fixed += t1 - t0;
+        us_float += t2 - t1;
+
+        fuzzy_result_t rf = FuzzyFixed::toFloat(rq);
+        const float q[4] = { rf.blowdown_rate, rf.caustic_rate, rf.sulfite_rate, rf.acid_rate };
+        const float s[4] = { rs.blowdown_rate, rs.caustic_rate, rs.sulfite_rate, rs.acid_rate };
+        const float a[4] = { ra.blowdown_rate, ra.caustic_rate, ra.sulfite_rate, ra.acid_rate };
+        for (int o = 0; o < 4; o++) {
+            worst_sampled = max(worst_sampled, fabsf(q[o] - s[o]));
+            worst_analytic = max(worst_analytic, fabsf(q[o] - a[o]));
+        }
+        if (rf.active_rules != rs.active_rules) rule_mismatch++;
+    }
+
+    Serial.printf("  worst |fixed - float sampled| = %.4f %%, |fixed - float analytic| = %.4f %%\n",
+                  worst_sampled, worst_analytic);
+    Serial.printf("  active rule count differs at %d points (firing near the 0.001 cut)\n", rule_mismatch);
+    Serial.printf("  evaluate(): fixed %.2f us, float sampled %.2f us\n\n",
+                  (float)us_fixed / N, (float)us_float / N);
+    ASSERT_NEAR(worst_sampled, 0.0f, FIXED_MAX_ERR_SAMPLED);
+    ASSERT_NEAR(worst_analytic, 0.0f, FIXED_MAX_ERR_ANALYTIC);
+    ASSERT_NEAR((float)rule_mismatch, 0.0f, N / 100.0f);
+}
+
+void test_determinism() {
+    Serial.println("Test 3: determinism signature");
+    // Inputs straight from the integer LCG: no float anywhere between here and the hash
+    s_seed = 99;
+    uint32_t h = 2166136261UL;
+    bool repeat_ok = true;
+    for (int i = 0; i < 1000; i++) {
+        fuzzy_inputs_q_t qin;
+        qin.value[FUZZY_IN_TDS] = (int32_t)(urand() % (5000UL << 16));
+        qin.value[FUZZY_IN_ALKALINITY] = (int32_t)(urand() % (1000UL << 16));
+        qin.value[FUZZY_IN_SULFITE] = (int32_t)(urand() % (100UL << 16));
+        qin.value[FUZZY_IN_PH] = (int32_t)((7UL << 16) + urand() % (7UL << 16));
+        qin.value[FUZZY_IN_TEMPERATURE] = (int32_t)(urand() % (100UL << 16));
+        qin.value[FUZZY_IN_TREND] = (int32_t)(urand() % (200UL << 16)) - (int32_t)(100L << 16);
+        qin.valid_mask = (uint8_t)(urand() >> 24) | 0x30;
+
+        fuzzy_result_q_t a = s_fx.evaluate(qin);
+        fuzzy_result_q_t b = s_fx.evaluate(qin);
+        if (memcmp(&a, &b, sizeof(a)) != 0) repeat_ok = false;
+        h = fnv1a(h, a.rate, sizeof(a.rate));
+        h = fnv1a(h, &a.max_firing_strength, sizeof(a.max_firing_strength));
+        h = fnv1a(h, &a.active_rules, 1);
+        h = fnv1a(h, &a.dominant_rule, 1);
+    }
+    uint32_t ht = fnv1a(2166136261UL, &s_fx.getTables(), sizeof(fuzzy_fixed_tables_t));
+    Serial.printf("  tables 0x%08lX, results 0x%08lX (compare across targets)\n\n",
+                  (unsigned long)ht, (unsigned long)h);
+    if (repeat_ok) passed++; else { Serial.println("FAIL: repeated evaluation differs"); failed++; }
+}
+
+void run_fuzzy_fixed_tests() {
+    Serial.println("\n=== Fixed-Point Fuzzy Engine Tests ===\n");
+    setupController();
+
+    test_membership();
+    test_inference_error();
+    test_determinism();
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_fuzzy_fixed_tests();
+}
+
+void loop() {
+    delay(10000);
+}
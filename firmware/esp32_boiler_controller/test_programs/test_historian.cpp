@@ -0,0 +1,203 @@
+/**
+ * @file test_historian.cpp
+ * @brief In-RAM trend historian (src/historian.cpp) tests
+ *
+ *   - Raw, minute and hour points equal the values / min / avg / max computed
+ *     over the recorded samples (within the channel resolution), 3 days at 1 s
+ *   - Tier selection by range start: raw for the last 10 min, minutes for the
+ *     last day, hours beyond
+ *   - Gaps and NAN samples leave no points; a jump past the retention clears
+ *     the old data; a chunked query (resume) returns the same points as one
+ *   - Memory does not change with the amount recorded; insert and query cost
+ *
+ * Runs on the ESP32 (env test_historian) or on the host:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/test_historian.cpp src/historian.cpp \
+ *       test_programs/host/host_main.cpp -o /tmp/test_historian && /tmp/test_historian
+ */
+
+#include <Arduino.h>
+#include "historian.h"
+
+#define ASSERT_TRUE(x) do { if (x) passed++; else { Serial.printf("FAIL line %d: expected true\n", __LINE__); failed++; } } while(0)
+
+static int passed = 0;
+static int failed = 0;
+
+static uint32_t s_seed = 12345;
+static uint32_t rnd() {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return s_seed >> 8;
+}
+
+// Daily cycle plus noise, so min, max and avg of an interval all differ
+static float signal(uint32_t t, uint8_t ch) {
+    float day = sinf(t * 2.0f * (float)M_PI / 86400.0f);
+    float noise = (float)(rnd() % 1000) / 1000.0f - 0.5f;
+    switch (ch) {
+        case HIST_CH_CONDUCTIVITY: return 2500.0f + 400.0f * day + 40.0f * noise;
+        case HIST_CH_TEMPERATURE:  return 180.0f + 5.0f * day + 2.0f * noise;
+        case HIST_CH_FLOW:         return 12.0f + 6.0f * day + 3.0f * noise;
+        default:                   return 12.0f + 4.0f * day + noise;
+    }
+}
+
+#define DAYS            3
+#define MINUTES         (DAYS * 1440)
+#define START           (300UL * 3600)  // Hour-aligned historian second of the first sample
+
+static Historian h;
+static hist_point_t pts[1600], pts2[1600];
+
+// Conductivity reference: last 10 min of samples, every minute's min/max/sum
+static float ref_raw[HIST_RAW_SLOTS];
+static float ref_min[MINUTES], ref_max[MINUTES], ref_sum[MINUTES];
+
+typedef struct {
+    float min;
+    float avg;
+    float max;
+} ref_t;
+
+static ref_t refRange(uint32_t first_minute, uint32_t minutes) {
+    ref_t r = { INFINITY, 0.0f, -INFINITY };
+    float sum = 0;
+    for (uint32_t m = first_minute; m < first_minute + minutes; m++) {
+        r.min = min(r.min, ref_min[m]);
+        r.max = max(r.max, ref_max[m]);
+        sum += ref_sum[m];
+    }
+    r.avg = sum / (60.0f * minutes);
+    return r;
+}
+
+static float worst(const hist_point_t& p, const ref_t& r) {
+    return max(fabsf(p.min - r.min), max(fabsf(p.avg - r.avg), fabsf(p.max - r.max)));
+}
+
+void run_historian_tests() {
+    Serial.println("\n=== Historian Tests ===\n");
+
+    ASSERT_TRUE(h.begin());
+    size_t mem = h.getMemoryBytes();
+
+    // Test 1: record, keeping the reference
+    Serial.printf("Test 1: %d days of 1 s samples, 4 channels\n", DAYS);
+    uint32_t us_insert = 0;
+    const uint32_t N = DAYS * 86400UL;
+    for (uint32_t i = 0; i < N; i++) {
+        float v[HIST_CHANNELS];
+        for (uint8_t ch = 0; ch < HIST_CHANNELS; ch++) v[ch] = signal(START + i, ch);
+        uint32_t m = i / 60;
+        if (i % 60 == 0) {
+            ref_min[m] = INFINITY;
+            ref_max[m] = -INFINITY;
+            ref_sum[m] = 0;
+        }
+        ref_min[m] = min(ref_min[m], v[0]);
+        ref_max[m] = max(ref_max[m], v[0]);
+        ref_sum[m] += v[0];
+        ref_raw[i % HIST_RAW_SLOTS] = v[0];
+
+        uint32_t t0 = micros();
+        h.record(START + i, v);
+        us_insert += micros() - t0;
+    }
+    const uint32_t now = START + N - 1;
+    Serial.printf("  %u bytes, %.3f us per insert\n\n", (unsigned)h.getMemoryBytes(), (float)us_insert / N);
+    ASSERT_TRUE(h.getMemoryBytes() == mem);
+    ASSERT_TRUE(mem < 64 * 1024);
+
+    // Test 2: each tier against the reference
+    Serial.println("Test 2: raw / minute / hour points vs reference");
+    ASSERT_TRUE(h.resolutionFor(now - 300) == 1);
+    ASSERT_TRUE(h.resolutionFor(now - 3000) == 60);
+    ASSERT_TRUE(h.resolutionFor(now - 2 * 86400) == 3600);
+
+    uint32_t resume;
+    size_t n = h.query(HIST_CH_CONDUCTIVITY, now - 299, now, 1, pts, 1600, &resume);
+    float err_raw = 0;
+    for (size_t k = 0; k < n; k++) {
+        err_raw = max(err_raw, fabsf(pts[k].avg - ref_raw[(pts[k].t - START) % HIST_RAW_SLOTS]));
+    }
+    ASSERT_TRUE(n == 300 && resume == now + 1);
+
+    // Last day of minutes (the newest, still open minute excluded)
+    n = h.query(HIST_CH_CONDUCTIVITY, now - 86340, now - 60, 60, pts, 1600, &resume);
+    float err_min = 0;
+    for (size_t k = 0; k < n; k++) err_min = max(err_min, worst(pts[k], refRange((pts[k].t - START) / 60, 1)));
+    ASSERT_TRUE(n == 1439);
+
+    // Hours of the first two days; also 15-minute points from the minute tier
+    n = h.query(HIST_CH_CONDUCTIVITY, START, START + 2 * 86400 - 1, 3600, pts, 1600, &resume);
+    float err_hour = 0;
+    for (size_t k = 0; k < n; k++) err_hour = max(err_hour, worst(pts[k], refRange((pts[k].t - START) / 60, 60)));
+    ASSERT_TRUE(n == 48);
+    size_t n15 = h.query(HIST_CH_CONDUCTIVITY, now - 86340, now, 900, pts2, 1600, &resume);
+    float err_15 = 0;
+    for (size_t k = 1; k + 1 < n15; k++) err_15 = max(err_15, worst(pts2[k], refRange((pts2[k].t - START) / 60, 15)));
+    Serial.printf("  raw %.2f, minute %.2f, hour %.2f, 15 min %.2f uS/cm worst error (%u, 1439, 48, %u points)\n\n",
+                  err_raw, err_min, err_hour, err_15, 300, (unsigned)n15);
+    ASSERT_TRUE(err_raw <= 0.5f && err_min <= 0.5f && err_hour <= 0.5f);
+    ASSERT_TRUE(err_15 <= 0.5f);         // Unweighted mean of whole minutes: exact here
+
+    // Test 3: chunked query
+    Serial.println("Test 3: query in chunks of 37 points vs one query");
+    size_t full = h.query(HIST_CH_TEMPERATURE, now - 86000, now, 60, pts, 1600, &resume);
+    size_t got = 0;
+    bool same = true;
+    uint32_t from = now - 86000;
+    uint32_t t0 = micros();
+    while (from <= now) {
+        size_t k = h.query(HIST_CH_TEMPERATURE, from, now, 60, pts2, 37, &resume);
+        for (size_t j = 0; j < k; j++, got++) {
+            if (got >= full || memcmp(&pts2[j], &pts[got], sizeof(hist_point_t)) != 0) same = false;
+        }
+        if (resume <= from) break;
+        from = resume;
+    }
+    uint32_t us_query = micros() - t0;
+    Serial.printf("  %u points either way: %s, %u us for the chunked day\n\n",
+                  (unsigned)full, same && got == full ? "identical" : "DIFFERENT", us_query);
+    ASSERT_TRUE(same && got == full);
+
+    // Test 4: gaps, NAN, retention
+    Serial.println("Test 4: gaps, missing samples, jump past retention");
+    static Historian g;
+    g.begin();
+    float v[HIST_CHANNELS] = { 3000.0f, 180.0f, NAN, 12.0f };
+    uint32_t t = START;
+    for (uint32_t i = 0; i < 1800; i++) g.record(t++, v);
+    t += 1200;                                  // 20 min without samples
+    for (uint32_t i = 0; i < 600; i++) g.record(t++, v);
+    n = g.query(HIST_CH_CONDUCTIVITY, START, t, 60, pts, 1600, &resume);
+    uint32_t in_gap = 0;
+    for (size_t k = 0; k < n; k++) {
+        if (pts[k].t >= START + 1800 && pts[k].t < START + 3000) in_gap++;
+    }
+    ASSERT_TRUE(n == 40 && in_gap == 0);
+    ASSERT_TRUE(g.query(HIST_CH_FLOW, START, t, 60, pts, 1600, &resume) == 0);
+    ASSERT_TRUE(!g.record(t - 10, v));          // Older than the open second
+
+    t += 40 * 86400UL;                          // Longer than the hour tier holds
+    for (uint32_t i = 0; i < 120; i++) g.record(t++, v);   // Coarse tiers move on as buckets close
+    ASSERT_TRUE(g.getOldest() > START + 3600);
+    ASSERT_TRUE(g.query(HIST_CH_CONDUCTIVITY, START, START + 4 * 3600, 3600, pts, 1600, &resume) == 0);
+    Serial.printf("  %u minute points around a 20 min gap, none inside; oldest after jump %lu\n\n",
+                  (unsigned)n, (unsigned long)g.getOldest());
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_historian_tests();
+}
+
+void loop() {
+    delay(10000);
+}
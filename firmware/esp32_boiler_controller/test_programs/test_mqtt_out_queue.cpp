@@ -0,0 +1,315 @@
+/**
+ * @file test_mqtt_out_queue.cpp
+ * @brief MQTT outbound queue (src/mqtt_out_queue.cpp) tests
+ *
+ *   - A full queue drops the oldest waiting reading, never alarms, events or
+ *     in-flight messages, and refuses when only those are left
+ *   - At most MQTT_INFLIGHT_MAX messages are unconfirmed; a reconnect burst is
+ *     paced at MQTT_DRAIN_PER_SEC after MQTT_DRAIN_BURST
+ *   - Ack echo and time confirm release in-flight messages in order, across
+ *     the order wrap; resend publishes them again with the same numbering
+ *   - Confirming spool replays returns the spool cursor past the last one
+ *     delivered, never past one still in flight
+ *   - Random push / publish / confirm / disconnect against a reference model:
+ *     every message is delivered in order, only dropped readings are missing,
+ *     repeats only come from resends
+ *
+ * Runs on the ESP32 (env test_mqtt_out_queue) or on the host:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/test_mqtt_out_queue.cpp src/mqtt_out_queue.cpp \
+ *       test_programs/host/host_main.cpp -o /tmp/test_mqtt_out_queue && /tmp/test_mqtt_out_queue
+ */
+
+#include <Arduino.h>
+#include <vector>
+#include "mqtt_out_queue.h"
+
+#define ASSERT_TRUE(x) do { if (x) passed++; else { Serial.printf("FAIL line %d: expected true\n", __LINE__); failed++; } } while(0)
+
+static int passed = 0;
+static int failed = 0;
+
+static uint32_t s_seed = 12345;
+static uint32_t rnd() {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return s_seed >> 8;
+}
+
+static MqttOutQueue s_queue;
+
+static net_msg_t message(uint8_t kind, uint32_t timestamp) {
+    net_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.kind = kind;
+    msg.sink = NET_SINK_MQTT;
+    msg.timestamp = timestamp;
+    return msg;
+}
+
+// Live messages are numbered in push order; spooled ones keep their own numbers
+static bool push(const net_msg_t* msg, uint32_t order, bool drop_reading,
+                 uint32_t spool_next = 0, uint32_t sequence = 0) {
+    mqtt_queued_t item;
+    memset(&item, 0, sizeof(item));
+    item.msg = *msg;
+    item.order = order;
+    item.boot_id = spool_next ? 0xB0071D01UL : 0xB0071D02UL;
+    item.sequence = spool_next ? sequence : order;
+    item.spool_next = spool_next;
+    return s_queue.push(&item, drop_reading);
+}
+
+// Publish everything next() allows at `now`; returns how many
+static int publishAll(uint32_t now, std::vector<uint32_t>* sent = nullptr) {
+    int n = 0;
+    const mqtt_queued_t* q;
+    while ((q = s_queue.next(now)) != nullptr) {
+        if (sent) sent->push_back(q->order);
+        s_queue.markSent(now);
+        n++;
+    }
+    return n;
+}
+
+static void testOverflow() {
+    s_queue.clear();
+    net_msg_t alarm = message(NET_MSG_ALARM, 1);
+    net_msg_t reading = message(NET_MSG_READING, 2);
+    for (uint32_t i = 0; i < MQTT_QUEUE_SLOTS; i++) {
+        ASSERT_TRUE(push(i % 4 == 0 ? &alarm : &reading, i, true));
+    }
+    ASSERT_TRUE(s_queue.isFull());
+    ASSERT_TRUE(!push(&reading, 100, false));       // No dropping: refused
+    ASSERT_TRUE(s_queue.getDropped() == 0);
+
+    // Sequence 0 is an alarm; 1 is the oldest reading
+    ASSERT_TRUE(push(&reading, 100, true));
+    ASSERT_TRUE(s_queue.count() == MQTT_QUEUE_SLOTS && s_queue.getDropped() == 1);
+    std::vector<uint32_t> sent;
+    publishAll(0, &sent);
+    ASSERT_TRUE(sent.size() == MQTT_DRAIN_BURST && sent[0] == 0 && sent[1] == 2);
+
+    // Only alarms left waiting: nothing to drop
+    s_queue.clear();
+    for (uint32_t i = 0; i < MQTT_QUEUE_SLOTS; i++) push(i < 4 ? &reading : &alarm, i, true);
+    publishAll(0);                                          // Readings 0..3 and 6 alarms in flight
+    ASSERT_TRUE(!push(&reading, 100, true));
+    ASSERT_TRUE(s_queue.getDropped() == 0);
+}
+
+static void testWindowAndRate() {
+    s_queue.clear();
+    net_msg_t reading = message(NET_MSG_READING, 1);
+    for (uint32_t i = 0; i < MQTT_QUEUE_SLOTS; i++) push(&reading, i, true);
+
+    // Burst, then MQTT_DRAIN_PER_SEC
+    ASSERT_TRUE(publishAll(0) == MQTT_DRAIN_BURST);
+    ASSERT_TRUE(publishAll(50) == 0);
+    ASSERT_TRUE(publishAll(100) == 1);
+    ASSERT_TRUE(publishAll(1100) == MQTT_INFLIGHT_MAX - MQTT_DRAIN_BURST - 1);  // Window, not rate
+    ASSERT_TRUE(s_queue.inFlight() == MQTT_INFLIGHT_MAX);
+    ASSERT_TRUE(s_queue.next(60000) == nullptr);            // Window full, tokens or not
+    ASSERT_TRUE(s_queue.lastSentOrder() == MQTT_INFLIGHT_MAX - 1);
+
+    // A quiet hour refills only the burst
+    s_queue.confirm(MQTT_INFLIGHT_MAX - 1);
+    ASSERT_TRUE(s_queue.count() == MQTT_QUEUE_SLOTS - MQTT_INFLIGHT_MAX && s_queue.inFlight() == 0);
+    ASSERT_TRUE(publishAll(3600000) == MQTT_DRAIN_BURST);
+
+    // millis() wrap does not stall the bucket
+    s_queue.clear();
+    for (uint32_t i = 0; i < 20; i++) push(&reading, i, true);
+    ASSERT_TRUE(publishAll(0xFFFFFF00UL) == MQTT_DRAIN_BURST);
+    s_queue.confirm(100);
+    ASSERT_TRUE(publishAll((uint32_t)(0xFFFFFF00UL + 300)) == 3);
+}
+
+static void testConfirm() {
+    s_queue.clear();
+    net_msg_t reading = message(NET_MSG_READING, 1);
+    uint32_t base = 0xFFFFFFFAUL;                           // Order wraps inside
+    for (uint32_t i = 0; i < 12; i++) push(&reading, base + i, true);
+    std::vector<uint32_t> sent;
+    publishAll(1000, &sent);
+    ASSERT_TRUE(sent.size() == 10 && sent[6] == 0);
+
+    s_queue.confirm(base + 2);                              // Stale echo of an older publish
+    ASSERT_TRUE(s_queue.inFlight() == 7 && s_queue.count() == 9);
+    s_queue.confirm(base - 5);                              // Older than anything queued
+    ASSERT_TRUE(s_queue.inFlight() == 7);
+    s_queue.confirm(1);                                     // Past the wrap
+    ASSERT_TRUE(s_queue.inFlight() == 2 && s_queue.count() == 4);
+    s_queue.confirm(100);                                   // Unsent messages stay
+    ASSERT_TRUE(s_queue.inFlight() == 0 && s_queue.count() == 2);
+
+    // Without echo: by time since publish
+    publishAll(2000);
+    ASSERT_TRUE(!s_queue.ackOverdue(2000 + MQTT_ACK_TIMEOUT_MS - 1));
+    ASSERT_TRUE(s_queue.ackOverdue(2000 + MQTT_ACK_TIMEOUT_MS));
+    s_queue.confirmBefore(2000 + MQTT_CONFIRM_MS - 1);
+    ASSERT_TRUE(s_queue.count() == 2);
+    s_queue.confirmBefore(2000 + MQTT_CONFIRM_MS);
+    ASSERT_TRUE(s_queue.count() == 0 && !s_queue.ackOverdue(100000));
+}
+
+static void testResend() {
+    s_queue.clear();
+    net_msg_t event = message(NET_MSG_EVENT, 1);
+    for (uint32_t i = 0; i < 6; i++) push(&event, 40 + i, true);
+    publishAll(0);
+    s_queue.confirm(41);
+    ASSERT_TRUE(s_queue.inFlight() == 4);
+    s_queue.resend();                                       // Reconnect
+    ASSERT_TRUE(s_queue.inFlight() == 0 && s_queue.count() == 4 && s_queue.getResent() == 4);
+    std::vector<uint32_t> sent;
+    publishAll(1000, &sent);
+    ASSERT_TRUE(sent.size() == 4 && sent[0] == 42 && sent[3] == 45);
+    ASSERT_TRUE(s_queue.lastSentOrder() == 45);
+}
+
+static void testSpoolCursor() {
+    s_queue.clear();
+    net_msg_t reading = message(NET_MSG_READING, 1);
+    net_msg_t event = message(NET_MSG_EVENT, 1);
+    push(&reading, 10, false);                              // Live, queued before the backlog
+    for (uint32_t i = 0; i < 4; i++) {
+        push(i % 2 ? &event : &reading, 11 + i, false, 501 + i, 90000 + i);   // Spool records 500..503
+    }
+    std::vector<const mqtt_queued_t*> sent;
+    const mqtt_queued_t* q;
+    while ((q = s_queue.next(0)) != nullptr) {
+        sent.push_back(q);
+        s_queue.markSent(0);
+    }
+    ASSERT_TRUE(sent.size() == 5 && sent[1]->sequence == 90000 && sent[1]->boot_id == 0xB0071D01UL);
+    ASSERT_TRUE(s_queue.lastSentOrder() == 14);
+
+    ASSERT_TRUE(s_queue.confirm(10) == 0);                  // Live message only
+    ASSERT_TRUE(s_queue.confirm(12) == 502);                // Records 500 and 501 delivered
+    s_queue.resend();                                       // 502 and 503 go again
+    q = s_queue.next(1000);
+    ASSERT_TRUE(q && q->order == 13 && q->sequence == 90002 && q->spool_next == 503);
+    s_queue.markSent(1000);
+    ASSERT_TRUE(s_queue.confirmBefore(1000 + MQTT_CONFIRM_MS) == 503);
+    ASSERT_TRUE(s_queue.confirm(100) == 0 && s_queue.count() == 1);     // 503 not published again yet
+}
+
+// Broker and link simulated; the queue must deliver every message in order
+static void testRandomAgainstModel() {
+    s_queue.clear();
+    uint32_t now = 0;
+    uint32_t next_seq = 0;
+    std::vector<uint32_t> pushed, delivered;
+    std::vector<uint8_t> kinds;
+    std::vector<uint32_t> link;                             // Published, echo not yet back
+    bool up = true;
+    uint32_t last_delivered = 0;
+    bool any_delivered = false;
+    uint32_t duplicates = 0;
+    int refused = 0;
+
+    for (int step = 0; step < 20000; step++) {
+        now += rnd() % 200;
+        uint32_t op = rnd() % 100;
+        if (op < 30) {
+            uint8_t kind = (rnd() % 5 == 0) ? NET_MSG_ALARM : NET_MSG_READING;
+            net_msg_t msg = message(kind, now);
+            if (push(&msg, next_seq, true)) {
+                pushed.push_back(next_seq);
+                kinds.push_back(kind);
+                next_seq++;
+            } else {
+                refused++;
+            }
+        } else if (op < 70 && up) {
+            const mqtt_queued_t* q;
+            while ((q = s_queue.next(now)) != nullptr) {
+                uint32_t seq = q->order;
+                // Backend side: a sequence not above the last one is a repeat and dropped
+                if (any_delivered && (int32_t)(seq - last_delivered) <= 0) {
+                    duplicates++;
+                } else {
+                    delivered.push_back(seq);
+                    last_delivered = seq;
+                    any_delivered = true;
+                }
+                s_queue.markSent(now);
+                link.push_back(seq);
+            }
+        } else if (op < 90 && up && !link.empty()) {
+            size_t n = 1 + rnd() % link.size();             // Echo of the n-th publish
+            s_queue.confirm(link[n - 1]);
+            link.erase(link.begin(), link.begin() + n);
+        } else if (op < 91 && up) {
+            up = false;                                     // Disconnect: echoes lost
+            link.clear();
+        } else if (!up && rnd() % 100 == 0) {
+            up = true;                                      // Outages long enough to overflow
+            s_queue.resend();
+        }
+    }
+    // Reconnect and drain everything
+    if (!up) s_queue.resend();
+    for (int i = 0; i < 1000 && s_queue.count() > 0; i++) {
+        now += 1000;
+        const mqtt_queued_t* q;
+        while ((q = s_queue.next(now)) != nullptr) {
+            uint32_t seq = q->order;
+            if (!any_delivered || (int32_t)(seq - last_delivered) > 0) {
+                delivered.push_back(seq);
+                last_delivered = seq;
+                any_delivered = true;
+            } else {
+                duplicates++;
+            }
+            s_queue.markSent(now);
+        }
+        s_queue.confirm(last_delivered);
+    }
+
+    // Missing sequences must be dropped readings
+    size_t d = 0;
+    uint32_t missing = 0, missing_alarms = 0;
+    for (size_t i = 0; i < pushed.size(); i++) {
+        if (d < delivered.size() && delivered[d] == pushed[i]) { d++; continue; }
+        missing++;
+        if (kinds[i] != NET_MSG_READING) missing_alarms++;
+    }
+    Serial.printf("  random: %u pushed, %u delivered, %u dropped, %u resent, %u repeats, %d refused\n",
+                  (unsigned)pushed.size(), (unsigned)delivered.size(), (unsigned)s_queue.getDropped(),
+                  (unsigned)s_queue.getResent(), (unsigned)duplicates, refused);
+    ASSERT_TRUE(s_queue.count() == 0);
+    ASSERT_TRUE(d == delivered.size());                     // Nothing delivered out of order
+    ASSERT_TRUE(duplicates <= s_queue.getResent());         // Repeats only from resends
+    // A dropped resend may have reached the broker before the outage
+    ASSERT_TRUE(missing <= s_queue.getDropped() && missing_alarms == 0);
+    ASSERT_TRUE(s_queue.getResent() > 0 && s_queue.getDropped() > 0);
+}
+
+void run_mqtt_out_queue_tests() {
+    Serial.println("\n========================================");
+    Serial.println("MQTT outbound queue tests");
+    Serial.println("========================================");
+
+    testOverflow();
+    testWindowAndRate();
+    testConfirm();
+    testResend();
+    testSpoolCursor();
+    testRandomAgainstModel();
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_mqtt_out_queue_tests();
+}
+
+void loop() {
+    delay(10000);
+}
@@ -0,0 +1,224 @@
+/**
+ * @file test_packed_reading.cpp
+ * @brief Delta-packed reading ring (src/packed_reading.cpp) tests
+ *
+ *   - A reading comes back at SD log resolution (conductivity 1 µS/cm),
+ *     totals and timestamps exact
+ *   - The ring holds PACKED_RING_SLOTS readings in 24-byte slots, 2.5x the
+ *     100 sensor_reading_t the same RAM held; when full the oldest go first
+ *   - Clock set by NTP, meter reset and long gaps (keyframes) decode exactly
+ *   - Random push / peek / drop sequences match a plain queue of readings
+ *
+ * Runs on the ESP32 (env test_packed_reading) or on the host:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/test_packed_reading.cpp src/packed_reading.cpp src/sd_log_record.cpp \
+ *       src/coprocessor_protocol.cpp test_programs/host/host_main.cpp \
+ *       -o /tmp/test_packed_reading && /tmp/test_packed_reading
+ */
+
+#include <Arduino.h>
+#include <deque>
+#include "packed_reading.h"
+
+#define ASSERT_TRUE(x) do { if (x) passed++; else { Serial.printf("FAIL line %d: expected true\n", __LINE__); failed++; } } while(0)
+
+static int passed = 0;
+static int failed = 0;
+
+static uint32_t s_seed = 12345;
+static uint32_t rnd() {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return s_seed >> 8;
+}
+
+static PackedReadingRing ring;
+
+// Plant state, advanced one log interval per reading
+static sensor_reading_t s_state;
+
+static void resetState(uint32_t t0) {
+    memset(&s_state, 0, sizeof(s_state));
+    s_state.timestamp = t0;
+    s_state.conductivity = 2500.0f;
+    s_state.temperature = 180.0f;
+    s_state.water_meter1 = 123456;
+    s_state.water_meter2 = 7890;
+    s_state.fw_pump_cycle_count = 4000;
+    s_state.fw_pump_on_time_sec = 900000;
+    s_state.devices_operational = 11;
+}
+
+static sensor_reading_t nextReading(uint32_t interval_s) {
+    s_state.timestamp += interval_s;
+    s_state.conductivity += (float)((int)(rnd() % 2001) - 1000) / 100.0f;
+    s_state.temperature = 170.0f + (float)(rnd() % 300) / 10.0f;
+    s_state.flow_rate = (float)(rnd() % 5000) / 100.0f;
+    s_state.water_meter1 += rnd() % 20;
+    s_state.water_meter2 += rnd() % 3;
+    s_state.valve_position_mA = 4.0f + (float)(rnd() % 1600) / 100.0f;
+    s_state.blowdown_active = rnd() & 1;
+    s_state.pump1_active = rnd() & 1;
+    s_state.feedwater_pump_on = rnd() & 1;
+    if (s_state.feedwater_pump_on) {
+        s_state.fw_pump_on_time_sec += interval_s;
+        s_state.fw_pump_cycle_count += rnd() % 2;
+    }
+    s_state.active_alarms = (rnd() % 8 == 0) ? (uint16_t)(1 << (rnd() % 16)) : 0;
+    s_state.safe_mode = (rnd() % 16 == 0) ? 2 : 0;
+    s_state.cond_sensor_valid = true;
+    s_state.temp_sensor_valid = rnd() % 10 != 0;
+    s_state.devices_faulted = rnd() % 3;
+    s_state.devices_faulted_mask = s_state.devices_faulted ? 0x0104 : 0;
+    s_state.measurement_age_ms = 200 + rnd() % 800;
+    return s_state;
+}
+
+// What the ring should give back: the SD record's resolution, conductivity
+// rounded to 1 µS/cm
+static sensor_reading_t expected(const sensor_reading_t& r) {
+    sd_log_record_t rec;
+    sensor_reading_t e;
+    sdlog_pack(&r, &rec);
+    sdlog_unpack(&rec, &e);
+    e.conductivity = roundf(r.conductivity);
+    return e;
+}
+
+static bool same(const sensor_reading_t& a, const sensor_reading_t& b) {
+    return a.timestamp == b.timestamp && a.conductivity == b.conductivity &&
+           a.temperature == b.temperature && a.water_meter1 == b.water_meter1 &&
+           a.water_meter2 == b.water_meter2 && a.flow_rate == b.flow_rate &&
+           a.blowdown_active == b.blowdown_active && a.valve_position_mA == b.valve_position_mA &&
+           a.pump1_active == b.pump1_active && a.pump2_active == b.pump2_active &&
+           a.pump3_active == b.pump3_active && a.feedwater_pump_on == b.feedwater_pump_on &&
+           a.fw_pump_cycle_count == b.fw_pump_cycle_count &&
+           a.fw_pump_on_time_sec == b.fw_pump_on_time_sec && a.active_alarms == b.active_alarms &&
+           a.safe_mode == b.safe_mode && a.cond_sensor_valid == b.cond_sensor_valid &&
+           a.temp_sensor_valid == b.temp_sensor_valid &&
+           a.devices_operational == b.devices_operational && a.devices_faulted == b.devices_faulted &&
+           a.devices_faulted_mask == b.devices_faulted_mask &&
+           a.measurement_age_ms == b.measurement_age_ms;
+}
+
+// Ring contents vs the reference queue
+static bool matches(const std::deque<sensor_reading_t>& ref) {
+    static sensor_reading_t out[PACKED_RING_SLOTS];
+    int n = ring.peek(out, PACKED_RING_SLOTS);
+    if (n != (int)ref.size() || n != ring.count()) return false;
+    for (int i = 0; i < n; i++) {
+        if (!same(out[i], ref[i])) return false;
+    }
+    return true;
+}
+
+void run_packed_reading_tests() {
+    Serial.println("\n=== Packed Reading Ring Tests ===\n");
+
+    // Test 1: one reading round trip
+    Serial.println("Test 1: round trip at SD log resolution");
+    Serial.printf("  packed_reading_t %u bytes, sensor_reading_t %u bytes\n\n",
+                  (unsigned)sizeof(packed_reading_t), (unsigned)sizeof(sensor_reading_t));
+    ASSERT_TRUE(sizeof(packed_reading_t) == PACKED_READING_SIZE);
+    ASSERT_TRUE(sizeof(ring) <= 100 * sizeof(sensor_reading_t) + 64);
+    resetState(1700000000);
+    sensor_reading_t r = nextReading(10), back;
+    ring.push(&r);
+    ASSERT_TRUE(ring.count() == 1 && ring.peek(&back, 1) == 1);
+    ASSERT_TRUE(same(back, expected(r)));
+    ASSERT_TRUE(back.water_meter1 == r.water_meter1 && back.fw_pump_on_time_sec == r.fw_pump_on_time_sec);
+    ASSERT_TRUE(fabsf(back.conductivity - r.conductivity) <= 0.5f);
+    ring.drop(1);
+    ASSERT_TRUE(ring.count() == 0 && ring.slotsUsed() == 0);
+
+    // Test 2: capacity and overwrite order
+    Serial.println("Test 2: full ring keeps the newest PACKED_RING_SLOTS readings");
+    ring.clear();
+    std::deque<sensor_reading_t> ref;
+    for (int i = 0; i < PACKED_RING_SLOTS + 37; i++) {
+        r = nextReading(10);
+        ring.push(&r);
+        ref.push_back(expected(r));
+        if ((int)ref.size() > PACKED_RING_SLOTS) ref.pop_front();
+    }
+    Serial.printf("  %d readings held, %lu dropped\n\n", ring.count(), (unsigned long)ring.getDropped());
+    ASSERT_TRUE(ring.count() == PACKED_RING_SLOTS && ring.getDropped() == 37);
+    ASSERT_TRUE(matches(ref));
+
+    // Test 3: deltas that do not fit
+    Serial.println("Test 3: NTP clock step, meter reset, long gap, cycle burst");
+    ring.clear();
+    ref.clear();
+    resetState(35);                                     // Uptime before NTP
+    for (int i = 0; i < 5; i++) { r = nextReading(10); ring.push(&r); ref.push_back(expected(r)); }
+    s_state.timestamp = 1700000000;                     // NTP sync
+    for (int i = 0; i < 5; i++) { r = nextReading(10); ring.push(&r); ref.push_back(expected(r)); }
+    s_state.water_meter1 = 0;                           // Meter total reset
+    for (int i = 0; i < 5; i++) { r = nextReading(10); ring.push(&r); ref.push_back(expected(r)); }
+    r = nextReading(86400);                             // A day without logging
+    ring.push(&r);
+    ref.push_back(expected(r));
+    s_state.fw_pump_cycle_count += 40;                  // More cycles than 5 bits
+    s_state.water_meter2 += 70000;
+    for (int i = 0; i < 5; i++) { r = nextReading(10); ring.push(&r); ref.push_back(expected(r)); }
+    s_state.timestamp -= 3600;                          // Clock set back
+    for (int i = 0; i < 5; i++) { r = nextReading(10); ring.push(&r); ref.push_back(expected(r)); }
+    Serial.printf("  %d readings in %d slots\n\n", ring.count(), ring.slotsUsed());
+    ASSERT_TRUE(matches(ref));
+    ASSERT_TRUE(ring.slotsUsed() == ring.count() + 5);  // One keyframe per step
+
+    // Dropping through keyframes keeps the rest exact
+    for (int i = 0; i < 12; i++) {
+        ring.drop(1);
+        ref.pop_front();
+        if (!matches(ref)) { ASSERT_TRUE(false); break; }
+    }
+    ASSERT_TRUE(ring.slotsUsed() == ring.count() + 3);
+
+    // Test 4: random use against a plain queue
+    Serial.println("Test 4: 20000 random push / peek / drop operations");
+    ring.clear();
+    ref.clear();
+    resetState(1700000000);
+    int wrong = 0;
+    uint32_t dropped = 0;
+    sensor_reading_t out[32];
+    for (int op = 0; op < 20000; op++) {
+        bool online = (op / 1500) % 2;                              // Outages fill the ring
+        uint32_t k = rnd() % 10;
+        if (k < 6) {
+            uint32_t interval = (rnd() % 50 == 0) ? 100000 : 10;    // Some keyframes
+            if (rnd() % 200 == 0) s_state.water_meter2 = 0;
+            r = nextReading(interval);
+            ring.push(&r);
+            ref.push_back(expected(r));
+            while ((int)ref.size() > ring.count()) { ref.pop_front(); dropped++; }
+        } else if (k < 9 && online) {
+            int want = 1 + rnd() % 32;
+            int n = ring.peek(out, want);
+            if (n != min(want, (int)ref.size())) wrong++;
+            for (int i = 0; i < n; i++) if (!same(out[i], ref[i])) wrong++;
+            int sent = n ? (int)(rnd() % (n + 1)) : 0;              // Partial upload
+            ring.drop(sent);
+            for (int i = 0; i < sent; i++) ref.pop_front();
+        }
+        if (op % 1000 == 0 && !matches(ref)) wrong++;
+    }
+    Serial.printf("  %d wrong, %d held, %lu overwritten\n\n", wrong, ring.count(), (unsigned long)dropped);
+    ASSERT_TRUE(wrong == 0 && matches(ref));
+    ASSERT_TRUE(ring.getDropped() == dropped);
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_packed_reading_tests();
+}
+
+void loop() {
+    delay(10000);
+}
@@ -0,0 +1,182 @@
+/**
+ * @file test_plant_id.cpp
+ * @brief RLS plant identification (src/plant_id.cpp) on a simulated boiler
+ *
+ * Simulated 16 gal boiler, 250 µS/cm feedwater, 2 gpm blowdown valve on
+ * hysteresis around 2500 µS/cm, 1 gal/pulse makeup meter, 30 s sensor
+ * transport delay, ±2 µS/cm noise. Simulated in 1 s steps (no real time).
+ *
+ *   - Convergence: makeup gain, blowdown rate and dead time after 12 h
+ *     (meter pulses are turned into a flow before fitting)
+ *   - Tracking: blowdown flow drops to 1.5 gpm; rate follows within the forgetting window
+ *   - No excitation: valve held closed for 8 h; estimates stay finite and do not wind up
+ *   - Tuning suggestions and CPU per sample
+ *
+ * Runs on the ESP32 (env test_plant_id) or on the host:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/test_plant_id.cpp src/plant_id.cpp \
+ *       test_programs/host/host_main.cpp -o /tmp/test_plant_id && /tmp/test_plant_id
+ */
+
+#include <Arduino.h>
+#include "plant_id.h"
+
+#define ASSERT_NEAR(a, b, tol) do { \
+    float _a = (a), _b = (b), _t = (tol); \
+    if (fabsf(_a - _b) > _t) { \
+        Serial.printf("FAIL line %d: %.5f not near %.5f (tol %.5f)\n", __LINE__, _a, _b, _t); \
+        failed++; \
+    } else { passed++; } \
+} while(0)
+
+#define ASSERT_TRUE(x) do { if (x) passed++; else { Serial.printf("FAIL line %d: expected true\n", __LINE__); failed++; } } while(0)
+
+#define SIM_VOLUME_GAL      16.0f
+#define SIM_FEED_US         250.0f
+#define SIM_DELAY_SEC       30
+
+static int passed = 0;
+static int failed = 0;
+
+static uint32_t s_seed = 77;
+static float frand(float lo, float hi) {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return lo + (hi - lo) * (float)(s_seed >> 8) / 16777216.0f;
+}
+
+// Plant state carried across test phases
+static float s_cond = 2500.0f;
+static float s_delay_line[SIM_DELAY_SEC];
+static uint32_t s_t = 0;
+static bool s_valve = false;
+static float s_meter_acc = 0.0f;
+static blowdown_config_t s_bd;
+static conductivity_config_t s_cc;
+
+/**
+ * @brief Advance the plant and the identifier
+ * @param valve_gpm Blowdown flow with the valve open
+ * @param allow_blowdown false holds the valve closed
+ */
+static void simulate(PlantIdentifier& id, uint32_t seconds, float valve_gpm, bool allow_blowdown) {
+    for (uint32_t n = 0; n < seconds; n++, s_t++) {
+        float hours = s_t / 3600.0f;
+        float makeup_gpm = 0.5f * (1.0f + 0.4f * sinf(2.0f * (float)M_PI * hours / 24.0f));
+
+        // Sensor reads the conductivity from SIM_DELAY_SEC ago
+        float measured = s_delay_line[s_t % SIM_DELAY_SEC] + frand(-2.0f, 2.0f);
+        s_delay_line[s_t % SIM_DELAY_SEC] = s_cond;
+
+        // Controller acts on the measurement
+        if (!allow_blowdown) s_valve = false;
+        else if (measured > s_bd.setpoint + s_bd.deadband) s_valve = true;
+        else if (measured < s_bd.setpoint - s_bd.deadband) s_valve = false;
+
+        // Makeup through a 1 gal/pulse contact meter
+        float makeup = makeup_gpm / 60.0f;
+        s_meter_acc += makeup;
+        float pulses = 0.0f;
+        if (s_meter_acc >= 1.0f) { pulses = 1.0f; s_meter_acc -= 1.0f; }
+
+        id.update(s_t * 1000UL, measured, s_valve, pulses);
+
+        float qbd = s_valve ? valve_gpm : 0.0f;
+        s_cond += (makeup * SIM_FEED_US - qbd / 60.0f * s_cond) / SIM_VOLUME_GAL;
+    }
+}
+
+void run_plant_id_tests() {
+    Serial.println("\n=== Plant Identification (RLS) Tests ===\n");
+
+    memset(&s_bd, 0, sizeof(s_bd));
+    s_bd.setpoint = 2500;
+    s_bd.deadband = 100;
+    s_bd.ball_valve_delay = 20;
+    memset(&s_cc, 0, sizeof(s_cc));
+    s_cc.max_prop_time_seconds = 300;
+    for (int i = 0; i < SIM_DELAY_SEC; i++) s_delay_line[i] = s_cond;
+
+    static PlantIdentifier id;
+    id.begin(&s_bd, &s_cc);
+
+    const float km_true = SIM_FEED_US / SIM_VOLUME_GAL;
+    const float kb_true = 2.0f / 60.0f / SIM_VOLUME_GAL;
+
+    // Test 1: convergence
+    Serial.println("Test 1: convergence after 12 h");
+    simulate(id, 1800, 2.0f, true);
+    ASSERT_TRUE(!id.getParams().valid);     // Not published before PLANT_ID_MIN_SAMPLES
+    simulate(id, 12 * 3600 - 1800, 2.0f, true);
+    plant_id_params_t p = id.getParams();
+    Serial.printf("  Km %.2f (true %.2f) µS/cm/gal, Kb %.6f (true %.6f) 1/s, tau %.0f s, dead time %.0f s, rms %.2f\n",
+                  p.makeup_gain, km_true, p.blowdown_rate, kb_true, p.tau_blowdown_sec, p.dead_time_sec, p.rms_error);
+    Serial.printf("  %lu samples, %lu with the valve open\n\n",
+                  (unsigned long)p.samples, (unsigned long)p.blowdown_samples);
+    ASSERT_TRUE(p.valid);
+    ASSERT_NEAR(p.makeup_gain, km_true, 0.1f * km_true);
+    ASSERT_NEAR(p.blowdown_rate, kb_true, 0.1f * kb_true);
+    ASSERT_NEAR(p.dead_time_sec, SIM_DELAY_SEC, PLANT_ID_SAMPLE_SEC);
+
+    // Test 2: tracking a change of the blowdown flow
+    Serial.println("Test 2: blowdown flow 2.0 -> 1.5 gpm, 8 h");
+    simulate(id, 8 * 3600, 1.5f, true);
+    p = id.getParams();
+    float kb_new = 1.5f / 60.0f / SIM_VOLUME_GAL;
+    Serial.printf("  Kb %.6f (true %.6f)\n\n", p.blowdown_rate, kb_new);
+    ASSERT_NEAR(p.blowdown_rate, kb_new, 0.1f * kb_new);
+
+    // Test 3: no blowdown for 8 h (conductivity drifts up; nothing to learn Kb from)
+    Serial.println("Test 3: valve held closed for 8 h");
+    simulate(id, 8 * 3600, 1.5f, false);
+    p = id.getParams();
+    float theta[PLANT_ID_PARAMS];
+    for (uint8_t d = 0; d < PLANT_ID_MAX_DELAY; d++) {
+        float err;
+        id.getCandidate(d, theta, &err);
+        ASSERT_TRUE(isfinite(theta[0]) && isfinite(theta[1]) && isfinite(err));
+    }
+    Serial.printf("  Kb %.6f (true %.6f), Km %.2f\n", p.blowdown_rate, kb_new, p.makeup_gain);
+    ASSERT_NEAR(p.blowdown_rate, kb_new, 0.15f * kb_new);
+    ASSERT_NEAR(p.makeup_gain, km_true, 0.1f * km_true);
+
+    // Blowdown resumes; estimate still consistent
+    simulate(id, 4 * 3600, 1.5f, true);
+    p = id.getParams();
+    Serial.printf("  after 4 h of blowdown again: Kb %.6f\n\n", p.blowdown_rate);
+    ASSERT_NEAR(p.blowdown_rate, kb_new, 0.1f * kb_new);
+
+    // Test 4: tuning suggestions and cost
+    Serial.println("Test 4: tuning suggestions, CPU per sample");
+    float lag = p.dead_time_sec + s_bd.ball_valve_delay;
+    Serial.printf("  deadband %.0f µS/cm (lag %.0f s), Mode P prop band %.0f µS/cm\n",
+                  p.suggested_deadband, lag, p.suggested_prop_band);
+    ASSERT_NEAR(p.suggested_deadband, constrain(s_bd.setpoint * kb_new * lag,
+                (float)BLOW_DEADBAND_MIN, (float)BLOW_DEADBAND_MAX), 0.15f * p.suggested_deadband);
+    ASSERT_NEAR(p.suggested_prop_band, PLANT_ID_PROP_MARGIN * s_bd.setpoint * kb_new * 300.0f,
+                0.15f * p.suggested_prop_band);
+
+    const int N = 2000;
+    uint32_t t0 = micros();
+    for (int i = 0; i < N; i++) {
+        // Each call lands on a sample boundary: one full update of all candidates
+        id.update((s_t + (uint32_t)(i + 1) * PLANT_ID_SAMPLE_SEC) * 1000UL, s_cond, (i & 7) == 0, 0.1f);
+    }
+    uint32_t us = micros() - t0;
+    Serial.printf("  %.2f us per sample (%d dead-time candidates), state %u bytes\n\n",
+                  (float)us / N, PLANT_ID_MAX_DELAY, (unsigned)sizeof(PlantIdentifier));
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_plant_id_tests();
+}
+
+void loop() {
+    delay(10000);
+}
@@ -0,0 +1,203 @@
+/**
+ * @file test_reading_codec.cpp
+ * @brief Reading block compression (src/reading_codec.cpp) tests
+ *
+ *   - Four hours of 10 s readings round-trip to identical SD log records (CRC
+ *     included) at a fraction of the 44-byte binary record
+ *   - Clock steps, counter resets and wraps, NaN conductivity and random
+ *     full-range records round-trip exactly
+ *   - A full buffer refuses the reading and leaves a valid block
+ *   - Truncated or foreign blocks are rejected without reading past the end
+ *
+ * Runs on the ESP32 (env test_reading_codec) or on the host:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/test_reading_codec.cpp src/reading_codec.cpp src/sd_log_record.cpp \
+ *       src/coprocessor_protocol.cpp test_programs/host/host_main.cpp \
+ *       -o /tmp/test_reading_codec && /tmp/test_reading_codec
+ */
+
+#include <Arduino.h>
+#include "reading_codec.h"
+#include "coprocessor_protocol.h"
+
+#define ASSERT_TRUE(x) do { if (x) passed++; else { Serial.printf("FAIL line %d: expected true\n", __LINE__); failed++; } } while(0)
+
+static int passed = 0;
+static int failed = 0;
+
+static uint32_t s_seed = 12345;
+static uint32_t rnd() {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return s_seed >> 8;
+}
+
+#define SPAN_READINGS   1440                    // 4 h at 10 s
+
+static sd_log_record_t s_recs[SPAN_READINGS];
+static uint8_t s_block[SPAN_READINGS * 12];
+
+// Plant state, advanced one log interval per reading
+static sensor_reading_t s_state;
+
+static void resetState(uint32_t t0) {
+    memset(&s_state, 0, sizeof(s_state));
+    s_state.timestamp = t0;
+    s_state.conductivity = 2500.0f;
+    s_state.temperature = 180.0f;
+    s_state.water_meter1 = 123456;
+    s_state.water_meter2 = 7890;
+    s_state.fw_pump_cycle_count = 4000;
+    s_state.fw_pump_on_time_sec = 900000;
+    s_state.cond_sensor_valid = true;
+    s_state.temp_sensor_valid = true;
+    s_state.devices_operational = 11;
+}
+
+// A steady plant: slow drifts, occasional pump and blowdown switching
+static sd_log_record_t nextRecord(uint32_t interval_s) {
+    s_state.timestamp += interval_s;
+    s_state.conductivity += (float)((int)(rnd() % 21) - 10) / 10.0f;
+    s_state.temperature += (float)((int)(rnd() % 3) - 1) / 10.0f;
+    s_state.flow_rate = 12.0f + (float)(rnd() % 20) / 100.0f;
+    s_state.water_meter1 += rnd() % 3;
+    if (rnd() % 30 == 0) s_state.water_meter2++;
+    if (rnd() % 60 == 0) s_state.blowdown_active = !s_state.blowdown_active;
+    s_state.valve_position_mA = s_state.blowdown_active ? 20.0f : 4.0f;
+    if (rnd() % 40 == 0) {
+        s_state.feedwater_pump_on = !s_state.feedwater_pump_on;
+        if (s_state.feedwater_pump_on) s_state.fw_pump_cycle_count++;
+    }
+    if (s_state.feedwater_pump_on) s_state.fw_pump_on_time_sec += interval_s;
+    s_state.measurement_age_ms = 200 + rnd() % 10;
+    sd_log_record_t rec;
+    sdlog_pack(&s_state, &rec);
+    return rec;
+}
+
+// Encode n records in one block and decode them back; bytes written to *size
+static bool roundTrip(const sd_log_record_t* recs, int n, size_t* size) {
+    ReadingEncoder enc;
+    enc.begin(s_block, sizeof(s_block));
+    for (int i = 0; i < n; i++) {
+        if (!enc.append(&recs[i])) return false;
+    }
+    *size = enc.finish();
+
+    ReadingDecoder dec;
+    if (!dec.begin(s_block, *size) || dec.count() != n) return false;
+    sd_log_record_t out;
+    for (int i = 0; i < n; i++) {
+        if (!dec.next(&out) || memcmp(&out, &recs[i], sizeof(out)) != 0) return false;
+    }
+    return !dec.next(&out);
+}
+
+void run_reading_codec_tests() {
+    Serial.println("\n=== Reading Codec Tests ===\n");
+    size_t size = 0;
+
+    // Test 1: hours of steady readings
+    Serial.println("Test 1: four hours of 10 s readings");
+    resetState(1700000000);
+    for (int i = 0; i < SPAN_READINGS; i++) s_recs[i] = nextRecord(10);
+    ASSERT_TRUE(roundTrip(s_recs, SPAN_READINGS, &size));
+    Serial.printf("  %d readings: %lu bytes binary, %lu compressed (%.2f bytes/reading, %.1fx)\n\n",
+                  SPAN_READINGS, (unsigned long)SPAN_READINGS * SD_BIN_RECORD_SIZE, (unsigned long)size,
+                  (double)size / SPAN_READINGS, (double)SPAN_READINGS * SD_BIN_RECORD_SIZE / size);
+    ASSERT_TRUE(size < (size_t)SPAN_READINGS * 8);            // > 5x
+
+    // Small blocks (one HTTP batch) still compress
+    ASSERT_TRUE(roundTrip(s_recs, 20, &size));
+    Serial.printf("  20-reading block: %lu bytes\n\n", (unsigned long)size);
+    ASSERT_TRUE(size < 20 * 12);
+
+    // Test 2: values that do not follow the trend
+    Serial.println("Test 2: clock steps, counter resets and wraps, NaN, random records");
+    int n = 0;
+    resetState(35);                                         // Uptime before NTP
+    for (int i = 0; i < 5; i++) s_recs[n++] = nextRecord(10);
+    s_state.timestamp = 1700000000;                         // NTP sync
+    for (int i = 0; i < 5; i++) s_recs[n++] = nextRecord(10);
+    s_state.timestamp -= 3600;                              // Clock set back
+    for (int i = 0; i < 5; i++) s_recs[n++] = nextRecord(1);
+    s_recs[n++] = nextRecord(86400);                        // A day without logging
+    s_state.water_meter1 = 0;                               // Meter total reset
+    s_state.water_meter2 = UINT32_MAX - 1;                  // About to wrap
+    for (int i = 0; i < 60; i++) s_recs[n++] = nextRecord(10);
+    s_state.conductivity = NAN;                             // Sensor fault
+    s_state.cond_sensor_valid = false;
+    s_state.active_alarms = 0x0041;
+    s_state.safe_mode = 2;
+    s_state.devices_faulted = 1;
+    s_state.devices_faulted_mask = 0x0100;
+    for (int i = 0; i < 5; i++) s_recs[n++] = nextRecord(10);
+    for (int i = 0; i < 200; i++) {                         // Anything a record can hold
+        sd_log_record_t rec;
+        uint8_t* p = (uint8_t*)&rec;
+        for (size_t k = 0; k < sizeof(rec); k++) p[k] = (uint8_t)rnd();
+        rec.crc = cp_crc16(p, offsetof(sd_log_record_t, crc));
+        s_recs[n++] = rec;
+    }
+    ASSERT_TRUE(roundTrip(s_recs, n, &size));
+    Serial.printf("  %d readings, %lu bytes\n\n", n, (unsigned long)size);
+
+    // Test 3: buffer full
+    Serial.println("Test 3: a full buffer refuses the reading, the block stays valid");
+    resetState(1700000000);
+    for (int i = 0; i < 100; i++) s_recs[i] = nextRecord(10);
+    ReadingEncoder enc;
+    enc.begin(s_block, 64);
+    int fitted = 0;
+    while (fitted < 100 && enc.append(&s_recs[fitted])) fitted++;
+    ASSERT_TRUE(fitted > 5 && fitted < 100 && enc.count() == fitted);
+    ASSERT_TRUE(!enc.append(&s_recs[fitted]));              // Still refused
+    size = enc.finish();
+    ASSERT_TRUE(size <= 64);
+    ReadingDecoder dec;
+    sd_log_record_t out;
+    int got = 0;
+    bool same = dec.begin(s_block, size);
+    while (dec.next(&out)) same = same && memcmp(&out, &s_recs[got++], sizeof(out)) == 0;
+    Serial.printf("  %d readings in 64 bytes\n\n", fitted);
+    ASSERT_TRUE(same && got == fitted);
+
+    // The refused reading starts the next block
+    enc.begin(s_block, sizeof(s_block));
+    ASSERT_TRUE(enc.append(&s_recs[fitted]));
+
+    // Test 4: damaged blocks
+    Serial.println("Test 4: truncated and foreign blocks");
+    ASSERT_TRUE(roundTrip(s_recs, 100, &size));
+    got = 0;
+    ASSERT_TRUE(dec.begin(s_block, size / 2));
+    while (dec.next(&out)) got++;
+    ASSERT_TRUE(got < 100);
+    ASSERT_TRUE(!dec.begin(s_block, 2));
+    s_block[0] = RCODEC_VERSION + 1;
+    ASSERT_TRUE(!dec.begin(s_block, size));
+    int garbage_ok = 0;
+    for (int i = 0; i < 100; i++) {                         // Random bytes never crash
+        for (int k = 0; k < 256; k++) s_block[k] = (uint8_t)rnd();
+        s_block[0] = RCODEC_VERSION;
+        if (dec.begin(s_block, 256)) {
+            while (dec.next(&out)) {}
+            garbage_ok++;
+        }
+    }
+    ASSERT_TRUE(garbage_ok == 100);
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_reading_codec_tests();
+}
+
+void loop() {
+    delay(10000);
+}
@@ -0,0 +1,331 @@
+/**
+ * @file test_sd_history.cpp
+ * @brief SD log time-range reader (src/sd_history.cpp) tests
+ *
+ *   - CSV rows parse back to the record they were formatted from
+ *   - Over days of CSV logs, binary logs with index, and a day switched from
+ *     CSV to binary: the output of [from, to] equals the rows selected by a
+ *     full scan, for many random ranges, fields and steps
+ *   - Output is the same whatever size the caller reads in (1 byte or 4 KB)
+ *   - Card reads are at most SD_HIST_BLOCK bytes each, and a short range in a
+ *     long file needs only a few of them (index search / bisection)
+ *   - Torn binary records are skipped; unknown field names are rejected
+ *   - A binary day written by a later version (longer records) reads the same
+ *
+ * Files live in memory behind SDHistorySource. Runs on the ESP32 (env
+ * test_sd_history) or on the host:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/test_sd_history.cpp src/sd_history.cpp src/sd_log_record.cpp \
+ *       src/coprocessor_protocol.cpp test_programs/host/host_main.cpp \
+ *       -o /tmp/test_sd_history && /tmp/test_sd_history
+ */
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "sd_history.h"
+
+#define ASSERT_TRUE(x) do { if (x) passed++; else { Serial.printf("FAIL line %d: expected true\n", __LINE__); failed++; } } while(0)
+
+static int passed = 0;
+static int failed = 0;
+
+static uint32_t s_seed = 12345;
+static uint32_t rnd() {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return s_seed >> 8;
+}
+
+// ============================================================================
+// IN-MEMORY CARD
+// ============================================================================
+
+class MemSource : public SDHistorySource {
+public:
+    std::map<std::string, std::vector<uint8_t>> files;
+    const std::vector<uint8_t>* cur = nullptr;
+    uint32_t reads = 0;
+    size_t largest = 0;
+    int opens = 0;
+
+    bool open(const char* path) override {
+        auto it = files.find(path);
+        cur = it == files.end() ? nullptr : &it->second;
+        if (cur) opens++;
+        return cur != nullptr;
+    }
+    int32_t read(uint32_t offset, uint8_t* buf, size_t len) override {
+        if (!cur) return -1;
+        reads++;
+        largest = max(largest, len);
+        if (offset >= cur->size()) return 0;
+        size_t n = min(len, cur->size() - offset);
+        memcpy(buf, cur->data() + offset, n);
+        return (int32_t)n;
+    }
+    uint32_t size() override { return cur ? (uint32_t)cur->size() : 0; }
+    void close() override {
+        if (cur) opens--;
+        cur = nullptr;
+    }
+};
+
+static MemSource card;
+static std::vector<sd_log_record_t> all;        // Every valid reading, in time order
+
+static sd_log_record_t makeRecord(uint32_t ts) {
+    sensor_reading_t r;
+    memset(&r, 0, sizeof(r));
+    r.timestamp = ts;
+    r.conductivity = 2000.0f + (float)(rnd() % 10000) / 10.0f;
+    r.temperature = 170.0f + (float)(rnd() % 300) / 10.0f;
+    r.water_meter1 = ts / 7;
+    r.water_meter2 = ts / 11;
+    r.flow_rate = (float)(rnd() % 2000) / 100.0f;
+    r.blowdown_active = rnd() & 1;
+    r.valve_position_mA = 4.0f + (float)(rnd() % 160) / 10.0f;
+    r.pump1_active = rnd() & 1;
+    r.fw_pump_cycle_count = ts / 600;
+    r.fw_pump_on_time_sec = ts / 60;
+    r.active_alarms = rnd() & 0x0FFF;
+    r.cond_sensor_valid = true;
+    r.temp_sensor_valid = rnd() & 1;
+    r.devices_operational = 5;
+    r.devices_faulted_mask = rnd() & 0x3;
+    r.measurement_age_ms = rnd() % 500;
+    sd_log_record_t rec;
+    sdlog_pack(&r, &rec);
+    return rec;
+}
+
+static void appendCsv(std::vector<uint8_t>& f, const sd_log_record_t& rec) {
+    char line[SD_CSV_MAX_LINE];
+    int n = sdlog_format_csv(&rec, line, sizeof(line));
+    f.insert(f.end(), line, line + n);
+    f.push_back('\n');
+}
+
+static void appendBin(std::vector<uint8_t>& bin, std::vector<uint8_t>& idx, uint32_t& count,
+                      const sd_log_record_t& rec) {
+    if (count % SD_BIN_INDEX_INTERVAL == 0) {
+        sd_log_index_entry_t e = { rec.timestamp, count };
+        idx.insert(idx.end(), (const uint8_t*)&e, (const uint8_t*)&e + sizeof(e));
+    }
+    bin.insert(bin.end(), (const uint8_t*)&rec, (const uint8_t*)&rec + sizeof(rec));
+    count++;
+}
+
+#define DAYS            6
+#define DAY0            1700006400UL    // 2023-11-15 00:00 UTC
+#define INTERVAL        10              // Seconds between readings
+
+// Days 0, 1: CSV; 2: CSV then binary from noon; 3: missing; 4, 5: binary (torn record on 4)
+static void buildCard() {
+    for (uint32_t d = 0; d < DAYS; d++) {
+        if (d == 3) continue;
+        char date[12], path[40];
+        sdhist_date(DAY0 + d * 86400 + 43200, date, sizeof(date));
+        std::vector<uint8_t> csv, bin, idx;
+        uint32_t count = 0;
+        sd_log_file_header_t hdr;
+        sdlog_init_header(&hdr);
+        bin.insert(bin.end(), (const uint8_t*)&hdr, (const uint8_t*)&hdr + sizeof(hdr));
+        const char* header = SD_CSV_HEADER "\n";
+        csv.insert(csv.end(), header, header + strlen(header));
+
+        for (uint32_t t = 0; t < 86400; t += INTERVAL) {
+            uint32_t ts = DAY0 + d * 86400 + t + (rnd() % 3);     // Jitter, still increasing
+            sd_log_record_t rec = makeRecord(ts);
+            bool binary = d >= 4 || (d == 2 && t >= 43200);
+            if (binary && d == 4 && t == 50000) {
+                sd_log_record_t torn = rec;
+                torn.conductivity += 1.0f;                           // CRC no longer matches
+                appendBin(bin, idx, count, torn);
+                continue;
+            }
+            if (binary) appendBin(bin, idx, count, rec);
+            else appendCsv(csv, rec);
+            all.push_back(rec);
+        }
+        if (d <= 2) {
+            snprintf(path, sizeof(path), "/logs/%s.csv", date);
+            card.files[path] = csv;
+        }
+        if (d >= 2) {
+            snprintf(path, sizeof(path), "/logs/%s.bin", date);
+            card.files[path] = bin;
+            snprintf(path, sizeof(path), "/logs/%s.idx", date);
+            card.files[path] = idx;
+        }
+    }
+}
+
+// Expected output by brute force over `all`
+static std::string expected(uint32_t from, uint32_t to, uint32_t fields, uint32_t step) {
+    fields = (fields ? fields : (1UL << SD_CSV_FIELDS) - 1) | 1;
+    std::string s;
+    char buf[SD_CSV_MAX_LINE];
+    for (uint8_t i = 0, first = 1; i < SD_CSV_FIELDS; i++) {
+        if (!(fields & (1UL << i))) continue;
+        if (!first) s += ',';
+        s += sdlog_field_name(i);
+        first = 0;
+    }
+    s += '\n';
+    uint32_t next = 0;
+    for (const sd_log_record_t& rec : all) {
+        if (rec.timestamp < from || rec.timestamp > to) continue;
+        if (step > 1) {
+            if (rec.timestamp < next) continue;
+            next = (rec.timestamp / step + 1) * step;
+        }
+        for (uint8_t i = 0, first = 1; i < SD_CSV_FIELDS; i++) {
+            if (!(fields & (1UL << i))) continue;
+            if (!first) s += ',';
+            sdlog_format_field(&rec, i, buf, sizeof(buf));
+            s += buf;
+            first = 0;
+        }
+        s += '\n';
+    }
+    return s;
+}
+
+static std::string readAll(SDHistoryReader& r, size_t piece) {
+    std::string s;
+    std::vector<char> buf(piece);
+    size_t n;
+    while ((n = r.read(buf.data(), piece)) > 0) s.append(buf.data(), n);
+    return s;
+}
+
+void run_sd_history_tests() {
+    Serial.println("\n=== SD History Reader Tests ===\n");
+    setenv("TZ", "UTC0", 1);
+    tzset();
+
+    // Test 1: CSV round trip
+    Serial.println("Test 1: CSV row -> record -> CSV row");
+    bool same = true;
+    for (int i = 0; i < 1000; i++) {
+        sd_log_record_t a = makeRecord(DAY0 + rnd() % 86400), b;
+        char la[SD_CSV_MAX_LINE], lb[SD_CSV_MAX_LINE];
+        sdlog_format_csv(&a, la, sizeof(la));
+        if (!sdlog_parse_csv(la, &b)) same = false;
+        sdlog_format_csv(&b, lb, sizeof(lb));
+        if (strcmp(la, lb) != 0 || !sdlog_record_valid(&b)) same = false;
+    }
+    sd_log_record_t rec;
+    ASSERT_TRUE(same);
+    ASSERT_TRUE(!sdlog_parse_csv(SD_CSV_HEADER, &rec));
+    ASSERT_TRUE(!sdlog_parse_csv("1700000000,2500.0,180.0", &rec));
+    Serial.printf("  1000 rows identical: %s\n\n", same ? "yes" : "NO");
+
+    buildCard();
+    SDHistoryReader reader(&card, "/logs");
+
+    // Test 2: random ranges against brute force
+    Serial.println("Test 2: 200 random ranges / fields / steps vs full scan");
+    int mismatches = 0;
+    uint32_t rows = 0;
+    for (int q = 0; q < 200; q++) {
+        uint32_t from = DAY0 - 3600 + rnd() % (DAYS * 86400 + 7200);
+        uint32_t to = from + rnd() % (q % 4 == 0 ? DAYS * 86400 : 7200);
+        uint32_t fields = (q % 3 == 0) ? 0 : (rnd() & ((1UL << SD_CSV_FIELDS) - 1));
+        uint32_t step = (q % 5 == 0) ? 0 : 1 + rnd() % 900;
+        ASSERT_TRUE(reader.begin(from, to, fields, step));
+        std::string got = readAll(reader, 1400);
+        if (got != expected(from, to, fields, step)) mismatches++;
+        rows += reader.getRows();
+    }
+    Serial.printf("  %d mismatches, %lu rows\n\n", mismatches, (unsigned long)rows);
+    ASSERT_TRUE(mismatches == 0);
+    ASSERT_TRUE(card.opens == 0);                   // Every file closed at the end
+
+    // Test 3: read size does not change the output
+    Serial.println("Test 3: whole range read in 1, 7, 100 and 4096 byte pieces");
+    uint32_t from = DAY0 + 86400 + 80000, to = DAY0 + 2 * 86400 + 50000;
+    std::string ref = expected(from, to, 0x3F, 0);
+    bool all_same = true;
+    const size_t pieces[] = { 1, 7, 100, 4096 };
+    for (size_t p : pieces) {
+        reader.begin(from, to, 0x3F, 0);
+        if (readAll(reader, p) != ref) all_same = false;
+    }
+    Serial.printf("  %u bytes each time: %s\n\n", (unsigned)ref.size(), all_same ? "identical" : "DIFFERENT");
+    ASSERT_TRUE(all_same);
+
+    // Test 4: reads per query
+    Serial.println("Test 4: card reads for a 10 min range in a day file");
+    card.reads = 0;
+    card.largest = 0;
+    reader.begin(DAY0 + 30000, DAY0 + 30600, 0, 0);     // CSV day (~1.1 MB)
+    readAll(reader, 1400);
+    uint32_t csv_reads = card.reads, csv_rows = reader.getRows();
+    card.reads = 0;
+    reader.begin(DAY0 + 5 * 86400 + 30000, DAY0 + 5 * 86400 + 30600, 0, 0);   // Binary day (380 KB)
+    readAll(reader, 1400);
+    uint32_t bin_reads = card.reads, bin_rows = reader.getRows();
+    Serial.printf("  CSV: %lu reads for %lu rows; binary: %lu reads for %lu rows; largest read %u bytes\n\n",
+                  (unsigned long)csv_reads, (unsigned long)csv_rows,
+                  (unsigned long)bin_reads, (unsigned long)bin_rows, (unsigned)card.largest);
+    ASSERT_TRUE(csv_rows >= 60 && csv_rows <= 61 && bin_rows >= 60 && bin_rows <= 61);
+    ASSERT_TRUE(csv_reads < 40 && bin_reads < 30);
+    ASSERT_TRUE(card.largest <= SD_HIST_BLOCK);
+
+    // Test 5: edge cases
+    Serial.println("Test 5: torn record, missing day, bad arguments");
+    reader.begin(DAY0 + 4 * 86400 + 49990, DAY0 + 4 * 86400 + 50020, 1, 0);
+    std::string torn = readAll(reader, 1400);
+    ASSERT_TRUE(torn == expected(DAY0 + 4 * 86400 + 49990, DAY0 + 4 * 86400 + 50020, 1, 0));
+    ASSERT_TRUE(reader.getRows() >= 2 && reader.getRows() <= 3);    // The torn one (50000) is skipped
+    reader.begin(DAY0 + 3 * 86400, DAY0 + 4 * 86400 - 1, 0, 0);
+    ASSERT_TRUE(readAll(reader, 1400) == expected(1, 0, 0, 0) && reader.getRows() == 0);
+    ASSERT_TRUE(!reader.begin(10, 5, 0, 0));
+    ASSERT_TRUE(!reader.begin(0, (SD_HIST_MAX_DAYS + 1) * 86400UL, 0, 0));
+
+    uint32_t mask;
+    ASSERT_TRUE(SDHistoryReader::parseFields("conductivity,temperature", &mask) && mask == 0x6);
+    ASSERT_TRUE(!SDHistoryReader::parseFields("conductivity,ph", &mask));
+    Serial.printf("  %u bytes around the torn record\n\n", (unsigned)torn.size());
+
+    // Test 6: a later log version appends fields to each record
+    Serial.println("Test 6: binary day with longer records (later version)");
+    char date[12], path[40];
+    sdhist_date(DAY0 + 5 * 86400 + 43200, date, sizeof(date));
+    snprintf(path, sizeof(path), "/logs/%s.bin", date);
+    const std::vector<uint8_t>& v1 = card.files[path];
+    const uint8_t extra = 8;
+    std::vector<uint8_t> v2(v1.begin(), v1.begin() + SD_BIN_HEADER_SIZE);
+    sd_log_file_header_t* hdr = (sd_log_file_header_t*)v2.data();
+    hdr->version = SD_BIN_VERSION + 1;
+    hdr->record_size = SD_BIN_RECORD_SIZE + extra;
+    for (size_t off = SD_BIN_HEADER_SIZE; off + SD_BIN_RECORD_SIZE <= v1.size(); off += SD_BIN_RECORD_SIZE) {
+        v2.insert(v2.end(), v1.begin() + off, v1.begin() + off + SD_BIN_RECORD_SIZE);
+        v2.insert(v2.end(), extra, 0xEE);
+    }
+    card.files[path] = v2;
+    from = DAY0 + 5 * 86400 + 20000;
+    to = from + 7200;
+    reader.begin(from, to, 0, 0);
+    std::string later = readAll(reader, 1400);
+    Serial.printf("  %lu rows, same as version 1: %s\n\n", (unsigned long)reader.getRows(),
+                  later == expected(from, to, 0, 0) ? "yes" : "NO");
+    ASSERT_TRUE(later == expected(from, to, 0, 0) && reader.getRows() >= 700);
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_sd_history_tests();
+}
+
+void loop() {
+    delay(10000);
+}
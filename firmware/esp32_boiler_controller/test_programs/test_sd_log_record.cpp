@@ -0,0 +1,207 @@
+/**
+ * @file test_sd_log_record.cpp
+ * @brief Binary SD log record (src/sd_log_record.cpp) tests
+ *
+ *   - CSV from a record matches the previous float snprintf row at logged resolution
+ *   - CRC detects every single-bit corruption of a record
+ *   - Sparse index: scan start found by binary search gives the same first match
+ *     as a full scan, and scans at most one index interval
+ *   - Size of a day at 10 s (binary vs CSV) and pack/format cost per reading
+ *
+ * Runs on the ESP32 (env test_sd_log_record) or on the host:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/test_sd_log_record.cpp src/sd_log_record.cpp src/coprocessor_protocol.cpp \
+ *       test_programs/host/host_main.cpp -o /tmp/test_sd_log_record && /tmp/test_sd_log_record
+ */
+
+#include <Arduino.h>
+#include "sd_log_record.h"
+
+#define ASSERT_TRUE(x) do { if (x) passed++; else { Serial.printf("FAIL line %d: expected true\n", __LINE__); failed++; } } while(0)
+
+static int passed = 0;
+static int failed = 0;
+
+static uint32_t s_seed = 12345;
+static uint32_t rnd() {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return s_seed >> 8;
+}
+
+/**
+ * @brief A plausible reading at the resolution the CSV prints
+ */
+static void makeReading(sensor_reading_t* r, uint32_t t) {
+    memset(r, 0, sizeof(*r));
+    r->timestamp = t;
+    r->conductivity = (2000 + rnd() % 10000) / 10.0f + 2000.0f;
+    r->temperature = (int)(rnd() % 2000) / 10.0f - 10.0f;
+    r->water_meter1 = 100000 + rnd() % 1000;
+    r->water_meter2 = rnd() % 5000;
+    r->flow_rate = (rnd() % 2500) / 100.0f;
+    r->blowdown_active = rnd() & 1;
+    r->valve_position_mA = (40 + rnd() % 161) / 10.0f;
+    r->pump1_active = rnd() & 1;
+    r->pump2_active = rnd() & 1;
+    r->pump3_active = rnd() & 1;
+    r->feedwater_pump_on = rnd() & 1;
+    r->fw_pump_cycle_count = rnd() % 100000;
+    r->fw_pump_on_time_sec = rnd();
+    r->active_alarms = rnd() & 0xFFFF;
+    r->safe_mode = rnd() % 4;
+    r->cond_sensor_valid = rnd() & 1;
+    r->temp_sensor_valid = rnd() & 1;
+    r->devices_operational = rnd() % 16;
+    r->devices_faulted = rnd() % 4;
+    r->devices_faulted_mask = rnd() & 0xFFFF;
+    r->measurement_age_ms = rnd() % 60000;
+}
+
+// The CSV row as SDLogger::logReading formatted it before the binary format
+static int legacyCsv(const sensor_reading_t* reading, char* line, size_t len) {
+    return snprintf(line, len,
+        "%lu,%.1f,%.1f,%lu,%lu,%.2f,%d,%.1f,%d,%d,%d,%d,%lu,%lu,0x%04X,"
+        "%u,%d,%d,%u,%u,0x%04X,%lu",
+        (unsigned long)reading->timestamp, reading->conductivity, reading->temperature,
+        (unsigned long)reading->water_meter1, (unsigned long)reading->water_meter2,
+        reading->flow_rate, reading->blowdown_active ? 1 : 0, reading->valve_position_mA,
+        reading->pump1_active ? 1 : 0, reading->pump2_active ? 1 : 0, reading->pump3_active ? 1 : 0,
+        reading->feedwater_pump_on ? 1 : 0,
+        (unsigned long)reading->fw_pump_cycle_count, (unsigned long)reading->fw_pump_on_time_sec,
+        reading->active_alarms, reading->safe_mode,
+        reading->cond_sensor_valid ? 1 : 0, reading->temp_sensor_valid ? 1 : 0,
+        reading->devices_operational, reading->devices_faulted, reading->devices_faulted_mask,
+        (unsigned long)reading->measurement_age_ms);
+}
+
+void run_sd_log_record_tests() {
+    Serial.println("\n=== Binary SD Log Record Tests ===\n");
+
+    sensor_reading_t r;
+    sd_log_record_t rec;
+    char a[SD_CSV_MAX_LINE], b[SD_CSV_MAX_LINE];
+
+    // Test 1: CSV equivalence
+    Serial.println("Test 1: CSV from record vs legacy row (2000 readings)");
+    int mismatches = 0;
+    for (int i = 0; i < 2000; i++) {
+        makeReading(&r, 1750000000UL + i * 10);
+        sdlog_pack(&r, &rec);
+        legacyCsv(&r, a, sizeof(a));
+        sdlog_format_csv(&rec, b, sizeof(b));
+        if (strcmp(a, b) != 0) {
+            if (mismatches++ < 3) Serial.printf("  legacy %s\n  record %s\n", a, b);
+        }
+    }
+    Serial.printf("  %d mismatches, record %u bytes, header %u bytes\n\n",
+                  mismatches, (unsigned)sizeof(sd_log_record_t), (unsigned)sizeof(sd_log_file_header_t));
+    ASSERT_TRUE(mismatches == 0);
+    ASSERT_TRUE(sizeof(sd_log_record_t) == SD_BIN_RECORD_SIZE);
+
+    // Out-of-range values saturate instead of wrapping
+    r.flow_rate = 1000.0f;
+    r.temperature = NAN;
+    sdlog_pack(&r, &rec);
+    ASSERT_TRUE(rec.flow_cgpm == UINT16_MAX && rec.temperature_d == 0);
+
+    // Test 2: CRC
+    Serial.println("Test 2: every single-bit flip fails the CRC");
+    makeReading(&r, 1750000000UL);
+    sdlog_pack(&r, &rec);
+    ASSERT_TRUE(sdlog_record_valid(&rec));
+    int undetected = 0;
+    for (size_t byte = 0; byte < sizeof(rec); byte++) {
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            sd_log_record_t c = rec;
+            ((uint8_t*)&c)[byte] ^= (uint8_t)(1u << bit);
+            if (sdlog_record_valid(&c)) undetected++;
+        }
+    }
+    sd_log_record_t blank;
+    memset(&blank, 0xFF, sizeof(blank));           // Padding after a torn write
+    Serial.printf("  %d undetected of %u\n\n", undetected, (unsigned)(sizeof(rec) * 8));
+    ASSERT_TRUE(undetected == 0);
+    ASSERT_TRUE(!sdlog_record_valid(&blank));
+
+    sd_log_file_header_t hdr;
+    sdlog_init_header(&hdr);
+    ASSERT_TRUE(sdlog_check_header(&hdr) == SD_BIN_RECORD_SIZE);
+    hdr.version = SD_BIN_VERSION + 1;              // Later version with appended fields
+    hdr.record_size = SD_BIN_RECORD_SIZE + 8;
+    ASSERT_TRUE(sdlog_check_header(&hdr) == SD_BIN_RECORD_SIZE + 8);
+    hdr.record_size = SD_BIN_RECORD_SIZE - 1;
+    ASSERT_TRUE(sdlog_check_header(&hdr) == 0);
+    sdlog_init_header(&hdr);
+    hdr.version = 0;
+    ASSERT_TRUE(sdlog_check_header(&hdr) == 0);
+    sdlog_init_header(&hdr);
+    hdr.magic ^= 1;
+    ASSERT_TRUE(sdlog_check_header(&hdr) == 0);
+
+    // Test 3: index search against a full scan (a day at 10 s, repeated timestamps)
+    Serial.println("Test 3: sparse index lookup");
+    const uint32_t N = 8640;
+    static uint32_t ts[N];
+    static sd_log_index_entry_t index[N / SD_BIN_INDEX_INTERVAL + 1];
+    size_t n_index = 0;
+    uint32_t t = 1750000000UL;
+    for (uint32_t i = 0; i < N; i++) {
+        t += (rnd() % 5 == 0) ? 0 : 10;            // Some readings share a second
+        ts[i] = t;
+        if (i % SD_BIN_INDEX_INTERVAL == 0) index[n_index++] = { t, i };
+    }
+    int wrong = 0;
+    uint32_t max_scan = 0;
+    for (int q = 0; q < 5000; q++) {
+        uint32_t target = ts[0] - 100 + rnd() % (ts[N - 1] - ts[0] + 200);
+        uint32_t expect = 0;
+        while (expect < N && ts[expect] < target) expect++;
+        uint32_t start = sdlog_index_start(index, n_index, target);
+        uint32_t found = start;
+        while (found < N && ts[found] < target) found++;
+        if (found != expect) wrong++;
+        max_scan = max(max_scan, found - start);
+    }
+    Serial.printf("  %u index entries (%u bytes), %d wrong, longest scan %u records\n\n",
+                  (unsigned)n_index, (unsigned)(n_index * sizeof(sd_log_index_entry_t)), wrong, max_scan);
+    ASSERT_TRUE(wrong == 0);
+    ASSERT_TRUE(max_scan <= SD_BIN_INDEX_INTERVAL);
+
+    // Test 4: size and cost
+    Serial.println("Test 4: one day at 10 s, size and cost per reading");
+    size_t csv_bytes = strlen(SD_CSV_HEADER) + 2, bin_bytes = SD_BIN_HEADER_SIZE;
+    uint32_t us_csv = 0, us_bin = 0;
+    for (uint32_t i = 0; i < N; i++) {
+        makeReading(&r, ts[i]);
+        uint32_t t0 = micros();
+        int len = legacyCsv(&r, a, sizeof(a));
+        uint32_t t1 = micros();
+        sdlog_pack(&r, &rec);
+        uint32_t t2 = micros();
+        us_csv += t1 - t0;
+        us_bin += t2 - t1;
+        csv_bytes += len + 2;                       // println adds CR LF
+        bin_bytes += sizeof(rec);
+    }
+    bin_bytes += n_index * sizeof(sd_log_index_entry_t);
+    Serial.printf("  CSV %u bytes, binary + index %u bytes (%.1fx smaller)\n",
+                  (unsigned)csv_bytes, (unsigned)bin_bytes, (float)csv_bytes / bin_bytes);
+    Serial.printf("  format %.2f us (snprintf) vs pack + CRC %.2f us per reading\n\n",
+                  (float)us_csv / N, (float)us_bin / N);
+    ASSERT_TRUE(csv_bytes > 2 * bin_bytes);
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_sd_log_record_tests();
+}
+
+void loop() {
+    delay(10000);
+}
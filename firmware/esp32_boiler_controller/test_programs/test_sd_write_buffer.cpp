@@ -0,0 +1,201 @@
+/**
+ * @file test_sd_write_buffer.cpp
+ * @brief SD writer queue and block staging (src/sd_write_buffer.cpp) tests
+ *
+ *   - Queue: several producer threads and one consumer; every message arrives
+ *     exactly once and in order per producer, or is counted as dropped
+ *   - Queue: a full queue drops instead of blocking, high water = slots
+ *   - Stager: every full block write is block-sized and ends block-aligned in
+ *     the file whatever the starting file size; partial (hold) writes realign;
+ *     the written bytes equal the appended bytes
+ *   - Bus holds for a day of CSV readings: per line vs per block
+ *
+ * Runs on the ESP32 (env test_sd_write_buffer) or on the host:
+ *   g++ -O2 -std=gnu++17 -pthread -Itest_programs/host -Iinclude \
+ *       test_programs/test_sd_write_buffer.cpp src/sd_write_buffer.cpp \
+ *       test_programs/host/host_main.cpp -o /tmp/test_sd_write_buffer && /tmp/test_sd_write_buffer
+ */
+
+#include <Arduino.h>
+#include <thread>
+#include <vector>
+#include "sd_write_buffer.h"
+
+#define ASSERT_TRUE(x) do { if (x) passed++; else { Serial.printf("FAIL line %d: expected true\n", __LINE__); failed++; } } while(0)
+
+static int passed = 0;
+static int failed = 0;
+
+static uint32_t s_seed = 12345;
+static uint32_t rnd() {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return s_seed >> 8;
+}
+
+typedef struct {
+    uint32_t producer;
+    uint32_t seq;
+} test_msg_t;
+
+#define PRODUCERS       4
+#define PER_PRODUCER    20000
+
+static SDWriteQueue s_queue;
+
+void run_sd_write_buffer_tests() {
+    Serial.println("\n=== SD Write Buffer Tests ===\n");
+
+    // Test 1: concurrent producers, one consumer
+    Serial.printf("Test 1: %d producers x %d messages, one consumer\n", PRODUCERS, PER_PRODUCER);
+    std::atomic<uint32_t> accepted[PRODUCERS];
+    for (int p = 0; p < PRODUCERS; p++) accepted[p] = 0;
+    std::atomic<bool> done(false);
+    uint32_t received = 0, out_of_order = 0, bad_len = 0;
+    uint32_t next[PRODUCERS] = {};
+
+    std::thread consumer([&]() {
+        sd_msg_t m;
+        for (;;) {
+            bool finished = done.load();
+            if (!s_queue.pop(&m)) {
+                if (finished) break;            // Producers had stopped before this empty pop
+                std::this_thread::yield();
+                continue;
+            }
+            test_msg_t t;
+            if (m.kind != SD_MSG_READING || m.len != sizeof(t)) { bad_len++; continue; }
+            memcpy(&t, m.payload, sizeof(t));
+            if (t.producer >= PRODUCERS || t.seq < next[t.producer]) out_of_order++;
+            else next[t.producer] = t.seq + 1;
+            received++;
+        }
+    });
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&, p]() {
+            for (uint32_t i = 0; i < PER_PRODUCER; i++) {
+                test_msg_t t = { p, i };
+                if (s_queue.push(SD_MSG_READING, &t, sizeof(t))) accepted[p]++;
+                if ((i & 63) == 0) std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    done = true;
+    consumer.join();
+
+    uint32_t total_accepted = 0;
+    for (int p = 0; p < PRODUCERS; p++) total_accepted += accepted[p];
+    Serial.printf("  received %u, dropped %u, high water %u, out of order %u\n\n",
+                  received, s_queue.getDropped(), s_queue.getHighWater(), out_of_order);
+    ASSERT_TRUE(received == total_accepted);
+    ASSERT_TRUE(received + s_queue.getDropped() == (uint32_t)PRODUCERS * PER_PRODUCER);
+    ASSERT_TRUE(out_of_order == 0 && bad_len == 0);
+    ASSERT_TRUE(s_queue.getHighWater() <= SD_QUEUE_SLOTS);
+
+    // Test 2: nobody consuming
+    Serial.println("Test 2: full queue drops without blocking");
+    static SDWriteQueue q;
+    uint32_t ok = 0;
+    for (uint32_t i = 0; i < SD_QUEUE_SLOTS + 5; i++) {
+        if (q.push(SD_MSG_EVENT, "x", 1)) ok++;
+    }
+    sd_msg_t m;
+    uint32_t popped = 0;
+    while (q.pop(&m)) popped++;
+    Serial.printf("  accepted %u, dropped %u, popped %u\n\n", ok, q.getDropped(), popped);
+    ASSERT_TRUE(ok == SD_QUEUE_SLOTS && q.getDropped() == 5 && popped == SD_QUEUE_SLOTS);
+    ASSERT_TRUE(q.getHighWater() == SD_QUEUE_SLOTS);
+    ASSERT_TRUE(q.push(SD_MSG_EVENT, "y", 1));      // Slots reused on the next lap
+
+    // Test 3: block alignment
+    Serial.println("Test 3: staged writes land block-aligned");
+    const size_t BLOCK = 512;
+    static uint8_t b0[BLOCK], b1[BLOCK];
+    SDBlockStager st;
+    st.begin(b0, b1, BLOCK);
+    int misaligned = 0, wrong_size = 0, mismatched = 0, full_writes = 0, tail_writes = 0;
+    for (int trial = 0; trial < 50; trial++) {
+        std::vector<uint8_t> in, file(rnd() % 3000);    // Existing file of any size
+        size_t start = file.size();
+        st.reset(file.size());
+        for (int i = 0; i < 400; i++) {
+            uint8_t line[140];
+            size_t len = 1 + rnd() % sizeof(line);
+            for (size_t k = 0; k < len; k++) line[k] = (uint8_t)rnd();
+            in.insert(in.end(), line, line + len);
+
+            size_t n = 0;
+            while (n < len) {
+                n += st.append(line + n, len - n);
+                // Writer: all full blocks, now and then a hold-time partial write
+                const uint8_t* d;
+                size_t dl;
+                bool tail = (rnd() % 40 == 0);
+                while (st.peek(&d, &dl, tail)) {
+                    bool was_full = st.hasFullBlock();
+                    file.insert(file.end(), d, d + dl);
+                    if (st.consume(dl)) {
+                        full_writes++;
+                        if (file.size() % BLOCK != 0) misaligned++;
+                        if (dl > BLOCK) wrong_size++;
+                    } else {
+                        tail_writes++;
+                        if (was_full) wrong_size++;     // A full block must be written whole
+                    }
+                }
+            }
+        }
+        const uint8_t* d;
+        size_t dl;
+        while (st.peek(&d, &dl, true)) {
+            file.insert(file.end(), d, d + dl);
+            st.consume(dl);
+        }
+        if (st.getStaged() != 0 || file.size() - start != in.size() ||
+            memcmp(file.data() + start, in.data(), in.size()) != 0) mismatched++;
+    }
+    Serial.printf("  %d full / %d partial writes, %d misaligned, %d wrong size, %d trials corrupted\n\n",
+                  full_writes, tail_writes, misaligned, wrong_size, mismatched);
+    ASSERT_TRUE(full_writes > 1000 && tail_writes > 0);
+    ASSERT_TRUE(misaligned == 0 && wrong_size == 0);
+    ASSERT_TRUE(mismatched == 0);
+
+    // Test 4: bus holds per day at 10 s logging, ~100-byte CSV rows
+    Serial.println("Test 4: SPI holds for one day of CSV readings");
+    static uint8_t c0[4096], c1[4096];
+    SDBlockStager day;
+    day.begin(c0, c1, sizeof(c0));
+    day.reset(strlen("header") + 2);
+    uint32_t rows = 8640, holds = 0, bytes = 0;
+    uint8_t row[100];
+    memset(row, '1', sizeof(row));
+    for (uint32_t i = 0; i < rows; i++) {
+        day.append(row, sizeof(row));
+        const uint8_t* d;
+        size_t dl;
+        while (day.peek(&d, &dl, false)) {
+            day.consume(dl);
+            holds++;
+            bytes += dl;
+        }
+    }
+    Serial.printf("  %u rows: %u bus holds per line vs %u per block (%u bytes each)\n\n",
+                  rows, rows, holds, (unsigned)sizeof(c0));
+    ASSERT_TRUE(holds * 40 < rows);
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_sd_write_buffer_tests();
+}
+
+void loop() {
+    delay(10000);
+}
@@ -0,0 +1,266 @@
+/**
+ * @file test_spool_record.cpp
+ * @brief Telemetry spool record and replay reader (src/spool_record.cpp) tests
+ *
+ *   - Readings, events and alarms pack into 128-byte records that check out
+ *     and unpack to what was packed; a flipped byte fails the CRC; an MQTT
+ *     stamp keeps the record valid and survives the trip
+ *   - Over several segment files the reader returns every record in order,
+ *     one card read per four records, and resumes at any cursor
+ *   - Torn records, records dropped for space, lost segments and segments
+ *     cut short are skipped and counted; the segment being written is never
+ *     skipped, and records appended after a short read are picked up
+ *
+ * Segment files live in memory behind SDHistorySource. Runs on the ESP32
+ * (env test_spool_record) or on the host:
+ *   g++ -O2 -std=gnu++17 -Itest_programs/host -Iinclude \
+ *       test_programs/test_spool_record.cpp src/spool_record.cpp src/sd_log_record.cpp \
+ *       src/coprocessor_protocol.cpp test_programs/host/host_main.cpp \
+ *       -o /tmp/test_spool_record && /tmp/test_spool_record
+ */
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "spool_record.h"
+
+#define ASSERT_TRUE(x) do { if (x) passed++; else { Serial.printf("FAIL line %d: expected true\n", __LINE__); failed++; } } while(0)
+
+static int passed = 0;
+static int failed = 0;
+
+static uint32_t s_seed = 12345;
+static uint32_t rnd() {
+    s_seed = s_seed * 1664525UL + 1013904223UL;
+    return s_seed >> 8;
+}
+
+// ============================================================================
+// IN-MEMORY CARD
+// ============================================================================
+
+// Like an SD File, a reader sees the size the file had when it was opened
+class MemSource : public SDHistorySource {
+public:
+    std::map<std::string, std::vector<uint8_t>> files;
+    const std::vector<uint8_t>* cur = nullptr;
+    size_t curSize = 0;
+    uint32_t reads = 0;
+    int opens = 0;
+
+    bool open(const char* path) override {
+        auto it = files.find(path);
+        cur = it == files.end() ? nullptr : &it->second;
+        if (!cur) return false;
+        curSize = cur->size();
+        opens++;
+        return true;
+    }
+    int32_t read(uint32_t offset, uint8_t* buf, size_t len) override {
+        if (!cur) return -1;
+        reads++;
+        if (offset >= curSize) return 0;
+        size_t n = min(len, curSize - offset);
+        memcpy(buf, cur->data() + offset, n);
+        return (int32_t)n;
+    }
+    uint32_t size() override { return cur ? (uint32_t)curSize : 0; }
+    void close() override {
+        if (cur) opens--;
+        cur = nullptr;
+    }
+};
+
+static MemSource card;
+static uint32_t s_head = 0;             // Records written (writer's head)
+
+static std::string segmentPath(uint32_t segment) {
+    char path[40];
+    spool_segment_path("/spool", segment, path, sizeof(path));
+    return path;
+}
+
+// Record n carries timestamp 1700000000 + n, so order is easy to check
+static void makeRecord(uint32_t n, spool_record_t* rec) {
+    uint32_t ts = 1700000000UL + n;
+    switch (n % 3) {
+        case 0: {
+            sensor_reading_t r;
+            memset(&r, 0, sizeof(r));
+            r.timestamp = ts;
+            r.conductivity = 2000.0f + (float)(rnd() % 10000) / 10.0f;
+            r.temperature = 180.5f;
+            r.water_meter1 = n;
+            r.cond_sensor_valid = true;
+            spool_pack_reading(&r, rec);
+            break;
+        }
+        case 1:
+            spool_pack_event(ts, "PUMP_ON", "Pump 1 started by timer", (int32_t)n, rec);
+            break;
+        default:
+            spool_pack_alarm(ts, (uint16_t)(n & 0xFF), "HIGH CONDUCTIVITY", n & 1, 3100.0f, rec);
+            break;
+    }
+}
+
+static void append(uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, s_head++) {
+        spool_record_t rec;
+        makeRecord(s_head, &rec);
+        std::vector<uint8_t>& f = card.files[segmentPath(s_head / SPOOL_SEGMENT_RECORDS)];
+        f.insert(f.end(), (const uint8_t*)&rec, (const uint8_t*)&rec + sizeof(rec));
+    }
+}
+
+// Replay [cursor, head): returns records read; false in *ordered on a gap
+// other than the expected skips
+static uint32_t replay(SpoolReader& reader, uint32_t first, uint32_t head, bool* ordered) {
+    spool_record_t rec;
+    uint32_t count = 0;
+    uint32_t last = 0;
+    *ordered = true;
+    while (reader.peek(first, head, &rec)) {
+        uint32_t n = rec.timestamp - 1700000000UL;
+        if (n != reader.tell() || (count && n <= last)) *ordered = false;
+        last = n;
+        reader.advance();
+        count++;
+    }
+    return count;
+}
+
+void run_spool_record_tests() {
+    Serial.println("\n=== Telemetry Spool Record Tests ===\n");
+
+    // Test 1: pack / check / unpack
+    Serial.println("Test 1: pack, CRC and unpack");
+    spool_record_t rec;
+    sensor_reading_t r, back;
+    memset(&r, 0, sizeof(r));
+    r.timestamp = 1700000123;
+    r.conductivity = 2875.5f;
+    r.temperature = 182.3f;
+    r.flow_rate = 12.34f;
+    r.pump2_active = true;
+    r.active_alarms = 0x21;
+    r.temp_sensor_valid = true;
+    spool_pack_reading(&r, &rec);
+    sdlog_unpack(&rec.reading, &back);
+    ASSERT_TRUE(spool_record_valid(&rec) && rec.kind == SPOOL_READING && rec.timestamp == r.timestamp);
+    ASSERT_TRUE(back.conductivity == r.conductivity && fabsf(back.temperature - r.temperature) < 0.05f);
+    ASSERT_TRUE(fabsf(back.flow_rate - r.flow_rate) < 0.005f && back.pump2_active && !back.pump1_active);
+    ASSERT_TRUE(back.active_alarms == 0x21 && back.temp_sensor_valid && !back.cond_sensor_valid);
+
+    spool_pack_event(1700000200, "BLOWDOWN_START", "A description longer than the seventy-five characters an event record has room for in its fixed slot", -5, &rec);
+    ASSERT_TRUE(spool_record_valid(&rec) && rec.kind == SPOOL_EVENT && rec.event.value == -5);
+    ASSERT_TRUE(strcmp(rec.event.type, "BLOWDOWN_START") == 0 && strlen(rec.event.description) == 75);
+    ASSERT_TRUE(rec.boot_id == 0 && rec.sequence == 0);
+    spool_stamp(&rec, 0xC0FFEE01UL, 4711);
+    ASSERT_TRUE(spool_record_valid(&rec) && rec.boot_id == 0xC0FFEE01UL && rec.sequence == 4711);
+    rec.sequence++;
+    ASSERT_TRUE(!spool_record_valid(&rec));                        // Stamp is covered by the CRC
+    spool_pack_alarm(1700000300, 7, "VALVE FAULT", true, 3.2f, &rec);
+    ASSERT_TRUE(spool_record_valid(&rec) && rec.alarm.code == 7 && rec.alarm.active == 1);
+    ASSERT_TRUE(strcmp(rec.alarm.name, "VALVE FAULT") == 0 && rec.alarm.trigger_value == 3.2f);
+
+    int detected = 0;
+    for (int i = 0; i < 500; i++) {
+        spool_record_t bad = rec;
+        ((uint8_t*)&bad)[rnd() % sizeof(bad)] ^= (uint8_t)(1 + rnd() % 255);
+        if (!spool_record_valid(&bad)) detected++;
+    }
+    memset(&rec, 0, sizeof(rec));
+    ASSERT_TRUE(detected == 500 && !spool_record_valid(&rec));     // Zeroed slot is not a record
+    Serial.printf("  %d/500 corrupted records rejected\n\n", detected);
+
+    // Test 2: replay across segments
+    Serial.println("Test 2: replay 3.5 segments in order");
+    append(SPOOL_SEGMENT_RECORDS * 3 + SPOOL_SEGMENT_RECORDS / 2);
+    SpoolReader reader(&card, "/spool");
+    bool ordered;
+    uint32_t got = replay(reader, 0, s_head, &ordered);
+    Serial.printf("  %lu of %lu records, %lu card reads\n\n", (unsigned long)got,
+                  (unsigned long)s_head, (unsigned long)reader.getBlockReads());
+    ASSERT_TRUE(got == s_head && ordered && reader.tell() == s_head);
+    ASSERT_TRUE(reader.getSkipped() == 0);
+    ASSERT_TRUE(reader.getBlockReads() <= s_head / SPOOL_BLOCK_RECORDS + 4);
+    reader.close();
+    ASSERT_TRUE(card.opens == 0);
+
+    // Test 3: resume at random cursors (record read after a reboot)
+    Serial.println("Test 3: resume at 100 random cursors");
+    int wrong = 0;
+    for (int i = 0; i < 100; i++) {
+        uint32_t cursor = rnd() % s_head;
+        reader.seek(cursor);
+        if (!reader.peek(0, s_head, &rec) || rec.timestamp != 1700000000UL + cursor || !spool_record_valid(&rec)) wrong++;
+        reader.advance();
+        if (!reader.peek(0, s_head, &rec) && cursor + 1 < s_head) wrong++;
+    }
+    reader.close();
+    Serial.printf("  %d wrong\n\n", wrong);
+    ASSERT_TRUE(wrong == 0);
+
+    // Test 4: writer still appending to the open segment
+    Serial.println("Test 4: records appended after the reader caught up");
+    uint32_t start = s_head;
+    reader.seek(start);
+    ASSERT_TRUE(!reader.peek(0, s_head, &rec));                     // Caught up
+    append(3);
+    ASSERT_TRUE(reader.peek(0, s_head, &rec) && rec.timestamp == 1700000000UL + start);
+    reader.advance();
+    append(10);                                                     // Same open file: stale size
+    got = replay(reader, 0, s_head, &ordered);
+    ASSERT_TRUE(got == 12 && ordered && reader.getSkipped() == 0);
+    Serial.printf("  %lu records picked up after growth\n\n", (unsigned long)got + 1);
+
+    // Test 5: damage and loss
+    Serial.println("Test 5: torn record, dropped records, lost and short segments");
+    std::vector<uint8_t>& seg1 = card.files[segmentPath(1)];
+    seg1[100 * SPOOL_RECORD_SIZE + 40] ^= 0x5A;                     // Torn record 8292
+    reader.seek(SPOOL_SEGMENT_RECORDS);
+    got = replay(reader, 0, SPOOL_SEGMENT_RECORDS * 2, &ordered);
+    ASSERT_TRUE(got == SPOOL_SEGMENT_RECORDS - 1 && reader.getSkipped() == 1);
+
+    uint32_t skipped = reader.getSkipped();
+    reader.seek(10);                                                // Records before first dropped
+    ASSERT_TRUE(reader.peek(SPOOL_SEGMENT_RECORDS / 2, s_head, &rec));
+    ASSERT_TRUE(rec.timestamp == 1700000000UL + SPOOL_SEGMENT_RECORDS / 2);
+    ASSERT_TRUE(reader.getSkipped() - skipped == SPOOL_SEGMENT_RECORDS / 2 - 10);
+    reader.close();
+
+    card.files.erase(segmentPath(2));                               // Card formatted / segment lost
+    seg1.resize(seg1.size() - 50 * SPOOL_RECORD_SIZE);              // Write error: segment 1 cut short
+    skipped = reader.getSkipped();
+    reader.seek(SPOOL_SEGMENT_RECORDS + SPOOL_SEGMENT_RECORDS - 60);
+    got = replay(reader, 0, s_head, &ordered);
+    ASSERT_TRUE(ordered && got == 10 + (s_head - SPOOL_SEGMENT_RECORDS * 3));
+    ASSERT_TRUE(reader.getSkipped() - skipped == 50 + SPOOL_SEGMENT_RECORDS);
+    reader.close();
+
+    card.files.erase(segmentPath(3));                               // Segment still being written
+    reader.seek(SPOOL_SEGMENT_RECORDS * 3);
+    skipped = reader.getSkipped();
+    ASSERT_TRUE(!reader.peek(0, s_head, &rec) && reader.tell() == SPOOL_SEGMENT_RECORDS * 3);
+    ASSERT_TRUE(reader.getSkipped() == skipped);
+    reader.close();
+    ASSERT_TRUE(card.opens == 0);
+    Serial.printf("  %lu records skipped in all\n\n", (unsigned long)reader.getSkipped());
+
+    Serial.println("----------------------------------------");
+    Serial.printf("Result: %d passed, %d failed\n", passed, failed);
+    Serial.println(failed == 0 ? "All passed." : "FAILURES");
+    Serial.println("========================================\n");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    run_spool_record_tests();
+}
+
+void loop() {
+    delay(10000);
+}